@@ -0,0 +1,454 @@
+/* epoll.c - Interest sets with a ready list, for waiting on many descriptors */
+
+#include "epoll.h"
+#include "poll.h"
+#include "syscalls.h"
+#include "paging.h"
+#include "lib.h"
+
+/* Every interest set, free ones have no process */
+static epoll_t epolls[MAX_EPOLLS];
+
+/*
+ * ready_add
+ *    DESCRIPTION: Puts an item at the end of its set's ready list, if it
+ *                 isn't on it, and wakes the set's waiters
+ *    INPUTS: epoll_item* item - the item
+ *    OUTPUTS: none
+ *    RETURN VALUE: none
+ *    SIDE EFFECTS: Called with interrupts masked
+ */
+static void ready_add(epoll_item* item){
+  epoll_t* ep = item->ep;
+
+  if(!item->ready){
+    item->ready = 1;
+    item->next_ready = NULL;
+    if(ep->ready_tail != NULL){
+      ep->ready_tail->next_ready = item;
+    } else{
+      ep->ready_head = item;
+    }
+    ep->ready_tail = item;
+  }
+  if(ep->wait != 0){
+    wake_up(&ep->wait);
+  }
+}
+
+/*
+ * item_free
+ *    DESCRIPTION: Takes an item off its driver's watcher list and its set's
+ *                 ready list and frees it
+ *    INPUTS: epoll_item* item - the item
+ *    OUTPUTS: none
+ *    RETURN VALUE: none
+ *    SIDE EFFECTS: Called with interrupts masked
+ */
+static void item_free(epoll_item* item){
+  epoll_t* ep = item->ep;
+  epoll_item** link;
+  epoll_item* prev = NULL;
+
+  if(item->source != NULL){
+    for(link = item->source; *link != NULL; link = &(*link)->next_watch){
+      if(*link == item){
+        *link = item->next_watch;
+        break;
+      }
+    }
+  }
+
+  if(item->ready){
+    for(link = &ep->ready_head; *link != item; link = &(*link)->next_ready){
+      prev = *link;
+    }
+    *link = item->next_ready;
+    if(ep->ready_tail == item){
+      ep->ready_tail = prev;
+    }
+  }
+
+  item->ep = NULL;
+}
+
+/*
+ * item_poll
+ *    DESCRIPTION: Asks an item's driver what is ready now
+ *    INPUTS: epoll_item* item - the item
+ *    OUTPUTS: none
+ *    RETURN VALUE: the events that happened, out of those wanted
+ *    SIDE EFFECTS: Called with interrupts masked
+ */
+static int32_t item_poll(epoll_item* item){
+  file_desc* file = get_fd(item->fd);
+  int32_t mask;
+
+  if(file == NULL){
+    mask = POLLNVAL;
+  } else if(file->jump_ptr->poll == NULL){
+    mask = POLLIN | POLLOUT;
+  } else{
+    mask = file->jump_ptr->poll(item->fd, 0);
+  }
+  return mask & (item->event.events | POLL_ALWAYS);
+}
+
+/*
+ * get_epoll
+ *    DESCRIPTION: Gets the interest set behind a descriptor
+ *    INPUTS: int32_t epfd - the descriptor
+ *    OUTPUTS: none
+ *    RETURN VALUE: the set, or NULL if epfd isn't an open interest set
+ *    SIDE EFFECTS: none
+ */
+static epoll_t* get_epoll(int32_t epfd){
+  file_desc* file = get_fd(epfd);
+
+  if(file == NULL || file->jump_ptr != &epoll_table){
+    return NULL;
+  }
+  return (epoll_t*)file->inode;
+}
+
+/*
+ * epoll_create
+ *    DESCRIPTION: System call to make an empty interest set
+ *    INPUTS: none
+ *    OUTPUTS: none
+ *    RETURN VALUE: descriptor of the set, or -1 for failure
+ *    SIDE EFFECTS: none
+ */
+int32_t epoll_create(void){
+  unsigned long flags; /* Saved interrupt flag */
+  epoll_t* ep = NULL;
+  file_desc* file;
+  int32_t i, fd;
+
+  cli_and_save(flags);
+  for(i = 0; i < MAX_EPOLLS; i++){
+    if(epolls[i].tgid == 0){
+      ep = &epolls[i];
+      memset(ep, 0, sizeof(epoll_t));
+      ep->tgid = get_pcb_add()->tgid;
+      break;
+    }
+  }
+  restore_flags(flags);
+
+  if(ep == NULL){
+    /* Return failure */
+    return -1;
+  }
+  if((fd = alloc_fd()) == -1){
+    ep->tgid = 0;
+    /* Return failure */
+    return -1;
+  }
+  file = get_fd(fd);
+  file->jump_ptr = &epoll_table;
+  file->inode = (int32_t)ep;
+  return fd;
+}
+
+/*
+ * epoll_ctl
+ *    DESCRIPTION: System call to add a descriptor to an interest set, change
+ *                 what it's watched for, or remove it. A descriptor that is
+ *                 already ready goes straight on the ready list
+ *    INPUTS: int32_t epfd - the interest set
+ *            int32_t op - EPOLL_CTL_ADD, EPOLL_CTL_MOD or EPOLL_CTL_DEL
+ *            int32_t fd - descriptor to watch
+ *            epoll_event* event - events wanted and data to hand back, not
+ *                                 used for EPOLL_CTL_DEL
+ *    OUTPUTS: none
+ *    RETURN VALUE: 0 for success, -1 for failure
+ *    SIDE EFFECTS: Links the item into the driver's watcher list
+ */
+int32_t epoll_ctl(int32_t epfd, int32_t op, int32_t fd, epoll_event* event){
+  unsigned long flags; /* Saved interrupt flag */
+  epoll_t* ep = get_epoll(epfd);
+  file_desc* file = get_fd(fd);
+  epoll_item* item = NULL;
+  int32_t i, ret = 0;
+
+  /* Sets can't watch sets */
+  if(ep == NULL || file == NULL || file->jump_ptr == &epoll_table){
+    /* Return failure */
+    return -1;
+  }
+  /* Check for a valid user event */
+  if(op != EPOLL_CTL_DEL && (event == NULL || (uint8_t*)event < (uint8_t*)USER_PROG ||
+     (uint32_t)event > USER_PROG + FOUR_MB - sizeof(epoll_event))){
+    /* Return failure */
+    return -1;
+  }
+
+  cli_and_save(flags);
+  for(i = 0; i < EPOLL_MAX_ITEMS; i++){
+    if(ep->items[i].ep != NULL && ep->items[i].fd == fd){
+      item = &ep->items[i];
+      break;
+    }
+  }
+
+  switch(op){
+    case EPOLL_CTL_ADD:
+      if(item != NULL){
+        ret = -1;
+        break;
+      }
+      for(i = 0; i < EPOLL_MAX_ITEMS && ep->items[i].ep != NULL; i++){
+      }
+      if(i == EPOLL_MAX_ITEMS){
+        ret = -1;
+        break;
+      }
+      item = &ep->items[i];
+      item->ep = ep;
+      item->fd = fd;
+      item->event = *event;
+      item->ready = 0;
+      item->next_ready = NULL;
+      item->next_watch = NULL;
+      item->source = NULL;
+      /* Drivers that never make a caller wait have nothing to watch */
+      if(file->jump_ptr->watch != NULL){
+        item->source = file->jump_ptr->watch(fd);
+        item->next_watch = *item->source;
+        *item->source = item;
+      }
+      if(item_poll(item)){
+        ready_add(item);
+      }
+      break;
+
+    case EPOLL_CTL_MOD:
+      if(item == NULL){
+        ret = -1;
+        break;
+      }
+      item->event = *event;
+      if(item_poll(item)){
+        ready_add(item);
+      }
+      break;
+
+    case EPOLL_CTL_DEL:
+      if(item == NULL){
+        ret = -1;
+        break;
+      }
+      item_free(item);
+      break;
+
+    default:
+      ret = -1;
+      break;
+  }
+  restore_flags(flags);
+
+  return ret;
+}
+
+/*
+ * epoll_wait
+ *    DESCRIPTION: System call to wait until watched descriptors are ready.
+ *                 Only items on the ready list are checked, so the cost is
+ *                 in what's ready rather than what's watched. Items still
+ *                 ready go back on the list for the next call
+ *    INPUTS: int32_t epfd - the interest set
+ *            epoll_event* events - gets each ready descriptor's events and data
+ *            int32_t maxevents - size of events
+ *            int32_t timeout - milliseconds to wait, 0 to only check, or
+ *                              negative to wait for as long as it takes
+ *    OUTPUTS: events
+ *    RETURN VALUE: number of ready descriptors, 0 if the timeout passed, or
+ *                  -1 for failure
+ *    SIDE EFFECTS: Other processes run while the caller sleeps
+ */
+int32_t epoll_wait(int32_t epfd, epoll_event* events, int32_t maxevents, int32_t timeout){
+  unsigned long flags; /* Saved interrupt flag */
+  epoll_t* ep = get_epoll(epfd);
+  uint32_t deadline = 0; /* PIT tick the timeout ends on */
+  epoll_item* item;
+  epoll_item* last;      /* Item on the ready list when the scan started */
+  int32_t mask, ready;
+
+  /* Check for a valid user array */
+  if(ep == NULL || events == NULL || maxevents <= 0 || maxevents > EPOLL_MAX_ITEMS ||
+     (uint8_t*)events < (uint8_t*)USER_PROG ||
+     (uint32_t)events > USER_PROG + FOUR_MB - maxevents * sizeof(epoll_event)){
+    /* Return failure */
+    return -1;
+  }
+
+  cli_and_save(flags);
+  if(timeout > 0){
+    deadline = pit_ticks + (timeout + MS_PER_TICK - 1) / MS_PER_TICK;
+  }
+
+  while(1){
+    ready = 0;
+    last = ep->ready_tail;
+    while(ready < maxevents && (item = ep->ready_head) != NULL){
+      ep->ready_head = item->next_ready;
+      if(ep->ready_head == NULL){
+        ep->ready_tail = NULL;
+      }
+      item->ready = 0;
+
+      if((mask = item_poll(item)) != 0){
+        events[ready].events = mask;
+        events[ready].data = item->event.data;
+        ready++;
+        /* Still ready until a read or write says otherwise */
+        ready_add(item);
+      }
+      if(item == last){
+        break;
+      }
+    }
+
+    if(ready != 0 || timeout == 0){
+      break;
+    }
+    if(timeout > 0){
+      /* Signed, so the counter wrapping doesn't end the wait early */
+      if((int32_t)(deadline - pit_ticks) <= 0){
+        break;
+      }
+      wait_on(&tick_wait);
+    }
+    wait_on(&ep->wait);
+    if(sched_block() == -1){
+      /* A signal is waiting */
+      ready = -1;
+      break;
+    }
+
+    /* Another thread closed the set */
+    if(get_epoll(epfd) != ep){
+      ready = -1;
+      break;
+    }
+  }
+  restore_flags(flags);
+
+  return ready;
+}
+
+/*
+ * epoll_notify
+ *    DESCRIPTION: Called by a driver when what it watches may have become
+ *                 ready, along with waking its own wait queue
+ *    INPUTS: epoll_item* watchers - the driver's watcher list
+ *    OUTPUTS: none
+ *    RETURN VALUE: none
+ *    SIDE EFFECTS: Wakes the sets' waiters
+ */
+void epoll_notify(epoll_item* watchers){
+  unsigned long flags; /* Saved interrupt flag */
+
+  cli_and_save(flags);
+  for(; watchers != NULL; watchers = watchers->next_watch){
+    ready_add(watchers);
+  }
+  restore_flags(flags);
+}
+
+/*
+ * epoll_forget
+ *    DESCRIPTION: Removes a descriptor the current process is closing from
+ *                 the process' interest sets, before the driver can free
+ *                 what it watches
+ *    INPUTS: int32_t fd - the descriptor
+ *    OUTPUTS: none
+ *    RETURN VALUE: none
+ *    SIDE EFFECTS: none
+ */
+void epoll_forget(int32_t fd){
+  unsigned long flags; /* Saved interrupt flag */
+  int32_t tgid = get_pcb_add()->tgid;
+  int32_t i, j;
+
+  cli_and_save(flags);
+  for(i = 0; i < MAX_EPOLLS; i++){
+    if(epolls[i].tgid != tgid){
+      continue;
+    }
+    for(j = 0; j < EPOLL_MAX_ITEMS; j++){
+      if(epolls[i].items[j].ep != NULL && epolls[i].items[j].fd == fd){
+        item_free(&epolls[i].items[j]);
+      }
+    }
+  }
+  restore_flags(flags);
+}
+
+/*
+ * epoll_open
+ *    DESCRIPTION: Interest sets have no name to open, they come from
+ *                 epoll_create
+ *    INPUTS: const uint8_t* filename - not used
+ *    OUTPUTS: none
+ *    RETURN VALUE: -1 for failure
+ *    SIDE EFFECTS: none
+ */
+int32_t epoll_open(const uint8_t* filename){
+  /* Return failure */
+  return -1;
+}
+
+/*
+ * epoll_close
+ *    DESCRIPTION: Closes an interest set, freeing its items
+ *    INPUTS: int32_t fd - the set
+ *    OUTPUTS: none
+ *    RETURN VALUE: 0 for success, -1 for failure
+ *    SIDE EFFECTS: Wakes threads waiting on the set so they fail
+ */
+int32_t epoll_close(int32_t fd){
+  unsigned long flags; /* Saved interrupt flag */
+  epoll_t* ep = get_epoll(fd);
+  int32_t i;
+
+  if(ep == NULL){
+    /* Return failure */
+    return -1;
+  }
+
+  cli_and_save(flags);
+  for(i = 0; i < EPOLL_MAX_ITEMS; i++){
+    if(ep->items[i].ep != NULL){
+      item_free(&ep->items[i]);
+    }
+  }
+  ep->tgid = 0;
+  if(ep->wait != 0){
+    wake_up(&ep->wait);
+  }
+  restore_flags(flags);
+  return 0;
+}
+
+/*
+ * epoll_poll
+ *    DESCRIPTION: Tells poll whether the set has anything on its ready list
+ *    INPUTS: int32_t fd - the set
+ *            int32_t wait - nonzero to join the set's queue if it hasn't
+ *    OUTPUTS: none
+ *    RETURN VALUE: POLLIN if an item may be ready, 0 if not
+ *    SIDE EFFECTS: Called by poll with interrupts masked
+ */
+int32_t epoll_poll(int32_t fd, int32_t wait){
+  epoll_t* ep = get_epoll(fd);
+
+  if(ep->ready_head != NULL){
+    return POLLIN;
+  }
+  if(wait){
+    wait_on(&ep->wait);
+  }
+  return 0;
+}
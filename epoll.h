@@ -0,0 +1,76 @@
+/* epoll.h - Interest sets with a ready list, for waiting on many descriptors */
+
+#ifndef _EPOLL_H
+#define _EPOLL_H
+
+#include "types.h"
+#include "pit.h"
+
+/* Interest sets open at once */
+#define MAX_EPOLLS          8
+/* Descriptors one interest set watches */
+#define EPOLL_MAX_ITEMS     32
+
+/* epoll_ctl operations */
+#define EPOLL_CTL_ADD       1
+#define EPOLL_CTL_DEL       2
+#define EPOLL_CTL_MOD       3
+
+#ifndef ASM
+
+/* What epoll_ctl takes and epoll_wait gives back, events are poll's */
+typedef struct epoll_event {
+  uint32_t events;                 /* POLLIN and POLLOUT wanted, or what happened */
+  uint32_t data;                   /* The caller's, handed back as is */
+} epoll_event;
+
+struct epoll;
+
+/* One watched descriptor */
+typedef struct epoll_item {
+  struct epoll* ep;                /* Interest set it's in, NULL if the item is free */
+  int32_t fd;                      /* Descriptor of the set's process */
+  epoll_event event;               /* Events wanted and the caller's data */
+  struct epoll_item** source;      /* Driver's watcher list it's on, NULL if always ready */
+  struct epoll_item* next_watch;   /* Next on the driver's list */
+  struct epoll_item* next_ready;   /* Next on the set's ready list */
+  int32_t ready;                   /* Nonzero while on the ready list */
+} epoll_item;
+
+/* An interest set, a driver wakeup puts the item on the ready list so
+ * epoll_wait only looks at descriptors that may be ready */
+typedef struct epoll {
+  int32_t tgid;                    /* Process it belongs to, 0 if the set is free */
+  epoll_item* ready_head;          /* Items that may be ready, oldest first */
+  epoll_item* ready_tail;
+  wait_queue wait;                 /* Callers of epoll_wait */
+  epoll_item items[EPOLL_MAX_ITEMS];
+} epoll_t;
+
+/* Makes an interest set and opens a descriptor for it */
+int32_t epoll_create(void);
+
+/* Adds, changes or removes a watched descriptor */
+int32_t epoll_ctl(int32_t epfd, int32_t op, int32_t fd, epoll_event* event);
+
+/* Waits until watched descriptors are ready, giving back only those */
+int32_t epoll_wait(int32_t epfd, epoll_event* events, int32_t maxevents, int32_t timeout);
+
+/* Puts everything on a driver's watcher list on its set's ready list */
+void epoll_notify(epoll_item* watchers);
+
+/* Stops watching a descriptor the current process closed */
+void epoll_forget(int32_t fd);
+
+/* Interest sets can't be opened by name */
+int32_t epoll_open(const uint8_t* filename);
+
+/* Closes an interest set */
+int32_t epoll_close(int32_t fd);
+
+/* Readiness of an interest set for poll */
+int32_t epoll_poll(int32_t fd, int32_t wait);
+
+#endif /* ASM */
+
+#endif /* _EPOLL_H */
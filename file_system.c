@@ -1,27 +1,396 @@
 #include "file_system.h"
 #include "lib.h"
 #include "syscalls.h"
+#include "paging.h"
+#include "trace.h"
 
-#define FOUR_KB 4096
+#define FOUR_KB FS_BLOCK_SIZE
+
+/* Overlay layout: boot block copy, inode table, inodes, then data blocks */
+#define OVERLAY_INODES      64
+#define OVERLAY_META_BLOCKS (2 + OVERLAY_INODES)
+#define OVERLAY_DBLOCKS     (FS_OVERLAY_SIZE / FOUR_KB - OVERLAY_META_BLOCKS)
+#define BITMAP_BITS         32
 
 /* Address of the file system */
 static boot_block_t* boot_block;
 static uint32_t* fs_start;
 
+/* Physical bounds of the image file_system_init was last given, so it can be loaded again */
+uint32_t fs_image_start;
+uint32_t fs_image_end;
+
+/* Boot block with no files, used when there is no image to mount */
+static uint32_t empty_image[FOUR_KB / 4];
+
+/* Counts from the read-only image, and the first data block in it */
+static uint32_t base_inodes;
+static uint32_t base_dblocks;
+static uint8_t* base_data;
+
+/* Writable overlay, NULL inode_table means the file system is read only */
+static inode_t** inode_table;
+static inode_t* overlay_inodes;
+static uint8_t* overlay_data;
+static uint32_t total_inodes;
+static uint32_t total_dblocks;
+
+/* Overlay free maps, a set bit is in use */
+static uint32_t inode_bitmap[(OVERLAY_INODES + BITMAP_BITS - 1) / BITMAP_BITS];
+static uint32_t dblock_bitmap[(OVERLAY_DBLOCKS + BITMAP_BITS - 1) / BITMAP_BITS];
+
+/* Where the next data block search starts, so appends get consecutive blocks */
+static uint32_t dblock_hint;
+
 /*
  * file_system_init
  *    DESCRIPTION: Initializes the file system
  *    INPUTS: uint32_t* file_sys_start - a pointer to the boot block in memory
+ *            uint32_t file_sys_end - physical address of the end of the image
  *    OUTPUTS: none
- *    RETURN VALUE: none
- *    SIDE EFFECTS: Adds a boot_block_t pointer to the start of the file system
+ *    RETURN VALUE: 0 for success, -1 if there is no image or it is too large
+ *                  for the window, and an empty file system is used instead
+ *    SIDE EFFECTS: Maps the image into the kernel file system window, maps
+ *                  the writable overlay and copies the boot block into it.
+ *                  Loading an image again starts with an empty overlay
  */
-void file_system_init(uint32_t* file_sys_start){
+int32_t file_system_init(uint32_t* file_sys_start, uint32_t file_sys_end){
+  uint32_t image = 0; /* Address of the image in the window */
+  uint32_t i;         /* Loop variable */
+
+  fs_image_start = (uint32_t)file_sys_start;
+  fs_image_end = file_sys_end;
+
+  /* Map the whole image, since large images run past the kernel page */
+  if(file_sys_start != NULL && file_sys_end >= (uint32_t)file_sys_start + FOUR_KB){
+    image = map_kernel_range(FS_IMAGE_ADDR, (uint32_t)file_sys_start, file_sys_end - (uint32_t)file_sys_start);
+  }
+  file_sys_start = image != 0 ? (uint32_t*)image : empty_image;
+
   /* Create a boot block pointer to access boot block values */
   boot_block = (boot_block_t*)file_sys_start;
 
   /* Store starting address of the file system */
   fs_start = file_sys_start;
+
+  base_inodes = boot_block->num_inodes;
+  base_dblocks = boot_block->num_dblocks;
+  base_data = (uint8_t*)fs_start + (base_inodes + 1) * FOUR_KB;
+  total_inodes = base_inodes;
+  total_dblocks = base_dblocks;
+  inode_table = NULL;
+
+  /* Stay read only if the overlay can't be mapped or the inode table can't hold every inode */
+  if(base_inodes > PTRS_PER_BLOCK - OVERLAY_INODES || base_dblocks > (uint32_t)-1 - OVERLAY_DBLOCKS ||
+     map_kernel_range(FS_OVERLAY_ADDR, FS_OVERLAY_ADDR, FS_OVERLAY_SIZE) != FS_OVERLAY_ADDR){
+    return image != 0 ? 0 : -1;
+  }
+
+  /* Dentries are changed in a copy of the boot block */
+  memcpy((void*)FS_OVERLAY_ADDR, boot_block, FOUR_KB);
+  boot_block = (boot_block_t*)FS_OVERLAY_ADDR;
+
+  /* Base inodes start out in the image, and move to the overlay when written */
+  inode_table = (inode_t**)(FS_OVERLAY_ADDR + FOUR_KB);
+  for(i = 0; i < base_inodes; i++){
+    inode_table[i] = (inode_t*)((uint8_t*)fs_start + FOUR_KB * (i + 1));
+  }
+  for(; i < base_inodes + OVERLAY_INODES; i++){
+    inode_table[i] = NULL;
+  }
+  overlay_inodes = (inode_t*)(FS_OVERLAY_ADDR + 2 * FOUR_KB);
+  overlay_data = (uint8_t*)FS_OVERLAY_ADDR + OVERLAY_META_BLOCKS * FOUR_KB;
+  total_inodes = base_inodes + OVERLAY_INODES;
+  total_dblocks = base_dblocks + OVERLAY_DBLOCKS;
+
+  memset(inode_bitmap, 0, sizeof(inode_bitmap));
+  memset(dblock_bitmap, 0, sizeof(dblock_bitmap));
+  dblock_hint = 0;
+
+  return image != 0 ? 0 : -1;
+}
+
+/*
+ * get_inode
+ *    DESCRIPTION: Gets the address of an inode
+ *    INPUTS: uint32_t inode - the inode number
+ *    OUTPUTS: none
+ *    RETURN VALUE: inode_t* - pointer to the inode block
+ *    SIDE EFFECTS: none
+ */
+static inode_t* get_inode(uint32_t inode){
+  /* Written and created inodes are found through the inode table */
+  if(inode_table != NULL){
+    return inode_table[inode];
+  }
+  return (inode_t*)((uint8_t*)fs_start + FOUR_KB * (inode + 1));
+}
+
+/*
+ * get_dblock
+ *    DESCRIPTION: Gets the address of a data block. Numbers past the image's
+ *                 data blocks are overlay blocks.
+ *    INPUTS: uint32_t dblock_num - the data block number
+ *    OUTPUTS: none
+ *    RETURN VALUE: uint8_t* - pointer to the data block, or NULL for a bad block number
+ *    SIDE EFFECTS: none
+ */
+static uint8_t* get_dblock(uint32_t dblock_num){
+  /* Check for a valid data block */
+  if(dblock_num >= total_dblocks){
+    return NULL;
+  }
+
+  if(dblock_num < base_dblocks){
+    return base_data + dblock_num * FOUR_KB;
+  }
+  return overlay_data + (dblock_num - base_dblocks) * FOUR_KB;
+}
+
+/*
+ * alloc_bit
+ *    DESCRIPTION: Finds and sets a clear bit in a free map
+ *    INPUTS: uint32_t* bitmap - the free map
+ *            uint32_t count - number of bits in the map
+ *            uint32_t start - bit to start searching from
+ *    OUTPUTS: none
+ *    RETURN VALUE: the bit that was set, or -1 if the map is full
+ *    SIDE EFFECTS: Sets the bit in bitmap
+ */
+static int32_t alloc_bit(uint32_t* bitmap, uint32_t count, uint32_t start){
+  uint32_t i, bit; /* Current bit, and the bit found */
+
+  for(i = 0; i < count; i++){
+    bit = (start + i) % count;
+
+    /* Skip words that are full */
+    if(bitmap[bit / BITMAP_BITS] == 0xFFFFFFFF){
+      i += BITMAP_BITS - 1 - (bit % BITMAP_BITS);
+      continue;
+    }
+    if(!(bitmap[bit / BITMAP_BITS] & (1 << (bit % BITMAP_BITS)))){
+      bitmap[bit / BITMAP_BITS] |= 1 << (bit % BITMAP_BITS);
+      return bit;
+    }
+  }
+
+  /* Map is full */
+  return -1;
+}
+
+/*
+ * alloc_dblock
+ *    DESCRIPTION: Allocates an overlay data block
+ *    INPUTS: const uint8_t* copy - block to copy into it, or NULL to zero it
+ *    OUTPUTS: none
+ *    RETURN VALUE: the new block number, or -1 if the overlay is full
+ *    SIDE EFFECTS: Marks the block in use
+ */
+static int32_t alloc_dblock(const uint8_t* copy){
+  int32_t bit = alloc_bit(dblock_bitmap, OVERLAY_DBLOCKS, dblock_hint);
+  uint8_t* block; /* Address of the new block */
+
+  if(bit == -1){
+    return -1;
+  }
+  dblock_hint = bit + 1;
+
+  block = overlay_data + bit * FOUR_KB;
+  if(copy != NULL){
+    memcpy_dword(block, copy, FOUR_KB / 4);
+  } else{
+    memset_dword(block, 0, FOUR_KB / 4);
+  }
+  return base_dblocks + bit;
+}
+
+/*
+ * free_dblock
+ *    DESCRIPTION: Returns an overlay data block to the free map
+ *    INPUTS: uint32_t dblock_num - the block number
+ *    OUTPUTS: none
+ *    RETURN VALUE: none
+ *    SIDE EFFECTS: Clears the block's bit
+ */
+static void free_dblock(uint32_t dblock_num){
+  if(dblock_num >= base_dblocks && dblock_num < total_dblocks){
+    dblock_num -= base_dblocks;
+    dblock_bitmap[dblock_num / BITMAP_BITS] &= ~(1 << (dblock_num % BITMAP_BITS));
+  }
+}
+
+/*
+ * writable_dblock
+ *    DESCRIPTION: Makes the block an entry points at writable, copying it out
+ *                 of the image on the first write
+ *    INPUTS: uint32_t* entry - writable block number entry
+ *            int32_t copy - 0 if the caller overwrites the whole block
+ *    OUTPUTS: none
+ *    RETURN VALUE: uint8_t* - the writable block, or NULL for failure
+ *    SIDE EFFECTS: May allocate a block and change *entry
+ */
+static uint8_t* writable_dblock(uint32_t* entry, int32_t copy){
+  int32_t block; /* Copied block number */
+
+  /* Overlay blocks are already writable */
+  if(*entry >= base_dblocks){
+    return get_dblock(*entry);
+  }
+  if((block = alloc_dblock(copy ? base_data + *entry * FOUR_KB : NULL)) == -1){
+    return NULL;
+  }
+  *entry = block;
+  return get_dblock(block);
+}
+
+/*
+ * writable_table
+ *    DESCRIPTION: Makes an indirect block writable, or creates it
+ *    INPUTS: uint32_t* entry - writable entry holding the table's block number
+ *            int32_t exists - 0 to create a new, empty table
+ *    OUTPUTS: none
+ *    RETURN VALUE: uint32_t* - the writable table, or NULL for failure
+ *    SIDE EFFECTS: May allocate a block and change *entry
+ */
+static uint32_t* writable_table(uint32_t* entry, int32_t exists){
+  int32_t block; /* New table's block number */
+
+  if(exists){
+    return (uint32_t*)writable_dblock(entry, 1);
+  }
+  if((block = alloc_dblock(NULL)) == -1){
+    return NULL;
+  }
+  *entry = block;
+  return (uint32_t*)get_dblock(block);
+}
+
+/*
+ * get_write_entry
+ *    DESCRIPTION: Finds a writable block number entry for a block of a file,
+ *                 copying or creating the indirect blocks on the way
+ *    INPUTS: inode_t* inode - the file's writable inode
+ *            uint32_t index - which block of the file to find
+ *            uint32_t nblocks - number of blocks the file has now
+ *    OUTPUTS: none
+ *    RETURN VALUE: uint32_t* - pointer to the entry, or NULL for failure
+ *    SIDE EFFECTS: May allocate indirect blocks
+ */
+static uint32_t* get_write_entry(inode_t* inode, uint32_t index, uint32_t nblocks){
+  uint32_t* table;  /* Indirect block of block numbers */
+  uint32_t* second; /* Second level block under the double indirect block */
+
+  /* Old images use every inode entry as a direct block */
+  if(!(boot_block->feature_flags & FS_FEATURE_INDIRECT)){
+    return index < INODE_BLOCK_NUM ? &(inode->dblocks[index]) : NULL;
+  }
+
+  /* Direct blocks */
+  if(index < DIRECT_BLOCK_NUM){
+    return &(inode->dblocks[index]);
+  }
+  index -= DIRECT_BLOCK_NUM;
+
+  /* Single indirect block */
+  if(index < PTRS_PER_BLOCK){
+    table = writable_table(&(inode->dblocks[SINGLE_INDIRECT]), nblocks > DIRECT_BLOCK_NUM);
+    return table == NULL ? NULL : &(table[index]);
+  }
+  index -= PTRS_PER_BLOCK;
+  nblocks = nblocks > DIRECT_BLOCK_NUM + PTRS_PER_BLOCK ? nblocks - DIRECT_BLOCK_NUM - PTRS_PER_BLOCK : 0;
+
+  /* Double indirect block, and the second level block under it */
+  if((table = writable_table(&(inode->dblocks[DOUBLE_INDIRECT]), nblocks > 0)) == NULL){
+    return NULL;
+  }
+  if((second = writable_table(&(table[index / PTRS_PER_BLOCK]), nblocks > index - (index % PTRS_PER_BLOCK))) == NULL){
+    /* Don't leave a new, empty double indirect block behind */
+    if(nblocks == 0){
+      free_dblock(inode->dblocks[DOUBLE_INDIRECT]);
+    }
+    return NULL;
+  }
+  return &(second[index % PTRS_PER_BLOCK]);
+}
+
+/*
+ * writable_inode
+ *    DESCRIPTION: Makes an inode writable, copying it out of the image on
+ *                 the first write
+ *    INPUTS: uint32_t inode - the inode number
+ *    OUTPUTS: none
+ *    RETURN VALUE: inode_t* - the writable inode, or NULL for failure
+ *    SIDE EFFECTS: May take an overlay inode and update the inode table
+ */
+static inode_t* writable_inode(uint32_t inode){
+  int32_t slot; /* Overlay inode to copy to */
+
+  if(inode_table == NULL || inode >= total_inodes){
+    return NULL;
+  }
+
+  /* Overlay inodes are already writable */
+  if(inode_table[inode] >= overlay_inodes && inode_table[inode] < overlay_inodes + OVERLAY_INODES){
+    return inode_table[inode];
+  }
+  if((slot = alloc_bit(inode_bitmap, OVERLAY_INODES, 0)) == -1){
+    return NULL;
+  }
+  memcpy_dword(&(overlay_inodes[slot]), inode_table[inode], FOUR_KB / 4);
+  inode_table[inode] = &(overlay_inodes[slot]);
+  return inode_table[inode];
+}
+
+/*
+ * get_block_run
+ *    DESCRIPTION: Finds the block number entry for a block of a file. Entries
+ *                 are resolved through the single and double indirect blocks
+ *                 when the image has FS_FEATURE_INDIRECT set.
+ *    INPUTS: inode_t* inode - the file's inode
+ *            uint32_t index - which block of the file to find
+ *            uint32_t* run - set to the number of entries left in the same table
+ *    OUTPUTS: none
+ *    RETURN VALUE: uint32_t* - pointer to the entry, or NULL for failure
+ *    SIDE EFFECTS: none
+ */
+static uint32_t* get_block_run(inode_t* inode, uint32_t index, uint32_t* run){
+  uint32_t* table; /* Indirect block of block numbers */
+
+  /* Old images use every inode entry as a direct block */
+  if(!(boot_block->feature_flags & FS_FEATURE_INDIRECT)){
+    if(index >= INODE_BLOCK_NUM){
+      return NULL;
+    }
+    *run = INODE_BLOCK_NUM - index;
+    return &(inode->dblocks[index]);
+  }
+
+  /* Direct blocks */
+  if(index < DIRECT_BLOCK_NUM){
+    *run = DIRECT_BLOCK_NUM - index;
+    return &(inode->dblocks[index]);
+  }
+  index -= DIRECT_BLOCK_NUM;
+
+  /* Single indirect block */
+  if(index < PTRS_PER_BLOCK){
+    if((table = (uint32_t*)get_dblock(inode->dblocks[SINGLE_INDIRECT])) == NULL){
+      return NULL;
+    }
+    *run = PTRS_PER_BLOCK - index;
+    return &(table[index]);
+  }
+  index -= PTRS_PER_BLOCK;
+
+  /* Double indirect block, index can't overflow since file sizes are 32 bits */
+  if((table = (uint32_t*)get_dblock(inode->dblocks[DOUBLE_INDIRECT])) == NULL){
+    return NULL;
+  }
+  if((table = (uint32_t*)get_dblock(table[index / PTRS_PER_BLOCK])) == NULL){
+    return NULL;
+  }
+  *run = PTRS_PER_BLOCK - (index % PTRS_PER_BLOCK);
+  return &(table[index % PTRS_PER_BLOCK]);
 }
 
 /*
@@ -34,6 +403,36 @@ void file_system_init(uint32_t* file_sys_start){
  */
 dentry_t* find_dentry(const uint8_t* filename){
   int i; /* Loop variable */
+  int low, high, cmp; /* Binary search bounds and result */
+
+  /* Sorted images keep "." first and the rest in name order */
+  if(boot_block->feature_flags & FS_FEATURE_SORTED){
+    /* Names longer than a dentry never match */
+    if(strlen((int8_t*)filename) > NAME_LENGTH){
+      return NULL;
+    }
+    if(boot_block->num_dentries > 0 && strncmp((const int8_t*)(boot_block->dentries[0].file_name), (const int8_t*)filename, NAME_LENGTH) == 0){
+      return &(boot_block->dentries[0]);
+    }
+
+    low = 1;
+    high = (int)boot_block->num_dentries - 1;
+    while(low <= high){
+      i = low + (high - low) / 2;
+      cmp = strncmp((const int8_t*)(boot_block->dentries[i].file_name), (const int8_t*)filename, NAME_LENGTH);
+      if(cmp == 0){
+        return &(boot_block->dentries[i]);
+      }
+      if(cmp < 0){
+        low = i + 1;
+      } else{
+        high = i - 1;
+      }
+    }
+
+    /* Dentry not found */
+    return NULL;
+  }
 
   /* Go through all dentries */
   for(i = 0; i < boot_block->num_dentries; i++){
@@ -106,8 +505,8 @@ int32_t read_dentry_by_index(uint32_t index, dentry_t* dentry){
 }
 
 /*
- * read_data
- *    DESCRIPTION: Reads the data of a file
+ * copy_data
+ *    DESCRIPTION: Copies the data of a file, the body of read_data
  *    INPUTS: uint32_t inode - the file's inode number
  *            uint32_t offset - how far in the file to start reading
  *            uint8_t* buf - where to copy the data to
@@ -116,21 +515,18 @@ int32_t read_dentry_by_index(uint32_t index, dentry_t* dentry){
  *    RETURN VALUE: The number of bytes read, or -1 for failure
  *    SIDE EFFECTS: none
  */
-int32_t read_data(uint32_t inode, uint32_t offset, uint8_t* buf, uint32_t length){
+static int32_t copy_data(uint32_t inode, uint32_t offset, uint8_t* buf, uint32_t length){
   /* Check for a valid inode */
-  if(inode >= (boot_block->num_inodes)){
+  if(inode >= total_inodes || get_inode(inode) == NULL){
     /* Return failure */
     return -1;
   }
 
   /* Address of given inode */
-  uint8_t* inode_addr = (uint8_t*)fs_start+(FOUR_KB * (inode+1));
+  inode_t* inode_addr = get_inode(inode);
 
   /* Size of file */
-  uint32_t file_size;
-
-  /* Get the size of the file */
-  memcpy(&file_size, inode_addr, 4);
+  uint32_t file_size = inode_addr->length;
 
   /* Check for a valid offset */
   if(offset > file_size){
@@ -138,32 +534,57 @@ int32_t read_data(uint32_t inode, uint32_t offset, uint8_t* buf, uint32_t length
     return 0;
   }
 
-  /* Ending point in the file  */
-  uint32_t end = (offset + length) > file_size ? file_size : offset + length;
-
-  /* Current data block number */
-  uint32_t dblock_num;
+  /* Ending point in the file, written so offset + length can't overflow */
+  uint32_t end = length > (file_size - offset) ? file_size : offset + length;
 
   /* Current point in the file */
   uint32_t cur = offset;
 
-  /* Get the current dblock number */
-  uint8_t* num_addr = inode_addr + 4 + (4 * (offset / FOUR_KB));
-  memcpy(&dblock_num, num_addr, 4);
+  /* Block number entry of the current dblock, and entries left in its table */
+  uint32_t* num_addr = NULL;
+  uint32_t run = 0;
 
-  /* Address of the dblock */
-  uint8_t* dblock_addr = (uint8_t*)fs_start + (boot_block->num_inodes + 1)*FOUR_KB + (dblock_num*FOUR_KB);
+  /* Address of the current dblock */
+  uint8_t* dblock_addr;
 
   /* Total amount of data copied */
   uint32_t copied_length = 0;
 
   /* Loop until the end point is reached */
   while(cur != end){
-    /* Amount copied per iteration: either the of the dblock or the set end point */
-    uint32_t copyLength = FOUR_KB - (cur % FOUR_KB) > (end - cur) ? (end - cur) : FOUR_KB - (cur % FOUR_KB);
+    /* Look up the next table of block numbers once the current one runs out */
+    if(run == 0 && (num_addr = get_block_run(inode_addr, cur / FOUR_KB, &run)) == NULL){
+      /* Return failure */
+      return -1;
+    }
+
+    /* Get the address of the dblock */
+    if((dblock_addr = get_dblock(*num_addr)) == NULL){
+      /* Return failure */
+      return -1;
+    }
+
+    /* Bytes from the current point to the end of its dblock */
+    uint32_t copyLength = FOUR_KB - (cur % FOUR_KB);
 
-    /* Copy to the buffer */
-    memcpy(buf + copied_length, dblock_addr + (cur % FOUR_KB), copyLength);
+    /* Grow the copy over following dblocks that sit right after this one in the image or overlay */
+    while(copyLength < end - cur && run > 1 && num_addr[1] == num_addr[0] + 1 && num_addr[1] != base_dblocks && num_addr[1] < total_dblocks){
+      copyLength += FOUR_KB;
+      num_addr++;
+      run--;
+    }
+
+    /* Stop at the set end point */
+    if(copyLength > end - cur){
+      copyLength = end - cur;
+    }
+
+    /* Copy to the buffer, whole aligned dblocks skip memcpy's byte handling */
+    if(cur % FOUR_KB == 0 && copyLength % FOUR_KB == 0 && ((uint32_t)(buf + copied_length) & 0x3) == 0){
+      memcpy_dword(buf + copied_length, dblock_addr, copyLength / 4);
+    } else{
+      memcpy(buf + copied_length, dblock_addr + (cur % FOUR_KB), copyLength);
+    }
 
     /* Update current point in the file */
     cur += copyLength;
@@ -171,18 +592,36 @@ int32_t read_data(uint32_t inode, uint32_t offset, uint8_t* buf, uint32_t length
     /* Update amount copied */
     copied_length += copyLength;
 
-    /* Get next dblock number */
-    num_addr += 4;
-    memcpy(&dblock_num, num_addr, 4);
-
-    /* Get the address of the next dblock */
-    dblock_addr = (uint8_t*)fs_start + (boot_block->num_inodes + 1)*FOUR_KB + (dblock_num*FOUR_KB);
+    /* Go to the next block number entry */
+    num_addr++;
+    run--;
   }
 
   /* Number of byte read */
   return copied_length;
 }
 
+/*
+ * read_data
+ *    DESCRIPTION: Reads the data of a file
+ *    INPUTS: uint32_t inode - the file's inode number
+ *            uint32_t offset - how far in the file to start reading
+ *            uint8_t* buf - where to copy the data to
+ *            uint32_t length - how many bytes to read
+ *    OUTPUTS: none
+ *    RETURN VALUE: The number of bytes read, or -1 for failure
+ *    SIDE EFFECTS: none
+ */
+int32_t read_data(uint32_t inode, uint32_t offset, uint8_t* buf, uint32_t length){
+  int32_t ret;
+
+  TRACE(TRACE_READ_DATA_ENTER, inode);
+  ret = copy_data(inode, offset, buf, length);
+  TRACE(TRACE_READ_DATA_EXIT, ret);
+
+  return ret;
+}
+
 /*
  * file_open
  *    DESCRIPTION: Opens a file and stores the file info
@@ -221,8 +660,8 @@ int32_t file_close(int32_t fd){
  */
 int32_t file_read(int32_t fd, void* buf, int32_t num_bytes){
   /* Check if a file is open */
-  pcb_t* pcb = get_pcb_add();
-  if(pcb->fdt[fd].inode == -1){
+  file_desc* file = get_fd(fd);
+  if(file == NULL || file->inode == -1){
     /* Return failure */
     return -1;
   }
@@ -231,29 +670,250 @@ int32_t file_read(int32_t fd, void* buf, int32_t num_bytes){
   int32_t read_ret;
 
   /* Read data, and check if file reading worked */
-  if((read_ret = read_data(pcb->fdt[fd].inode, pcb->fdt[fd].file_position, (uint8_t*)buf, num_bytes)) == -1){
+  if((read_ret = read_data(file->inode, file->file_position, (uint8_t*)buf, num_bytes)) == -1){
     /* Return failure */
     return -1;
   }
 
   /* Update point in file */
-  pcb->fdt[fd].file_position += read_ret;
+  file->file_position += read_ret;
 
   /* Number of bytes read */
 	return read_ret;
 }
 
+/*
+ * write_data
+ *    DESCRIPTION: Writes data to a file, growing it when the write runs past
+ *                 its end. Blocks from the image are copied to the overlay
+ *                 the first time they're written.
+ *    INPUTS: uint32_t inode - the file's inode number
+ *            uint32_t offset - how far in the file to start writing
+ *            const uint8_t* buf - where to copy the data from
+ *            uint32_t length - how many bytes to write
+ *    OUTPUTS: none
+ *    RETURN VALUE: The number of bytes written, or -1 for failure
+ *    SIDE EFFECTS: May allocate overlay inodes and blocks
+ */
+int32_t write_data(uint32_t inode, uint32_t offset, const uint8_t* buf, uint32_t length){
+  inode_t* inode_addr;   /* Writable inode */
+  uint32_t flags;        /* Saved interrupt flag */
+  uint32_t* num_addr;    /* Block number entry of the current dblock */
+  uint8_t* dblock_addr;  /* Address of the current dblock */
+  int32_t block;         /* Newly allocated dblock */
+  uint32_t cur, end, nblocks, copyLength;
+
+  /* Nothing to write */
+  if(length == 0){
+    return 0;
+  }
+
+  /* Return values and file positions are signed, so stop before they'd overflow */
+  if(buf == NULL || offset > 0x7FFFFFFF){
+    /* Return failure */
+    return -1;
+  }
+  if(length > 0x7FFFFFFF - offset){
+    length = 0x7FFFFFFF - offset;
+  }
+  end = offset + length;
+
+  /* Keep other processes from changing the overlay under us */
+  cli_and_save(flags);
+  inode_addr = writable_inode(inode);
+  /* Writing past the end fills the gap with zeros first */
+  cur = (inode_addr == NULL || offset < inode_addr->length) ? offset : inode_addr->length;
+  restore_flags(flags);
+
+  if(inode_addr == NULL){
+    /* Return failure */
+    return -1;
+  }
+
+  while(cur < end){
+    /* The block maps and the allocator are shared, so finding the block is
+     * masked, and copying into it is not */
+    cli_and_save(flags);
+    nblocks = (inode_addr->length + FOUR_KB - 1) / FOUR_KB;
+
+    /* Bytes from the current point to the end of its dblock, or of the gap */
+    copyLength = FOUR_KB - (cur % FOUR_KB);
+    if(copyLength > (cur < offset ? offset : end) - cur){
+      copyLength = (cur < offset ? offset : end) - cur;
+    }
+
+    if(cur / FOUR_KB < nblocks){
+      /* Existing dblock, copy it out of the image unless it's all overwritten */
+      num_addr = get_write_entry(inode_addr, cur / FOUR_KB, nblocks);
+      dblock_addr = num_addr == NULL ? NULL : writable_dblock(num_addr, copyLength != FOUR_KB);
+    } else{
+      /* New dblock, allocated before its entry so a failure leaves no empty table */
+      dblock_addr = NULL;
+      if((block = alloc_dblock(NULL)) != -1){
+        if((num_addr = get_write_entry(inode_addr, cur / FOUR_KB, nblocks)) == NULL){
+          free_dblock(block);
+        } else{
+          *num_addr = block;
+          dblock_addr = get_dblock(block);
+        }
+      }
+    }
+
+    /* Out of overlay space, or the file can't grow any more */
+    if(dblock_addr == NULL){
+      restore_flags(flags);
+      break;
+    }
+
+    /* Claim the bytes first, so a writer past them finds this block rather
+     * than allocating another. New blocks read as zeros until the copy lands */
+    if(cur + copyLength > inode_addr->length){
+      inode_addr->length = cur + copyLength;
+    }
+
+    if(cur < offset){
+      /* At most the rest of one block */
+      memset(dblock_addr + (cur % FOUR_KB), 0, copyLength);
+      restore_flags(flags);
+    } else{
+      restore_flags(flags);
+      memcpy(dblock_addr + (cur % FOUR_KB), buf + (cur - offset), copyLength);
+    }
+
+    /* Update current point in the file */
+    cur += copyLength;
+  }
+
+  /* Nothing written */
+  if(cur <= offset){
+    /* Return failure */
+    return -1;
+  }
+
+  /* Number of bytes written */
+  return cur - offset;
+}
+
 /*
  * file_write
- *    DESCRIPTION: Writes to a file
- *    INPUTS: none
+ *    DESCRIPTION: Writes to a file at its current position
+ *    INPUTS: int32_t fd - file to write
+ *            const void* buf - the buffer to copy from
+ *            int32_t num_bytes - the number of bytes to write
  *    OUTPUTS: none
- *    RETURN VALUE: -1 for failure
- *    SIDE EFFECTS: none
+ *    RETURN VALUE: Number of bytes written, or -1 for failure
+ *    SIDE EFFECTS: Updates the current file offset
  */
 int32_t file_write(int32_t fd, const void* buf, int32_t num_bytes){
-  /* File system is read only, so return failure */
-  return -1;
+  /* Check if a file is open */
+  file_desc* file = get_fd(fd);
+  if(file == NULL || file->inode == -1 || num_bytes < 0){
+    /* Return failure */
+    return -1;
+  }
+
+  /* Number of bytes written */
+  int32_t write_ret;
+
+  /* Write data, and check if file writing worked */
+  if((write_ret = write_data(file->inode, file->file_position, (const uint8_t*)buf, num_bytes)) == -1){
+    /* Return failure */
+    return -1;
+  }
+
+  /* Update point in file */
+  file->file_position += write_ret;
+
+  /* Number of bytes written */
+  return write_ret;
+}
+
+/*
+ * file_lseek
+ *    DESCRIPTION: Moves a file's position. Positions past the end are
+ *                 allowed, and a write there fills the gap with zeros.
+ *    INPUTS: int32_t fd - file to seek
+ *            int32_t offset - new position, relative to whence
+ *            int32_t whence - SEEK_SET, SEEK_CUR or SEEK_END
+ *    OUTPUTS: none
+ *    RETURN VALUE: the new position, or -1 for failure
+ *    SIDE EFFECTS: Updates the current file offset
+ */
+int32_t file_lseek(int32_t fd, int32_t offset, int32_t whence){
+  file_desc* file = get_fd(fd);
+  int32_t base; /* Position offset is relative to */
+
+  /* Check if a file is open */
+  if(file == NULL || file->inode == -1){
+    /* Return failure */
+    return -1;
+  }
+
+  switch(whence){
+    case SEEK_SET: base = 0;
+                   break;
+    case SEEK_CUR: base = file->file_position;
+                   break;
+    case SEEK_END: if(file->inode >= total_inodes || get_inode(file->inode) == NULL){
+                     return -1;
+                   }
+                   base = get_inode(file->inode)->length;
+                   break;
+    default: return -1;
+  }
+
+  /* New position can't be negative or overflow */
+  if((offset < 0 && base + offset < 0) || (offset > 0 && base > 0x7FFFFFFF - offset)){
+    /* Return failure */
+    return -1;
+  }
+
+  file->file_position = base + offset;
+  return file->file_position;
+}
+
+/*
+ * file_pread
+ *    DESCRIPTION: Reads a file at a given offset without moving its position
+ *    INPUTS: int32_t fd - file to read
+ *            void* buf - the buffer to copy to
+ *            int32_t num_bytes - the number of bytes to read
+ *            uint32_t offset - where in the file to start
+ *    OUTPUTS: none
+ *    RETURN VALUE: Number of bytes read, or -1 for failure
+ *    SIDE EFFECTS: none
+ */
+int32_t file_pread(int32_t fd, void* buf, int32_t num_bytes, uint32_t offset){
+  /* Check if a file is open */
+  file_desc* file = get_fd(fd);
+  if(file == NULL || file->inode == -1 || num_bytes < 0){
+    /* Return failure */
+    return -1;
+  }
+
+  return read_data(file->inode, offset, (uint8_t*)buf, num_bytes);
+}
+
+/*
+ * file_pwrite
+ *    DESCRIPTION: Writes a file at a given offset without moving its position
+ *    INPUTS: int32_t fd - file to write
+ *            const void* buf - the buffer to copy from
+ *            int32_t num_bytes - the number of bytes to write
+ *            uint32_t offset - where in the file to start
+ *    OUTPUTS: none
+ *    RETURN VALUE: Number of bytes written, or -1 for failure
+ *    SIDE EFFECTS: May grow the file
+ */
+int32_t file_pwrite(int32_t fd, const void* buf, int32_t num_bytes, uint32_t offset){
+  /* Check if a file is open */
+  file_desc* file = get_fd(fd);
+  if(file == NULL || file->inode == -1 || num_bytes < 0){
+    /* Return failure */
+    return -1;
+  }
+
+  return write_data(file->inode, offset, (const uint8_t*)buf, num_bytes);
 }
 
 /*
@@ -295,22 +955,22 @@ int32_t dir_close(int32_t fd){
 int32_t dir_read(int32_t fd, void* buf, int32_t nbytes){
   /* Dentry struct to copy to */
   dentry_t dentry;
-  pcb_t* pcb = get_pcb_add();
+  file_desc* file = get_fd(fd);
 
   /* Check for a valid index */
-  if(pcb->fdt[fd].file_position == -1){
+  if(file == NULL || file->file_position == -1){
     /* Return failure */
     return -1;
   }
 
   /* Check if directory is done reading */
-  if(pcb->fdt[fd].file_position >= boot_block->num_dentries){
+  if(file->file_position >= boot_block->num_dentries){
     /* Return success */
     return 0;
   }
 
   /* Read dentry at the index, and check if read worked */
-	if(-1 == read_dentry_by_index(pcb->fdt[fd].file_position, &dentry)){
+	if(-1 == read_dentry_by_index(file->file_position, &dentry)){
     return -1;
   }
 
@@ -318,21 +978,126 @@ int32_t dir_read(int32_t fd, void* buf, int32_t nbytes){
   strncpy((int8_t*)buf, (const int8_t*)dentry.file_name, NAME_LENGTH);
 
   /* Go to the next entry */
-  pcb->fdt[fd].file_position++;
+  file->file_position++;
 
   /* Number of bytes wirtten is length of file name */
   return NAME_LENGTH;
 }
 
+/*
+ * dir_getdents
+ *    DESCRIPTION: Reads as many directory entries as fit in the buffer
+ *    INPUTS: int32_t fd - directory to read from
+ *            void* buf - buffer of dirent_t to read to
+ *            nbytes - number of bytes the buffer can hold
+ *    OUTPUTS: none
+ *    RETURN VALUE: number of bytes filled in, 0 at the end of the directory,
+ *                  or -1 for failure
+ *    SIDE EFFECTS: Moves the dentry index past the entries read
+ */
+int32_t dir_getdents(int32_t fd, void* buf, int32_t nbytes){
+  file_desc* file = get_fd(fd);
+  dirent_t* dirent = (dirent_t*)buf; /* Next entry to fill in */
+  dentry_t* dentry;                   /* Dentry being copied */
+  inode_t* inode_addr;                /* Its inode, for the size */
+  int32_t count = 0;                  /* Entries filled in */
+
+  /* Check for a valid index, and room for at least one entry */
+  if(buf == NULL || file == NULL || file->file_position == -1 || nbytes < (int32_t)sizeof(dirent_t)){
+    /* Return failure */
+    return -1;
+  }
+
+  while(count < nbytes / (int32_t)sizeof(dirent_t) && file->file_position < boot_block->num_dentries){
+    dentry = &(boot_block->dentries[file->file_position]);
+
+    /* Names that fill the dentry have no terminator */
+    memcpy(dirent->name, dentry->file_name, NAME_LENGTH);
+    dirent->type = dentry->file_type;
+    dirent->inode = dentry->inode_num;
+    dirent->size = 0;
+
+    /* Only regular files have an inode */
+    if(dentry->file_type == FS_TYPE_FILE && dentry->inode_num < total_inodes && (inode_addr = get_inode(dentry->inode_num)) != NULL){
+      dirent->size = inode_addr->length;
+    }
+
+    /* Go to the next entry */
+    file->file_position++;
+    dirent++;
+    count++;
+  }
+
+  /* Number of bytes filled in */
+  return count * sizeof(dirent_t);
+}
+
 /*
  * dir_write
- *    DESCRIPTION: Write to the directory
- *    INPUTS: none
+ *    DESCRIPTION: Creates an empty file in the directory
+ *    INPUTS: int32_t fd - directory to write to
+ *            const void* buf - name of the new file
+ *            int32_t num_bytes - length of the name
  *    OUTPUTS: none
- *    RETURN VALUE: -1 for failure
- *    SIDE EFFECTS: none
+ *    RETURN VALUE: 0 for success, -1 for failure
+ *    SIDE EFFECTS: Adds a dentry and takes an overlay inode
  */
 int32_t dir_write(int32_t fd, const void* buf, int32_t num_bytes){
-  /* File system is read only, so return failure */
-  return -1;
+  uint8_t name[NAME_LENGTH + 1]; /* Name with a terminator for find_dentry */
+  uint32_t flags;                /* Saved interrupt flag */
+  int32_t len, slot, i;
+  dentry_t* dentry;
+
+  /* Check for a writable file system */
+  if(buf == NULL || num_bytes <= 0 || inode_table == NULL){
+    /* Return failure */
+    return -1;
+  }
+
+  /* The name ends at num_bytes or a terminator */
+  for(len = 0; len < num_bytes && len <= NAME_LENGTH && ((const uint8_t*)buf)[len] != '\0'; len++){
+    name[len] = ((const uint8_t*)buf)[len];
+  }
+  if(len == 0 || len > NAME_LENGTH){
+    /* Return failure */
+    return -1;
+  }
+  name[len] = '\0';
+
+  cli_and_save(flags);
+
+  /* Names are unique, and the boot block has a fixed number of dentries */
+  if(find_dentry(name) != NULL || boot_block->num_dentries >= MAX_DENTRIES ||
+     (slot = alloc_bit(inode_bitmap, OVERLAY_INODES, 0)) == -1){
+    restore_flags(flags);
+    /* Return failure */
+    return -1;
+  }
+
+  /* Sorted images keep "." first and insert in name order */
+  i = boot_block->num_dentries;
+  if((boot_block->feature_flags & FS_FEATURE_SORTED) && i > 0){
+    for(i = 1; i < boot_block->num_dentries; i++){
+      if(strncmp((const int8_t*)(boot_block->dentries[i].file_name), (const int8_t*)name, NAME_LENGTH) > 0){
+        break;
+      }
+    }
+    memmove(&(boot_block->dentries[i + 1]), &(boot_block->dentries[i]), (boot_block->num_dentries - i) * sizeof(dentry_t));
+  }
+
+  /* New file is empty */
+  overlay_inodes[slot].length = 0;
+  inode_table[base_inodes + slot] = &(overlay_inodes[slot]);
+
+  dentry = &(boot_block->dentries[i]);
+  memset(dentry, 0, sizeof(dentry_t));
+  memcpy(dentry->file_name, name, len);
+  dentry->file_type = FS_TYPE_FILE;
+  dentry->inode_num = base_inodes + slot;
+  boot_block->num_dentries++;
+
+  restore_flags(flags);
+
+  /* Return success */
+  return 0;
 }
@@ -4,6 +4,34 @@
 #include "types.h"
 
 #define NAME_LENGTH 32
+#define MAX_DENTRIES 63
+#define FS_BLOCK_SIZE 4096
+
+/* Block numbers held in an inode after its length word */
+#define INODE_BLOCK_NUM   1023
+/* Block numbers held in one indirect block */
+#define PTRS_PER_BLOCK    1024
+
+/* Dentry file types */
+#define FS_TYPE_RTC  0
+#define FS_TYPE_DIR  1
+#define FS_TYPE_FILE 2
+
+/* lseek whence values */
+#define SEEK_SET 0
+#define SEEK_CUR 1
+#define SEEK_END 2
+
+/* Boot block feature flags */
+#define FS_FEATURE_INDIRECT 0x1
+/* Dentries after "." are sorted by name */
+#define FS_FEATURE_SORTED   0x2
+
+/* With FS_FEATURE_INDIRECT, the last two inode entries point at a single
+ * and a double indirect block instead of data */
+#define DIRECT_BLOCK_NUM  1021
+#define SINGLE_INDIRECT   1021
+#define DOUBLE_INDIRECT   1022
 
 #ifndef ASM
 /* Directory entry struct */
@@ -22,15 +50,39 @@ struct boot_struct{
   uint32_t num_dentries;
   uint32_t num_inodes;
   uint32_t num_dblocks;
-  uint32_t reserved52[13];
-  dentry_t dentries[63];
+  uint32_t feature_flags;
+  uint32_t reserved48[12];
+  dentry_t dentries[MAX_DENTRIES];
 };
 
 // boot block
 typedef struct boot_struct boot_block_t;
 
+/* Inode struct */
+struct inode_struct{
+  uint32_t length;
+  uint32_t dblocks[INODE_BLOCK_NUM];
+};
+
+// inode
+typedef struct inode_struct inode_t;
+
+/* Directory entry as returned by getdents */
+struct dirent_struct{
+  uint8_t name[NAME_LENGTH];
+  uint32_t type;
+  uint32_t inode;
+  uint32_t size;
+};
+
+// getdents entry
+typedef struct dirent_struct dirent_t;
+
+/* Physical bounds of the image file_system_init was last given */
+extern uint32_t fs_image_start;
+extern uint32_t fs_image_end;
 
-void file_system_init(uint32_t* file_sys_start);
+int32_t file_system_init(uint32_t* file_sys_start, uint32_t file_sys_end);
 
 dentry_t* find_dentry(const uint8_t* filename);
 
@@ -40,6 +92,8 @@ int32_t read_dentry_by_index(uint32_t index, dentry_t* dentry);
 
 int32_t read_data(uint32_t inode, uint32_t offset, uint8_t* buf, uint32_t length);
 
+int32_t write_data(uint32_t inode, uint32_t offset, const uint8_t* buf, uint32_t length);
+
 int32_t file_open(const uint8_t* filename);
 
 int32_t file_close(int32_t fd);
@@ -48,12 +102,20 @@ int32_t file_read(int32_t fd, void* buf, int32_t num_bytes);
 
 int32_t file_write(int32_t fd, const void* buf, int32_t num_bytes);
 
+int32_t file_lseek(int32_t fd, int32_t offset, int32_t whence);
+
+int32_t file_pread(int32_t fd, void* buf, int32_t num_bytes, uint32_t offset);
+
+int32_t file_pwrite(int32_t fd, const void* buf, int32_t num_bytes, uint32_t offset);
+
 int32_t dir_open(const uint8_t* filename);
 
 int32_t dir_close(int32_t fd);
 
 int32_t dir_read(int32_t fd, void* buf, int32_t nbytes);
 
+int32_t dir_getdents(int32_t fd, void* buf, int32_t nbytes);
+
 int32_t dir_write(int32_t fd, const void* buf, int32_t num_bytes);
 
 #endif /* ASM */
@@ -10,6 +10,7 @@
 #include "linkage.h"
 #include "syscalls.h"
 #include "paging.h"
+#include "klog.h"
 
 #define NUM_EXCEPTION 32
 #define SYS_CALL_INDEX 0x80
@@ -23,141 +24,131 @@
 /*
  * irq1_handler
  *    DESCRIPTION: Handles IRQ1 interrupts
- *    OUTPUTS: Prints IRQ number to screen, and sends EOI for IRQ1
+ *    OUTPUTS: Logs the IRQ number, and sends EOI for IRQ1
  */
 void irq1_handler(void){
   send_eoi(1);
-  printf("keyboard interrupt\n");
+  klog("keyboard interrupt");
 }
 
 /*
  * irq2_handler
  *    DESCRIPTION: Handles IRQ2 interrupts
- *    OUTPUTS: Prints IRQ number to screen, and sends EOI for IRQ2
+ *    OUTPUTS: Logs the IRQ number, and sends EOI for IRQ2
  */
 void irq2_handler(void){
   send_eoi(2);
-  printf("slave interrupt\n");
+  klog("slave interrupt");
 }
 
 /*
  * irq3_handler
  *    DESCRIPTION: Handles IRQ3 interrupts
- *    OUTPUTS: Prints IRQ number to screen, and sends EOI for IRQ3
+ *    OUTPUTS: Logs the IRQ number, and sends EOI for IRQ3
  */
 void irq3_handler(void){
   send_eoi(3);
-  printf("irq3 interrupt\n");
-}
-
-/*
- * irq4_handler
- *    DESCRIPTION: Handles IRQ4 interrupts
- *    OUTPUTS: Prints IRQ number to screen, and sends EOI for IRQ4
- */
-void irq4_handler(void){
-  send_eoi(4);
-  printf("serial port interrupt\n");
+  klog("irq3 interrupt");
 }
 
 /*
  * irq5_handler
  *    DESCRIPTION: Handles IRQ5 interrupts
- *    OUTPUTS: Prints IRQ number to screen, and sends EOI for IRQ5
+ *    OUTPUTS: Logs the IRQ number, and sends EOI for IRQ5
  */
 void irq5_handler(void){
   send_eoi(5);
-  printf("irq_5\n");
+  klog("irq_5");
 }
 
 /*
  * irq6_handler
  *    DESCRIPTION: Handles IRQ6 interrupts
- *    OUTPUTS: Prints IRQ number to screen, and sends EOI for IRQ6
+ *    OUTPUTS: Logs the IRQ number, and sends EOI for IRQ6
  */
 void irq6_handler(void){
   send_eoi(6);
-  printf("irq_6\n");
+  klog("irq_6");
 }
 
 /*
  * irq7_handler
  *    DESCRIPTION: Handles IRQ7 interrupts
- *    OUTPUTS: Prints IRQ number to screen, and sends EOI for IRQ7
+ *    OUTPUTS: Logs the IRQ number, and sends EOI for IRQ7
  */
 void irq7_handler(void){
   send_eoi(7);
-  printf("irq_7");
+  klog("irq_7");
 }
 
 /*
  * irq9_handler
  *    DESCRIPTION: Handles IRQ9 interrupts
- *    OUTPUTS: Prints IRQ number to screen, and sends EOI for IRQ9
+ *    OUTPUTS: Logs the IRQ number, and sends EOI for IRQ9
  */
 void irq9_handler(void){
   send_eoi(9);
-  printf("irq_9\n");
+  klog("irq_9");
 }
 
 /*
  * irq10_handler
  *    DESCRIPTION: Handles IRQ10 interrupts
- *    OUTPUTS: Prints IRQ number to screen, and sends EOI for IRQ10
+ *    OUTPUTS: Logs the IRQ number, and sends EOI for IRQ10
  */
 void irq10_handler(void){
   send_eoi(10);
-  printf("irq_10\n");
+  klog("irq_10");
 }
 
 /*
  * irq11_handler
  *    DESCRIPTION: Handles IRQ11 interrupts
- *    OUTPUTS: Prints IRQ number to screen, and sends EOI for IRQ11
+ *    OUTPUTS: Logs the IRQ number, and sends EOI for IRQ11
  */
 void irq11_handler(void){
   send_eoi(11);
-  printf("irq_11, eth0(network)\n");
+  klog("irq_11, eth0(network)");
 }
 
 /*
  * irq12_handler
  *    DESCRIPTION: Handles IRQ12 interrupts
- *    OUTPUTS: Prints IRQ number to screen, and sends EOI for IRQ12
+ *    OUTPUTS: Logs the IRQ number, and sends EOI for IRQ12
  */
 void irq12_handler(void){
   send_eoi(12);
-  printf("irq_12, PS/2 mouse interrupt\n");
+  klog("irq_12, PS/2 mouse interrupt");
 }
 
 /*
  * irq13_handler
  *    DESCRIPTION: Handles IRQ13 interrupts
- *    OUTPUTS: Prints IRQ number to screen, and sends EOI for IRQ13
+ *    OUTPUTS: Logs the IRQ number, and sends EOI for IRQ13
  */
 void irq13_handler(void){
   send_eoi(13);
-  printf("irq_13\n");
+  klog("irq_13");
 }
 
 /*
  * irq14_handler
  *    DESCRIPTION: Handles IRQ14 interrupts
- *    OUTPUTS: Prints IRQ number to screen, and sends EOI for IRQ014
+ *    OUTPUTS: Logs the IRQ number, and sends EOI for IRQ014
  */
 void irq14_handler(void){
   send_eoi(14);
-  printf("irq_14, ide0(hard drive interrupt)\n");
+  klog("irq_14, ide0(hard drive interrupt)");
 }
 
 /*
  * irq15_handler
  *    DESCRIPTION: Handles IRQ15 interrupts
- *    OUTPUTS: Prints IRQ number to screen, and sends EOI for IRQ15
+ *    OUTPUTS: Logs the IRQ number, and sends EOI for IRQ15
  */
 void irq15_handler(void){
   send_eoi(15);
-  printf("irq_15\n");
+  klog("irq_15");
 }
 
 /*
@@ -184,69 +175,38 @@ void test_interrupt(void){
 	printf("Steve Lumetta is an AI coded by Steven Lumetta\n");
 }
 
+/* Name of each exception the linkage handles, by vector */
+static const char* exception_names[NUM_EXCEPTION] = {
+  "Divide Error", "RESERVED", "NMI", "Breakpoint", "Overflow", "BOUND Range Exceeded",
+  "Invalid OPCODE", "Device Not Available", "Double Fault", "Coprocessor Segment Overrun",
+  "Invalid TSS", "Segment Not Present", "Stack Segment Fault", "General Protection",
+  "Page Fault", NULL, "x87 FPU Floating-Point Error(Math Fault)", "Alignment Check",
+  "Machine Check", "SIMD Floating-point exception"
+};
+
 /*
- * exception_func
- *    DESCRIPTION: A macro to handle exceptions
- *    INPUTS: x - The type of exception
- *            msg - Exception type to print to screen
- *    OUTPUTS: Prints the exception type to the screen
+ * exception_handler
+ *    DESCRIPTION: Handles exceptions from the linkage. A user program with a
+ *                 handler for the signal gets it on the way back, anything
+ *                 else ends the process as before
+ *    INPUTS: hw_context* regs - what the linkage saved
+ *    OUTPUTS: Prints the exception type to the screen if the process ends
  *    RETURN VALUE: none
- *    SIDE EFFECTS: Causes the program to enter an inifinite loop
+ *    SIDE EFFECTS: Raises DIV_ZERO for a divide error and SEGFAULT for the rest
  */
-#define EXCEPTION_MAKER(x,msg) \
-	void x(void){ \
-    cli(); \
-		printf("Exception: %s\n",msg); \
-    pcb_t* cur_pcb = get_pcb_add(); /* Get the current process pcb */ \
-    process_num--; \
-    process_array[(cur_pcb->pid)-1]=-1; \
-    sched_arr[cur_sched_term].process_num = cur_pcb->parent_pid; \
-    sched_arr[cur_sched_term].esp = cur_pcb->parent_esp; \
-    sched_arr[cur_sched_term].ebp = cur_pcb->parent_ebp; \
-    set_page_dir_entry(USER_PROG, EIGHT_MB + (cur_pcb->parent_pid - 1)*FOUR_MB); \
-    if(cur_pcb->vidmem)sched_arr[cur_sched_term].vid_map = 0; \
-    int i; \
-    for(i = 0; i <= MAX_FD_NUM; i++) close(i);\
-    asm volatile ("      \n\
-       movl %%cr3, %%eax \n\
-       movl %%eax, %%cr3" \
-       :  \
-       :  \
-       : "eax"  \
-    );  \
-      tss.esp0 = cur_pcb->parent_esp; /* Set TSS esp0 back to parent stack pointer */ \
-      asm volatile ("      \n\
-         movl $256,%%eax \n\
-         movl %0,%%ebp     \n\
-         sti              \n\
-         leave             \n\
-         ret" \
-         :  \
-         : "r"(cur_pcb->parent_ebp)\
-         : "ebp","eax"  \
-      );  \
-     }
+void exception_handler(hw_context* regs){
+  int32_t signum = regs->vector == 0 ? DIV_ZERO : SEGFAULT;
+
+  cli();
 
-/* List of excetions */
-EXCEPTION_MAKER(DIVIDE_ERROR, "Divide Error");
-EXCEPTION_MAKER(RESERVED, "RESERVED");
-EXCEPTION_MAKER(NMI, "NMI");
-EXCEPTION_MAKER(BREAKPOINT, "Breakpoint");
-EXCEPTION_MAKER(OVERFLOW, "Overflow");
-EXCEPTION_MAKER(BOUND_RANGE_EXCEEDED, "BOUND Range Exceeded");
-EXCEPTION_MAKER(INVALID_OPCODE, "Invalid OPCODE");
-EXCEPTION_MAKER(DEVICE_NOT, "Device Not Available");
-EXCEPTION_MAKER(DOUBLE_FAULT, "Double Fault");
-EXCEPTION_MAKER(SEGMENT_OVERRUN, "Coprocessor Segment Overrun");
-EXCEPTION_MAKER(INVALID_TSS, "Invalid TSS");
-EXCEPTION_MAKER(SEGMENT_NOT_PRESENT, "Segment Not Present");
-EXCEPTION_MAKER(STACK_SEGMENT_FAULT, "Stack Segment Fault") ;
-EXCEPTION_MAKER(GENERAL_PROTECTION, "General Protection");
-EXCEPTION_MAKER(PAGE_FAULT, "Page Fault");
-EXCEPTION_MAKER(MATH_FAULT, "x87 FPU Floating-Point Error(Math Fault)");
-EXCEPTION_MAKER(ALIGNMENT_CHECK, "Alignment Check");
-EXCEPTION_MAKER(MACHINE_CHECK, "Machine Check");
-EXCEPTION_MAKER(SIMD_FLOATING_POINT_EXCEPTION, "SIMD Floating-point exception");
+  /* Faults in the kernel, and ones nothing catches, can't be resumed */
+  if((regs->cs & 3) != 3 || cur_pid == 0 || !signal_caught(signum)){
+    printf("Exception: %s\n", exception_names[regs->vector]);
+    end_process(EXCEPTION_STATUS);
+  }
+
+  send_signal(cur_pid, signum);
+}
 
 /*
  * exception_func
@@ -346,7 +306,7 @@ void initialize_idt(void){
   	SET_IDT_ENTRY(idt[0x20], pit_linkage);
     SET_IDT_ENTRY(idt[0x22], irq2_handler);
     SET_IDT_ENTRY(idt[0x23], irq3_handler);
-  	SET_IDT_ENTRY(idt[0x24], irq4_handler);
+  	SET_IDT_ENTRY(idt[0x24], serial_linkage);
 	  SET_IDT_ENTRY(idt[0x25], irq5_handler);
 	  SET_IDT_ENTRY(idt[0x26], irq6_handler);
     SET_IDT_ENTRY(idt[0x27], irq7_handler);
@@ -4,8 +4,12 @@
 #define _IDT_INIT_H
 
 #include "x86_desc.h"
+#include "signal.h"
 
 /* Initilize the idt in the boot.S */
 void initialize_idt(void);
 
+/* Raises the signal for an exception, called from its linkage */
+void exception_handler(hw_context* regs);
+
 #endif
@@ -4,7 +4,13 @@
 #include "lib.h"
 #include "pit.h"
 #include "paging.h"
+#include "trace.h"
 #include "lib.h"
+#include "poll.h"
+#include "signal.h"
+#include "scrollback.h"
+#include "ldisc.h"
+#include "syscalls.h"
 
 #define IRQ_NUM           1
 #define RECENT_RELEASE    0x80
@@ -22,10 +28,13 @@
 #define A_CHAR            30
 #define L_CHAR            38
 #define Z_CHAR            44
+#define C_CHAR            46
 #define M_CHAR            50
 #define F1_CHAR           59
 #define F2_CHAR           60
 #define F3_CHAR           61
+#define PG_UP             73
+#define PG_DOWN           81
 
 #define CAP_OFFSET        90
 #define UP_BOUND          128
@@ -35,6 +44,12 @@
 
 unsigned long flags; /* Hold current flags */
 
+/* Scan codes waiting for keyboard_process, a power of two so an index is a mask */
+static uint8_t kb_ring[KB_RING_SIZE];
+static volatile uint32_t kb_head = 0; /* Scan codes ever queued, only the interrupt moves it */
+static volatile uint32_t kb_tail = 0; /* Scan codes ever processed, only keyboard_process moves it */
+volatile uint32_t kb_overruns = 0;    /* Scan codes dropped on a full ring */
+
 // Table to map the scan_code not actualy 256 character in length
 uint8_t kbdus[256] =
 {
@@ -127,7 +142,8 @@ int32_t terminal_open(const uint8_t* filename){
 
 /*
  * terminal_write
- *    DESCRIPTION: Writes characters to the screen based on array that is passed in
+ *    DESCRIPTION: Writes characters to the screen based on array that is passed in,
+ *                 moving the cursor once for the whole buffer
  *    INPUTS: void* buf - Array to write to the screen
  *		        int32_t nbytes - The Number of bytes to write to the screen
  *    OUTPUTS: Character from copy_buf
@@ -141,15 +157,11 @@ int terminal_write(int32_t fd, const void* buf, int32_t nbytes){
 		return -1;
 	}
 
-	int i; /* Loop variable */
-
   /* Disable interrupts */
   cli_and_save(flags);
 
-  /* Print to the screen */
-	for(i = 0; i < nbytes; i++){
-		putc(*(uint8_t*)(buf+i));
-	}
+  /* Print to the screen as one batch */
+	putbuf((const uint8_t*)buf, nbytes);
 
   /* Restore interrupts */
   restore_flags(flags);
@@ -171,41 +183,127 @@ int32_t terminal_close(int32_t fd){
     return 0;
 }
 
+/*
+ * terminal_use_mode
+ *    DESCRIPTION: Puts the process' terminal in the mode of the descriptor about
+ *                 to read it
+ *    INPUTS: int32_t fd - terminal descriptor
+ *    OUTPUTS: None
+ *    RETURN VALUE: None
+ *    SIDE EFFECTS: The caller masks interrupts
+ */
+static void terminal_use_mode(int32_t fd){
+    file_desc* file = get_fd(fd);
+
+    /* Kernel tests read without a process */
+    ldisc_mode(cur_sched_term, file != NULL ? file->tty_mode : LDISC_COOKED);
+}
+
 /*
  * terminal_read
- *    DESCRIPTION: Reads characters from the keyboard buffer into the buffer
+ *    DESCRIPTION: Reads typed input into the buffer, a line at a time when the
+ *                 descriptor is cooked or whatever keys are waiting otherwise
  *    INPUTS: void* buf - Array to read into
  *		        int32_t nbytes - number of bytes to read into the buffer
  *    OUTPUTS: None
  *    RETURN VALUE: -1 for failure, Number of bytes read
- *    SIDE EFFECTS: None
+ *    SIDE EFFECTS: Puts the terminal in the descriptor's mode
  */
 int terminal_read(int32_t fd, void* buf, int32_t nbytes){
     int32_t bytes_read = 0; /* Number of bytes read */
 
-		if(buf == NULL || nbytes < 0){
+		/* A zero length read would wait for input just to throw it away */
+		if(buf == NULL || nbytes <= 0){
       /* Return failure */
 			return -1;
 		}
 
-    terminals[cur_sched_term].line_buffer_flag = 0; /* Sets the flag for determining whether enter is pressed */
-
-    /* Wait until the line is finsied */
-		while(!terminals[cur_sched_term].line_buffer_flag){
-		}
-
     cli();
+    terminal_use_mode(fd);
+
+    /* Sleep until there is input on this process' terminal */
+		while(!ldisc_ready(cur_sched_term)){
+			if(sleep_on(&ldiscs[cur_sched_term].read_wait) == -1){
+				sti();
+				/* Return failure, a signal is waiting */
+				return -1;
+			}
+		}
 
-    /* Print the number of bytes desired or the number of bytes typed */
-    bytes_read = nbytes < terminals[cur_terminal].buf_index ? nbytes : terminals[cur_terminal].buf_index;
-    memcpy(buf, (void*)terminals[cur_terminal].kb_buf, bytes_read);
-
-    terminals[cur_terminal].buf_index = 0;
+    /* What doesn't fit stays queued for the next read */
+    bytes_read = ldisc_read(cur_sched_term, (uint8_t*)buf, nbytes);
 
     sti();
     return bytes_read;
 }
 
+/*
+ * terminal_poll
+ *    DESCRIPTION: Tells poll whether a read would wait for input
+ *    INPUTS: int32_t fd - descriptor being polled
+ *            int32_t wait - nonzero to join the terminal's read queue if it would
+ *    OUTPUTS: None
+ *    RETURN VALUE: POLLIN if a read would return, 0 if it would wait
+ *    SIDE EFFECTS: Called by poll with interrupts masked
+ */
+int32_t terminal_poll(int32_t fd, int32_t wait){
+    terminal_use_mode(fd);
+    if(ldisc_ready(cur_sched_term)){
+      return POLLIN;
+    }
+    if(wait){
+      wait_on(&ldiscs[cur_sched_term].read_wait);
+    }
+    return 0;
+}
+
+/*
+ * terminal_watch
+ *    DESCRIPTION: Gives epoll the list notified when there is input
+ *    INPUTS: int32_t fd - not used
+ *    OUTPUTS: None
+ *    RETURN VALUE: the process' terminal's watcher list
+ *    SIDE EFFECTS: None
+ */
+epoll_item** terminal_watch(int32_t fd){
+    return &ldiscs[cur_sched_term].watch;
+}
+
+/*
+ * terminal_ioctl
+ *    DESCRIPTION: Gets or sets the line discipline mode of a terminal descriptor
+ *    INPUTS: int32_t fd - terminal descriptor
+ *            int32_t request - TTY_GET_MODE or TTY_SET_MODE
+ *            int32_t arg - LDISC_COOKED, LDISC_CBREAK or LDISC_RAW to set
+ *    OUTPUTS: None
+ *    RETURN VALUE: the mode for TTY_GET_MODE, 0 for a set, -1 for failure
+ *    SIDE EFFECTS: A set takes effect on the process' terminal at once. The
+ *                  terminal has one mode, so descriptors sharing it in
+ *                  different modes take turns: each read or poll puts the
+ *                  terminal back in its descriptor's mode
+ */
+int32_t terminal_ioctl(int32_t fd, int32_t request, int32_t arg){
+    file_desc* file = get_fd(fd);
+    unsigned long flags; /* Saved interrupt flag */
+
+    switch(request){
+      case TTY_GET_MODE:
+        return file->tty_mode;
+      case TTY_SET_MODE:
+        if(arg < LDISC_COOKED || arg > LDISC_RAW){
+          /* Return failure */
+          return -1;
+        }
+        cli_and_save(flags);
+        file->tty_mode = arg;
+        ldisc_mode(cur_sched_term, arg);
+        restore_flags(flags);
+        return 0;
+    }
+    /* Return failure */
+    return -1;
+}
+
 /*
  * keyboard_init
  *    DESCRIPTION: Enables keyboard interrupts
@@ -248,23 +346,14 @@ int32_t in_char_range (uint8_t scan_code) {
 
 /*
  * print_scancode
- *    DESCRIPTION: prints the scan_code
+ *    DESCRIPTION: Passes the character of a scan code to the line discipline
  *    INPUTS: uint32_t scan_code - scan_code of the key pressed
  *    OUTPUTS: none
  *    RETURN VALUE: none
- *    SIDE EFFECTS: prints the matching characters of the scan_code
+ *    SIDE EFFECTS: echoes the character unless the terminal is raw
  */
 void print_scancode (uint8_t scan_code) {
-  /* Check for a full terminal buffer */
-  if((terminals[cur_terminal].buf_index >= (BUF_LENGTH - 1) && scan_code != NEW_LINE) || terminals[cur_terminal].line_buffer_flag){
-    return;
-  }
-
-  putc(kbdus[scan_code]); // Prints this scan code to the screen
-
-  /* Store character in terminal buffer */
-  terminals[cur_terminal].kb_buf[terminals[cur_terminal].buf_index] = kbdus[scan_code];
-  terminals[cur_terminal].buf_index++;
+  ldisc_receive(cur_terminal, kbdus[scan_code]);
 }
 
  /*
@@ -288,7 +377,18 @@ int caps_no_shift (void) {
  *    SIDE EFFECTS: none
  */
 void recent_release_exec (uint8_t scan_code) {
-  if(scan_code == CTRL){ //If the CTRL button is pressed
+  int32_t paging = (terminals[cur_terminal].shift_pressed == 1 && (scan_code == PG_UP || scan_code == PG_DOWN));
+
+  /* Typing goes back to the live screen, modifiers and paging keep the history view */
+  if(!paging && scan_code != LEFT_SHIFT && scan_code != RIGHT_SHIFT && scan_code != CTRL && scan_code != ALT_CHAR){
+    screen_view(0);
+  }
+
+  if(paging){
+    /* Shift+PgUp and Shift+PgDn page through the viewing terminal's history */
+    screen_view(scan_code == PG_UP ? SCROLLBACK_PAGE : -SCROLLBACK_PAGE);
+  }
+  else if(scan_code == CTRL){ //If the CTRL button is pressed
     terminals[cur_terminal].ctrl_pressed = 1;
   }
   else if(terminals[cur_terminal].alt_pressed == 1 && (scan_code == F1_CHAR || scan_code == F2_CHAR || scan_code == F3_CHAR)){
@@ -309,6 +409,14 @@ void recent_release_exec (uint8_t scan_code) {
 		change_shell(terminal);
 
   }
+  else if(terminals[cur_terminal].ctrl_pressed == 1 && ldiscs[cur_terminal].mode == LDISC_RAW && in_char_range(scan_code)){
+    /* Raw readers get ctrl+letter as its control byte */
+    ldisc_receive(cur_terminal, kbdus[scan_code] & 0x1F);
+  }
+  else if(scan_code == C_CHAR && terminals[cur_terminal].ctrl_pressed == 1) {
+    /* Interrupt the program in front of the viewing terminal */
+    signal_foreground(cur_terminal, INTERRUPT);
+  }
   else if(scan_code == L_CHAR && terminals[cur_terminal].ctrl_pressed == 1) {
     int32_t i;
     clear();
@@ -318,18 +426,14 @@ void recent_release_exec (uint8_t scan_code) {
     }
   }
   else if(scan_code == BACK_SPACE){
-    /* Deletes a buffer character if it is allowed */
-    if(terminals[cur_terminal].buf_index <= 0){
-      return;
-    }
-    terminals[cur_terminal].buf_index--;
-    back_space();
+    /* Erases in a cooked line, and is a key of its own otherwise */
+    print_scancode(scan_code);
   } else if(scan_code == ALT_CHAR){
 	  terminals[cur_terminal].alt_pressed = 1;
   }
   else if(scan_code == NEW_LINE){
+    /* Finishes a cooked line */
     print_scancode(scan_code);
-    terminals[cur_terminal].line_buffer_flag = 1;
   }
   else if(scan_code == (LEFT_SHIFT) || scan_code == (RIGHT_SHIFT)){
     /* Sets shift_pressed to 1. Used ot indicate an on state */
@@ -380,74 +484,92 @@ void after_release_exec (uint8_t scan_code) {
 
 
 /*
- * keyboard_interrupt_handler
- *    DESCRIPTION: Handler for keyboard interrupts
+ * keyboard_push
+ *    DESCRIPTION: Queues a scan code for keyboard_process. Only the keyboard
+ *                 interrupt adds to the ring and only keyboard_process takes
+ *                 from it, so neither needs to mask interrupts
+ *    INPUTS: uint8_t scan_code - scan code read from the keyboard
+ *    OUTPUTS: none
+ *    RETURN VALUE: 0 for success, -1 if the ring is full
+ *    SIDE EFFECTS: Counts the scan code in kb_overruns if it is dropped
+ */
+int32_t keyboard_push(uint8_t scan_code){
+  uint32_t head = kb_head;
+
+  if(head - kb_tail >= KB_RING_SIZE){
+    kb_overruns++;
+    return -1;
+  }
+  kb_ring[head & (KB_RING_SIZE - 1)] = scan_code;
+  /* The scan code is in the ring before keyboard_process can see it */
+  barrier();
+  kb_head = head + 1;
+  return 0;
+}
+
+/*
+ * keyboard_process
+ *    DESCRIPTION: Decodes and echoes the scan codes queued since the last call
  *    INPUTS: none
- *    OUTPUTS: Character on the screen
+ *    OUTPUTS: Characters on the viewing terminal
  *    RETURN VALUE: none
- *    SIDE EFFECTS: Prints keyboard input to screen, and sends EOI
+ *    SIDE EFFECTS: Called every PIT tick with interrupts enabled, just before
+ *                  the screen is flushed, so an echo is drawn in the same tick.
+ *                  Only kb_tail is shared with the interrupt, the rest is only
+ *                  touched by the tick, which never runs twice at once
  */
-void keyboard_interrupt_handler(void){
-    /* Mask interrupts and store flags */
-    cli_and_save(flags);
-    /* Mask IRQ on PIC */
-		disable_irq(IRQ_NUM);
+void keyboard_process(void){
+  uint32_t tail = kb_tail;
+  uint8_t scan_code;
 
-    /* Send EOI to PIC to indicate interrupt is serviced */
-		send_eoi(IRQ_NUM);
+  if(tail == kb_head){
+    return;
+  }
 
-    /* Read the keyboard data buffer to get the current character */
-		uint8_t scan_code = inb(0x60);
+  /* Print to the viewing terminal */
+  print_terminal = cur_terminal;
+
+  while(tail != kb_head){
+    scan_code = kb_ring[tail & (KB_RING_SIZE - 1)];
+    /* The slot is read before the interrupt can reuse it */
+    barrier();
+    kb_tail = ++tail;
 
 		if((scan_code >= CAP_OFFSET && scan_code <= UP_BOUND) || (scan_code >= (CAP_OFFSET + UP_BOUND))){
-      /* Allow interrupts again */
-  		restore_flags(flags);
-      /* Unmask the IRQ1 on the PIC */
-  		enable_irq(IRQ_NUM);
-			return;
+			continue;
 		}
 
-    /* Print to the viewing terminal */
-    print_terminal = cur_terminal;
-
-    /* Map video paging to physical video memory */
-    set_page_table1_entry(VIDEO_MEM_ADDR, VIDEO_MEM_ADDR);
-
-    /* Flush TLB */
-    asm volatile ("     \n\
-      movl %%cr3, %%eax \n\
-      movl %%eax, %%cr3"
-      :
-      :
-      : "eax"
-    );
-
     /* Tests to see whether the key is being presed versus being released */
 		if(scan_code < RECENT_RELEASE){
       recent_release_exec(scan_code);
 		} else{
       after_release_exec(scan_code);
 		}
+  }
 
-    /* Remap video paging to buffer */
-    if(cur_sched_term != cur_terminal){
-      set_page_table1_entry(VIDEO_MEM_ADDR, sched_arr[cur_sched_term].video_buffer);
-
-      /* Flush TLB */
-      asm volatile ("     \n\
-        movl %%cr3, %%eax \n\
-        movl %%eax, %%cr3"
-        :
-        :
-        : "eax"
-      );
-    }
+  /* Print to the scheduled terminal */
+  print_terminal = cur_sched_term;
+}
 
-    /* Print to the scheduled terminal */
-    print_terminal = cur_sched_term;
+/*
+ * keyboard_interrupt_handler
+ *    DESCRIPTION: Handler for keyboard interrupts
+ *    INPUTS: none
+ *    OUTPUTS: none
+ *    RETURN VALUE: none
+ *    SIDE EFFECTS: Queues the scan code for keyboard_process, and sends EOI
+ */
+void keyboard_interrupt_handler(void){
+    /* Read the keyboard data buffer to get the current character */
+		uint8_t scan_code = inb(0x60);
 
-    /* Allow interrupts again */
-		restore_flags(flags);
-    /* Unmask the IRQ1 on the PIC */
-		enable_irq(IRQ_NUM);
+    TRACE(TRACE_KEYBOARD_ENTER, scan_code);
+
+    /* Decoding and echoing wait for the next tick */
+    keyboard_push(scan_code);
+
+    /* Send EOI to PIC to indicate interrupt is serviced */
+		send_eoi(IRQ_NUM);
+
+    TRACE(TRACE_KEYBOARD_EXIT, 0);
 }
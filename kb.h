@@ -5,8 +5,11 @@
 
 #include "types.h"
 #include "lib.h"
+#include "epoll.h"
 
 #define BUF_LENGTH 128
+/* Scan codes the keyboard interrupt can queue between ticks */
+#define KB_RING_SIZE 256
 
 #ifndef ASM
 
@@ -16,6 +19,15 @@ void keyboard_init(void);
 // Read the buffer inot the copy_buf array
 int32_t terminal_read(int32_t fd, void* buf, int32_t nbytes);
 
+// Tells poll whether a read would wait
+int32_t terminal_poll(int32_t fd, int32_t wait);
+
+// Watcher list of the terminal for epoll
+epoll_item** terminal_watch(int32_t fd);
+
+// Gets or sets the line discipline mode of a terminal descriptor
+int32_t terminal_ioctl(int32_t fd, int32_t request, int32_t arg);
+
 // Writes to the string buffer
 int32_t terminal_write(int32_t fd, const void* buf, int32_t nbytes);
 
@@ -49,6 +61,15 @@ void after_release_exec (uint8_t scan_code);
 /* Handler for keyboard interrupts */
 void keyboard_interrupt_handler(void);
 
+/* Queue a scan code for keyboard_process */
+int32_t keyboard_push(uint8_t scan_code);
+
+/* Decode and echo the queued scan codes */
+void keyboard_process(void);
+
+/* Scan codes dropped on a full ring */
+extern volatile uint32_t kb_overruns;
+
 
 #endif /* ASM */
 
@@ -14,6 +14,7 @@
 #include "paging.h"
 #include "file_system.h"
 #include "syscalls.h"
+#include "serial.h"
 
 #define RUN_TESTS
 
@@ -21,11 +22,95 @@
 /* Check if the bit BIT in FLAGS is set. */
 #define CHECK_FLAG(flags, bit)   ((flags) & (1 << (bit)))
 
+/* The boot loader's upper memory count starts at 1MB */
+#define UPPER_MEM_START 0x100000
+
+/* Where move_fs_image copied the file system module, both 0 if it didn't */
+static uint32_t fs_mod_start = 0;
+static uint32_t fs_mod_end = 0;
+
+/* Check if the space separated command line has WORD in it. */
+static int cmdline_has(const char *cmdline, const char *word) {
+    uint32_t len = strlen((int8_t *)word);
+
+    while (*cmdline != '\0') {
+        if (strncmp((int8_t *)cmdline, (int8_t *)word, len) == 0 &&
+                (cmdline[len] == ' ' || cmdline[len] == '\0'))
+            return 1;
+        /* Skip to the next word */
+        while (*cmdline != ' ' && *cmdline != '\0')
+            cmdline++;
+        while (*cmdline == ' ')
+            cmdline++;
+    }
+    return 0;
+}
+
+/* Returns END if it is past DEST, DEST otherwise. */
+static uint32_t past(uint32_t dest, uint32_t end) {
+    return end > dest ? end : dest;
+}
+
+/*
+ * move_fs_image
+ *    DESCRIPTION: Copies the file system module past the memory the kernel
+ *                 uses for its processes, the overlay and the page pool, and
+ *                 past everything the boot loader handed over. The loader
+ *                 puts the module right after the kernel, where a large one
+ *                 runs into all of those
+ *    INPUTS: unsigned long magic - multiboot magic number
+ *            unsigned long addr - address of the Multiboot information structure
+ *    OUTPUTS: none
+ *    RETURN VALUE: none
+ *    SIDE EFFECTS: Called from boot.S before paging, on a stack inside the
+ *                  kernel. Leaves the module alone and fs_mod_start at 0 if
+ *                  there is none or the copy doesn't fit in memory
+ */
+void move_fs_image(unsigned long magic, unsigned long addr) {
+    multiboot_info_t *mbi = (multiboot_info_t *) addr;
+    module_t *mod;
+    uint32_t dest = FS_IMAGE_PHYS;  /* Where the copy goes */
+    uint32_t top = 0xFFFFFFFF;      /* End of memory */
+    uint32_t length, i;
+
+    if (magic != MULTIBOOT_BOOTLOADER_MAGIC || !CHECK_FLAG(mbi->flags, 3) || mbi->mods_count == 0)
+        return;
+
+    /* entry still reads the information structure and what it points at */
+    dest = past(dest, addr + sizeof(multiboot_info_t));
+    if (CHECK_FLAG(mbi->flags, 2))
+        dest = past(dest, mbi->cmdline + strlen((int8_t *)mbi->cmdline) + 1);
+    if (CHECK_FLAG(mbi->flags, 6))
+        dest = past(dest, mbi->mmap_addr + mbi->mmap_length);
+    mod = (module_t *) mbi->mods_addr;
+    dest = past(dest, (uint32_t)(mod + mbi->mods_count));
+    for (i = 0; i < mbi->mods_count; i++) {
+        dest = past(dest, mod[i].mod_end);
+        if (mod[i].string != 0)
+            dest = past(dest, mod[i].string + strlen((int8_t *)mod[i].string) + 1);
+    }
+    dest = (dest + PAGE_SIZE - 1) & ~(PAGE_SIZE - 1);
+
+    if (CHECK_FLAG(mbi->flags, 0) && mbi->mem_upper < (top - UPPER_MEM_START) / 1024)
+        top = UPPER_MEM_START + mbi->mem_upper * 1024;
+    length = mod->mod_end - mod->mod_start;
+    if (dest > top || length > top - dest)
+        return;
+
+    memcpy((void *)dest, (void *)mod->mod_start, length);
+    fs_mod_start = dest;
+    fs_mod_end = dest + length;
+}
+
 /* Check if MAGIC is valid and print the Multiboot information structure
    pointed by ADDR. */
 void entry(unsigned long magic, unsigned long addr) {
 
     multiboot_info_t *mbi;
+    int headless = 0;           /* Run the tests and benchmarks instead of the shell */
+
+  	/*Initialize Shells, the screen is the first one's text region*/
+  	init_shell();
 
     /* Clear the screen. */
     clear();
@@ -51,14 +136,16 @@ void entry(unsigned long magic, unsigned long addr) {
         printf("boot_device = 0x%#x\n", (unsigned)mbi->boot_device);
 
     /* Is the command line passed? */
-    if (CHECK_FLAG(mbi->flags, 2))
+    if (CHECK_FLAG(mbi->flags, 2)) {
         printf("cmdline = %s\n", (char *)mbi->cmdline);
+        /* Read it now, paging leaves it unmapped */
+        headless = cmdline_has((char *)mbi->cmdline, "headless");
+    }
 
     if (CHECK_FLAG(mbi->flags, 3)) {
         int mod_count = 0;
         int i;
         module_t* mod = (module_t*)mbi->mods_addr;
-        file_system_init((uint32_t*)mod->mod_start);
         while (mod_count < mbi->mods_count) {
             printf("Module %d loaded at address: 0x%#x\n", mod_count, (unsigned int)mod->mod_start);
             printf("Module %d ends at address: 0x%#x\n", mod_count, (unsigned int)mod->mod_end);
@@ -148,6 +235,10 @@ void entry(unsigned long magic, unsigned long addr) {
     /* Initialize paging */
     init_paging();
 
+    /* Map in the file system now that paging is on */
+    if (file_system_init((uint32_t*)fs_mod_start, fs_mod_end) == -1)
+        printf("No file system image fits in memory, starting with an empty one\n");
+
     /* Init the PIC */
     i8259_init();
 
@@ -163,13 +254,13 @@ void entry(unsigned long magic, unsigned long addr) {
     /* Initialize PIT */
     pit_init();
 
-  	/*Initialize Shells*/
-  	init_shell();
-
 
     /* Initialize keyboard */
     keyboard_init();
 
+    /* Initialize the serial port, if there is one */
+    serial_init();
+
     /* Enable interrupts */
     /* Do not enable the following until after you have set up your
      * IDT correctly otherwise QEMU will triple fault and simple close
@@ -180,6 +271,10 @@ void entry(unsigned long magic, unsigned long addr) {
     /* Turn on interrupts */
     sti();
 
+    /* Report over serial and exit QEMU, never returns */
+    if (headless)
+        launch_headless();
+
 #ifdef RUN_TESTS
   reset_screen();
     /* Run tests */
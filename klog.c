@@ -0,0 +1,268 @@
+/* klog.c - Kernel log ring, read through the dmesg device */
+
+#include "klog.h"
+#include "pit.h"
+#include "syscalls.h"
+#include "serial.h"
+
+/* seq of a record a writer is in the middle of */
+#define KLOG_BUSY     0xFFFFFFFF
+/* Longest formatted record: time, text and newline */
+#define KLOG_LINE     (KLOG_TEXT + 16)
+
+/* The ring, a writer takes the next sequence number and owns its slot */
+static klog_record records[KLOG_RECORDS];
+static volatile uint32_t klog_next = 0; /* Sequence number of the next record */
+
+int32_t klog_to_console = 1;           /* Whether the console drain is on */
+static uint32_t console_pos = 0;       /* Next record the console prints */
+static uint32_t serial_pos = 0;        /* Next record the serial port sends */
+
+/*
+ * klog_write
+ *    DESCRIPTION: Adds a message to the log. Takes a slot with one atomic add,
+ *                 so interrupt handlers can log over a writer they interrupt
+ *                 and nothing waits on the screen
+ *    INPUTS: const int8_t* text - message, a trailing newline is dropped
+ *            int32_t n - its length, cut to KLOG_TEXT
+ *    OUTPUTS: none
+ *    RETURN VALUE: none
+ *    SIDE EFFECTS: Overwrites the oldest record
+ */
+void klog_write(const int8_t* text, int32_t n){
+  klog_record* rec;
+  uint32_t seq = 1;
+
+  asm volatile ("lock xaddl %0, %1" : "+r"(seq), "+m"(klog_next) : : "memory");
+  rec = &records[seq & (KLOG_RECORDS - 1)];
+
+  if(n > 0 && text[n - 1] == '\n'){
+    n--;
+  }
+  if(n > KLOG_TEXT){
+    n = KLOG_TEXT;
+  }
+
+  /* Readers skip the slot until it's whole */
+  rec->seq = KLOG_BUSY;
+  barrier();
+  rec->tick = pit_ticks;
+  rec->len = n;
+  memcpy(rec->text, text, n);
+  barrier();
+  rec->seq = seq + 1;
+}
+
+/*
+ * klog
+ *    DESCRIPTION: Adds a printf formatted message to the log
+ *    INPUTS: int8_t* format - format string, as for printf, then its arguments
+ *    OUTPUTS: none
+ *    RETURN VALUE: none
+ *    SIDE EFFECTS: Overwrites the oldest record
+ */
+void klog(int8_t* format, ...){
+  int8_t text[KLOG_TEXT + 1];
+
+  klog_write(text, vsnprintf(text, sizeof(text), format, (int32_t*)&format + 1));
+}
+
+/*
+ * klog_get
+ *    DESCRIPTION: Copies out the record at a reader's position, moving the
+ *                 position past any records that have been overwritten
+ *    INPUTS: uint32_t* pos - sequence number the reader is at
+ *    OUTPUTS: klog_record* rec - copy of the record
+ *    RETURN VALUE: 1 if there was a record, 0 if the reader is caught up
+ *    SIDE EFFECTS: Moves pos past the record
+ */
+int32_t klog_get(uint32_t* pos, klog_record* rec){
+  klog_record* slot;
+  uint32_t seq;
+
+  while(*pos != klog_next){
+    /* Records the writers have lapped are gone */
+    if(klog_next - *pos > KLOG_RECORDS){
+      *pos = klog_next - KLOG_RECORDS;
+    }
+    slot = &records[*pos & (KLOG_RECORDS - 1)];
+    seq = slot->seq;
+    if(seq == KLOG_BUSY || (int32_t)(seq - (*pos + 1)) < 0){
+      /* Still being written */
+      return 0;
+    }
+    barrier();
+    memcpy(rec, slot, sizeof(klog_record));
+    barrier();
+    /* A writer that took the slot meanwhile made the copy useless */
+    if(slot->seq != *pos + 1){
+      (*pos)++;
+      continue;
+    }
+    (*pos)++;
+    return 1;
+  }
+  return 0;
+}
+
+/*
+ * klog_format
+ *    DESCRIPTION: Formats a record as a line with its time in seconds
+ *    INPUTS: klog_record* rec - the record
+ *    OUTPUTS: int8_t* buf - KLOG_LINE bytes for the line
+ *    RETURN VALUE: length of the line
+ *    SIDE EFFECTS: none
+ */
+static int32_t klog_format(klog_record* rec, int8_t* buf){
+  uint32_t hundredths = (rec->tick % PIT_HZ) * 100 / PIT_HZ;
+  int32_t len;
+
+  buf[0] = '[';
+  itoa(rec->tick / PIT_HZ, buf + 1, 10);
+  len = strlen(buf);
+  buf[len++] = '.';
+  buf[len++] = '0' + hundredths / 10;
+  buf[len++] = '0' + hundredths % 10;
+  buf[len++] = ']';
+  buf[len++] = ' ';
+  memcpy(buf + len, rec->text, rec->len);
+  len += rec->len;
+  buf[len++] = '\n';
+  return len;
+}
+
+/*
+ * klog_send
+ *    DESCRIPTION: Sends records logged since the last call to the serial port,
+ *                 as many as it has room for
+ *    INPUTS: none
+ *    OUTPUTS: none
+ *    RETURN VALUE: none
+ *    SIDE EFFECTS: Called every PIT tick with interrupts masked, it only
+ *                  queues bytes for the transmit interrupt
+ */
+void klog_send(void){
+  klog_record rec;
+  int8_t line[KLOG_LINE];
+  uint32_t pos;
+  int32_t len;
+
+  /* Whole lines only, a record that doesn't fit waits for the next tick */
+  for(pos = serial_pos; serial_present && klog_get(&pos, &rec); serial_pos = pos){
+    len = klog_format(&rec, line);
+    if(serial_room() < len + 1){
+      break;
+    }
+    serial_send((uint8_t*)line, len - 1);
+    serial_send((uint8_t*)"\r\n", 2);
+  }
+}
+
+/*
+ * klog_drain
+ *    DESCRIPTION: Prints a few records logged since the last call to the
+ *                 viewing terminal
+ *    INPUTS: none
+ *    OUTPUTS: none
+ *    RETURN VALUE: none
+ *    SIDE EFFECTS: Called every PIT tick from tick_work, with interrupts
+ *                  enabled. The screen is left alone while the console drain
+ *                  is off, so the records wait for dmesg
+ */
+void klog_drain(void){
+  klog_record rec;
+  int8_t line[KLOG_LINE];
+  int32_t i;
+
+  if(!klog_to_console){
+    console_pos = klog_next;
+    return;
+  }
+
+  print_terminal = cur_terminal;
+  for(i = 0; i < KLOG_DRAIN && klog_get(&console_pos, &rec); i++){
+    putbuf((uint8_t*)line, klog_format(&rec, line));
+  }
+  print_terminal = cur_sched_term;
+}
+
+/*
+ * klog_open
+ *    DESCRIPTION: Opens dmesg, which starts at the oldest record
+ *    INPUTS: const uint8_t* filename - not used
+ *    OUTPUTS: none
+ *    RETURN VALUE: 0 for success
+ *    SIDE EFFECTS: none
+ */
+int32_t klog_open(const uint8_t* filename){
+  return 0;
+}
+
+/*
+ * klog_close
+ *    DESCRIPTION: Closes dmesg
+ *    INPUTS: int32_t fd - not used
+ *    OUTPUTS: none
+ *    RETURN VALUE: 0 for success
+ *    SIDE EFFECTS: none
+ */
+int32_t klog_close(int32_t fd){
+  return 0;
+}
+
+/*
+ * klog_read
+ *    DESCRIPTION: Reads the records after the descriptor's position as lines
+ *                 of text, as many whole lines as fit
+ *    INPUTS: int32_t fd - dmesg descriptor, its position is a sequence number
+ *            int32_t nbytes - size of the buffer
+ *    OUTPUTS: void* buf - the lines
+ *    RETURN VALUE: number of bytes read, 0 when there are no new records
+ *    SIDE EFFECTS: A line longer than the whole buffer is cut short
+ */
+int32_t klog_read(int32_t fd, void* buf, int32_t nbytes){
+  file_desc* file = get_fd(fd);
+  uint32_t pos = file->file_position;
+  klog_record rec;
+  int8_t line[KLOG_LINE];
+  int32_t len, n = 0;
+
+  if(buf == NULL || nbytes < 0){
+    /* Return failure */
+    return -1;
+  }
+
+  while(n < nbytes && klog_get(&pos, &rec)){
+    len = klog_format(&rec, line);
+    if(len > nbytes - n){
+      if(n > 0){
+        /* Leave it for the next read */
+        break;
+      }
+      len = nbytes;
+    }
+    memcpy((int8_t*)buf + n, line, len);
+    n += len;
+    file->file_position = pos;
+  }
+  return n;
+}
+
+/*
+ * klog_ioctl
+ *    DESCRIPTION: Turns the console drain on or off
+ *    INPUTS: int32_t fd - not used
+ *            int32_t request - KLOG_CONSOLE
+ *            int32_t arg - 1 for on, 0 for off
+ *    OUTPUTS: none
+ *    RETURN VALUE: 0 for success, -1 for failure
+ *    SIDE EFFECTS: none
+ */
+int32_t klog_ioctl(int32_t fd, int32_t request, int32_t arg){
+  if(request != KLOG_CONSOLE || (arg != 0 && arg != 1)){
+    /* Return failure */
+    return -1;
+  }
+  klog_to_console = arg;
+  return 0;
+}
@@ -0,0 +1,56 @@
+/* klog.h - Kernel log ring, read through the dmesg device */
+
+#ifndef _KLOG_H
+#define _KLOG_H
+
+#include "types.h"
+#include "lib.h"
+
+/* Records the ring keeps, a power of two so a sequence number masks to its slot */
+#define KLOG_RECORDS  128
+/* Longest message, the rest is cut off */
+#define KLOG_TEXT     116
+/* Records the console drain prints each tick */
+#define KLOG_DRAIN    8
+
+/* ioctl requests on dmesg */
+#define KLOG_CONSOLE  1   /* arg 1 copies new records to the viewing terminal, 0 stops it */
+
+#ifndef ASM
+
+/* One message. seq is the record's sequence number + 1 once it is written,
+ * and KLOG_BUSY while a writer is filling it */
+typedef struct klog_record {
+  volatile uint32_t seq;
+  uint32_t tick;                /* pit_ticks when it was logged */
+  uint32_t len;
+  int8_t text[KLOG_TEXT];
+} klog_record;
+
+/* Whether the console drain is on */
+extern int32_t klog_to_console;
+
+/* Log a message, formatted as printf does */
+void klog(int8_t* format, ...);
+
+/* Log text that is already formatted */
+void klog_write(const int8_t* text, int32_t n);
+
+/* Copy out the record at a sequence number, moving past any that were overwritten */
+int32_t klog_get(uint32_t* pos, klog_record* rec);
+
+/* Send new records to the serial port */
+void klog_send(void);
+
+/* Print new records to the viewing terminal */
+void klog_drain(void);
+
+/* dmesg file operations */
+int32_t klog_open(const uint8_t* filename);
+int32_t klog_close(int32_t fd);
+int32_t klog_read(int32_t fd, void* buf, int32_t nbytes);
+int32_t klog_ioctl(int32_t fd, int32_t request, int32_t arg);
+
+#endif /* ASM */
+
+#endif /* _KLOG_H */
@@ -0,0 +1,179 @@
+/* ldisc.c - Line discipline between the keyboard and terminal reads */
+
+#include "ldisc.h"
+
+/* Typeahead of each terminal */
+ldisc_t ldiscs[SHELL_NUM];
+
+/*
+ * ldisc_put
+ *    DESCRIPTION: Adds a byte to a terminal's typeahead
+ *    INPUTS: ldisc_t* ld - the terminal's typeahead
+ *            uint8_t c - byte to add
+ *    OUTPUTS: none
+ *    RETURN VALUE: 0 for success, -1 if the queue is full
+ *    SIDE EFFECTS: Counts a finished line
+ */
+static int32_t ldisc_put(ldisc_t* ld, uint8_t c){
+  if(ld->head - ld->tail >= LDISC_SIZE){
+    /* Return failure */
+    return -1;
+  }
+  ld->queue[ld->head++ & (LDISC_SIZE - 1)] = c;
+  if(c == '\n'){
+    ld->lines++;
+  }
+  return 0;
+}
+
+/*
+ * ldisc_wake
+ *    DESCRIPTION: Tells a terminal's readers there is input
+ *    INPUTS: int32_t t - terminal
+ *    OUTPUTS: none
+ *    RETURN VALUE: none
+ *    SIDE EFFECTS: Wakes sleeping reads and polls, and notifies epoll
+ */
+static void ldisc_wake(int32_t t){
+  if(ldisc_ready(t)){
+    wake_up(&ldiscs[t].read_wait);
+    epoll_notify(ldiscs[t].watch);
+  }
+}
+
+/*
+ * ldisc_receive
+ *    DESCRIPTION: Handles a character typed on the viewing terminal. Cooked
+ *                 terminals edit it into the line and queue the line on enter,
+ *                 others queue it straight away, so typing never waits on a
+ *                 reader
+ *    INPUTS: int32_t t - the viewing terminal
+ *            uint8_t c - the character, '\b' for backspace and '\n' for enter
+ *    OUTPUTS: none
+ *    RETURN VALUE: none
+ *    SIDE EFFECTS: Echoes to the screen unless the terminal is raw. Called from
+ *                  keyboard_process, which runs on top of whatever process it
+ *                  interrupted, so no reader is part way through the line
+ */
+void ldisc_receive(int32_t t, uint8_t c){
+  shell_t* term = &terminals[t];
+  ldisc_t* ld = &ldiscs[t];
+  int32_t i;
+
+  /* Keys with no character */
+  if(c == 0){
+    return;
+  }
+
+  if(ld->mode != LDISC_COOKED){
+    if(ldisc_put(ld, c) == -1){
+      return;
+    }
+    if(ld->mode == LDISC_CBREAK && c != '\b'){
+      putc(c);
+    }
+    ldisc_wake(t);
+    return;
+  }
+
+  if(c == '\b'){
+    /* Deletes a buffer character if it is allowed */
+    if(term->buf_index > 0){
+      term->buf_index--;
+      back_space();
+    }
+    return;
+  }
+
+  if(c == '\n'){
+    /* Without room the line stays in the buffer, enter can be pressed again once it's read */
+    if(LDISC_SIZE - (ld->head - ld->tail) < (uint32_t)term->buf_index + 1){
+      return;
+    }
+    for(i = 0; i < term->buf_index; i++){
+      ldisc_put(ld, term->kb_buf[i]);
+    }
+    ldisc_put(ld, '\n');
+    term->buf_index = 0;
+    putc('\n');
+    ldisc_wake(t);
+    return;
+  }
+
+  /* The last slot is kept for enter */
+  if(term->buf_index >= BUF_LENGTH - 1){
+    return;
+  }
+  term->kb_buf[term->buf_index++] = c;
+  putc(c);
+}
+
+/*
+ * ldisc_mode
+ *    DESCRIPTION: Switches a terminal to the mode of the descriptor reading it
+ *    INPUTS: int32_t t - terminal
+ *            int32_t mode - LDISC_COOKED, LDISC_CBREAK or LDISC_RAW
+ *    OUTPUTS: none
+ *    RETURN VALUE: none
+ *    SIDE EFFECTS: Leaving cooked mode queues the half typed line as it is
+ */
+void ldisc_mode(int32_t t, int32_t mode){
+  shell_t* term = &terminals[t];
+  ldisc_t* ld = &ldiscs[t];
+  int32_t i;
+
+  if(mode == ld->mode){
+    return;
+  }
+
+  if(ld->mode == LDISC_COOKED){
+    for(i = 0; i < term->buf_index && ldisc_put(ld, term->kb_buf[i]) == 0; i++);
+    term->buf_index = 0;
+  }
+  ld->mode = mode;
+}
+
+/*
+ * ldisc_ready
+ *    DESCRIPTION: Checks whether a read of a terminal would return without waiting
+ *    INPUTS: int32_t t - terminal
+ *    OUTPUTS: none
+ *    RETURN VALUE: 1 if there is a line, or any byte when not cooked, 0 if not
+ *    SIDE EFFECTS: none
+ */
+int32_t ldisc_ready(int32_t t){
+  ldisc_t* ld = &ldiscs[t];
+
+  if(ld->mode == LDISC_COOKED){
+    return ld->lines > 0;
+  }
+  return ld->head != ld->tail;
+}
+
+/*
+ * ldisc_read
+ *    DESCRIPTION: Takes bytes from a terminal's typeahead, stopping after a
+ *                 newline when cooked. What doesn't fit stays for the next read
+ *    INPUTS: int32_t t - terminal
+ *            int32_t nbytes - most bytes to take
+ *    OUTPUTS: uint8_t* buf - the bytes
+ *    RETURN VALUE: number of bytes taken
+ *    SIDE EFFECTS: The caller masks interrupts
+ */
+int32_t ldisc_read(int32_t t, uint8_t* buf, int32_t nbytes){
+  ldisc_t* ld = &ldiscs[t];
+  int32_t n = 0;
+  uint8_t c;
+
+  while(n < nbytes && ld->tail != ld->head){
+    c = ld->queue[ld->tail++ & (LDISC_SIZE - 1)];
+    buf[n++] = c;
+    if(c == '\n'){
+      ld->lines--;
+      if(ld->mode == LDISC_COOKED){
+        break;
+      }
+    }
+  }
+  return n;
+}
@@ -0,0 +1,53 @@
+/* ldisc.h - Line discipline between the keyboard and terminal reads */
+
+#ifndef _LDISC_H
+#define _LDISC_H
+
+#include "types.h"
+#include "lib.h"
+#include "pit.h"
+#include "epoll.h"
+
+/* Typed bytes a terminal holds for its readers, a power of two so the ring can mask its counters */
+#define LDISC_SIZE    1024
+
+/* Modes, kept in the inode of a terminal descriptor so a new one starts cooked */
+#define LDISC_COOKED  0   /* Lines are edited and echoed, a read returns a whole line */
+#define LDISC_CBREAK  1   /* Each key is echoed and readable at once, ctrl+C still interrupts */
+#define LDISC_RAW     2   /* Each key is readable at once, unechoed, with ctrl keys as control bytes */
+
+/* ioctl requests on a terminal */
+#define TTY_GET_MODE  1   /* Returns the descriptor's mode */
+#define TTY_SET_MODE  2   /* Sets the descriptor's mode to arg */
+
+#ifndef ASM
+
+/* Typeahead of one terminal, the line being edited stays in its kb_buf */
+typedef struct ldisc_t {
+  uint32_t head;              /* Bytes ever queued */
+  uint32_t tail;              /* Bytes ever read */
+  int32_t lines;              /* Finished lines in the queue */
+  int32_t mode;               /* Mode of the descriptor that last read the terminal */
+  wait_queue read_wait;       /* Readers waiting for input */
+  epoll_item* watch;          /* Interest sets watching the terminal */
+  uint8_t queue[LDISC_SIZE];
+} ldisc_t;
+
+/* Typeahead of each terminal */
+extern ldisc_t ldiscs[SHELL_NUM];
+
+/* Handle a typed character */
+void ldisc_receive(int32_t t, uint8_t c);
+
+/* Switch a terminal to the mode of the descriptor reading it */
+void ldisc_mode(int32_t t, int32_t mode);
+
+/* Whether a read would return without waiting */
+int32_t ldisc_ready(int32_t t);
+
+/* Take queued bytes, a line at most when cooked */
+int32_t ldisc_read(int32_t t, uint8_t* buf, int32_t nbytes);
+
+#endif /* ASM */
+
+#endif /* _LDISC_H */
@@ -7,18 +7,40 @@
 #include "x86_desc.h"
 #include "i8259.h"
 #include "pit.h"
+#include "paging.h"
+#include "scrollback.h"
 
 #define VIDEO       0xB8000
-#define PAGE_SIZE	  4096
 #define ATTRIB      0x7
+#define BLANK       ((ATTRIB << 8) | ' ')
 
 /* Some helpful constants for the terminal driver*/
 #define COL_END     79
 #define PORT_3D4		0x3D4
 #define PORT_3D5    0x3D5
+#define START_HIGH  0x0C
+#define START_LOW   0x0D
+
+/* Bytes of one screen */
+#define SCREEN_BYTES ((NUM_ROWS * NUM_COLS) << 1)
+/* Rows a terminal scrolls through before it moves back to the top of its region */
+#define TEXT_ROWS    (TEXT_REGION_SIZE / (NUM_COLS << 1))
+/* Character offset of a terminal's text region from the start of VGA memory */
+#define TEXT_START(t) (((uint32_t)terminals[t].vid_mem - VIDEO) >> 1)
+/* Characters in a terminal's text region */
+#define TEXT_CELLS   (TEXT_ROWS * NUM_COLS)
+/* Words of a dirty row bitmap */
+#define DIRTY_WORDS  ((TEXT_ROWS + 31) >> 5)
 
 static int32_t current_line = 0;
-static char* video_mem = (char *)VIDEO;
+
+/* Terminals print into RAM, and the rows that changed go out to their VGA regions on the next flush */
+static uint16_t shadow[SHELL_NUM][TEXT_CELLS];
+static uint32_t dirty[SHELL_NUM][DIRTY_WORDS];
+
+/* Start address and cursor the VGA display was last given, -1 before the first flush */
+static int32_t shown_start = -1;
+static int32_t shown_cursor = -1;
 
 /* Current viewing terminal */
 int32_t cur_terminal = 0;
@@ -26,6 +48,197 @@ int32_t cur_terminal = 0;
 /* Current printing terminal */
 int32_t print_terminal = 0;
 
+/*
+ * screen
+ *    DESCRIPTION: Finds the top row of a terminal's screen, wherever it has
+ *                 scrolled to in the terminal's shadow of its text region
+ *    INPUTS: int32_t t - terminal
+ *    OUTPUTS: none
+ *    RETURN VALUE: address of the terminal's first character
+ *    SIDE EFFECTS: none
+ */
+static uint8_t* screen(int32_t t){
+	/* A vidmap page sees the VGA region itself, so that terminal writes straight through */
+	if(terminals[t].vid_map){
+		return (uint8_t*)terminals[t].vid_mem;
+	}
+	return (uint8_t*)(shadow[t] + terminals[t].origin * NUM_COLS);
+}
+
+/*
+ * mark_dirty
+ *    DESCRIPTION: Marks rows of a terminal's screen to be copied out on the next flush
+ *    INPUTS: int32_t t - terminal
+ *            int32_t y - first row of the screen that changed
+ *            int32_t n - number of rows
+ *    OUTPUTS: none
+ *    RETURN VALUE: none
+ *    SIDE EFFECTS: none
+ */
+static void mark_dirty(int32_t t, int32_t y, int32_t n){
+	int32_t row;
+	for(row = terminals[t].origin + y; n > 0; row++, n--){
+		dirty[t][row >> 5] |= 1 << (row & 31);
+	}
+}
+
+/*
+ * set_cursor
+ *    DESCRIPTION: Writes the text-mode cursor location registers
+ *    INPUTS: int pos - character offset from the start of VGA memory
+ *    OUTPUTS: none
+ *    RETURN VALUE: none
+ *    SIDE EFFECTS: none
+ */
+static void set_cursor(int pos){
+	outb(0x0F, PORT_3D4); 								    /*write 0x0F to port 0x3D4*/
+	outb((uint8_t)(pos&0xFF), PORT_3D5);      /*write the low 8 bits (1 byte) of the position to port 0x3D5*/
+	outb(0x0E, PORT_3D4); 								    /*write 0x0E to port 0x3D4*/
+	outb((uint8_t)((pos>>8)&0xFF), PORT_3D5); /*write the high 8 bits to port 0x3D5*/
+}
+
+/*
+ * screen_flush
+ *    DESCRIPTION: Copies the viewing terminal's changed rows out to VGA memory,
+ *                 then points the display and the cursor at its screen
+ *    INPUTS: none
+ *    OUTPUTS: none
+ *    RETURN VALUE: none
+ *    SIDE EFFECTS: Called every PIT tick from tick_work with interrupts enabled,
+ *                  and on a terminal switch, the CRTC ports are only written
+ *                  when what they hold changes. Does nothing while the
+ *                  terminal shows its history
+ */
+void screen_flush(void){
+	shell_t* term = &terminals[cur_terminal];
+	uint32_t bits;
+	int32_t i, row, pos;
+
+	/* The rows stay dirty under a history view until it goes back to the live screen */
+	if(scrollbacks[cur_terminal].view != 0){
+		return;
+	}
+
+	for(i = 0; i < DIRTY_WORDS; i++){
+		/* Take the word in one instruction, an interrupt that prints can mark more rows */
+		bits = 0;
+		asm volatile ("xchgl %0, %1" : "+r"(bits), "+m"(dirty[cur_terminal][i]) : : "memory");
+		/* The program drew a vidmap terminal's region itself */
+		if(term->vid_map){
+			continue;
+		}
+		for(row = i << 5; bits != 0; row++, bits >>= 1){
+			if(bits & 1){
+				memcpy_dword(term->vid_mem + ((row * NUM_COLS) << 1), shadow[cur_terminal] + row * NUM_COLS, NUM_COLS >> 1);
+			}
+		}
+	}
+
+	pos = TEXT_START(cur_terminal) + term->origin * NUM_COLS;
+	if(pos != shown_start){
+		outb(START_HIGH, PORT_3D4);
+		outb((uint8_t)((pos >> 8) & 0xFF), PORT_3D5);
+		outb(START_LOW, PORT_3D4);
+		outb((uint8_t)(pos & 0xFF), PORT_3D5);
+		shown_start = pos;
+	}
+
+	pos += term->y * NUM_COLS + term->x;
+	if(pos != shown_cursor){
+		move_cursor(term->x, term->y);
+		shown_cursor = pos;
+	}
+}
+
+/*
+ * screen_map
+ *    DESCRIPTION: Hands a terminal's screen to a vidmap program, or takes it back
+ *    INPUTS: int32_t t - terminal
+ *            int32_t mapped - nonzero when a program maps the screen, 0 when it is done
+ *    OUTPUTS: none
+ *    RETURN VALUE: none
+ *    SIDE EFFECTS: Mapping moves the screen to the top of the region, where the
+ *                  vidmap page sees it, and writes it all out to VGA memory.
+ *                  Masks interrupts while it works
+ */
+void screen_map(int32_t t, int32_t mapped){
+	shell_t* term = &terminals[t];
+	unsigned long flags;
+
+	/* Keep the tick from echoing or flushing while the screen moves */
+	cli_and_save(flags);
+	if(mapped){
+		if(term->vid_map){
+			restore_flags(flags);
+			return;
+		}
+		if(term->origin != 0){
+			memcpy_dword(shadow[t], shadow[t] + term->origin * NUM_COLS, SCREEN_BYTES >> 2);
+			term->origin = 0;
+		}
+		memcpy_dword(term->vid_mem, shadow[t], SCREEN_BYTES >> 2);
+		term->vid_map = 1;
+	}
+	else{
+		if(!term->vid_map){
+			restore_flags(flags);
+			return;
+		}
+		/* Keep what the program drew */
+		memcpy_dword(shadow[t], term->vid_mem, SCREEN_BYTES >> 2);
+		term->vid_map = 0;
+	}
+
+	if(t == cur_terminal){
+		screen_flush();
+	}
+	restore_flags(flags);
+}
+
+/*
+ * screen_view
+ *    DESCRIPTION: Scrolls the viewing terminal's display back through its history,
+ *                 while its program keeps printing to the screen underneath
+ *    INPUTS: int32_t lines - rows to move back, negative to move forward, or 0 to
+ *                            go back to the live screen
+ *    OUTPUTS: none
+ *    RETURN VALUE: none
+ *    SIDE EFFECTS: Draws the view straight to the VGA memory being displayed
+ */
+void screen_view(int32_t lines){
+	scrollback_t* sb = &scrollbacks[cur_terminal];
+	uint16_t* vga = (uint16_t*)VIDEO + shown_start;
+	int32_t view, n;
+
+	view = (lines == 0) ? 0 : sb->view + lines;
+	if(view < 0){
+		view = 0;
+	}
+	if(view > sb->lines){
+		view = sb->lines;
+	}
+	/* A vidmap program owns its screen */
+	if(view == sb->view || terminals[cur_terminal].vid_map || shown_start < 0){
+		return;
+	}
+	sb->view = view;
+
+	if(view == 0){
+		/* Whatever was printed in the meantime goes out with the rest */
+		mark_dirty(cur_terminal, 0, NUM_ROWS);
+		screen_flush();
+		return;
+	}
+
+	/* History on top, then as much of the live screen as still fits */
+	n = scrollback_read(cur_terminal, view, vga, NUM_ROWS);
+	memcpy_dword(vga + n * NUM_COLS, screen(cur_terminal), ((NUM_ROWS - n) * NUM_COLS) >> 1);
+
+	/* Hide the cursor below the screen until the view is live again */
+	set_cursor(shown_start + NUM_ROWS * NUM_COLS);
+	shown_cursor = -1;
+}
+
 /*
  * init_shell
  *    DESCRIPTION: Initializes the terminal structs
@@ -38,35 +251,40 @@ void init_shell(void){
 	terminals[0].x = 0;
 	terminals[0].y = 0;
 	terminals[0].vid_mem = (char*)FIRST_SHELL;
-	terminals[0].line_buffer_flag = 0;
 	terminals[0].buf_index = 0;
 	terminals[0].shift_pressed = 0;
 	terminals[0].caps_lock = 0;
 	terminals[0].ctrl_pressed = 0;
 	terminals[0].alt_pressed = 0;
 	terminals[0].vid_map = 0;
+	terminals[0].origin = 0;
 
 	terminals[1].x = 0;
 	terminals[1].y = 0;
 	terminals[1].vid_mem = (char*)SECOND_SHELL;
-	terminals[1].line_buffer_flag = 0;
 	terminals[1].buf_index = 0;
 	terminals[1].shift_pressed = 0;
 	terminals[1].caps_lock = 0;
 	terminals[1].ctrl_pressed = 0;
 	terminals[1].alt_pressed = 0;
 	terminals[1].vid_map = 0;
+	terminals[1].origin = 0;
 
 	terminals[2].x = 0;
 	terminals[2].y = 0;
 	terminals[2].vid_mem = (char*)THIRD_SHELL;
-	terminals[2].line_buffer_flag = 0;
 	terminals[2].buf_index = 0;
 	terminals[2].shift_pressed = 0;
 	terminals[2].caps_lock = 0;
 	terminals[2].ctrl_pressed = 0;
 	terminals[2].alt_pressed = 0;
 	terminals[2].vid_map = 0;
+	terminals[2].origin = 0;
+	/* Every row of the regions goes out blank on the first flushes */
+	memset_word(shadow, BLANK, SHELL_NUM * TEXT_CELLS);
+	mark_dirty(0, 0, TEXT_ROWS);
+	mark_dirty(1, 0, TEXT_ROWS);
+	mark_dirty(2, 0, TEXT_ROWS);
 }
 
 /*
@@ -75,7 +293,7 @@ void init_shell(void){
  *    INPUTS: int32_t next - terminal number to change to
  *    OUTPUTS: none
  *    RETURN VALUE: 0 for success, -1 for failure
- *    SIDE EFFECTS: Copies physical video memory to the current terminal's buffer, and sets the memory to the next terminal
+ *    SIDE EFFECTS: Moves the VGA display and the cursor to the next terminal's text region
  */
 int32_t change_shell(int32_t next){
 	/* Check for valid terminal */
@@ -84,17 +302,17 @@ int32_t change_shell(int32_t next){
 		return -1;
 	}
 
-	/* Copy video memory to buffer */
-	memcpy(terminals[cur_terminal].vid_mem, video_mem, PAGE_SIZE);
+	/* Leave the outgoing terminal's history, its screen is redrawn when it is shown again */
+	if(scrollbacks[cur_terminal].view != 0){
+		scrollbacks[cur_terminal].view = 0;
+		mark_dirty(cur_terminal, 0, NUM_ROWS);
+	}
 
 	/* Set current terminal */
 	cur_terminal = next;
 
-	/* Copy buffer to video memory */
-	memcpy(video_mem, terminals[next].vid_mem, PAGE_SIZE);
-
-	/* Move cursor */
-	move_cursor(terminals[next].x, terminals[next].y);
+	/* Show its region, only the rows it changed in the background are copied */
+	screen_flush();
 
 	/* Return success */
 	return 0;
@@ -103,13 +321,12 @@ int32_t change_shell(int32_t next){
 /* void clear(void);
  * Inputs: void
  * Return Value: none
- * Function: Clears video memory */
+ * Function: Clears the printing terminal's screen */
 void clear(void) {
-    int32_t i;
-    for (i = 0; i < NUM_ROWS * NUM_COLS; i++) {
-        *(uint8_t *)(video_mem + (i << 1)) = ' ';
-        *(uint8_t *)(video_mem + (i << 1) + 1) = ATTRIB;
-    }
+    /* Start over at the top of the text region */
+    terminals[print_terminal].origin = 0;
+    memset_word(screen(print_terminal), BLANK, NUM_ROWS * NUM_COLS);
+    mark_dirty(print_terminal, 0, NUM_ROWS);
 }
 
 /* scroll_up
@@ -118,14 +335,46 @@ void clear(void) {
  * Effects: scrolls up the screen by one row when end of screen is reached
  */
 void scroll_up(void){
-	int32_t i;
-	for(i = 0; i < NUM_ROWS*NUM_COLS-NUM_COLS; i++){
-			*(uint8_t*)(video_mem + (i << 1)) = *(uint8_t *)(video_mem+((i + NUM_COLS) << 1));
-			*(uint8_t *)(video_mem + (i << 1) + 1) = ATTRIB;
+	shell_t* term = &terminals[print_terminal];
+	uint8_t* rows = screen(print_terminal);
+
+	/* The top row goes into the terminal's history */
+	scrollback_push(print_terminal, (uint16_t*)rows);
+
+	if(!term->vid_map){
+		/* Show the text region a row further down, and only copy once the screen reaches its end */
+		if(term->origin + NUM_ROWS >= TEXT_ROWS){
+			memcpy_dword(shadow[print_terminal], rows + (NUM_COLS << 1), ((NUM_ROWS - 1) * NUM_COLS) >> 1);
+			term->origin = 0;
+			mark_dirty(print_terminal, 0, NUM_ROWS - 1);
+		}
+		else{
+			term->origin++;
+		}
 	}
-	for(i = NUM_ROWS*NUM_COLS-NUM_COLS; i < NUM_ROWS*NUM_COLS; i++){
-		*(uint8_t*)(video_mem + (i << 1)) = ' '; /* put empty space character in the index */
-		*(uint8_t *)(video_mem + (i << 1) + 1) = ATTRIB;
+	else{
+		/* vidmap's page doesn't move, so the rows do */
+		memcpy_dword(rows, rows + (NUM_COLS << 1), ((NUM_ROWS - 1) * NUM_COLS) >> 1);
+	}
+
+	/* Blank the row that scrolled in */
+	memset_word(screen(print_terminal) + (((NUM_ROWS - 1) * NUM_COLS) << 1), BLANK, NUM_COLS);
+	mark_dirty(print_terminal, NUM_ROWS - 1, 1);
+}
+
+/* line_feed
+ * Inputs: void
+ * Outputs: none
+ * Effects: moves the printing terminal to the start of the next row, scrolling at the bottom
+ */
+static void line_feed(void){
+	terminals[print_terminal].x = 0;
+	/* if at the last row */
+	if(terminals[print_terminal].y == (NUM_ROWS - 1)){
+		scroll_up();
+	}
+	else{
+		terminals[print_terminal].y++;
 	}
 }
 
@@ -135,17 +384,7 @@ void scroll_up(void){
  * Effects: goes to newline (at end of screen, end of line, enter is pressed)
  */
 void new_line(void){
-  	/* if at the last row */
-		if(terminals[print_terminal].y == (NUM_ROWS - 1)){
-			scroll_up();
-			terminals[print_terminal].x = 0; /* set start of column (screen_x) to 0*/
-		}
-  	else{
-			terminals[print_terminal].y++;
-			terminals[print_terminal].x = 0;
-		}
-
-		move_cursor(terminals[cur_terminal].x, terminals[cur_terminal].y);
+		line_feed();
 }
 
 /* reset_screen
@@ -157,8 +396,6 @@ void reset_screen(void){
 		terminals[cur_terminal].y = 0; /* set start of rows to 0 */
 		terminals[cur_terminal].x = 0; /* set start of column to 0*/
     current_line = 0;
-
-		move_cursor(terminals[cur_terminal].x, terminals[cur_terminal].y); /* move cursor to start of screen */
 }
 
 /* back_space
@@ -173,9 +410,8 @@ void back_space(void){
     terminals[cur_terminal].y--; /* Move up */
 	}
   /* Put empty space character in the index */
-	*(uint8_t *)(video_mem + ((NUM_COLS * terminals[cur_terminal].y + terminals[cur_terminal].x) << 1)) = ' ';
-
-	move_cursor(terminals[cur_terminal].x, terminals[cur_terminal].y); /* update cursor position */
+	*(screen(cur_terminal) + ((NUM_COLS * terminals[cur_terminal].y + terminals[cur_terminal].x) << 1)) = ' ';
+	mark_dirty(cur_terminal, terminals[cur_terminal].y, 1);
 }
 
 /* move_cursor
@@ -185,39 +421,46 @@ void back_space(void){
  * Effects: updates the location of the text-mode cursor
  * */
 void move_cursor(int screen_x, int screen_y){
-	int pos = screen_y*NUM_COLS + screen_x;   /*position on the screen*/
-	outb(0x0F, PORT_3D4); 								    /*write 0x0F to port 0x3D4*/
-	outb((uint8_t)(pos&0xFF), PORT_3D5);      /*write the low 8 bits (1 byte) of the position to port 0x3D5*/
-	outb(0x0E, PORT_3D4); 								    /*write 0x0E to port 0x3D4*/
-	outb((uint8_t)((pos>>8)&0xFF), PORT_3D5); /*write the high 8 bits to port 0x3D5*/
+	set_cursor(TEXT_START(cur_terminal) + (terminals[cur_terminal].origin + screen_y)*NUM_COLS + screen_x);   /*position in the text region*/
 }
 
-/* Standard printf().
- * Only supports the following format strings:
- * %%  - print a literal '%' character
- * %x  - print a number in hexadecimal
- * %u  - print a number as an unsigned integer
- * %d  - print a number as a signed integer
- * %c  - print a character
- * %s  - print a string
- * %#x - print a number in 32-bit aligned hexadecimal, i.e.
- *       print 8 hexadecimal digits, zero-padded on the left.
- *       For example, the hex number "E" would be printed as
- *       "0000000E".
- *       Note: This is slightly different than the libc specification
- *       for the "#" modifier (this implementation doesn't add a "0x" at
- *       the beginning), but I think it's more flexible this way.
- *       Also note: %x is the only conversion specifier that can use
- *       the "#" modifier to alter output. */
-int32_t printf(int8_t *format, ...) {
+/* Where format_args sends its text */
+typedef struct format_out {
+    int8_t* buf;      /* Buffer to fill, NULL for the console */
+    int32_t size;     /* Bytes buf holds, the terminator's included */
+    int32_t len;      /* Characters put in buf so far */
+} format_out;
+
+/* void format_emit(format_out* out, const int8_t* s, int32_t n);
+ * Inputs: format_out* out = where the text goes
+ *         const int8_t* s = text
+ *         int32_t n = number of characters
+ * Return Value: none
+ * Function: Outputs formatted text to the console, or as much as still fits
+ *           in a buffer */
+static void format_emit(format_out* out, const int8_t* s, int32_t n) {
+    if(out->buf == NULL) {
+        putbuf((const uint8_t*)s, n);
+        return;
+    }
+    if(n > out->size - 1 - out->len) {
+        n = out->size - 1 - out->len;
+    }
+    memcpy(out->buf + out->len, s, n);
+    out->len += n;
+}
+
+/* int32_t format_args(format_out* out, int8_t* format, int32_t* esp);
+ * Inputs: format_out* out = where the text goes
+ *         int8_t* format = format string, as for printf
+ *         int32_t* esp = the first argument after the format on the stack
+ * Return Value: Number of format characters read
+ * Function: The formatting behind printf and vsnprintf */
+static int32_t format_args(format_out* out, int8_t* format, int32_t* esp) {
 
     /* Pointer to the format string */
     int8_t* buf = format;
 
-    /* Stack pointer for the other parameters */
-    int32_t* esp = (void *)&format;
-    esp++;
-
     while (*buf != '\0') {
         switch (*buf) {
             case '%':
@@ -230,7 +473,7 @@ format_char_switch:
                     switch (*buf) {
                         /* Print a literal '%' character */
                         case '%':
-                            putc('%');
+                            format_emit(out, "%", 1);
                             break;
 
                         /* Use alternate formatting */
@@ -248,7 +491,7 @@ format_char_switch:
                                 int8_t conv_buf[64];
                                 if (alternate == 0) {
                                     itoa(*((uint32_t *)esp), conv_buf, 16);
-                                    puts(conv_buf);
+                                    format_emit(out, conv_buf, strlen(conv_buf));
                                 } else {
                                     int32_t starting_index;
                                     int32_t i;
@@ -258,7 +501,7 @@ format_char_switch:
                                         conv_buf[i] = '0';
                                         i++;
                                     }
-                                    puts(&conv_buf[starting_index]);
+                                    format_emit(out, &conv_buf[starting_index], strlen(&conv_buf[starting_index]));
                                 }
                                 esp++;
                             }
@@ -269,7 +512,7 @@ format_char_switch:
                             {
                                 int8_t conv_buf[36];
                                 itoa(*((uint32_t *)esp), conv_buf, 10);
-                                puts(conv_buf);
+                                format_emit(out, conv_buf, strlen(conv_buf));
                                 esp++;
                             }
                             break;
@@ -285,20 +528,23 @@ format_char_switch:
                                 } else {
                                     itoa(value, conv_buf, 10);
                                 }
-                                puts(conv_buf);
+                                format_emit(out, conv_buf, strlen(conv_buf));
                                 esp++;
                             }
                             break;
 
                         /* Print a single character */
                         case 'c':
-                            putc((uint8_t) *((int32_t *)esp));
-                            esp++;
+                            {
+                                int8_t c = (int8_t) *((int32_t *)esp);
+                                format_emit(out, &c, 1);
+                                esp++;
+                            }
                             break;
 
                         /* Print a NULL-terminated string */
                         case 's':
-                            puts(*((int8_t **)esp));
+                            format_emit(out, *((int8_t **)esp), strlen(*((int8_t **)esp)));
                             esp++;
                             break;
 
@@ -310,7 +556,7 @@ format_char_switch:
                 break;
 
             default:
-                putc(*buf);
+                format_emit(out, buf, 1);
                 break;
         }
         buf++;
@@ -318,17 +564,51 @@ format_char_switch:
     return (buf - format);
 }
 
+/* Standard printf().
+ * Only supports the following format strings:
+ * %%  - print a literal '%' character
+ * %x  - print a number in hexadecimal
+ * %u  - print a number as an unsigned integer
+ * %d  - print a number as a signed integer
+ * %c  - print a character
+ * %s  - print a string
+ * %#x - print a number in 32-bit aligned hexadecimal, i.e.
+ *       print 8 hexadecimal digits, zero-padded on the left.
+ *       For example, the hex number "E" would be printed as
+ *       "0000000E".
+ *       Note: This is slightly different than the libc specification
+ *       for the "#" modifier (this implementation doesn't add a "0x" at
+ *       the beginning), but I think it's more flexible this way.
+ *       Also note: %x is the only conversion specifier that can use
+ *       the "#" modifier to alter output. */
+int32_t printf(int8_t *format, ...) {
+    format_out out = {NULL, 0, 0};
+
+    /* Stack pointer for the other parameters */
+    return format_args(&out, format, (int32_t*)&format + 1);
+}
+
+/* int32_t vsnprintf(int8_t* buf, int32_t size, int8_t* format, int32_t* args);
+ * Inputs: int8_t* buf = buffer to fill
+ *         int32_t size = bytes buf holds, at least 1
+ *         int8_t* format = format string, as for printf
+ *         int32_t* args = the first argument after the format on the caller's stack
+ * Return Value: Number of characters put in buf, not counting the terminator
+ * Function: printf into a buffer, cutting the text short if it doesn't fit */
+int32_t vsnprintf(int8_t* buf, int32_t size, int8_t* format, int32_t* args) {
+    format_out out = {buf, size, 0};
+
+    format_args(&out, format, args);
+    buf[out.len] = '\0';
+    return out.len;
+}
+
 /* int32_t puts(int8_t* s);
  *   Inputs: int_8* s = pointer to a string of characters
  *   Return Value: Number of bytes written
  *    Function: Output a string to the console */
 int32_t puts(int8_t* s) {
-    register int32_t index = 0;
-    while (s[index] != '\0') {
-        putc(s[index]);
-        index++;
-    }
-    return index;
+    return putbuf((uint8_t*)s, strlen(s));
 }
 
 /* void putc(uint8_t c);
@@ -336,20 +616,46 @@ int32_t puts(int8_t* s) {
  * Return Value: void
  *  Function: Output a character to the console */
 void putc(uint8_t c) {
-    if(c == '\n' || c == '\r') {
-        new_line();
-        current_line = terminals[print_terminal].y;
-    } else {
-        *(uint8_t *)(video_mem + ((NUM_COLS * terminals[print_terminal].y + terminals[print_terminal].x) << 1)) = c;
-        *(uint8_t *)(video_mem + ((NUM_COLS * terminals[print_terminal].y + terminals[print_terminal].x) << 1) + 1) = ATTRIB;
-        terminals[print_terminal].x++;
-        if(terminals[print_terminal].x == NUM_COLS){
-          new_line();
+    putbuf(&c, 1);
+}
+
+/* int32_t putbuf(const uint8_t* buf, int32_t n);
+ * Inputs: const uint8_t* buf = characters to print
+ *               int32_t n = number of characters
+ * Return Value: Number of bytes written
+ * Function: Output a buffer to the console's shadow, marking the rows it
+ *           touches for the next flush to copy out along with the cursor */
+int32_t putbuf(const uint8_t* buf, int32_t n) {
+    shell_t* term = &terminals[print_terminal];
+    uint8_t* pos = screen(print_terminal) + ((NUM_COLS * term->y + term->x) << 1);
+    int32_t i;
+
+    for(i = 0; i < n; i++) {
+        if(buf[i] == '\n' || buf[i] == '\r') {
+            mark_dirty(print_terminal, term->y, 1);
+            line_feed();
+            current_line = term->y;
+        } else {
+            /* Write straight into the row until it wraps */
+            pos[0] = buf[i];
+            pos[1] = ATTRIB;
+            pos += 2;
+            if(++term->x < NUM_COLS) {
+                continue;
+            }
+            mark_dirty(print_terminal, term->y, 1);
+            line_feed();
         }
-        terminals[print_terminal].y = (terminals[print_terminal].y + (terminals[print_terminal].x / NUM_COLS)) % NUM_ROWS;
+        pos = screen(print_terminal) + ((NUM_COLS * term->y + term->x) << 1);
     }
 
-	move_cursor(terminals[cur_terminal].x, terminals[cur_terminal].y);
+    mark_dirty(print_terminal, term->y, 1);
+
+    /* Nothing flushes until the PIT runs, so early boot messages go straight out */
+    if(pit_ticks == 0) {
+        screen_flush();
+    }
+    return n;
 }
 
 /* int8_t* itoa(uint32_t value, int8_t* buf, int32_t radix);
@@ -548,6 +854,27 @@ void* memcpy(void* dest, const void* src, uint32_t n) {
     return dest;
 }
 
+/* void* memcpy_dword(void* dest, const void* src, uint32_t n);
+ * Description: Optimized memcpy for aligned buffers
+ * Inputs:      void* dest = destination of copy
+ *         const void* src = source of copy
+ *              uint32_t n = number of dwords to copy
+ * Return Value: pointer to dest
+ * Function: copy n 4-byte memory locations of src to dest */
+void* memcpy_dword(void* dest, const void* src, uint32_t n) {
+    asm volatile ("                 \n\
+            movw    %%ds, %%dx      \n\
+            movw    %%dx, %%es      \n\
+            cld                     \n\
+            rep     movsl           \n\
+            "
+            :
+            : "S"(src), "D"(dest), "c"(n)
+            : "edx", "memory", "cc"
+    );
+    return dest;
+}
+
 /* void* memmove(void* dest, const void* src, uint32_t n);
  * Description: Optimized memmove (used for overlapping memory areas)
  * Inputs:      void* dest = destination of move
@@ -642,7 +969,9 @@ int8_t* strncpy(int8_t* dest, const int8_t* src, uint32_t n) {
  * Function: increments video memory. To be used to test rtc */
 void test_interrupts(void) {
     int32_t i;
+    uint8_t* video_mem = screen(print_terminal);
     for (i = 0; i < NUM_ROWS * NUM_COLS; i++) {
         video_mem[i << 1]++;
     }
+    mark_dirty(print_terminal, 0, NUM_ROWS);
 }
@@ -16,8 +16,10 @@
 
 void test_interrupts(void);
 int32_t printf(int8_t *format, ...);
+int32_t vsnprintf(int8_t* buf, int32_t size, int8_t* format, int32_t* args);
 void putc(uint8_t c);
 int32_t puts(int8_t *s);
+int32_t putbuf(const uint8_t* buf, int32_t n);
 int8_t *itoa(uint32_t value, int8_t* buf, int32_t radix);
 int8_t *strrev(int8_t* s);
 uint32_t strlen(const int8_t* s);
@@ -30,6 +32,15 @@ void move_cursor(int screen_x, int screen_y);
 /* Initialize terminal structs */
 void init_shell(void);
 
+/* Copy the viewing terminal's changed rows out to VGA memory */
+void screen_flush(void);
+
+/* Hand a terminal's screen to a vidmap program, or take it back */
+void screen_map(int32_t t, int32_t mapped);
+
+/* Scroll the viewing terminal's display through its history, 0 for the live screen */
+void screen_view(int32_t lines);
+
 /* View a different terminal */
 int32_t change_shell(int32_t shell_num);
 
@@ -45,13 +56,13 @@ typedef struct {
 	int32_t x;
 	int32_t y;
 	uint8_t kb_buf[BUF_LENGTH]; // Buffer of size that is 128;
-	volatile int32_t line_buffer_flag;
 	int32_t buf_index; //Index of the current element in the buffer
 	uint8_t shift_pressed;
 	uint8_t caps_lock;
 	uint8_t ctrl_pressed;
 	uint8_t alt_pressed;
-	int32_t vid_map;
+	int32_t vid_map;  // A program on the terminal uses vidmap
+	int32_t origin;   // Row of its text region at the top of the screen
 } shell_t;
 
 /* Array of terminals */
@@ -62,6 +73,7 @@ void* memset(void* s, int32_t c, uint32_t n);
 void* memset_word(void* s, int32_t c, uint32_t n);
 void* memset_dword(void* s, int32_t c, uint32_t n);
 void* memcpy(void* dest, const void* src, uint32_t n);
+void* memcpy_dword(void* dest, const void* src, uint32_t n);
 void* memmove(void* dest, const void* src, uint32_t n);
 int32_t strncmp(const int8_t* s1, const int8_t* s2, uint32_t n);
 int8_t* strcpy(int8_t* dest, const int8_t*src);
@@ -115,6 +127,18 @@ static inline uint32_t inl(port) {
     return val;
 }
 
+/* Reads the low 32 bits of the time stamp counter, enough to time
+ * anything shorter than a second */
+static inline uint32_t rdtsc(void) {
+    uint32_t low, high;
+    asm volatile ("rdtsc"
+            : "=a"(low), "=d"(high)
+            :
+            : "memory"
+    );
+    return low;
+}
+
 /* Writes a byte to a port */
 #define outb(data, port)                \
 do {                                    \
@@ -145,6 +169,10 @@ do {                                    \
     );                                  \
 } while (0)
 
+/* Compiler barrier - keeps the compiler from moving memory accesses
+ * across it, so a ring slot is written before its index moves */
+#define barrier() asm volatile ("" : : : "memory")
+
 /* Clear interrupt flag - disables interrupts on this processor */
 #define cli()                           \
 do {                                    \
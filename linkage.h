@@ -20,6 +20,36 @@ extern void rtc_linkage();
 /* Save registers for pit handler */
 extern void pit_linkage();
 
+/* Save registers for serial handler */
+extern void serial_linkage();
+
+/* Save callee-saved registers and esp, then resume another kernel stack */
+extern void switch_stack(int32_t* save_esp, int32_t new_esp);
+
+/* Start of a new process' first switch, jumps to user space */
+extern void start_process();
+
+/* Linkage for each exception, they save a hw_context and call exception_handler */
+extern void DIVIDE_ERROR();
+extern void RESERVED();
+extern void NMI();
+extern void BREAKPOINT();
+extern void OVERFLOW();
+extern void BOUND_RANGE_EXCEEDED();
+extern void INVALID_OPCODE();
+extern void DEVICE_NOT();
+extern void DOUBLE_FAULT();
+extern void SEGMENT_OVERRUN();
+extern void INVALID_TSS();
+extern void SEGMENT_NOT_PRESENT();
+extern void STACK_SEGMENT_FAULT();
+extern void GENERAL_PROTECTION();
+extern void PAGE_FAULT();
+extern void MATH_FAULT();
+extern void ALIGNMENT_CHECK();
+extern void MACHINE_CHECK();
+extern void SIMD_FLOATING_POINT_EXCEPTION();
+
 #endif /* ASM */
 
 #endif /* _LINKAGE_H */
@@ -15,6 +15,9 @@
 #define FOUR_MB        0x400000
 #define PAGE_INDEX     0x3FF
 #define NOT_PRESENT    0xFFFFFFFE
+#define KERNEL_4MB     0x083
+#define POOL_PAGES     (PAGE_POOL_SIZE / PAGE_SIZE)
+#define BITMAP_BITS    32
 
 /* Page directory array */
 static uint32_t page_directory[TABLE_ENTRIES]  __attribute__((aligned (PAGE_SIZE)));
@@ -23,6 +26,11 @@ static uint32_t first_page_table[TABLE_ENTRIES]  __attribute__((aligned (PAGE_SI
 /* Second page table array */
 static uint32_t second_page_table[TABLE_ENTRIES] __attribute__((aligned (PAGE_SIZE)));
 
+/* Kernel page pool, a set bit is in use */
+static uint32_t pool_bitmap[POOL_PAGES / BITMAP_BITS];
+/* Word to start the next search at, every word before it is full */
+static uint32_t pool_hint;
+
 /*
  * set_page_dir_entry
  *    DESCRIPTION: Creates an entry in the page directory
@@ -90,6 +98,134 @@ int32_t disable_page_entry(int32_t virtual){
   return 0;
 }
 
+/*
+ * set_shm_table
+ *    DESCRIPTION: Switches the shared memory window to a process' page table
+ *    INPUTS: uint32_t* table - page table from the page pool, or NULL if the
+ *                              process has nothing attached
+ *    OUTPUTS: none
+ *    RETURN VALUE: none
+ *    SIDE EFFECTS: Changes the window's page directory entry, the caller
+ *                  flushes the TLB
+ */
+void set_shm_table(uint32_t* table){
+  if(table == NULL){
+    page_directory[SHM_BASE >> PD_OFFSET] = RW_NOT_PRESENT;
+  } else{
+    /* Pool pages are identity mapped, so the address is the physical one */
+    page_directory[SHM_BASE >> PD_OFFSET] = (uint32_t)table | USER_MODE;
+  }
+}
+
+/*
+ * map_kernel_range
+ *    DESCRIPTION: Maps a range of physical memory with supervisor 4MB pages
+ *    INPUTS: uint32_t virtual - 4MB aligned virtual address of the window
+ *            uint32_t physical - start of the physical range
+ *            uint32_t length - number of bytes in the range
+ *    OUTPUTS: none
+ *    RETURN VALUE: virtual address of physical, or 0 if the window is too small
+ *    SIDE EFFECTS: Adds page directory entries starting at virtual
+ */
+uint32_t map_kernel_range(uint32_t virtual, uint32_t physical, uint32_t length){
+  uint32_t page;                                  /* Current 4MB physical page */
+  uint32_t first = physical & ~(FOUR_MB - 1);     /* First 4MB page of the range */
+  uint32_t last = (physical + (length ? length - 1 : 0)) & ~(FOUR_MB - 1);
+
+  /* Check if the range fits in the window */
+  if(length > FS_IMAGE_MAX - (physical - first) - FOUR_MB){
+    /* Return failure */
+    return 0;
+  }
+
+  /* Map every 4MB page that the range touches */
+  for(page = first; page <= last; page += FOUR_MB){
+    page_directory[(virtual + (page - first)) >> PD_OFFSET] = page | KERNEL_4MB;
+  }
+
+  /* Return the address of the range in the window */
+  return virtual + (physical - first);
+}
+
+/*
+ * alloc_page
+ *    DESCRIPTION: Takes a page from the kernel page pool
+ *    INPUTS: none
+ *    OUTPUTS: none
+ *    RETURN VALUE: address of the zeroed page, or NULL if the pool is empty
+ *    SIDE EFFECTS: Marks the page in use
+ */
+void* alloc_page(void){
+  uint32_t flags;  /* Saved interrupt flag */
+  uint32_t i, bit; /* Word and bit of the free page */
+  void* page;      /* Address of the page */
+
+  cli_and_save(flags);
+
+  /* Find a word with a clear bit */
+  for(i = pool_hint; i < POOL_PAGES / BITMAP_BITS && pool_bitmap[i] == 0xFFFFFFFF; i++);
+  pool_hint = i;
+  if(i == POOL_PAGES / BITMAP_BITS){
+    restore_flags(flags);
+    /* Pool is empty */
+    return NULL;
+  }
+
+  /* Lowest clear bit */
+  asm volatile ("bsfl %1, %0" : "=r"(bit) : "r"(~pool_bitmap[i]));
+  pool_bitmap[i] |= 1 << bit;
+
+  restore_flags(flags);
+
+  page = (void*)(PAGE_POOL_ADDR + (i * BITMAP_BITS + bit) * PAGE_SIZE);
+  memset_dword(page, 0, PAGE_SIZE / 4);
+  return page;
+}
+
+/*
+ * free_page
+ *    DESCRIPTION: Returns a page to the kernel page pool
+ *    INPUTS: void* page - a page from alloc_page
+ *    OUTPUTS: none
+ *    RETURN VALUE: none
+ *    SIDE EFFECTS: Marks the page free
+ */
+void free_page(void* page){
+  uint32_t flags; /* Saved interrupt flag */
+  uint32_t index = ((uint32_t)page - PAGE_POOL_ADDR) / PAGE_SIZE;
+
+  /* Ignore anything that isn't a pool page */
+  if(page == NULL || (uint32_t)page < PAGE_POOL_ADDR || index >= POOL_PAGES){
+    return;
+  }
+
+  cli_and_save(flags);
+  pool_bitmap[index / BITMAP_BITS] &= ~(1 << (index % BITMAP_BITS));
+  if(index / BITMAP_BITS < pool_hint){
+    pool_hint = index / BITMAP_BITS;
+  }
+  restore_flags(flags);
+}
+
+/*
+ * free_page_count
+ *    DESCRIPTION: Counts the free pages in the kernel page pool
+ *    INPUTS: none
+ *    OUTPUTS: none
+ *    RETURN VALUE: number of free pages
+ *    SIDE EFFECTS: none
+ */
+uint32_t free_page_count(void){
+  uint32_t i, count = 0; /* Loop variable and free page count */
+
+  for(i = 0; i < POOL_PAGES; i++){
+    if(!(pool_bitmap[i / BITMAP_BITS] & (1 << (i % BITMAP_BITS)))){
+      count++;
+    }
+  }
+  return count;
+}
+
 /*
  * get_dir
  *    DESCRIPTION: Get an entry from page directory
@@ -129,6 +265,11 @@ void init_paging(void){
     /* Initialize first page table array */
     init_page_table();
 
+    /* Map the kernel page pool, every page starts out free */
+    map_kernel_range(PAGE_POOL_ADDR, PAGE_POOL_ADDR, PAGE_POOL_SIZE);
+    memset(pool_bitmap, 0, sizeof(pool_bitmap));
+    pool_hint = 0;
+
     /* Turn on paging */
     enable_paging();
 }
@@ -181,13 +322,10 @@ void init_page_table(void){
       second_page_table[i] = (i * PAGE_SIZE) | RW_NOT_PRESENT;
     }
 
-    /* Set video memory page to present, read/write, and supervisor mode */
-    first_page_table[VIDEO_MEM_ADDR >> PT_OFFSET] |= RW_PRESENT;
-
-    /*Sets up temporary buffers for when the process is not the visible process*/
-    first_page_table[FIRST_SHELL >> PT_OFFSET] |= RW_PRESENT;
-    first_page_table[SECOND_SHELL >> PT_OFFSET] |= RW_PRESENT;
-    first_page_table[THIRD_SHELL >> PT_OFFSET] |= RW_PRESENT;
+    /* Set video memory pages to present, read/write, and supervisor mode, one text region per terminal */
+    for(i = VIDEO_MEM_ADDR; i < THIRD_SHELL + TEXT_REGION_SIZE; i += PAGE_SIZE){
+      first_page_table[i >> PT_OFFSET] |= RW_PRESENT;
+    }
 }
 
 /*
@@ -3,10 +3,26 @@
 
 #define VIDEO_MEM_ADDR 0xB8000
 #define USER_VIDEO_MEM 0x4500000
-#define FIRST_SHELL    (VIDEO_MEM_ADDR + PAGE_SIZE)
-#define SECOND_SHELL   (VIDEO_MEM_ADDR + 2*PAGE_SIZE)
-#define THIRD_SHELL    (VIDEO_MEM_ADDR + 3*PAGE_SIZE)
+/* Each terminal prints to and scrolls through its own region of VGA text memory */
+#define TEXT_REGION_SIZE (2*PAGE_SIZE)
+#define FIRST_SHELL    VIDEO_MEM_ADDR
+#define SECOND_SHELL   (VIDEO_MEM_ADDR + TEXT_REGION_SIZE)
+#define THIRD_SHELL    (VIDEO_MEM_ADDR + 2*TEXT_REGION_SIZE)
 #define PAGE_SIZE      4096
+#define FS_IMAGE_ADDR  0xC0000000
+#define FS_IMAGE_MAX   0x40000000
+/* Writable file system overlay, identity mapped right after the last user program */
+#define FS_OVERLAY_ADDR 0x2000000
+#define FS_OVERLAY_SIZE 0x400000
+/* Pool of kernel pages, identity mapped after the overlay */
+#define PAGE_POOL_ADDR 0x2400000
+#define PAGE_POOL_SIZE 0x400000
+/* Lowest physical address the file system image is copied to at boot, past
+ * the process memory, the overlay and the pool */
+#define FS_IMAGE_PHYS  (PAGE_POOL_ADDR + PAGE_POOL_SIZE)
+/* Window for shared memory segments, right after the user program page */
+#define SHM_BASE       0x8400000
+#define SHM_WINDOW     0x400000
 
 #ifndef ASM
 
@@ -21,6 +37,21 @@ int32_t set_page_table1_entry(int32_t virtual, int32_t physical);
 
 int32_t disable_page_entry(int32_t virtual);
 
+/* Point the shared memory window at a process' page table, NULL for none */
+void set_shm_table(uint32_t* table);
+
+/* Map a physical range into kernel-only 4MB pages */
+uint32_t map_kernel_range(uint32_t virtual, uint32_t physical, uint32_t length);
+
+/* Take a zeroed page from the kernel page pool */
+void* alloc_page(void);
+
+/* Return a page to the kernel page pool */
+void free_page(void* page);
+
+/* Number of free pages in the kernel page pool */
+uint32_t free_page_count(void);
+
 /* Get a page directory entry */
 uint32_t get_dir(uint32_t i);
 
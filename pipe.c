@@ -0,0 +1,401 @@
+/* pipe.c - Anonymous pipes between processes */
+
+#include "pipe.h"
+#include "syscalls.h"
+#include "paging.h"
+#include "lib.h"
+#include "poll.h"
+
+/* Every pipe, free ones have no buffer */
+static pipe_t pipes[MAX_PIPES];
+
+/*
+ * pipe_create
+ *    DESCRIPTION: Makes a new pipe, the caller owns one read end and one
+ *                 write end
+ *    INPUTS: none
+ *    OUTPUTS: none
+ *    RETURN VALUE: the pipe, or NULL if there are no free pipes or pages
+ *    SIDE EFFECTS: Takes a page for the ring
+ */
+pipe_t* pipe_create(void){
+  unsigned long flags; /* Saved interrupt flag */
+  pipe_t* pipe = NULL;
+  uint8_t* buf;
+  int32_t i;
+
+  if((buf = (uint8_t*)alloc_page()) == NULL){
+    /* Return failure */
+    return NULL;
+  }
+
+  cli_and_save(flags);
+  for(i = 0; i < MAX_PIPES; i++){
+    if(pipes[i].buf == NULL){
+      pipe = &pipes[i];
+      pipe->head = 0;
+      pipe->tail = 0;
+      pipe->readers = 1;
+      pipe->writers = 1;
+      pipe->reading = 0;
+      pipe->writing = 0;
+      pipe->read_wait = 0;
+      pipe->write_wait = 0;
+      pipe->read_turn = 0;
+      pipe->write_turn = 0;
+      pipe->read_watch = NULL;
+      pipe->write_watch = NULL;
+      pipe->buf = buf;
+      break;
+    }
+  }
+  restore_flags(flags);
+
+  if(pipe == NULL){
+    free_page(buf);
+  }
+  return pipe;
+}
+
+/*
+ * pipe_take_turn
+ *    DESCRIPTION: Waits until nobody else is using one end of a pipe, then
+ *                 marks it busy
+ *    INPUTS: int32_t* busy - the end's busy flag
+ *            wait_queue* turn - where others wait for it
+ *    OUTPUTS: none
+ *    RETURN VALUE: 0 once the end is ours, -1 if a signal cut the wait short
+ *    SIDE EFFECTS: The caller masks interrupts
+ */
+static int32_t pipe_take_turn(int32_t* busy, wait_queue* turn){
+  while(*busy){
+    if(sleep_on(turn) == -1){
+      /* Return failure, a signal is waiting */
+      return -1;
+    }
+  }
+  *busy = 1;
+  return 0;
+}
+
+/*
+ * pipe_end_turn
+ *    DESCRIPTION: Hands one end of a pipe to whoever is waiting for it
+ *    INPUTS: int32_t* busy - the end's busy flag
+ *            wait_queue* turn - where others wait for it
+ *    OUTPUTS: none
+ *    RETURN VALUE: none
+ *    SIDE EFFECTS: none
+ */
+static void pipe_end_turn(int32_t* busy, wait_queue* turn){
+  unsigned long flags; /* Saved interrupt flag */
+
+  cli_and_save(flags);
+  *busy = 0;
+  if(*turn != 0){
+    wake_up(turn);
+  }
+  restore_flags(flags);
+}
+
+/*
+ * pipe_release
+ *    DESCRIPTION: Drops one end of a pipe and wakes the other side, so readers
+ *                 see the end of the data and writers see nobody is reading
+ *    INPUTS: pipe_t* pipe - the pipe
+ *            int32_t writer - 1 for a write end, 0 for a read end
+ *    OUTPUTS: none
+ *    RETURN VALUE: none
+ *    SIDE EFFECTS: Frees the pipe when both sides are gone
+ */
+void pipe_release(pipe_t* pipe, int32_t writer){
+  unsigned long flags; /* Saved interrupt flag */
+
+  cli_and_save(flags);
+  if(writer){
+    pipe->writers--;
+    wake_up(&pipe->read_wait);
+    epoll_notify(pipe->read_watch);
+  } else{
+    pipe->readers--;
+    wake_up(&pipe->write_wait);
+    epoll_notify(pipe->write_watch);
+  }
+
+  if(pipe->readers == 0 && pipe->writers == 0){
+    free_page(pipe->buf);
+    pipe->buf = NULL;
+  }
+  restore_flags(flags);
+}
+
+/*
+ * pipe_read
+ *    DESCRIPTION: Reads whatever is in the pipe, up to nbytes, waiting while
+ *                 it's empty and a writer is still open
+ *    INPUTS: int32_t fd - read end of the pipe
+ *            void* buf - buffer to read to
+ *            int32_t nbytes - size of the buffer
+ *    OUTPUTS: none
+ *    RETURN VALUE: number of bytes read, 0 once every writer has closed and
+ *                  the pipe is empty, or -1 for failure
+ *    SIDE EFFECTS: Waits for other readers of the pipe to finish first.
+ *                  Wakes writers waiting for room
+ */
+int32_t pipe_read(int32_t fd, void* buf, int32_t nbytes){
+  file_desc* file = get_fd(fd);
+  unsigned long flags; /* Saved interrupt flag */
+  pipe_t* pipe;
+  uint32_t count, start, first; /* Bytes to read, where in the ring and before the wrap */
+
+  if(file == NULL || buf == NULL || nbytes < 0){
+    /* Return failure */
+    return -1;
+  }
+  if(nbytes == 0){
+    return 0;
+  }
+  pipe = (pipe_t*)file->inode;
+
+  /* Wait for other readers sharing the end, then for data or for the last writer to go */
+  cli_and_save(flags);
+  if(pipe_take_turn(&pipe->reading, &pipe->read_turn) == -1){
+    restore_flags(flags);
+    /* Return failure, a signal is waiting */
+    return -1;
+  }
+  while(pipe->head == pipe->tail && pipe->writers > 0){
+    if(sleep_on(&pipe->read_wait) == -1){
+      restore_flags(flags);
+      pipe_end_turn(&pipe->reading, &pipe->read_turn);
+      /* Return failure, a signal is waiting */
+      return -1;
+    }
+  }
+  restore_flags(flags);
+
+  /* Only the reader with the turn moves tail, so what's there stays there */
+  count = pipe->head - pipe->tail;
+  if(count > (uint32_t)nbytes){
+    count = nbytes;
+  }
+  start = pipe->tail & (PIPE_SIZE - 1);
+  first = count < PIPE_SIZE - start ? count : PIPE_SIZE - start;
+  memcpy(buf, pipe->buf + start, first);
+  memcpy((uint8_t*)buf + first, pipe->buf, count - first);
+  barrier();
+  pipe->tail += count;
+  pipe_end_turn(&pipe->reading, &pipe->read_turn);
+
+  if(pipe->write_wait != 0){
+    wake_up(&pipe->write_wait);
+  }
+  if(pipe->write_watch != NULL){
+    epoll_notify(pipe->write_watch);
+  }
+  return count;
+}
+
+/*
+ * pipe_write
+ *    DESCRIPTION: Writes all of buf to the pipe, waiting whenever it's full
+ *    INPUTS: int32_t fd - write end of the pipe
+ *            const void* buf - buffer to write from
+ *            int32_t nbytes - number of bytes to write
+ *    OUTPUTS: none
+ *    RETURN VALUE: number of bytes written, or -1 if nothing could be
+ *                  written because every reader has closed
+ *    SIDE EFFECTS: Waits for other writers of the pipe to finish first, so
+ *                  writes don't interleave. Wakes readers waiting for data
+ */
+int32_t pipe_write(int32_t fd, const void* buf, int32_t nbytes){
+  file_desc* file = get_fd(fd);
+  unsigned long flags; /* Saved interrupt flag */
+  pipe_t* pipe;
+  int32_t written = 0;          /* Bytes written so far */
+  uint32_t count, start, first; /* Bytes to write, where in the ring and before the wrap */
+
+  if(file == NULL || buf == NULL || nbytes < 0){
+    /* Return failure */
+    return -1;
+  }
+  pipe = (pipe_t*)file->inode;
+
+  /* Writers sharing the end take turns, so each write goes in whole */
+  cli_and_save(flags);
+  if(pipe_take_turn(&pipe->writing, &pipe->write_turn) == -1){
+    restore_flags(flags);
+    /* Return failure, a signal is waiting */
+    return -1;
+  }
+  restore_flags(flags);
+
+  while(written < nbytes){
+    /* Wait for room, or for the last reader to go */
+    cli_and_save(flags);
+    while(pipe->head - pipe->tail == PIPE_SIZE && pipe->readers > 0){
+      if(sleep_on(&pipe->write_wait) == -1){
+        restore_flags(flags);
+        pipe_end_turn(&pipe->writing, &pipe->write_turn);
+        /* A signal is waiting, report what got through */
+        return written ? written : -1;
+      }
+    }
+    restore_flags(flags);
+
+    if(pipe->readers == 0){
+      pipe_end_turn(&pipe->writing, &pipe->write_turn);
+      return written ? written : -1;
+    }
+
+    /* Only the writer with the turn moves head, so the room can only grow */
+    count = PIPE_SIZE - (pipe->head - pipe->tail);
+    if(count > (uint32_t)(nbytes - written)){
+      count = nbytes - written;
+    }
+    start = pipe->head & (PIPE_SIZE - 1);
+    first = count < PIPE_SIZE - start ? count : PIPE_SIZE - start;
+    memcpy(pipe->buf + start, (const uint8_t*)buf + written, first);
+    memcpy(pipe->buf, (const uint8_t*)buf + written + first, count - first);
+    barrier();
+    pipe->head += count;
+    written += count;
+
+    if(pipe->read_wait != 0){
+      wake_up(&pipe->read_wait);
+    }
+    if(pipe->read_watch != NULL){
+      epoll_notify(pipe->read_watch);
+    }
+  }
+  pipe_end_turn(&pipe->writing, &pipe->write_turn);
+  return written;
+}
+
+/*
+ * pipe_read_poll
+ *    DESCRIPTION: Tells poll whether a read would wait
+ *    INPUTS: int32_t fd - read end of the pipe
+ *            int32_t wait - nonzero to join the read queue if it would
+ *    OUTPUTS: none
+ *    RETURN VALUE: POLLIN if there is data, with POLLHUP once every writer
+ *                  has closed, or 0 if a read would wait
+ *    SIDE EFFECTS: Called by poll with interrupts masked
+ */
+int32_t pipe_read_poll(int32_t fd, int32_t wait){
+  pipe_t* pipe = (pipe_t*)get_fd(fd)->inode;
+
+  if(pipe->writers == 0){
+    return POLLIN | POLLHUP;
+  }
+  if(pipe->head != pipe->tail){
+    return POLLIN;
+  }
+  if(wait){
+    wait_on(&pipe->read_wait);
+  }
+  return 0;
+}
+
+/*
+ * pipe_write_poll
+ *    DESCRIPTION: Tells poll whether a write would wait
+ *    INPUTS: int32_t fd - write end of the pipe
+ *            int32_t wait - nonzero to join the write queue if it would
+ *    OUTPUTS: none
+ *    RETURN VALUE: POLLOUT if there is room, POLLERR once every reader has
+ *                  closed, or 0 if a write would wait
+ *    SIDE EFFECTS: Called by poll with interrupts masked
+ */
+int32_t pipe_write_poll(int32_t fd, int32_t wait){
+  pipe_t* pipe = (pipe_t*)get_fd(fd)->inode;
+
+  if(pipe->readers == 0){
+    return POLLERR;
+  }
+  if(pipe->head - pipe->tail != PIPE_SIZE){
+    return POLLOUT;
+  }
+  if(wait){
+    wait_on(&pipe->write_wait);
+  }
+  return 0;
+}
+
+/*
+ * pipe_read_watch
+ *    DESCRIPTION: Gives epoll the list notified when data comes or the last
+ *                 writer goes
+ *    INPUTS: int32_t fd - read end of the pipe
+ *    OUTPUTS: none
+ *    RETURN VALUE: the read end's watcher list
+ *    SIDE EFFECTS: none
+ */
+epoll_item** pipe_read_watch(int32_t fd){
+  return &((pipe_t*)get_fd(fd)->inode)->read_watch;
+}
+
+/*
+ * pipe_write_watch
+ *    DESCRIPTION: Gives epoll the list notified when room is made or the
+ *                 last reader goes
+ *    INPUTS: int32_t fd - write end of the pipe
+ *    OUTPUTS: none
+ *    RETURN VALUE: the write end's watcher list
+ *    SIDE EFFECTS: none
+ */
+epoll_item** pipe_write_watch(int32_t fd){
+  return &((pipe_t*)get_fd(fd)->inode)->write_watch;
+}
+
+/*
+ * pipe_open
+ *    DESCRIPTION: Pipes have no name to open, they come from the pipe system
+ *                 call or a pipeline in execute
+ *    INPUTS: const uint8_t* filename - not used
+ *    OUTPUTS: none
+ *    RETURN VALUE: -1 for failure
+ *    SIDE EFFECTS: none
+ */
+int32_t pipe_open(const uint8_t* filename){
+  /* Return failure */
+  return -1;
+}
+
+/*
+ * pipe_read_close
+ *    DESCRIPTION: Closes the read end of a pipe
+ *    INPUTS: int32_t fd - the read end
+ *    OUTPUTS: none
+ *    RETURN VALUE: 0 for success, -1 for failure
+ *    SIDE EFFECTS: Writers waiting for room give up
+ */
+int32_t pipe_read_close(int32_t fd){
+  file_desc* file = get_fd(fd);
+
+  if(file == NULL){
+    /* Return failure */
+    return -1;
+  }
+  pipe_release((pipe_t*)file->inode, 0);
+  return 0;
+}
+
+/*
+ * pipe_write_close
+ *    DESCRIPTION: Closes the write end of a pipe
+ *    INPUTS: int32_t fd - the write end
+ *    OUTPUTS: none
+ *    RETURN VALUE: 0 for success, -1 for failure
+ *    SIDE EFFECTS: Readers waiting on an empty pipe see its end
+ */
+int32_t pipe_write_close(int32_t fd){
+  file_desc* file = get_fd(fd);
+
+  if(file == NULL){
+    /* Return failure */
+    return -1;
+  }
+  pipe_release((pipe_t*)file->inode, 1);
+  return 0;
+}
@@ -0,0 +1,74 @@
+/* pipe.h - Anonymous pipes between processes */
+
+#ifndef _PIPE_H
+#define _PIPE_H
+
+#include "types.h"
+#include "pit.h"
+#include "epoll.h"
+
+/* Bytes a pipe holds, a power of two so the ring can mask its counters */
+#define PIPE_SIZE   4096
+/* Pipes open at once */
+#define MAX_PIPES   16
+
+#ifndef ASM
+
+/*
+ * Ring with one reader and one writer at a time. Threads and processes
+ * sharing an end take turns through its busy flag, so only the reader
+ * holding it moves tail and only the writer holding it moves head, and
+ * data is copied with interrupts on.
+ */
+typedef struct pipe {
+  volatile uint32_t head;     /* Bytes written since the pipe was made */
+  volatile uint32_t tail;     /* Bytes read since the pipe was made */
+  int32_t readers;            /* Open read ends */
+  int32_t writers;            /* Open write ends */
+  int32_t reading;            /* Whether a reader is in pipe_read */
+  int32_t writing;            /* Whether a writer is in pipe_write */
+  wait_queue read_wait;       /* Readers waiting for data */
+  wait_queue write_wait;      /* Writers waiting for room */
+  wait_queue read_turn;       /* Readers waiting for another reader to finish */
+  wait_queue write_turn;      /* Writers waiting for another writer to finish */
+  epoll_item* read_watch;     /* Interest sets watching the read end */
+  epoll_item* write_watch;    /* Interest sets watching the write end */
+  uint8_t* buf;               /* Ring of PIPE_SIZE bytes, NULL if the pipe is free */
+} pipe_t;
+
+/* Makes a pipe with one read end and one write end */
+pipe_t* pipe_create(void);
+
+/* Drops one end of a pipe, freeing it once both sides are gone */
+void pipe_release(pipe_t* pipe, int32_t writer);
+
+/* Reads what is in the pipe, waiting for at least one byte */
+int32_t pipe_read(int32_t fd, void* buf, int32_t nbytes);
+
+/* Writes everything, waiting for room */
+int32_t pipe_write(int32_t fd, const void* buf, int32_t nbytes);
+
+/* Readiness of a read end for poll */
+int32_t pipe_read_poll(int32_t fd, int32_t wait);
+
+/* Readiness of a write end for poll */
+int32_t pipe_write_poll(int32_t fd, int32_t wait);
+
+/* Watcher list of a read end for epoll */
+epoll_item** pipe_read_watch(int32_t fd);
+
+/* Watcher list of a write end for epoll */
+epoll_item** pipe_write_watch(int32_t fd);
+
+/* Pipes can't be opened by name */
+int32_t pipe_open(const uint8_t* filename);
+
+/* Closes a read end */
+int32_t pipe_read_close(int32_t fd);
+
+/* Closes a write end */
+int32_t pipe_write_close(int32_t fd);
+
+#endif /* ASM */
+
+#endif /* _PIPE_H */
@@ -4,13 +4,22 @@
 #include "syscalls.h"
 #include "paging.h"
 #include "x86_desc.h"
+#include "linkage.h"
+#include "trace.h"
+#include "kb.h"
+#include "klog.h"
 
 #define OSCILLATOR_FREQ 1193182      /* PIT oscillator runs at approximately 1.193182 MHz */
-#define INTERRUPT_INTERVAL 100    /* we want PIT interrupts every 100Hz = 10ms */
+#define INTERRUPT_INTERVAL PIT_HZ    /* we want PIT interrupts every 100Hz = 10ms */
+#define SWITCH_REGS 4                /* ebp, ebx, esi and edi, saved by switch_stack */
 
-int32_t prev_sched_term = -1; /* the scheduled process right before scheduling switch*/
-int32_t cur_sched_term = 0;	/* the next scheduled process */
-sched_node sched_arr[SCHED_SIZE];	/* scheduling data strucute */
+int32_t cur_pid = 0; /* the process on the CPU, 0 before launch */
+int32_t cur_sched_term = 0;	/* terminal of the running process */
+sched_node sched_arr[SCHED_SIZE];	/* video state of each terminal */
+volatile uint32_t pit_ticks = 0; /* PIT interrupts since boot */
+wait_queue tick_wait = 0; /* processes woken on the next tick */
+static volatile int32_t tick_work_busy = 0;    /* a tick is in tick_work */
+static volatile int32_t tick_work_pending = 0; /* a tick came in during tick_work */
 
 /*
  * pit_init
@@ -25,23 +34,9 @@ void pit_init(void){
   uint32_t divisor_low = divisor & 0xFF; /* low byte of divisor */
   uint32_t divisor_high = (divisor >> 8) & 0xFF; /* high byte of divisor */
 
-	sched_arr[0].process_num = 1;
   sched_arr[0].video_buffer = FIRST_SHELL;
-	sched_arr[0].vid_map = 0;
-  sched_arr[0].esp = EIGHT_MB;
-  sched_arr[0].ebp = EIGHT_MB;
-
-  sched_arr[1].process_num = 2;
   sched_arr[1].video_buffer = SECOND_SHELL;
-	sched_arr[1].vid_map = 0;
-  sched_arr[1].esp = -1;
-  sched_arr[1].ebp = -1;
-
-  sched_arr[2].process_num = 3;
   sched_arr[2].video_buffer = THIRD_SHELL;
-	sched_arr[2].vid_map = 0;
-  sched_arr[2].esp = -1;
-  sched_arr[2].ebp = -1;
 
   outb(0x36, PIT_COMMAND_PORT); /* 0x36 = command to set PIT to repeating mode */
   outb(divisor_low, PIT_CHANNEL0); /* write low and high byte of divisor to channel 0 */
@@ -52,40 +47,85 @@ void pit_init(void){
 }
 
 /*
- * switch_process
- *    DESCRIPTION: Switch from currently scheduled process to next scheduled process
+ * next_runnable
+ *    DESCRIPTION: Finds the next process after the running one that can run,
+ *                 going round the process slots in order
  *    INPUTS: none
  *    OUTPUTS: none
+ *    RETURN VALUE: pid of the process, the running one if it is the only
+ *                  one, or -1 if nothing can run
+ *    SIDE EFFECTS: none
+ */
+static int32_t next_runnable(void){
+  int32_t i, pid; /* Loop variable and candidate pid */
+  pcb_t* pcb;
+
+  for(i = 1; i <= MAX_PROGS; i++){
+    pid = (cur_pid - 1 + i) % MAX_PROGS + 1;
+    pcb = get_pcb(pid);
+    if(process_array[pid - 1] != -1 && (pcb->state == PROC_NEW || pcb->state == PROC_RUNNABLE)){
+      return pid;
+    }
+  }
+  return -1;
+}
+
+/*
+ * sched_new
+ *    DESCRIPTION: Lays out a new process' kernel stack the way switch_stack
+ *                 leaves it, so the first switch to the process returns into
+ *                 start_process and on to user space
+ *    INPUTS: int32_t pid - the new process, its pcb must already be in place
+ *            uint32_t entry - address of the program's first instruction
+ *            uint32_t esp - user stack pointer, USER_ESP or a thread's stack
+ *    OUTPUTS: none
  *    RETURN VALUE: none
- *    SIDE EFFECTS: restores info of next process and saves current process ebp,esp
- *									remaps video memory paging
- *									starts executing the next scheduled process
+ *    SIDE EFFECTS: Marks the process PROC_NEW
+ */
+void sched_new(int32_t pid, uint32_t entry, uint32_t esp){
+  pcb_t* pcb = get_pcb(pid);
+  uint32_t* stack = (uint32_t*)(EIGHT_MB - (pid - 1)*EIGHT_KB);
+  int32_t i;
+
+  *(--stack) = esp;
+  *(--stack) = entry;
+  *(--stack) = (uint32_t)start_process;
+  for(i = 0; i < SWITCH_REGS; i++){
+    *(--stack) = 0;
+  }
+
+  pcb->current_esp = (int32_t)stack;
+  pcb->state = PROC_NEW;
+}
+
+/*
+ * switch_process
+ *    DESCRIPTION: Switch from the running process to another one
+ *    INPUTS: int32_t next - pid of the process to run
+ *    OUTPUTS: none
+ *    RETURN VALUE: none
+ *    SIDE EFFECTS: saves the running process' kernel stack and resumes next's
  *									remaps vidmap system call's paging if needed
  *									changes the terminal that terminal_write prints to
  */
-void switch_process(){
+static void switch_process(int32_t next){
+  pcb_t* prev_pcb = get_pcb(cur_pid);
+  pcb_t* next_pcb = get_pcb(next);
+  pcb_t* next_proc = get_pcb(next_pcb->tgid); /* Threads share their main thread's memory */
+
+  TRACE(TRACE_SWITCH, next);
+
 	/* Set TSS to next process */
-  tss.esp0 = EIGHT_MB - (sched_arr[cur_sched_term].process_num - 1)*EIGHT_KB;
-
-	/* Remap user page */
-  set_page_dir_entry(USER_PROG, EIGHT_MB + (sched_arr[cur_sched_term].process_num - 1)*FOUR_MB);
-
-	/* Remap video memory paging along with user video memory if process uses vidmap */
-  if(cur_sched_term == cur_terminal){
-		if(sched_arr[cur_sched_term].vid_map == 1){
-			/* scheduled process is same as currently viewing terminal, set user video mem to map to physical video mem */
-			set_page_table2_entry(USER_VIDEO_MEM, VIDEO_MEM_ADDR);
-		}
-		/* scheduled process is same as currently viewing terminal, set video mem to map to physical video mem */
-    set_page_table1_entry(VIDEO_MEM_ADDR, VIDEO_MEM_ADDR);
-  } else{
-		if(sched_arr[cur_sched_term].vid_map == 1){
-			/* set user video mem to map to scheduled process' video buffer */
-			set_page_table2_entry(USER_VIDEO_MEM, sched_arr[cur_sched_term].video_buffer);
-		}
-		/* set video mem to map to scheduled process' video buffer */
-    set_page_table1_entry(VIDEO_MEM_ADDR, sched_arr[cur_sched_term].video_buffer);
-  }
+  tss.esp0 = EIGHT_MB - (next - 1)*EIGHT_KB;
+
+	/* Remap user page and shared memory */
+  set_page_dir_entry(USER_PROG, EIGHT_MB + (next_pcb->tgid - 1)*FOUR_MB);
+  set_shm_table(next_proc->shm.table);
+
+	/* Remap user video memory if process uses vidmap, to its terminal's text region whether or not it is viewed */
+	if(next_proc->vidmem){
+		set_page_table2_entry(USER_VIDEO_MEM, sched_arr[next_pcb->terminal].video_buffer);
+	}
 
 	/* Flush TLB */
 	asm volatile ("      \n\
@@ -97,36 +137,170 @@ void switch_process(){
 	);
 
 	/* set terminal write to print to the terminal that is being scheduled */
+	cur_pid = next;
+	cur_sched_term = next_pcb->terminal;
 	print_terminal = cur_sched_term;
 
-	/* Save esp and ebp */
-	asm volatile("    \n\
-     movl %%esp, %0 \n\
-     movl %%ebp, %1"
-     : "=r"(sched_arr[prev_sched_term].esp), "=r"(sched_arr[prev_sched_term].ebp)
-  );
-
-	/* Check if terminal has been accessed before */
-	if(sched_arr[cur_sched_term].esp == -1){
-		/* Unmask PIC interrupts*/
-	  enable_irq(PIT_IRQ_NUM);
-
-	  asm volatile("       \n\
-	    movl %0, %%ecx     \n\
-	    jmp context_switch"
-	    :
-	    : "r"(program_addr_test)
-	    : "ecx"
-	  );
+	/* A new process starts from the stack sched_new laid out */
+	if(next_pcb->state == PROC_NEW){
+		next_pcb->state = PROC_RUNNABLE;
 	}
 
-	/* Restore esp and ebp */
-  asm volatile("    \n\
-     movl %0, %%esp \n\
-     movl %1, %%ebp"
-     :
-     : "r"(sched_arr[cur_sched_term].esp), "r"(sched_arr[cur_sched_term].ebp)
-  );
+	/* Save this stack and run on next's until something switches back */
+	switch_stack(&(prev_pcb->current_esp), next_pcb->current_esp);
+}
+
+/*
+ * schedule
+ *    DESCRIPTION: Gives the CPU to the next runnable process
+ *    INPUTS: none
+ *    OUTPUTS: none
+ *    RETURN VALUE: none
+ *    SIDE EFFECTS: returns once the running process is switched back to, or
+ *                  right away if nothing else can run
+ */
+void schedule(void){
+  unsigned long flags; /* Hold the current flags */
+  int32_t next;        /* Process to run */
+
+  cli_and_save(flags);
+  if(cur_pid != 0 && (next = next_runnable()) != -1 && next != cur_pid){
+    switch_process(next);
+  }
+  restore_flags(flags);
+}
+
+/*
+ * sched_exit
+ *    DESCRIPTION: Runs something else after the running process has freed its
+ *                 slot, idling until there is something to run
+ *    INPUTS: none
+ *    OUTPUTS: none
+ *    RETURN VALUE: none, never returns
+ *    SIDE EFFECTS: the halted process' kernel stack is abandoned
+ */
+void sched_exit(void){
+  int32_t next; /* Process to run */
+
+  cli();
+  while((next = next_runnable()) == -1){
+    /* sti only takes effect after hlt, so no wake up is missed */
+    asm volatile ("sti; hlt; cli");
+  }
+  switch_process(next);
+}
+
+/*
+ * wait_on
+ *    DESCRIPTION: Puts the running process on a wait queue without sleeping,
+ *                 so it can wait on several before sched_block
+ *    INPUTS: wait_queue* queue - queue to join
+ *    OUTPUTS: none
+ *    RETURN VALUE: none
+ *    SIDE EFFECTS: The caller masks interrupts until it blocks
+ */
+void wait_on(wait_queue* queue){
+  *queue |= 1 << (cur_pid - 1);
+}
+
+/*
+ * sched_block
+ *    DESCRIPTION: Blocks the running process until a wake_up on any queue it
+ *                 joined with wait_on. The caller masks interrupts while it
+ *                 checks what it's waiting for, and checks again after waking
+ *    INPUTS: none
+ *    OUTPUTS: none
+ *    RETURN VALUE: 0 when woken, -1 if a signal cut the wait short and the
+ *                  caller should fail
+ *    SIDE EFFECTS: other processes run, or the CPU idles, until wake_up
+ */
+int32_t sched_block(void){
+  pcb_t* pcb = get_pcb(cur_pid);
+
+  if(signal_pending()){
+    return -1;
+  }
+
+  pcb->state = PROC_BLOCKED;
+  while(pcb->state == PROC_BLOCKED){
+    schedule();
+    if(pcb->state == PROC_BLOCKED){
+      /* Nothing else can run, wait for an interrupt to wake us */
+      asm volatile ("sti; hlt; cli");
+    }
+  }
+  return signal_pending() ? -1 : 0;
+}
+
+/*
+ * sleep_on
+ *    DESCRIPTION: Blocks the running process on a wait queue. The caller masks
+ *                 interrupts while it checks what it's waiting for, and checks
+ *                 again after waking
+ *    INPUTS: wait_queue* queue - queue to sleep on
+ *    OUTPUTS: none
+ *    RETURN VALUE: 0 when woken, -1 if a signal cut the wait short
+ *    SIDE EFFECTS: other processes run, or the CPU idles, until wake_up
+ */
+int32_t sleep_on(wait_queue* queue){
+  wait_on(queue);
+  return sched_block();
+}
+
+/*
+ * wake_up
+ *    DESCRIPTION: Makes every process asleep on a wait queue runnable
+ *    INPUTS: wait_queue* queue - queue to empty
+ *    OUTPUTS: none
+ *    RETURN VALUE: none
+ *    SIDE EFFECTS: the processes run on a later schedule
+ */
+void wake_up(wait_queue* queue){
+  unsigned long flags; /* Hold the current flags */
+  uint32_t bit;        /* Sleeping process' bit */
+  pcb_t* pcb;
+
+  cli_and_save(flags);
+  while(*queue != 0){
+    asm volatile ("bsfl %1, %0" : "=r"(bit) : "r"(*queue));
+    *queue &= ~(1 << bit);
+    pcb = get_pcb(bit + 1);
+    if(pcb->state == PROC_BLOCKED){
+      pcb->state = PROC_RUNNABLE;
+    }
+  }
+  restore_flags(flags);
+}
+
+/*
+ * tick_work
+ *    DESCRIPTION: The part of a tick that runs with interrupts enabled, so the
+ *                 other devices aren't held off while it works
+ *    INPUTS: none
+ *    OUTPUTS: none
+ *    RETURN VALUE: none
+ *    SIDE EFFECTS: Called by the PIT handler after EOI with interrupts masked,
+ *                  returns with them masked. A tick that comes in meanwhile
+ *                  asks for another pass instead of starting its own
+ */
+static void tick_work(void){
+  tick_work_busy = 1;
+  do{
+    tick_work_pending = 0;
+    sti();
+
+    /* Print what was logged since the last tick */
+    klog_drain();
+
+    /* Handle the keys typed since the last tick */
+    keyboard_process();
+
+    /* Draw this frame's terminal output */
+    screen_flush();
+
+    cli();
+  } while(tick_work_pending);
+  tick_work_busy = 0;
 }
 
 /*
@@ -135,7 +309,9 @@ void switch_process(){
  *    INPUTS: none
  *    OUTPUTS: none
  *    RETURN VALUE: none
- *    SIDE EFFECTS: switch to next scheduled process
+ *    SIDE EFFECTS: switch to next scheduled process. The log is printed, keys
+ *                  are handled and the screen is drawn in tick_work with
+ *                  interrupts enabled
  */
 void pit_interrupt_handler(void){
   unsigned long flags; /* Hold the current flags */
@@ -143,34 +319,31 @@ void pit_interrupt_handler(void){
   /* Mask interrupt flags */
   cli_and_save(flags);
 
-  /* Turn off PIC interrupts */
-  disable_irq(PIT_IRQ_NUM);
-
   /* Send EOI signal */
   send_eoi(PIT_IRQ_NUM);
 
-  /* Check if interrupts are allowed */
-	if(prev_sched_term == -1){
-		/* Unmask PIC interrupts*/
-	  enable_irq(PIT_IRQ_NUM);
-
-	  /* Re-enable interrupts and restores flags */
-	  restore_flags(flags);
-
-		return;
-	}
-
-	/* move to next scheduled process */
-	prev_sched_term = cur_sched_term;
+  pit_ticks++;
+  if(__builtin_expect(trace_on, 0)){
+    trace_tick();
+  }
+  if(tick_wait != 0){
+    wake_up(&tick_wait);
+  }
+  signal_tick();
 
-  /* Increment schedule number */
-  cur_sched_term = (cur_sched_term + 1) % SCHED_SIZE;
+  /* Queue what was logged since the last tick for the serial port */
+  klog_send();
 
-  /* Change process */
-  switch_process();
+  /* The tick this one interrupted finishes the work and schedules */
+  if(tick_work_busy){
+    tick_work_pending = 1;
+    restore_flags(flags);
+    return;
+  }
+  tick_work();
 
-  /* Unmask PIC interrupts*/
-  enable_irq(PIT_IRQ_NUM);
+  /* Change process, interrupts stay masked until this process is back */
+  schedule();
 
   /* Re-enable interrupts and restores flags */
   restore_flags(flags);
@@ -7,30 +7,60 @@
 #define PIT_CHANNEL0 0x40
 #define PIT_COMMAND_PORT 0x43
 #define SCHED_SIZE 3
+/* PIT interrupts per second */
+#define PIT_HZ 100
+/* Milliseconds between PIT interrupts */
+#define MS_PER_TICK (1000 / PIT_HZ)
 
 #ifndef ASM
 
-/* State of scheduled process */
+/* Video state of a terminal */
 typedef struct sched{
-	int32_t process_num;
   int32_t video_buffer;
-	int32_t vid_map;
-  int32_t esp;
-  int32_t ebp;
 } sched_node;
 
-/* Terminal currently scheduled to execute */
-extern int32_t cur_sched_term;
+/* Processes asleep on something, bit pid - 1 is set for each one */
+typedef uint32_t wait_queue;
+
+/* Process running on the CPU, 0 until the shells are launched */
+extern int32_t cur_pid;
 
-/* Previously scheduled terminal */
-extern int32_t prev_sched_term;
+/* Terminal of the running process */
+extern int32_t cur_sched_term;
 
-/* State of scheduled process */
+/* Video state of each terminal */
 extern sched_node sched_arr[SCHED_SIZE];
 
+/* Number of PIT interrupts since boot */
+extern volatile uint32_t pit_ticks;
+
+/* Processes woken on the next PIT interrupt */
+extern wait_queue tick_wait;
+
 /* initialize the pit */
 void pit_init(void);
 
+/* Sets up a process' kernel stack so its first switch starts it at entry, on user stack esp */
+void sched_new(int32_t pid, uint32_t entry, uint32_t esp);
+
+/* Switches to the next runnable process, if there is one */
+void schedule(void);
+
+/* Switches away from a process that has halted, never returns */
+void sched_exit(void);
+
+/* Puts the running process on a wait queue without sleeping */
+void wait_on(wait_queue* queue);
+
+/* Blocks the running process until a queue it is on is woken or a signal comes */
+int32_t sched_block(void);
+
+/* Blocks the running process on a wait queue until it is woken or a signal comes */
+int32_t sleep_on(wait_queue* queue);
+
+/* Makes every process on a wait queue runnable again */
+void wake_up(wait_queue* queue);
+
 /* pit interrupt handler */
 void pit_interrupt_handler(void);
 
@@ -0,0 +1,98 @@
+/* poll.c - Waiting on several descriptors at once */
+
+#include "poll.h"
+#include "syscalls.h"
+#include "paging.h"
+#include "pit.h"
+#include "lib.h"
+
+/*
+ * poll_scan
+ *    DESCRIPTION: Asks each descriptor's driver what is ready. Until one is,
+ *                 drivers put the caller on the queues that will change that
+ *    INPUTS: pollfd* fds - descriptors to check
+ *            int32_t nfds - number of descriptors
+ *            int32_t wait - nonzero if the caller will sleep when none are ready
+ *    OUTPUTS: revents of each descriptor
+ *    RETURN VALUE: number of descriptors with revents set
+ *    SIDE EFFECTS: Called with interrupts masked
+ */
+static int32_t poll_scan(pollfd* fds, int32_t nfds, int32_t wait){
+  file_desc* file;
+  int32_t i, mask, ready = 0;
+
+  for(i = 0; i < nfds; i++){
+    if(fds[i].fd < 0){
+      fds[i].revents = 0;
+      continue;
+    }
+
+    file = get_fd(fds[i].fd);
+    if(file == NULL){
+      mask = POLLNVAL;
+    } else if(file->jump_ptr->poll == NULL){
+      /* Files, directories and the screen never make a caller wait */
+      mask = POLLIN | POLLOUT;
+    } else{
+      /* Once something is ready there's no need to wait on the rest */
+      mask = file->jump_ptr->poll(fds[i].fd, wait && ready == 0);
+    }
+
+    fds[i].revents = mask & (fds[i].events | POLL_ALWAYS);
+    if(fds[i].revents != 0){
+      ready++;
+    }
+  }
+  return ready;
+}
+
+/*
+ * poll
+ *    DESCRIPTION: System call to wait until any of several descriptors can
+ *                 be read or written without waiting. Sleeps on the drivers'
+ *                 wait queues rather than spinning
+ *    INPUTS: pollfd* fds - descriptors and the events wanted
+ *            int32_t nfds - number of descriptors
+ *            int32_t timeout - milliseconds to wait, 0 to only check, or
+ *                              negative to wait for as long as it takes
+ *    OUTPUTS: revents of each descriptor
+ *    RETURN VALUE: number of ready descriptors, 0 if the timeout passed, or
+ *                  -1 for failure
+ *    SIDE EFFECTS: Other processes run while the caller sleeps
+ */
+int32_t poll(pollfd* fds, int32_t nfds, int32_t timeout){
+  unsigned long flags; /* Saved interrupt flag */
+  uint32_t deadline = 0; /* PIT tick the timeout ends on */
+  int32_t ready;
+
+  /* Check for a valid user array */
+  if(fds == NULL || nfds < 0 || nfds > POLL_MAX || (uint8_t*)fds < (uint8_t*)USER_PROG ||
+     (uint32_t)fds > USER_PROG + FOUR_MB - nfds * sizeof(pollfd)){
+    /* Return failure */
+    return -1;
+  }
+
+  cli_and_save(flags);
+  if(timeout > 0){
+    /* Round up, so the caller waits at least as long as it asked */
+    deadline = pit_ticks + (timeout + MS_PER_TICK - 1) / MS_PER_TICK;
+  }
+
+  while((ready = poll_scan(fds, nfds, timeout != 0)) == 0 && timeout != 0){
+    if(timeout > 0){
+      /* Signed, so the counter wrapping doesn't end the wait early */
+      if((int32_t)(deadline - pit_ticks) <= 0){
+        break;
+      }
+      wait_on(&tick_wait);
+    }
+    if(sched_block() == -1){
+      /* A signal is waiting */
+      ready = -1;
+      break;
+    }
+  }
+  restore_flags(flags);
+
+  return ready;
+}
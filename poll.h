@@ -0,0 +1,34 @@
+/* poll.h - Waiting on several descriptors at once */
+
+#ifndef _POLL_H
+#define _POLL_H
+
+#include "types.h"
+
+/* Events, in pollfd's events and revents */
+#define POLLIN          0x01    /* Read won't wait */
+#define POLLOUT         0x04    /* Write won't wait */
+#define POLLERR         0x08    /* Nobody reads what is written, always reported */
+#define POLLHUP         0x10    /* Nobody writes any more, always reported */
+#define POLLNVAL        0x20    /* Descriptor isn't open, always reported */
+/* Events reported even when they weren't asked for */
+#define POLL_ALWAYS     (POLLERR | POLLHUP | POLLNVAL)
+
+/* Descriptors one poll takes */
+#define POLL_MAX        64
+
+#ifndef ASM
+
+/* One descriptor to wait on, the same layout as the user's */
+typedef struct pollfd {
+  int32_t fd;                   /* Descriptor, ignored if negative */
+  int16_t events;               /* POLLIN and POLLOUT wanted */
+  int16_t revents;              /* What happened, filled in by poll */
+} pollfd;
+
+/* Waits until a descriptor is ready or the timeout passes */
+int32_t poll(pollfd* fds, int32_t nfds, int32_t timeout);
+
+#endif /* ASM */
+
+#endif /* _POLL_H */
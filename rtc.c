@@ -3,6 +3,7 @@
 #include "i8259.h"
 #include "syscalls.h"
 #include "pit.h"
+#include "poll.h"
 
 #define MAX_FREQ 1024
 
@@ -19,6 +20,12 @@ int32_t count[3] = {0, 0, 0};
 /* Frequency requests of processes */
 int32_t frequencies[3] = {-1, -1, -1};
 
+/* Readers waiting for each terminal's next interrupt */
+static wait_queue rtc_wait[3];
+
+/* Interest sets watching each terminal's RTC */
+static epoll_item* rtc_watchers[3];
+
 /*
  * rtc_init
  *    DESCRIPTION: Initializes RTC
@@ -79,6 +86,12 @@ void rtc_interrupt_handler(void){
         /* Simulate interrupt */
         interrupt_flags[i] = 1;
         count[i] = 0;
+        if(rtc_wait[i] != 0){
+          wake_up(&rtc_wait[i]);
+        }
+        if(rtc_watchers[i] != NULL){
+          epoll_notify(rtc_watchers[i]);
+        }
       }
     }
   }
@@ -118,6 +131,8 @@ int32_t rtc_open(const uint8_t* filename){
 
   /* Set frequency to 2 Hz */
   frequencies[cur_sched_term] = MAX_FREQ / 2;
+  count[cur_sched_term] = 0;
+  interrupt_flags[cur_sched_term] = 0;
 
   /* Restore the interrupt flags */
   restore_flags(flags);
@@ -141,31 +156,67 @@ int32_t rtc_close(int32_t fd){
 
 /*
  * rtc_read
- *    DESCRIPTION: Waits for an RTC interrupt to occur
+ *    DESCRIPTION: Waits for an RTC interrupt to occur, returning at once if
+ *                 one occured since the last read
  *    INPUTS: int32_t fd - the file to read
  *            void* buf - a buffer, does nothing
  *            int32_t - number of bytes in the buffer
  *    OUTPUTS: none
  *    RETURN VALUE: 0 for success
- *    SIDE EFFECTS: none
+ *    SIDE EFFECTS: Sleeps until the interrupt
  */
 int32_t rtc_read(int32_t fd, void* buf, int32_t nbytes){
   cli();
 
-  /* Set number of occured interrupts */
-  //count[cur_sched_term] = 0;
+  /* Block until an RTC interrupt occurs */
+  while(!interrupt_flags[cur_sched_term]) {
+    if(sleep_on(&rtc_wait[cur_sched_term]) == -1){
+      sti();
+      /* Return failure, a signal is waiting */
+      return -1;
+    }
+  }
+
+  /* Use up the interrupt */
   interrupt_flags[cur_sched_term] = 0;
 
   sti();
 
-  /* Block until an RTC interrupt occurs */
-  while(!interrupt_flags[cur_sched_term]) {
+  /* Return success */
+  return 0;
+}
 
+/*
+ * rtc_poll
+ *    DESCRIPTION: Tells poll whether a read would wait for an interrupt
+ *    INPUTS: int32_t fd - not used
+ *            int32_t wait - nonzero to join the terminal's queue if it would
+ *    OUTPUTS: none
+ *    RETURN VALUE: POLLIN if an interrupt occured since the last read, 0 if
+ *                  a read would wait
+ *    SIDE EFFECTS: Called by poll with interrupts masked
+ */
+int32_t rtc_poll(int32_t fd, int32_t wait){
+  if(interrupt_flags[cur_sched_term]){
+    return POLLIN;
+  }
+  if(wait){
+    wait_on(&rtc_wait[cur_sched_term]);
   }
-
-  /* Return success */
   return 0;
 }
+
+/*
+ * rtc_watch
+ *    DESCRIPTION: Gives epoll the list notified on the terminal's interrupts
+ *    INPUTS: int32_t fd - not used
+ *    OUTPUTS: none
+ *    RETURN VALUE: the process' terminal's watcher list
+ *    SIDE EFFECTS: none
+ */
+epoll_item** rtc_watch(int32_t fd){
+  return &rtc_watchers[cur_sched_term];
+}
 /*
  * rtc_write
  *    DESCRIPTION: Change the RTC rate
@@ -4,6 +4,7 @@
 #define _RTC_H
 
 #include "types.h"
+#include "epoll.h"
 
 /* Ports and registers used to initialize the RTC. */
 #define RTC_PORT0 0x70
@@ -36,6 +37,12 @@ int32_t rtc_close(int32_t fd);
 /* RTC device driver read */
 int32_t rtc_read(int32_t fd, void* buf, int32_t nbytes);
 
+/* Tells poll whether a read would wait */
+int32_t rtc_poll(int32_t fd, int32_t wait);
+
+/* Watcher list of the RTC for epoll */
+epoll_item** rtc_watch(int32_t fd);
+
 /* Set the frequency of the RTC */
 int32_t rtc_write(int32_t fd, const void* buf, int32_t nbytes);
 
@@ -0,0 +1,151 @@
+/* scrollback.c - History of the rows that scroll off each terminal */
+
+#include "scrollback.h"
+
+/* Header bit for a row whose characters keep their own attributes */
+#define SB_MIXED     0x80
+/* Header bits with the row's length before its blank tail */
+#define SB_LEN       0x7F
+/* Header, tail attribute and size bytes around the characters */
+#define SB_OVERHEAD  3
+#define SB_MASK      (SCROLLBACK_SIZE - 1)
+
+/* History of each terminal */
+scrollback_t scrollbacks[SHELL_NUM];
+
+/*
+ * record_size
+ *    DESCRIPTION: Finds the size of a stored row from its header
+ *    INPUTS: scrollback_t* sb - history the row is in
+ *            uint32_t pos - where the row starts
+ *    OUTPUTS: none
+ *    RETURN VALUE: bytes the row takes
+ *    SIDE EFFECTS: none
+ */
+static uint32_t record_size(scrollback_t* sb, uint32_t pos){
+  uint8_t hdr = sb->buf[pos & SB_MASK];
+  uint32_t len = hdr & SB_LEN;
+
+  return SB_OVERHEAD + ((hdr & SB_MIXED) ? len << 1 : len);
+}
+
+/*
+ * scrollback_push
+ *    DESCRIPTION: Saves a row as it scrolls off the top of a terminal, dropping
+ *                 the oldest rows once the history is full
+ *    INPUTS: int32_t t - terminal
+ *            const uint16_t* row - the row's characters and attributes
+ *    OUTPUTS: none
+ *    RETURN VALUE: none
+ *    SIDE EFFECTS: Moves a scrolled back view along so it keeps showing the same rows
+ */
+void scrollback_push(int32_t t, const uint16_t* row){
+  scrollback_t* sb = &scrollbacks[t];
+  uint16_t blank = (row[NUM_COLS - 1] & 0xFF00) | ' ';
+  uint8_t attr = row[NUM_COLS - 1] >> 8;
+  uint8_t mixed = 0;
+  int32_t i, len;
+  uint32_t size;
+
+  /* The blank tail is stored as just its attribute */
+  for(len = NUM_COLS; len > 0 && row[len - 1] == blank; len--);
+  for(i = 0; i < len; i++){
+    if((row[i] >> 8) != attr){
+      mixed = SB_MIXED;
+      break;
+    }
+  }
+  size = SB_OVERHEAD + (mixed ? len << 1 : len);
+
+  /* Make room */
+  while(SCROLLBACK_SIZE - (sb->head - sb->tail) < size){
+    sb->tail += record_size(sb, sb->tail);
+    sb->lines--;
+  }
+
+  sb->buf[sb->head++ & SB_MASK] = mixed | len;
+  sb->buf[sb->head++ & SB_MASK] = attr;
+  for(i = 0; i < len; i++){
+    sb->buf[sb->head++ & SB_MASK] = row[i] & 0xFF;
+    if(mixed){
+      sb->buf[sb->head++ & SB_MASK] = row[i] >> 8;
+    }
+  }
+  sb->buf[sb->head++ & SB_MASK] = size;
+  sb->lines++;
+
+  if(sb->view != 0){
+    sb->view++;
+  }
+  if(sb->view > sb->lines){
+    sb->view = sb->lines;
+  }
+}
+
+/*
+ * scrollback_read
+ *    DESCRIPTION: Unpacks stored rows, oldest first, starting a number of rows
+ *                 back from the newest
+ *    INPUTS: int32_t t - terminal
+ *            int32_t back - how far back the first row is, 1 for the newest
+ *            int32_t n - most rows to unpack
+ *    OUTPUTS: uint16_t* rows - NUM_COLS characters and attributes for each row
+ *    RETURN VALUE: number of rows unpacked
+ *    SIDE EFFECTS: none
+ */
+int32_t scrollback_read(int32_t t, int32_t back, uint16_t* rows, int32_t n){
+  scrollback_t* sb = &scrollbacks[t];
+  uint32_t pos = sb->head;
+  uint8_t hdr, attr;
+  int32_t i, row, len;
+
+  if(back > sb->lines){
+    back = sb->lines;
+  }
+  if(n > back){
+    n = back;
+  }
+
+  /* Walk back by the size each row ends with */
+  for(i = 0; i < back; i++){
+    pos -= sb->buf[(pos - 1) & SB_MASK];
+  }
+
+  for(row = 0; row < n; row++, rows += NUM_COLS){
+    hdr = sb->buf[pos++ & SB_MASK];
+    attr = sb->buf[pos++ & SB_MASK];
+    len = hdr & SB_LEN;
+    for(i = 0; i < len; i++){
+      if(hdr & SB_MIXED){
+        rows[i] = sb->buf[pos & SB_MASK] | (sb->buf[(pos + 1) & SB_MASK] << 8);
+        pos += 2;
+      } else{
+        rows[i] = sb->buf[pos++ & SB_MASK] | (attr << 8);
+      }
+    }
+    for(; i < NUM_COLS; i++){
+      rows[i] = (attr << 8) | ' ';
+    }
+    /* Skip the size */
+    pos++;
+  }
+  return n;
+}
+
+/*
+ * scrollback_report
+ *    DESCRIPTION: Measures how compactly a terminal's history is stored
+ *    INPUTS: int32_t t - terminal
+ *    OUTPUTS: none
+ *    RETURN VALUE: bytes SCROLLBACK_REPORT rows like the ones stored would take,
+ *                  0 if there are none
+ *    SIDE EFFECTS: none
+ */
+uint32_t scrollback_report(int32_t t){
+  scrollback_t* sb = &scrollbacks[t];
+
+  if(sb->lines == 0){
+    return 0;
+  }
+  return (sb->head - sb->tail) * SCROLLBACK_REPORT / sb->lines;
+}
@@ -0,0 +1,44 @@
+/* scrollback.h - History of the rows that scroll off each terminal */
+
+#ifndef _SCROLLBACK_H
+#define _SCROLLBACK_H
+
+#include "types.h"
+#include "lib.h"
+
+/* Bytes of history per terminal, a power of two so an offset is a mask */
+#define SCROLLBACK_SIZE   0x10000
+/* Rows Shift+PgUp and Shift+PgDn move the view, one row stays on screen */
+#define SCROLLBACK_PAGE   (NUM_ROWS - 1)
+/* Lines the memory report is scaled to */
+#define SCROLLBACK_REPORT 10000
+
+#ifndef ASM
+
+/* One terminal's history. A row is stored as a header byte with its length
+ * before the blank tail, the tail's attribute, then its characters, or each
+ * character and its own attribute when the attributes differ, then the
+ * record's size so the ring can be walked back from the newest row */
+typedef struct scrollback_t {
+  uint32_t head;                   /* Bytes ever written */
+  uint32_t tail;                   /* Where the oldest row starts */
+  int32_t lines;                   /* Rows in the ring */
+  int32_t view;                    /* Rows the view is scrolled back, 0 shows the live screen */
+  uint8_t buf[SCROLLBACK_SIZE];
+} scrollback_t;
+
+/* History of each terminal */
+extern scrollback_t scrollbacks[SHELL_NUM];
+
+/* Save a row as it scrolls off the top of a terminal */
+void scrollback_push(int32_t t, const uint16_t* row);
+
+/* Unpack rows, starting back rows from the newest */
+int32_t scrollback_read(int32_t t, int32_t back, uint16_t* rows, int32_t n);
+
+/* Bytes the terminal's history would take for SCROLLBACK_REPORT rows like it */
+uint32_t scrollback_report(int32_t t);
+
+#endif /* ASM */
+
+#endif /* _SCROLLBACK_H */
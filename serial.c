@@ -0,0 +1,342 @@
+/* serial.c - COM1 16550 UART, as a device and a sink for the kernel log */
+
+#include "serial.h"
+#include "lib.h"
+#include "i8259.h"
+#include "syscalls.h"
+#include "poll.h"
+
+/* Registers, from COM1_PORT */
+#define UART_DATA     0   /* Receive and transmit, divisor low byte with DLAB */
+#define UART_IER      1   /* Interrupt enable, divisor high byte with DLAB */
+#define UART_IIR      2   /* Interrupt identification, FIFO control on write */
+#define UART_LCR      3   /* Line control */
+#define UART_MCR      4   /* Modem control */
+#define UART_LSR      5   /* Line status */
+#define UART_SCR      7   /* Scratch */
+
+#define IER_RX        0x01  /* Data received, or sitting in the FIFO */
+#define IER_TX        0x02  /* Transmit holding register empty */
+#define IIR_NONE      0x01  /* No interrupt pending */
+#define LCR_8N1       0x03  /* 8 data bits, no parity, 1 stop bit */
+#define LCR_DLAB      0x80  /* Divisor latch access */
+#define FCR_ENABLE    0xC7  /* Enable and clear both FIFOs, receive interrupt at 14 bytes */
+#define MCR_IRQ       0x0B  /* DTR, RTS, and OUT2 to let the interrupt through */
+#define LSR_DATA      0x01  /* A received byte is waiting */
+#define LSR_THRE      0x20  /* The transmit FIFO is empty */
+#define LSR_TEMT      0x40  /* The last byte has left the shift register */
+#define SCR_PROBE     0xAE  /* Read back from the scratch register if a UART is there */
+#define BAUD_DIVISOR  1     /* 115200 baud */
+
+int32_t serial_present = 0;       /* Whether a UART answered at COM1 */
+uint32_t serial_rx_overruns = 0;  /* Received bytes dropped on a full ring */
+
+/* Bytes waiting to go out. Writers add with interrupts masked, the interrupt takes */
+static uint8_t tx_buf[SERIAL_TX_SIZE];
+static volatile uint32_t tx_head = 0;
+static volatile uint32_t tx_tail = 0;
+
+/* Bytes received. Only the interrupt adds, serial_read takes with interrupts masked */
+static uint8_t rx_buf[SERIAL_RX_SIZE];
+static volatile uint32_t rx_head = 0;
+static volatile uint32_t rx_tail = 0;
+
+static wait_queue rx_wait = 0;    /* Readers waiting for a byte */
+static wait_queue tx_wait = 0;    /* Writers waiting for room */
+static epoll_item* watch = NULL;  /* Interest sets watching the port */
+
+/*
+ * tx_fill
+ *    DESCRIPTION: Moves queued bytes into the transmit FIFO once it has
+ *                 emptied, a FIFO's worth at a time
+ *    INPUTS: none
+ *    OUTPUTS: none
+ *    RETURN VALUE: none
+ *    SIDE EFFECTS: The empty interrupt is on only while bytes are queued.
+ *                  Called with interrupts masked
+ */
+static void tx_fill(void){
+  int32_t i;
+
+  if(inb(COM1_PORT + UART_LSR) & LSR_THRE){
+    for(i = 0; i < UART_FIFO_SIZE && tx_tail != tx_head; i++){
+      outb(tx_buf[tx_tail & (SERIAL_TX_SIZE - 1)], COM1_PORT + UART_DATA);
+      tx_tail++;
+    }
+  }
+  outb(tx_tail != tx_head ? IER_RX | IER_TX : IER_RX, COM1_PORT + UART_IER);
+}
+
+/*
+ * serial_init
+ *    DESCRIPTION: Finds the UART at COM1 and sets it to 115200 baud 8N1 with
+ *                 its FIFOs and receive interrupt on
+ *    INPUTS: none
+ *    OUTPUTS: none
+ *    RETURN VALUE: none
+ *    SIDE EFFECTS: Unmasks IRQ4 on the PIC if the UART is there
+ */
+void serial_init(void){
+  /* Nothing answers on the scratch register without a UART */
+  outb(SCR_PROBE, COM1_PORT + UART_SCR);
+  if(inb(COM1_PORT + UART_SCR) != SCR_PROBE){
+    return;
+  }
+
+  outb(0, COM1_PORT + UART_IER);
+  outb(LCR_DLAB, COM1_PORT + UART_LCR);
+  outb(BAUD_DIVISOR & 0xFF, COM1_PORT + UART_DATA);
+  outb(BAUD_DIVISOR >> 8, COM1_PORT + UART_IER);
+  outb(LCR_8N1, COM1_PORT + UART_LCR);
+  outb(FCR_ENABLE, COM1_PORT + UART_IIR);
+  outb(MCR_IRQ, COM1_PORT + UART_MCR);
+  outb(IER_RX, COM1_PORT + UART_IER);
+
+  serial_present = 1;
+  enable_irq(SERIAL_IRQ_NUM);
+}
+
+/*
+ * serial_interrupt_handler
+ *    DESCRIPTION: Handler for serial interrupts. Empties the receive FIFO into
+ *                 its ring and refills the transmit FIFO from its ring
+ *    INPUTS: none
+ *    OUTPUTS: none
+ *    RETURN VALUE: none
+ *    SIDE EFFECTS: Wakes readers and writers, and sends EOI
+ */
+void serial_interrupt_handler(void){
+  uint32_t head;
+
+  /* The interrupt line is edge triggered, so nothing can be left pending */
+  while(!(inb(COM1_PORT + UART_IIR) & IIR_NONE)){
+    head = rx_head;
+    while(inb(COM1_PORT + UART_LSR) & LSR_DATA){
+      if(head - rx_tail < SERIAL_RX_SIZE){
+        rx_buf[head++ & (SERIAL_RX_SIZE - 1)] = inb(COM1_PORT + UART_DATA);
+      } else{
+        inb(COM1_PORT + UART_DATA);
+        serial_rx_overruns++;
+      }
+    }
+    barrier();
+    rx_head = head;
+    tx_fill();
+  }
+
+  if(rx_head != rx_tail && rx_wait != 0){
+    wake_up(&rx_wait);
+  }
+  if(tx_head - tx_tail < SERIAL_TX_SIZE && tx_wait != 0){
+    wake_up(&tx_wait);
+  }
+  if(watch != NULL){
+    epoll_notify(watch);
+  }
+
+  send_eoi(SERIAL_IRQ_NUM);
+}
+
+/*
+ * serial_room
+ *    DESCRIPTION: Counts the bytes that can be queued without waiting
+ *    INPUTS: none
+ *    OUTPUTS: none
+ *    RETURN VALUE: free bytes in the transmit ring, 0 without a UART
+ *    SIDE EFFECTS: none
+ */
+int32_t serial_room(void){
+  return serial_present ? SERIAL_TX_SIZE - (tx_head - tx_tail) : 0;
+}
+
+/*
+ * serial_send
+ *    DESCRIPTION: Queues bytes to send without waiting, and starts the
+ *                 transmitter if it is idle
+ *    INPUTS: const uint8_t* buf - bytes to send
+ *            int32_t n - number of bytes
+ *    OUTPUTS: none
+ *    RETURN VALUE: number of bytes queued, fewer than n if the ring filled
+ *    SIDE EFFECTS: none
+ */
+int32_t serial_send(const uint8_t* buf, int32_t n){
+  unsigned long flags; /* Saved interrupt flag */
+  uint32_t count, start, first; /* Bytes to queue, where in the ring and before the wrap */
+
+  cli_and_save(flags);
+  count = serial_room();
+  if(count > (uint32_t)n){
+    count = n;
+  }
+  start = tx_head & (SERIAL_TX_SIZE - 1);
+  first = count < SERIAL_TX_SIZE - start ? count : SERIAL_TX_SIZE - start;
+  memcpy(tx_buf + start, buf, first);
+  memcpy(tx_buf, buf + first, count - first);
+  tx_head += count;
+  if(count > 0){
+    tx_fill();
+  }
+  restore_flags(flags);
+  return count;
+}
+
+/*
+ * serial_flush
+ *    DESCRIPTION: Waits until everything queued has left the UART, for a
+ *                 caller about to stop the machine
+ *    INPUTS: none
+ *    OUTPUTS: none
+ *    RETURN VALUE: none
+ *    SIDE EFFECTS: Spins, the serial interrupt must be able to come in
+ */
+void serial_flush(void){
+  if(!serial_present){
+    return;
+  }
+  while(tx_head != tx_tail);
+  while(!(inb(COM1_PORT + UART_LSR) & LSR_TEMT));
+}
+
+/*
+ * serial_open
+ *    DESCRIPTION: Opens the serial port
+ *    INPUTS: const uint8_t* filename - not used
+ *    OUTPUTS: none
+ *    RETURN VALUE: 0 for success
+ *    SIDE EFFECTS: none
+ */
+int32_t serial_open(const uint8_t* filename){
+  return 0;
+}
+
+/*
+ * serial_close
+ *    DESCRIPTION: Closes the serial port, what was written still goes out
+ *    INPUTS: int32_t fd - not used
+ *    OUTPUTS: none
+ *    RETURN VALUE: 0 for success
+ *    SIDE EFFECTS: none
+ */
+int32_t serial_close(int32_t fd){
+  return 0;
+}
+
+/*
+ * serial_read
+ *    DESCRIPTION: Reads what has been received, waiting for at least one byte
+ *    INPUTS: int32_t fd - not used
+ *            int32_t nbytes - size of the buffer
+ *    OUTPUTS: void* buf - the bytes
+ *    RETURN VALUE: number of bytes read, or -1 for failure
+ *    SIDE EFFECTS: none
+ */
+int32_t serial_read(int32_t fd, void* buf, int32_t nbytes){
+  unsigned long flags; /* Saved interrupt flag */
+  uint32_t count, start, first; /* Bytes to read, where in the ring and before the wrap */
+
+  if(!serial_present || buf == NULL || nbytes < 0){
+    /* Return failure */
+    return -1;
+  }
+  if(nbytes == 0){
+    return 0;
+  }
+
+  cli_and_save(flags);
+  while(rx_head == rx_tail){
+    if(sleep_on(&rx_wait) == -1){
+      restore_flags(flags);
+      /* Return failure, a signal is waiting */
+      return -1;
+    }
+  }
+
+  /* Any process can read the port, so the bytes are taken and tail moved
+   * before another reader runs */
+  count = rx_head - rx_tail;
+  if(count > (uint32_t)nbytes){
+    count = nbytes;
+  }
+  start = rx_tail & (SERIAL_RX_SIZE - 1);
+  first = count < SERIAL_RX_SIZE - start ? count : SERIAL_RX_SIZE - start;
+  memcpy(buf, rx_buf + start, first);
+  memcpy((uint8_t*)buf + first, rx_buf, count - first);
+  barrier();
+  rx_tail += count;
+  restore_flags(flags);
+  return count;
+}
+
+/*
+ * serial_write
+ *    DESCRIPTION: Queues everything for sending, waiting for room as the
+ *                 interrupt drains the ring
+ *    INPUTS: int32_t fd - not used
+ *            const void* buf - bytes to send
+ *            int32_t nbytes - number of bytes
+ *    OUTPUTS: none
+ *    RETURN VALUE: number of bytes written, or -1 for failure
+ *    SIDE EFFECTS: none
+ */
+int32_t serial_write(int32_t fd, const void* buf, int32_t nbytes){
+  unsigned long flags; /* Saved interrupt flag */
+  int32_t written = 0; /* Bytes queued so far */
+
+  if(!serial_present || buf == NULL || nbytes < 0){
+    /* Return failure */
+    return -1;
+  }
+
+  while(written < nbytes){
+    written += serial_send((const uint8_t*)buf + written, nbytes - written);
+
+    /* Wait for room */
+    cli_and_save(flags);
+    while(written < nbytes && serial_room() == 0){
+      if(sleep_on(&tx_wait) == -1){
+        restore_flags(flags);
+        /* A signal is waiting, report what got through */
+        return written ? written : -1;
+      }
+    }
+    restore_flags(flags);
+  }
+  return written;
+}
+
+/*
+ * serial_poll
+ *    DESCRIPTION: Tells poll whether a read or write would wait
+ *    INPUTS: int32_t fd - not used
+ *            int32_t wait - nonzero to join the queues of whatever would wait
+ *    OUTPUTS: none
+ *    RETURN VALUE: POLLIN if a byte has been received, POLLOUT if there is room to send
+ *    SIDE EFFECTS: Called by poll with interrupts masked
+ */
+int32_t serial_poll(int32_t fd, int32_t wait){
+  int32_t mask = 0;
+
+  if(rx_head != rx_tail){
+    mask |= POLLIN;
+  } else if(wait){
+    wait_on(&rx_wait);
+  }
+  if(serial_room() > 0){
+    mask |= POLLOUT;
+  } else if(wait){
+    wait_on(&tx_wait);
+  }
+  return mask;
+}
+
+/*
+ * serial_watch
+ *    DESCRIPTION: Gives epoll the list notified on each serial interrupt
+ *    INPUTS: int32_t fd - not used
+ *    OUTPUTS: none
+ *    RETURN VALUE: the port's watcher list
+ *    SIDE EFFECTS: none
+ */
+epoll_item** serial_watch(int32_t fd){
+  return &watch;
+}
@@ -0,0 +1,52 @@
+/* serial.h - COM1 16550 UART, as a device and a sink for the kernel log */
+
+#ifndef _SERIAL_H
+#define _SERIAL_H
+
+#include "types.h"
+#include "pit.h"
+#include "epoll.h"
+
+/* COM1's registers start here */
+#define COM1_PORT       0x3F8
+#define SERIAL_IRQ_NUM  4
+/* Bytes queued for sending and received but unread, powers of two so the rings can mask their counters */
+#define SERIAL_TX_SIZE  4096
+#define SERIAL_RX_SIZE  1024
+/* Bytes the transmit FIFO takes at once */
+#define UART_FIFO_SIZE  16
+
+#ifndef ASM
+
+/* Whether a UART answered at COM1 */
+extern int32_t serial_present;
+
+/* Received bytes dropped on a full ring */
+extern uint32_t serial_rx_overruns;
+
+/* Find and set up the UART */
+void serial_init(void);
+
+/* Handler for serial interrupts */
+void serial_interrupt_handler(void);
+
+/* Queue bytes to send without waiting, returning how many fit */
+int32_t serial_send(const uint8_t* buf, int32_t n);
+
+/* Bytes that can be queued without waiting */
+int32_t serial_room(void);
+
+/* Wait until everything queued has been sent */
+void serial_flush(void);
+
+/* serial file operations */
+int32_t serial_open(const uint8_t* filename);
+int32_t serial_close(int32_t fd);
+int32_t serial_read(int32_t fd, void* buf, int32_t nbytes);
+int32_t serial_write(int32_t fd, const void* buf, int32_t nbytes);
+int32_t serial_poll(int32_t fd, int32_t wait);
+epoll_item** serial_watch(int32_t fd);
+
+#endif /* ASM */
+
+#endif /* _SERIAL_H */
@@ -0,0 +1,289 @@
+/* shm.c - Shared memory segments between processes */
+
+#include "shm.h"
+#include "syscalls.h"
+#include "paging.h"
+#include "lib.h"
+
+#define PT_OFFSET     12
+#define PAGE_PRESENT  0x1
+#define USER_RW       0x7
+#define WINDOW_PAGES  (SHM_WINDOW / PAGE_SIZE)
+
+/* Every segment */
+static shm_seg segs[MAX_SHM];
+
+/*
+ * free_seg
+ *    DESCRIPTION: Gives a segment's pages back to the pool
+ *    INPUTS: shm_seg* seg - the segment
+ *    OUTPUTS: none
+ *    RETURN VALUE: none
+ *    SIDE EFFECTS: The segment's key can be used again
+ */
+static void free_seg(shm_seg* seg){
+  int32_t i;
+
+  for(i = 0; i < seg->num_pages; i++){
+    free_page((void*)seg->pages[i]);
+  }
+  seg->num_pages = 0;
+}
+
+/*
+ * window_free
+ *    DESCRIPTION: Checks that a range of the shared memory window has nothing
+ *                 mapped
+ *    INPUTS: uint32_t* table - the process' page table, NULL if it has none
+ *            uint32_t first - first page of the range in the window
+ *            int32_t num_pages - pages in the range
+ *    OUTPUTS: none
+ *    RETURN VALUE: 1 if the range is free, 0 if not
+ *    SIDE EFFECTS: none
+ */
+static int32_t window_free(uint32_t* table, uint32_t first, int32_t num_pages){
+  int32_t i;
+
+  if(first + num_pages > WINDOW_PAGES){
+    return 0;
+  }
+  for(i = 0; table != NULL && i < num_pages; i++){
+    if(table[first + i] & PAGE_PRESENT){
+      return 0;
+    }
+  }
+  return 1;
+}
+
+/*
+ * flush_tlb
+ *    DESCRIPTION: Points the window at the current process' table and flushes
+ *                 the TLB
+ *    INPUTS: uint32_t* table - the current process' page table
+ *    OUTPUTS: none
+ *    RETURN VALUE: none
+ *    SIDE EFFECTS: none
+ */
+static void flush_tlb(uint32_t* table){
+  set_shm_table(table);
+
+  asm volatile ("      \n\
+     movl %%cr3, %%eax \n\
+     movl %%eax, %%cr3"
+     :
+     :
+     : "eax"
+  );
+}
+
+/*
+ * shm_create
+ *    DESCRIPTION: Makes a shared memory segment
+ *    INPUTS: uint32_t key - name for the segment
+ *            uint32_t size - bytes, rounded up to whole pages
+ *    OUTPUTS: none
+ *    RETURN VALUE: 0 for success, -1 if the key is taken, the size is bad, or
+ *                  there's no room
+ *    SIDE EFFECTS: Takes zeroed pages from the pool. The segment goes away
+ *                  when its last attachment is detached, or when its creator
+ *                  halts if it was never attached
+ */
+int32_t shm_create(uint32_t key, uint32_t size){
+  unsigned long flags;   /* Saved interrupt flag */
+  int32_t num_pages = (size + PAGE_SIZE - 1) / PAGE_SIZE;
+  shm_seg* seg = NULL;
+  int32_t i;
+
+  if(size == 0 || num_pages > SHM_MAX_PAGES){
+    /* Return failure */
+    return -1;
+  }
+
+  cli_and_save(flags);
+  for(i = 0; i < MAX_SHM; i++){
+    if(segs[i].num_pages != 0 && segs[i].key == key){
+      restore_flags(flags);
+      /* Return failure */
+      return -1;
+    }
+    if(segs[i].num_pages == 0 && seg == NULL){
+      seg = &segs[i];
+    }
+  }
+  if(seg == NULL){
+    restore_flags(flags);
+    /* Return failure */
+    return -1;
+  }
+
+  /* Frames for the segment, all or nothing */
+  for(i = 0; i < num_pages; i++){
+    if((seg->pages[i] = (uint32_t)alloc_page()) == 0){
+      seg->num_pages = i;
+      free_seg(seg);
+      restore_flags(flags);
+      /* Return failure */
+      return -1;
+    }
+  }
+  seg->key = key;
+  seg->num_pages = num_pages;
+  seg->refs = 0;
+  seg->creator = get_proc_pcb()->pid;
+  restore_flags(flags);
+
+  /* Return success */
+  return 0;
+}
+
+/*
+ * shm_attach
+ *    DESCRIPTION: Maps a segment's frames into the current process' shared
+ *                 memory window, so processes attached to it see the same
+ *                 memory with no copies
+ *    INPUTS: uint32_t key - the segment
+ *            void* addr - page aligned address in the window, or NULL for
+ *                         the lowest free range that fits
+ *    OUTPUTS: none
+ *    RETURN VALUE: the address of the segment, or -1 for failure
+ *    SIDE EFFECTS: Takes a pool page for the process' page table the first
+ *                  time
+ */
+int32_t shm_attach(uint32_t key, void* addr){
+  pcb_t* pcb = get_proc_pcb();
+  unsigned long flags;   /* Saved interrupt flag */
+  shm_seg* seg = NULL;
+  shm_map* map = NULL;
+  uint32_t first;        /* First page in the window */
+  int32_t i;
+
+  cli_and_save(flags);
+
+  /* Find the segment and a free attachment */
+  for(i = 0; i < MAX_SHM; i++){
+    if(segs[i].num_pages != 0 && segs[i].key == key){
+      seg = &segs[i];
+    }
+  }
+  for(i = 0; i < SHM_PER_PROC; i++){
+    if(pcb->shm.maps[i].addr == 0){
+      map = &pcb->shm.maps[i];
+      break;
+    }
+  }
+  if(seg == NULL || map == NULL){
+    restore_flags(flags);
+    /* Return failure */
+    return -1;
+  }
+
+  /* Pick a place, or check the one asked for */
+  if(addr == NULL){
+    for(first = 0; first < WINDOW_PAGES && !window_free(pcb->shm.table, first, seg->num_pages); first++);
+  } else if((uint32_t)addr < SHM_BASE || ((uint32_t)addr & (PAGE_SIZE - 1)) != 0){
+    first = WINDOW_PAGES;
+  } else{
+    first = ((uint32_t)addr - SHM_BASE) >> PT_OFFSET;
+  }
+  if(first >= WINDOW_PAGES || !window_free(pcb->shm.table, first, seg->num_pages)){
+    restore_flags(flags);
+    /* Return failure */
+    return -1;
+  }
+
+  if(pcb->shm.table == NULL && (pcb->shm.table = (uint32_t*)alloc_page()) == NULL){
+    restore_flags(flags);
+    /* Return failure */
+    return -1;
+  }
+
+  for(i = 0; i < seg->num_pages; i++){
+    pcb->shm.table[first + i] = seg->pages[i] | USER_RW;
+  }
+  seg->refs++;
+  map->seg = seg - segs;
+  map->addr = SHM_BASE + (first << PT_OFFSET);
+  flush_tlb(pcb->shm.table);
+
+  restore_flags(flags);
+  return map->addr;
+}
+
+/*
+ * shm_detach
+ *    DESCRIPTION: Unmaps a segment from the current process
+ *    INPUTS: void* addr - address shm_attach returned
+ *    OUTPUTS: none
+ *    RETURN VALUE: 0 for success, -1 if nothing is attached there
+ *    SIDE EFFECTS: Frees the segment after its last attachment
+ */
+int32_t shm_detach(void* addr){
+  pcb_t* pcb = get_proc_pcb();
+  unsigned long flags;   /* Saved interrupt flag */
+  shm_seg* seg;
+  uint32_t first;        /* First page in the window */
+  int32_t i, j;
+
+  if(addr == NULL){
+    /* Return failure */
+    return -1;
+  }
+
+  cli_and_save(flags);
+  for(i = 0; i < SHM_PER_PROC; i++){
+    if(pcb->shm.maps[i].addr == (uint32_t)addr){
+      seg = &segs[pcb->shm.maps[i].seg];
+      first = ((uint32_t)addr - SHM_BASE) >> PT_OFFSET;
+      for(j = 0; j < seg->num_pages; j++){
+        pcb->shm.table[first + j] = 0;
+      }
+      pcb->shm.maps[i].addr = 0;
+      flush_tlb(pcb->shm.table);
+
+      if(--seg->refs == 0){
+        free_seg(seg);
+      }
+      restore_flags(flags);
+      /* Return success */
+      return 0;
+    }
+  }
+  restore_flags(flags);
+
+  /* Return failure */
+  return -1;
+}
+
+/*
+ * shm_exit
+ *    DESCRIPTION: Detaches every segment of the current process and frees its
+ *                 page table, then frees segments it made that nothing
+ *                 attached
+ *    INPUTS: none
+ *    OUTPUTS: none
+ *    RETURN VALUE: none
+ *    SIDE EFFECTS: The window is left unmapped
+ */
+void shm_exit(void){
+  pcb_t* pcb = get_proc_pcb();
+  unsigned long flags;   /* Saved interrupt flag */
+  int32_t i;
+
+  cli_and_save(flags);
+  for(i = 0; i < SHM_PER_PROC; i++){
+    if(pcb->shm.maps[i].addr != 0){
+      shm_detach((void*)pcb->shm.maps[i].addr);
+    }
+  }
+
+  for(i = 0; i < MAX_SHM; i++){
+    if(segs[i].num_pages != 0 && segs[i].refs == 0 && segs[i].creator == pcb->pid){
+      free_seg(&segs[i]);
+    }
+  }
+
+  free_page(pcb->shm.table);
+  pcb->shm.table = NULL;
+  flush_tlb(NULL);
+  restore_flags(flags);
+}
@@ -0,0 +1,52 @@
+/* shm.h - Shared memory segments between processes */
+
+#ifndef _SHM_H
+#define _SHM_H
+
+#include "types.h"
+
+/* Segments at once */
+#define MAX_SHM         16
+/* Largest segment, in pages */
+#define SHM_MAX_PAGES   256
+/* Segments one process can have attached */
+#define SHM_PER_PROC    8
+
+#ifndef ASM
+
+/* A segment, its frames come from the kernel page pool */
+typedef struct shm_seg {
+  uint32_t key;                    /* Name processes agree on */
+  int32_t num_pages;               /* Size in pages, 0 if the segment is free */
+  int32_t refs;                    /* Attachments, in every process */
+  int32_t creator;                 /* pid that made it */
+  uint32_t pages[SHM_MAX_PAGES];   /* Physical address of each page */
+} shm_seg;
+
+/* One attachment */
+typedef struct shm_map {
+  int32_t seg;                     /* Index of the segment */
+  uint32_t addr;                   /* Where it's attached, 0 if unused */
+} shm_map;
+
+/* Shared memory a process has attached, all zero for none */
+typedef struct shm_space {
+  uint32_t* table;                 /* Page table for the window, NULL until the first attach */
+  shm_map maps[SHM_PER_PROC];      /* Attachments */
+} shm_space;
+
+/* Makes a segment of at least size bytes */
+int32_t shm_create(uint32_t key, uint32_t size);
+
+/* Maps a segment into the current process */
+int32_t shm_attach(uint32_t key, void* addr);
+
+/* Unmaps a segment from the current process */
+int32_t shm_detach(void* addr);
+
+/* Detaches everything the current process has, for halt */
+void shm_exit(void);
+
+#endif /* ASM */
+
+#endif /* _SHM_H */
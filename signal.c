@@ -0,0 +1,297 @@
+/* signal.c - Signals delivered to user handlers on the way back to user space */
+
+#include "signal.h"
+#include "syscalls.h"
+#include "x86_desc.h"
+#include "paging.h"
+#include "pit.h"
+#include "lib.h"
+
+/* Every signal */
+#define ALL_SIGNALS     ((1 << NUM_SIGNALS) - 1)
+/* Signals that end the process when it has no handler */
+#define KILL_SIGNALS    ((1 << DIV_ZERO) | (1 << SEGFAULT) | (1 << INTERRUPT))
+/* Flags a handler may change in the context it returns to */
+#define USER_FLAGS      0x00000CD5
+/* Bytes of user stack the trampoline takes */
+#define TRAMPOLINE_SIZE 8
+
+/* movl $10, %eax; int $0x80, sigreturn from the user stack */
+static const uint8_t trampoline[TRAMPOLINE_SIZE] = {0xB8, 0x0A, 0x00, 0x00, 0x00, 0xCD, 0x80, 0x90};
+
+/*
+ * acts_on
+ *    DESCRIPTION: Finds the pending signals that will do something, run a
+ *                 handler or end the process, rather than be ignored
+ *    INPUTS: signal_state* sig - the process' signals
+ *    OUTPUTS: none
+ *    RETURN VALUE: bit per such signal
+ *    SIDE EFFECTS: none
+ */
+static uint32_t acts_on(signal_state* sig){
+  uint32_t caught = 0;
+  int32_t i;
+
+  for(i = 0; i < NUM_SIGNALS; i++){
+    if(sig->handlers[i] != NULL){
+      caught |= 1 << i;
+    }
+  }
+  return sig->pending & ~sig->masked & (caught | KILL_SIGNALS);
+}
+
+/*
+ * signal_init
+ *    DESCRIPTION: Gives a new process the default handlers, nothing pending
+ *                 and its first ALARM ALARM_SECONDS from now
+ *    INPUTS: signal_state* sig - the process' signals
+ *    OUTPUTS: none
+ *    RETURN VALUE: none
+ *    SIDE EFFECTS: none
+ */
+void signal_init(signal_state* sig){
+  memset(sig, 0, sizeof(signal_state));
+  sig->alarm_tick = pit_ticks + ALARM_SECONDS * PIT_HZ;
+}
+
+/*
+ * send_signal
+ *    DESCRIPTION: Raises a signal in a process. If the signal will do
+ *                 something, threads asleep in the kernel wake so their
+ *                 system call can fail and the signal be delivered
+ *    INPUTS: int32_t pid - any thread of the process
+ *            int32_t signum - the signal
+ *    OUTPUTS: none
+ *    RETURN VALUE: none
+ *    SIDE EFFECTS: Delivered the next time the process returns to user space
+ */
+void send_signal(int32_t pid, int32_t signum){
+  unsigned long flags; /* Saved interrupt flag */
+  pcb_t* proc_pcb = get_pcb(get_pcb(pid)->tgid);
+  int32_t i;
+
+  cli_and_save(flags);
+  proc_pcb->sig.pending |= 1 << signum;
+  if(acts_on(&proc_pcb->sig)){
+    for(i = 0; i < MAX_PROGS; i++){
+      if(process_array[i] != -1 && get_pcb(i + 1)->tgid == proc_pcb->pid && get_pcb(i + 1)->state == PROC_BLOCKED){
+        get_pcb(i + 1)->state = PROC_RUNNABLE;
+      }
+    }
+  }
+  restore_flags(flags);
+}
+
+/*
+ * signal_foreground
+ *    DESCRIPTION: Raises a signal in the process the user is typing to on a
+ *                 terminal, the last one execute started there. The shell
+ *                 at the bottom and background processes are left alone
+ *    INPUTS: int32_t terminal - the terminal
+ *            int32_t signum - the signal
+ *    OUTPUTS: none
+ *    RETURN VALUE: none
+ *    SIDE EFFECTS: Called from the keyboard handler
+ */
+void signal_foreground(int32_t terminal, int32_t signum){
+  pcb_t* pcb;
+  pcb_t* child;
+  int32_t i, j;
+
+  for(i = 0; i < MAX_PROGS; i++){
+    pcb = get_pcb(i + 1);
+    if(process_array[i] == -1 || pcb->tgid != pcb->pid || pcb->terminal != terminal || pcb->background){
+      continue;
+    }
+
+    /* A process execute is waiting on isn't the one in front */
+    for(j = 0; j < MAX_PROGS; j++){
+      child = get_pcb(j + 1);
+      if(j != i && process_array[j] != -1 && child->tgid == child->pid && !child->background &&
+         child->parent_pid != 0 && get_pcb(child->parent_pid)->tgid == pcb->pid){
+        break;
+      }
+    }
+
+    if(j == MAX_PROGS && pcb->parent_pid != 0){
+      send_signal(pcb->pid, signum);
+      return;
+    }
+  }
+}
+
+/*
+ * signal_pending
+ *    DESCRIPTION: Checks for a signal that should cut a sleep in the kernel
+ *                 short, one with a handler or one that ends the process
+ *    INPUTS: none
+ *    OUTPUTS: none
+ *    RETURN VALUE: nonzero if there is one
+ *    SIDE EFFECTS: none
+ */
+int32_t signal_pending(void){
+  return cur_pid != 0 && acts_on(&get_proc_pcb()->sig) != 0;
+}
+
+/*
+ * signal_caught
+ *    DESCRIPTION: Checks whether the current process would run a handler for
+ *                 a signal now, rather than take the default
+ *    INPUTS: int32_t signum - the signal
+ *    OUTPUTS: none
+ *    RETURN VALUE: nonzero if a handler is set and not held back
+ *    SIDE EFFECTS: none
+ */
+int32_t signal_caught(int32_t signum){
+  signal_state* sig = &get_proc_pcb()->sig;
+
+  return sig->handlers[signum] != NULL && !(sig->masked & (1 << signum));
+}
+
+/*
+ * deliver_signals
+ *    DESCRIPTION: Called by the linkage just before it returns. On the way to
+ *                 user space, takes the lowest pending signal: ignores it,
+ *                 ends the process, or builds a frame on the user stack so
+ *                 the iret lands in the handler. The frame has the
+ *                 trampoline that calls sigreturn, the saved context, the
+ *                 signal number and a return address to the trampoline
+ *    INPUTS: hw_context* regs - what the linkage saved
+ *    OUTPUTS: none
+ *    RETURN VALUE: none
+ *    SIDE EFFECTS: Other signals wait for sigreturn
+ */
+void deliver_signals(hw_context* regs){
+  unsigned long flags; /* Saved interrupt flag */
+  signal_state* sig;
+  uint32_t ready;      /* Signals that can be delivered */
+  uint32_t esp;        /* New user stack pointer */
+  uint32_t tramp;      /* Where the trampoline goes */
+  int32_t signum;
+
+  /* Only on the way back to user space */
+  if((regs->cs & 3) != 3){
+    return;
+  }
+
+  cli_and_save(flags);
+  sig = &get_proc_pcb()->sig;
+  while((ready = sig->pending & ~sig->masked) != 0){
+    asm volatile ("bsfl %1, %0" : "=r"(signum) : "r"(ready));
+    sig->pending &= ~(1 << signum);
+
+    if(sig->handlers[signum] != NULL){
+      break;
+    }
+    if(KILL_SIGNALS & (1 << signum)){
+      end_process(EXCEPTION_STATUS);
+    }
+  }
+  if(ready == 0){
+    restore_flags(flags);
+    return;
+  }
+
+  /* Lay out the frame, the whole of it must be in the program page */
+  tramp = (regs->esp - TRAMPOLINE_SIZE) & ~(TRAMPOLINE_SIZE - 1);
+  esp = tramp - sizeof(hw_context) - 2 * sizeof(uint32_t);
+  if(regs->esp > USER_PROG + FOUR_MB || esp < USER_PROG || esp > tramp){
+    end_process(EXCEPTION_STATUS);
+  }
+  memcpy((void*)tramp, trampoline, TRAMPOLINE_SIZE);
+  memcpy((void*)(esp + 2 * sizeof(uint32_t)), regs, sizeof(hw_context));
+  ((uint32_t*)esp)[1] = signum;
+  ((uint32_t*)esp)[0] = tramp;
+
+  /* Hold everything back until the handler returns */
+  sig->masked = ALL_SIGNALS;
+  regs->esp = esp;
+  regs->eip = (uint32_t)sig->handlers[signum];
+  restore_flags(flags);
+}
+
+/*
+ * signal_tick
+ *    DESCRIPTION: Raises ALARM in the running process every ALARM_SECONDS,
+ *                 if it has a handler for it
+ *    INPUTS: none
+ *    OUTPUTS: none
+ *    RETURN VALUE: none
+ *    SIDE EFFECTS: Called from the PIT handler with interrupts masked
+ */
+void signal_tick(void){
+  signal_state* sig;
+
+  if(cur_pid == 0){
+    return;
+  }
+  sig = &get_pcb(get_pcb(cur_pid)->tgid)->sig;
+
+  /* Signed, so the counter wrapping doesn't matter */
+  if((int32_t)(pit_ticks - sig->alarm_tick) >= 0){
+    sig->alarm_tick += ALARM_SECONDS * PIT_HZ;
+    if(sig->handlers[ALARM] != NULL){
+      sig->pending |= 1 << ALARM;
+    }
+  }
+}
+
+/*
+ * set_handler
+ *    DESCRIPTION: System call to set the user function a signal runs. It
+ *                 gets the signal number and must return to let sigreturn
+ *                 resume the program
+ *    INPUTS: int32_t signum - the signal
+ *            void* handler_address - the handler, NULL for the default
+ *    OUTPUTS: none
+ *    RETURN VALUE: 0 for success, -1 for failure
+ *    SIDE EFFECTS: none
+ */
+int32_t set_handler(int32_t signum, void* handler_address){
+  /* Check for a valid signal and a handler in the program page */
+  if(signum < 0 || signum >= NUM_SIGNALS || (handler_address != NULL &&
+     ((uint8_t*)handler_address < (uint8_t*)USER_PROG || (uint8_t*)handler_address >= (uint8_t*)(USER_PROG + FOUR_MB)))){
+    /* Return failure */
+    return -1;
+  }
+
+  get_proc_pcb()->sig.handlers[signum] = handler_address;
+  return 0;
+}
+
+/*
+ * sigreturn
+ *    DESCRIPTION: System call the trampoline makes when a handler returns.
+ *                 Copies the context saved on the user stack, which the
+ *                 handler may have changed, over the system call's own, so
+ *                 the linkage returns to where the signal interrupted
+ *    INPUTS: none
+ *    OUTPUTS: none
+ *    RETURN VALUE: the interrupted eax, for the linkage to put back, or -1
+ *                  for failure
+ *    SIDE EFFECTS: Lets other signals through again
+ */
+int32_t sigreturn(void){
+  /* A system call from user space saves its context at the top of the kernel stack */
+  hw_context* regs = (hw_context*)tss.esp0 - 1;
+  hw_context* saved = (hw_context*)(regs->esp + sizeof(uint32_t));
+  uint32_t cs = regs->cs, ss = regs->ss, ds = regs->ds, eflags = regs->eflags;
+
+  /* Check for a context in the program page */
+  if((uint8_t*)saved < (uint8_t*)USER_PROG || (uint8_t*)saved > (uint8_t*)(USER_PROG + FOUR_MB) - sizeof(hw_context)){
+    /* Return failure */
+    return -1;
+  }
+
+  /* The handler can change registers, but not its privilege */
+  memcpy(regs, saved, sizeof(hw_context));
+  regs->cs = cs;
+  regs->ss = ss;
+  regs->ds = ds;
+  regs->es = ds;
+  regs->fs = ds;
+  regs->eflags = (regs->eflags & USER_FLAGS) | (eflags & ~USER_FLAGS);
+
+  get_proc_pcb()->sig.masked = 0;
+  return regs->eax;
+}
@@ -0,0 +1,85 @@
+/* signal.h - Signals delivered to user handlers on the way back to user space */
+
+#ifndef _SIGNAL_H
+#define _SIGNAL_H
+
+#include "types.h"
+
+/* Signals, the same numbers as the user's enum signums */
+#define DIV_ZERO        0   /* Divide error, kills by default */
+#define SEGFAULT        1   /* Any other exception, kills by default */
+#define INTERRUPT       2   /* Ctrl+C on the process' terminal, kills by default */
+#define ALARM           3   /* Every ALARM_SECONDS, ignored by default */
+#define USER1           4   /* Ignored by default */
+#define NUM_SIGNALS     5
+
+/* Seconds between ALARM signals */
+#define ALARM_SECONDS   10
+
+/* Offsets into hw_context, for the linkage */
+#define HW_EAX          24
+
+#ifndef ASM
+
+/*
+ * What the linkage saves on the kernel stack, lowest address first. A
+ * handler finds a copy of it just above its signal number on the user stack.
+ */
+typedef struct hw_context {
+  uint32_t ebx;
+  uint32_t ecx;
+  uint32_t edx;
+  uint32_t esi;
+  uint32_t edi;
+  uint32_t ebp;
+  uint32_t eax;
+  uint32_t ds;
+  uint32_t es;
+  uint32_t fs;
+  uint32_t vector;          /* Exception or IRQ vector, 0x80 for a system call */
+  uint32_t error_code;      /* From the CPU, or 0 */
+  uint32_t eip;             /* Pushed by the CPU */
+  uint32_t cs;
+  uint32_t eflags;
+  uint32_t esp;             /* Only there when coming from user space */
+  uint32_t ss;
+} hw_context;
+
+/* Signal state of a process, kept in its main thread's pcb */
+typedef struct signal_state {
+  void* handlers[NUM_SIGNALS];     /* User handler of each signal, NULL for the default */
+  uint32_t pending;                /* Bit per signal raised and not yet delivered */
+  uint32_t masked;                 /* Signals held back while a handler runs */
+  uint32_t alarm_tick;             /* pit_ticks when the next ALARM is due */
+} signal_state;
+
+/* Starts a process with default handlers and nothing pending */
+void signal_init(signal_state* sig);
+
+/* Raises a signal in a process */
+void send_signal(int32_t pid, int32_t signum);
+
+/* Raises a signal in the foreground process of a terminal */
+void signal_foreground(int32_t terminal, int32_t signum);
+
+/* Nonzero if the current process has a signal that will interrupt a sleep */
+int32_t signal_pending(void);
+
+/* Nonzero if the current process has a handler ready for a signal */
+int32_t signal_caught(int32_t signum);
+
+/* Sets up the next pending signal as the linkage returns to user space */
+void deliver_signals(hw_context* regs);
+
+/* Raises ALARM in the running process when it's due, from the PIT handler */
+void signal_tick(void);
+
+/* Sets a signal's handler, NULL for the default */
+int32_t set_handler(int32_t signum, void* handler_address);
+
+/* Returns from a handler to where the signal interrupted */
+int32_t sigreturn(void);
+
+#endif /* ASM */
+
+#endif /* _SIGNAL_H */
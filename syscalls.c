@@ -5,27 +5,58 @@
 #include "kb.h"
 #include "linkage.h"
 #include "pit.h"
+#include "pipe.h"
+#include "trace.h"
+#include "ldisc.h"
+#include "klog.h"
+#include "serial.h"
 
 #define PROG_OFFSET     0x00048000
 #define RUNNING         0
 #define STOPPED         1
 #define MAX_PROG_SIZE   FOUR_MB - PROG_OFFSET
+/* Longest command execute takes, a file name and its arguments */
+#define CMD_LENGTH      (NAME_LENGTH + BUF_LENGTH)
 
 /* Function pointers for rtc */
-jump_table rtc_table = {rtc_write, rtc_read, rtc_open, rtc_close};
+jump_table rtc_table = {rtc_write, rtc_read, rtc_open, rtc_close, NULL, NULL, NULL, NULL, rtc_poll, rtc_watch};
 
 /* Function pointers for file */
-jump_table file_table = {file_write, file_read, file_open, file_close};
+jump_table file_table = {file_write, file_read, file_open, file_close, file_lseek, file_pread, file_pwrite};
 
 /* Function pointers for directory */
-jump_table dir_table = {dir_write, dir_read, dir_open, dir_close};
+jump_table dir_table = {dir_write, dir_read, dir_open, dir_close, NULL, NULL, NULL, dir_getdents};
 
 /* Function pointers for stdin */
-jump_table stdin_table = {invalid_write, terminal_read, terminal_open, terminal_close};
+jump_table stdin_table = {invalid_write, terminal_read, terminal_open, terminal_close, NULL, NULL, NULL, NULL, terminal_poll, terminal_watch, terminal_ioctl};
 
 /* Function pointers for stdout */
 jump_table stdout_table = {terminal_write, invalid_read, terminal_open, terminal_close};
 
+/* Function pointers for the read end of a pipe */
+jump_table pipe_read_table = {invalid_write, pipe_read, pipe_open, pipe_read_close, NULL, NULL, NULL, NULL, pipe_read_poll, pipe_read_watch};
+
+/* Function pointers for the write end of a pipe */
+jump_table pipe_write_table = {pipe_write, invalid_read, pipe_open, pipe_write_close, NULL, NULL, NULL, NULL, pipe_write_poll, pipe_write_watch};
+
+/* Function pointers for interest sets */
+jump_table epoll_table = {invalid_write, invalid_read, epoll_open, epoll_close, NULL, NULL, NULL, NULL, epoll_poll};
+
+/* Function pointers for the kernel log */
+jump_table klog_table = {invalid_write, klog_read, klog_open, klog_close, NULL, NULL, NULL, NULL, NULL, NULL, klog_ioctl};
+
+/* Function pointers for the serial port */
+jump_table serial_table = {serial_write, serial_read, serial_open, serial_close, NULL, NULL, NULL, NULL, serial_poll, serial_watch};
+
+/* Devices opened by name that have no file in the file system */
+static struct {
+  int8_t* name;
+  jump_table* table;
+} devices[] = {
+  {"dmesg", &klog_table},
+  {"serial", &serial_table},
+};
+
 /* Process number: 1st process has pid 1, 0 means no processes have been launched */
 int32_t process_num = 0;
 
@@ -39,10 +70,107 @@ int32_t process_num = 0;
  *    SIDE EFFECTS: halt current process, return to parent process(shell)
  */
 int32_t halt(uint8_t status){
-  /* If shell tries to halt, just launch shell again */
-  pcb_t* cur_pcb = get_pcb_add();   /* Get the current process pcb */
+  return end_process(status);
+}
+
+/*
+ * end_thread
+ *    DESCRIPTION: Frees a thread's slot and user stack, keeping its status
+ *                 for thread_join
+ *    INPUTS: pcb_t* pcb - the thread, not a main thread
+ *            int32_t status - its exit status
+ *    OUTPUTS: none
+ *    RETURN VALUE: none
+ *    SIDE EFFECTS: Wakes threads in thread_join, called with interrupts masked
+ */
+static void end_thread(pcb_t* pcb, int32_t status){
+  pcb_t* proc_pcb = get_pcb(pcb->tgid);
+
+  proc_pcb->thread_stacks &= ~(1 << pcb->stack_slot);
+  proc_pcb->exit_status[pcb->pid - 1] = status;
+  proc_pcb->exited |= 1 << (pcb->pid - 1);
+  process_num--;
+  process_array[pcb->pid - 1] = -1;
+  wake_up(&proc_pcb->join_wait);
+}
+
+/*
+ * end_threads
+ *    DESCRIPTION: Ends every thread of a process except the main thread and
+ *                 the running one, wherever they are. Programs it started
+ *                 are left running with no parent
+ *    INPUTS: pcb_t* proc_pcb - the process' main thread
+ *    OUTPUTS: none
+ *    RETURN VALUE: none
+ *    SIDE EFFECTS: called with interrupts masked, the ended threads' kernel
+ *                  stacks are abandoned
+ */
+static void end_threads(pcb_t* proc_pcb){
+  int32_t pid;
+  pcb_t* pcb;
+
+  for(pid = 1; pid <= MAX_PROGS; pid++){
+    if(process_array[pid - 1] == -1){
+      continue;
+    }
+    pcb = get_pcb(pid);
+    if(pcb->tgid == proc_pcb->pid){
+      if(pid != proc_pcb->pid && pid != cur_pid){
+        end_thread(pcb, EXCEPTION_STATUS);
+      }
+    } else if(pcb->parent_pid != 0 && get_pcb(pcb->parent_pid)->tgid == proc_pcb->pid){
+      /* Its halt has nothing to return to or report to */
+      pcb->background = 1;
+      pcb->parent_pid = 0;
+    }
+  }
+}
+
+/*
+ * end_process
+ *    DESCRIPTION: Stops the current process, for halt and for exceptions. Any
+ *                 thread can end the process, the others end with it
+ *    INPUTS: int32_t status - value the parent's execute returns
+ *    OUTPUTS: none
+ *    RETURN VALUE: Returns to parent execute, or runs another process if no
+ *                  parent is waiting
+ *    SIDE EFFECTS: closes fds and frees the process slot, shells start over
+ */
+int32_t end_process(int32_t status){
+  pcb_t* cur_pcb = get_pcb_add();   /* Get the current thread's pcb */
+  pcb_t* proc_pcb = get_pcb(cur_pcb->tgid); /* And the process' */
+
+  cli();
+
+  TRACE(TRACE_HALT, status);
 
-  if(cur_pcb->pid == 1 || cur_pcb->pid == 2 || cur_pcb->pid == 3){
+  end_threads(proc_pcb);
+
+  /* The terminal can move its screen again */
+  if(proc_pcb->vidmem){
+    screen_map(proc_pcb->terminal, 0);
+  }
+
+  /* If shell tries to halt, just launch shell again */
+  if(proc_pcb->pid == 1 || proc_pcb->pid == 2 || proc_pcb->pid == 3){
+    /* end_threads let go of its children */
+    proc_pcb->children = 0;
+    proc_pcb->zombies = 0;
+    signal_init(&proc_pcb->sig);
+
+    /* The new shell starts with only stdin and stdout, so a pipe it held
+     * open doesn't keep its reader from seeing the end */
+    free_fds();
+    shm_exit();
+    /* free_fds just gave back the page init_fds takes */
+    init_fds(proc_pcb);
+    ldisc_mode(proc_pcb->terminal, LDISC_COOKED);
+    if(cur_pcb != proc_pcb){
+      /* The main thread starts the shell over, this thread just ends */
+      sched_new(proc_pcb->pid, program_addr_test, USER_ESP);
+      end_thread(cur_pcb, status);
+      sched_exit();
+    }
     asm volatile("       \n\
       movl %0, %%ecx     \n\
       jmp context_switch"
@@ -52,29 +180,41 @@ int32_t halt(uint8_t status){
     );
   }
 
-  int i; /* Loop variable */
-
   /* Close all files in the pcb */
-  for(i = 0; i <= MAX_FD_NUM; i++){
-    close(i);
+  free_fds();
+
+  /* Drop shared memory, the last process attached frees a segment */
+  shm_exit();
+
+  /* Free the halting thread's slot as well as the main thread's */
+  if(cur_pcb != proc_pcb){
+    process_num--;
+    process_array[cur_pcb->pid - 1] = -1;
   }
+  cur_pcb = proc_pcb;
 
   process_num--; /* Decrement process number */
   process_array[cur_pcb->pid - 1] = -1; /* Mark process slot as free */
+
+  /* Earlier pipeline stages have nobody to return to, spawned ones leave their status for wait */
+  if(cur_pcb->background){
+    if(cur_pcb->parent_pid != 0 && (get_pcb(cur_pcb->parent_pid)->children & (1 << (cur_pcb->pid - 1)))){
+      get_pcb(cur_pcb->parent_pid)->child_status[cur_pcb->pid - 1] = status;
+      get_pcb(cur_pcb->parent_pid)->zombies |= 1 << (cur_pcb->pid - 1);
+      wake_up(&get_pcb(cur_pcb->parent_pid)->child_wait);
+    }
+    sched_exit();
+  }
+
   tss.esp0 = cur_pcb->parent_esp;   /* Set TSS esp0 back to parent stack pointer */
 
-  sched_arr[cur_sched_term].process_num = cur_pcb->parent_pid;
-  sched_arr[cur_sched_term].esp = cur_pcb->parent_esp;
-  sched_arr[cur_sched_term].ebp = cur_pcb->parent_ebp;
+  /* Parent runs again, on this terminal */
+  get_pcb(cur_pcb->parent_pid)->state = PROC_RUNNABLE;
+  cur_pid = cur_pcb->parent_pid;
 
   /* Remap user program paging back to parent program */
-  set_page_dir_entry(USER_PROG, EIGHT_MB + (cur_pcb->parent_pid - 1)*FOUR_MB);
-
-  /* Check if program was using video memory */
-  if(cur_pcb->vidmem){
-    //disable_page_entry(USER_VIDEO_MEM);
-    sched_arr[cur_sched_term].vid_map = 0;
-  }
+  set_page_dir_entry(USER_PROG, EIGHT_MB + (get_pcb(cur_pcb->parent_pid)->tgid - 1)*FOUR_MB);
+  set_shm_table(get_pcb(get_pcb(cur_pcb->parent_pid)->tgid)->shm.table);
 
   /* Flush tlb */
   asm volatile ("      \n\
@@ -87,17 +227,17 @@ int32_t halt(uint8_t status){
 
   /*
   inline assembly:
-    1st line: zero extend bl and move value into eax so that the correct status is returned from halt
+    1st line: move status into eax so that the correct status is returned from execute
     2nd line: set ebp to parent process ebp
     3rd andd 4th line: jump back to parent's system call linkage
   */
   asm volatile ("       \n\
-     movzbl %%bl, %%eax \n\
+     movl %1, %%eax     \n\
      movl %0, %%ebp     \n\
      leave              \n\
      ret"
      :
-     : "r" (cur_pcb->parent_ebp)
+     : "r" (cur_pcb->parent_ebp), "r" (status)
      : "ebp", "eax"
   );
 
@@ -170,40 +310,54 @@ int32_t launch(){
   }
 
   pcb.parent_pid = 0;
-  /* Load stdin and stdout jump table and mark as in use */
-  pcb.fdt[0].jump_ptr = &stdin_table;
-  pcb.fdt[1].jump_ptr = &stdout_table;
-  pcb.fdt[0].flags = 1;
-  pcb.fdt[1].flags = 1;
   pcb.vidmem = 0;
+  pcb.background = 0;
+  memset(&pcb.shm, 0, sizeof(shm_space));
+  pcb.stack_slot = 0;
+  pcb.thread_stacks = 1;
+  pcb.exited = 0;
+  pcb.join_wait = 0;
+  pcb.children = 0;
+  pcb.zombies = 0;
+  pcb.child_wait = 0;
+  signal_init(&pcb.sig);
   /* Set arguments to an empty string */
   strncpy((int8_t*)pcb.args, (int8_t*)"", BUF_LENGTH);
-  /* Mark remaining file descriptors as not in use */
-  for(i = 2; i <= MAX_FD_NUM; i++){
-    pcb.fdt[i].flags = -1;
-  }
 
   /* Set count of process numbers to number of terminals */
   process_num = SHELL_NUM;
 
-  /* Place pcb in kernel memory */
+  /* Get address of first instruction */
+  uint32_t program_addr = *(uint32_t*)(ELF_buf + 24);
+
+  /* Save instruction address */
+  program_addr_test = program_addr;
+
+  /* Place pcb in kernel memory, each shell gets its own stdin and stdout */
   for(i = 0; i < SHELL_NUM; i++){
     pcb.pid = i + 1;
+    pcb.tgid = pcb.pid;
+    pcb.terminal = i;
+    pcb.state = PROC_RUNNABLE;
+    if(init_fds(&pcb) == -1){
+      /* Return failure */
+      return -1;
+    }
     memcpy((void *)(EIGHT_MB - pcb.pid*EIGHT_KB), &pcb, sizeof(pcb));
+
+    /* The first shell runs now, the others on their first switch */
+    if(i != 0){
+      sched_new(pcb.pid, program_addr, USER_ESP);
+    }
   }
 
   /* Set TSS to point to kernel stack */
   tss.esp0 = EIGHT_MB;
   tss.ss0 = KERNEL_DS;
 
-  /* Get address of first instruction */
-  uint32_t program_addr = *(uint32_t*)(ELF_buf + 24);
-
-  /* Save instruction address */
-  program_addr_test = program_addr;
-
-  /* Allow pit interrupts */
-  prev_sched_term = 0;
+  /* Allow pit interrupts to switch processes */
+  cur_pid = 1;
+  cur_sched_term = 0;
 
   /* Put program_addr into ecx and jump to the context switch */
   asm volatile("       \n\
@@ -218,38 +372,26 @@ int32_t launch(){
 }
 
 /*
- * execute
- *    DESCRIPTION: Loads executable into memory and returns to user program
- *    INPUTS: const uint8_t* command - command to execute
+ * load_program
+ *    DESCRIPTION: Sets up a process for one command: takes a process slot,
+ *                 copies the executable to the slot's user page and opens
+ *                 stdin and stdout
+ *    INPUTS: const uint8_t* command - program name followed by its arguments
+ *            pcb_t* pcb - pcb to fill in, the caller places it in memory
  *    OUTPUTS: none
- *    RETURN VALUE: -1 for failure, 0 to 255 for success, 256 for an exception
- *    SIDE EFFECTS: Copies executable program and pcb into memory
+ *    RETURN VALUE: address of the program's first instruction, 0 for failure
+ *    SIDE EFFECTS: Maps the new process' user page at 128MB
  */
-int32_t execute(const uint8_t* command){
-  /* Limit number of programs */
-  if(process_num >= MAX_PROGS){
-    /* Return failure */
-    return -1;
-  }
-
-  /* Check for a user level command */
-  /*
-  if(process_num > 0 && (command < (const uint8_t*)(USER_PROG) || command >= (const uint8_t*)(USER_PROG + FOUR_MB))){*/
-    /* Return failure */ /*
-    return -1;
-  } */
+static uint32_t load_program(const uint8_t* command, pcb_t* pcb){
 	uint8_t filename[NAME_LENGTH + 1]; /* Name of the file, with null terminate */
   int32_t i = 0; /* Loop variable */
 
-  if(process_num == 0){
-    for(i = 0; i < MAX_PROGS; i++) process_array[i] = -1;
+  /* Limit number of programs */
+  if(process_num >= MAX_PROGS){
+    /* Return failure */
+    return 0;
   }
 
-  i = 0;
-
-  /* Mask interrupts */
-  cli();
-
   /* Get the file name */
   while(command[i] != '\0' && command[i] != ' ' && i < NAME_LENGTH){
     filename[i] = command[i];
@@ -262,8 +404,7 @@ int32_t execute(const uint8_t* command){
   /* Check for a valid file name */
   if(read_dentry_by_name(filename, &file_dentry) == -1){
     /* Return failure */
-    sti();
-    return -1;
+    return 0;
   }
 
   /* Read the executable */
@@ -271,20 +412,15 @@ int32_t execute(const uint8_t* command){
   uint32_t size; /* Size of executable file */
   if((size = read_data(file_dentry.inode_num, 0, ELF_buf, NAME_LENGTH)) == -1){
     /* Return failure */
-    sti();
-    return -1;
+    return 0;
   }
 
   /* Check if file is an executable */
   if(ELF_buf[0] != 0x7F || ELF_buf[1] != 0x45 || ELF_buf[2] != 0x4C || ELF_buf[3] != 0x46){
     /* Return failure */
-    sti();
-    return -1;
+    return 0;
   }
 
-  uint8_t args[BUF_LENGTH];
-  args[0] = '\0'; /* Default args is empty string */
-
   /* Get argument */
   const uint8_t* command_args = &(command[i]); //start of args
   i = 0;
@@ -298,29 +434,35 @@ int32_t execute(const uint8_t* command){
 
   /* Copy characters over */
   while(j < BUF_LENGTH && command_args[j] != '\0'){
-    args[j] = command_args[j];
+    pcb->args[j] = command_args[j];
     j++;
   }
 
   /* Null terminate the arguments */
   if(j < BUF_LENGTH){
-    args[j] = '\0';
+    pcb->args[j] = '\0';
   }
-  args[BUF_LENGTH-1] = '\0';
+  pcb->args[BUF_LENGTH-1] = '\0';
 
-  /* Create pcb */
-  pcb_t pcb;
   /* Find a free process slot */
   for(i = 0; i < MAX_PROGS; i++){
     if(process_array[i] == -1){
-      pcb.pid = i + 1;
+      pcb->pid = i + 1;
       process_array[i] = 1; /* Mark process slot as in use */
       break;
     }
   }
 
-  /* Set up user page */
-  set_page_dir_entry(USER_PROG, EIGHT_MB + (pcb.pid - 1)*FOUR_MB);
+  /* Set up stdin and stdout */
+  if(init_fds(pcb) == -1){
+    process_array[pcb->pid - 1] = -1;
+    /* Return failure */
+    return 0;
+  }
+
+  /* Set up user page, with nothing in the shared memory window */
+  set_page_dir_entry(USER_PROG, EIGHT_MB + (pcb->pid - 1)*FOUR_MB);
+  set_shm_table(NULL);
 
   /* Flush tlb */
   asm volatile ("      \n\
@@ -333,39 +475,240 @@ int32_t execute(const uint8_t* command){
 
   /* Copy executable to 128MB */
   if((size = read_data(file_dentry.inode_num, 0, (uint8_t*)(USER_PROG + PROG_OFFSET), MAX_PROG_SIZE)) == -1){
+    free_page(pcb->fds.pages[0]);
+    process_array[pcb->pid - 1] = -1;
     /* Return failure */
-    return -1;
+    return 0;
   }
 
-  pcb.parent_pid = sched_arr[cur_sched_term].process_num;
-  /* Load stdin and stdout jump table and mark as in use */
-  pcb.fdt[0].jump_ptr = &stdin_table;
-  pcb.fdt[1].jump_ptr = &stdout_table;
-  pcb.fdt[0].flags = 1;
-  pcb.fdt[1].flags = 1;
-  pcb.vidmem = 0;
-  /* Copy arguments to the pcb */
-  strncpy((int8_t*)pcb.args, (const int8_t*)args, BUF_LENGTH);
-  /* Mark remaining file descriptors as not in use */
-  for(i = 2; i <= MAX_FD_NUM; i++){
-    pcb.fdt[i].flags = -1;
-  }
+  /* Same terminal as the process running execute */
+  pcb->parent_pid = cur_pid;
+  pcb->terminal = cur_sched_term;
+  pcb->vidmem = 0;
+  pcb->background = 0;
+  memset(&pcb->shm, 0, sizeof(shm_space));
+
+  /* One thread, on the stack at the top of the page */
+  pcb->tgid = pcb->pid;
+  pcb->stack_slot = 0;
+  pcb->thread_stacks = 1;
+  pcb->exited = 0;
+  pcb->join_wait = 0;
+
+  /* No children yet */
+  pcb->children = 0;
+  pcb->zombies = 0;
+  pcb->child_wait = 0;
+  signal_init(&pcb->sig);
 
   /* Increment process count */
   process_num++;
 
+  TRACE(TRACE_EXECUTE, pcb->pid);
+
+  /* Return address of first instruction */
+  return *(uint32_t*)(ELF_buf + 24);
+}
+
+/*
+ * drop_process
+ *    DESCRIPTION: Throws away a pipeline stage that never ran
+ *    INPUTS: int32_t pid - the stage's process
+ *    OUTPUTS: none
+ *    RETURN VALUE: none
+ *    SIDE EFFECTS: Releases its pipe ends, descriptor table and process slot
+ */
+static void drop_process(int32_t pid){
+  pcb_t* pcb = get_pcb(pid);
+  file_desc* page = pcb->fds.pages[0]; /* Only stdin and stdout are open */
+  int32_t fd;
+
+  for(fd = 0; fd < 2; fd++){
+    if(page[fd].jump_ptr == &pipe_read_table){
+      pipe_release((pipe_t*)page[fd].inode, 0);
+    } else if(page[fd].jump_ptr == &pipe_write_table){
+      pipe_release((pipe_t*)page[fd].inode, 1);
+    }
+  }
+  free_page(page);
+
+  process_num--;
+  process_array[pid - 1] = -1;
+}
+
+/*
+ * remap_caller
+ *    DESCRIPTION: Maps the running process' program page and shared memory
+ *                 back after load_program mapped a new program's
+ *    INPUTS: none
+ *    OUTPUTS: none
+ *    RETURN VALUE: none
+ *    SIDE EFFECTS: Flushes the TLB
+ */
+static void remap_caller(void){
+  /* Nothing to map back before the shells are launched */
+  if(cur_pid == 0){
+    return;
+  }
+
+  set_page_dir_entry(USER_PROG, EIGHT_MB + (get_pcb(cur_pid)->tgid - 1)*FOUR_MB);
+  set_shm_table(get_proc_pcb()->shm.table);
+  asm volatile ("      \n\
+     movl %%cr3, %%eax \n\
+     movl %%eax, %%cr3"
+     :
+     :
+     : "eax"
+  );
+}
+
+/*
+ * run_command
+ *    DESCRIPTION: Loads executable into memory and returns to user program.
+ *                 Commands split by '|' run together, each stage's stdout
+ *                 going through a pipe to the next one's stdin, and the
+ *                 caller waits for the last stage unless it was spawned
+ *    INPUTS: const uint8_t* command - command to execute
+ *            int32_t spawn_child - 1 to return the last stage's pid right
+ *                                  away, for wait to collect
+ *    OUTPUTS: none
+ *    RETURN VALUE: -1 for failure, otherwise the pid for spawn_child, or 0 to
+ *                  255 for success and 256 for an exception
+ *    SIDE EFFECTS: Copies executable program and pcb into memory
+ */
+static int32_t run_command(const uint8_t* command, int32_t spawn_child){
+  uint8_t line[CMD_LENGTH];        /* Copy of the command, split into stages */
+  uint8_t* stages[MAX_PROGS];      /* Start of each stage's command */
+  int32_t pids[MAX_PROGS];         /* Stages placed so far */
+  int32_t num_stages = 1;
+  pipe_t* in_pipe = NULL;          /* Pipe to the stage's stdin */
+  pipe_t* out_pipe;                /* Pipe from the stage's stdout */
+  uint32_t program_addr = 0;       /* First instruction of the stage */
+  int32_t i, j;                    /* Loop variables */
+
+  if(command == NULL){
+    /* Return failure */
+    return -1;
+  }
+
+  if(process_num == 0){
+    for(i = 0; i < MAX_PROGS; i++) process_array[i] = -1;
+  }
+
+  /* Split the command into stages, trimming the spaces around each one */
+  for(i = 0; i < CMD_LENGTH - 1 && command[i] != '\0'; i++){
+    line[i] = command[i];
+  }
+  line[i] = '\0';
+  stages[0] = line;
+  for(i = 0; line[i] != '\0'; i++){
+    if(line[i] == '|'){
+      if(num_stages == MAX_PROGS){
+        /* Return failure */
+        return -1;
+      }
+      line[i] = '\0';
+      stages[num_stages++] = &line[i + 1];
+    }
+  }
+  for(i = 0; i < num_stages; i++){
+    while(*stages[i] == ' '){
+      stages[i]++;
+    }
+    for(j = strlen((int8_t*)stages[i]); j > 0 && stages[i][j - 1] == ' '; j--){
+      stages[i][j - 1] = '\0';
+    }
+    if(*stages[i] == '\0'){
+      /* Return failure */
+      return -1;
+    }
+  }
+
+  /* Mask interrupts */
+  cli();
+
+  /* Create pcb */
+  pcb_t pcb;
+
+  /* Every stage but the last runs on its own */
+  for(i = 0; i < num_stages; i++){
+    out_pipe = NULL;
+    if(i < num_stages - 1 && (out_pipe = pipe_create()) == NULL){
+      break;
+    }
+    if((program_addr = load_program(stages[i], &pcb)) == 0){
+      if(out_pipe != NULL){
+        pipe_release(out_pipe, 0);
+        pipe_release(out_pipe, 1);
+      }
+      break;
+    }
+
+    /* The pid may belong to a child that was never waited for, its status is lost */
+    get_proc_pcb()->children &= ~(1 << (pcb.pid - 1));
+    get_proc_pcb()->zombies &= ~(1 << (pcb.pid - 1));
+
+    /* The stage owns the pipe ends from here */
+    if(in_pipe != NULL){
+      pcb.fds.pages[0][0].jump_ptr = &pipe_read_table;
+      pcb.fds.pages[0][0].inode = (int32_t)in_pipe;
+    }
+    if(out_pipe != NULL){
+      pcb.fds.pages[0][1].jump_ptr = &pipe_write_table;
+      pcb.fds.pages[0][1].inode = (int32_t)out_pipe;
+    }
+    in_pipe = out_pipe;
+
+    if(i < num_stages - 1 || spawn_child){
+      pcb.background = 1;
+      if(i == num_stages - 1){
+        /* wait is answered by the process, whichever thread spawned */
+        pcb.parent_pid = get_proc_pcb()->pid;
+      }
+      memcpy((void *)(EIGHT_MB - pcb.pid*EIGHT_KB), &pcb, sizeof(pcb));
+      sched_new(pcb.pid, program_addr, USER_ESP);
+      pids[i] = pcb.pid;
+    }
+  }
+
+  /* A stage failed, nothing runs */
+  if(i < num_stages){
+    if(i > 0){
+      pipe_release(in_pipe, 0);
+    }
+    for(j = 0; j < i; j++){
+      drop_process(pids[j]);
+    }
+
+    /* Remap user program paging back to this program */
+    remap_caller();
+    sti();
+    /* Return failure */
+    return -1;
+  }
+
+  /* A spawned process runs on its own, the caller carries on */
+  if(spawn_child){
+    get_proc_pcb()->children |= 1 << (pcb.pid - 1);
+    remap_caller();
+    sti();
+    return pcb.pid;
+  }
+
   /* Set parent esp and ebp for child processes */
   pcb.parent_esp = EIGHT_MB - (pcb.parent_pid - 1)*EIGHT_KB;
-  //pcb.parent_ebp = sched_arr[cur_sched_term].ebp;
 
   asm volatile("     \n\
      movl %%ebp, %0"
      : "=r"(pcb.parent_ebp)
   );
 
-  /* Store terminal's current running process */
-  // terminals[cur_terminal].cur_pid = pcb.pid;
-  sched_arr[cur_sched_term].process_num = pcb.pid;
+  /* Parent waits here until the last stage halts */
+  if(cur_pid != 0){
+    get_pcb(cur_pid)->state = PROC_WAITING;
+  }
+  pcb.state = PROC_RUNNABLE;
+  cur_pid = pcb.pid;
 
   /* Place pcb in kernel memory */
   memcpy((void *)(EIGHT_MB - pcb.pid*EIGHT_KB), &pcb, sizeof(pcb));
@@ -374,9 +717,6 @@ int32_t execute(const uint8_t* command){
   tss.esp0 = EIGHT_MB - (pcb.pid - 1)*EIGHT_KB;
   tss.ss0 = KERNEL_DS;
 
-  /* Get address of first instruction */
-  uint32_t program_addr = *(uint32_t*)(ELF_buf + 24);
-
   /* Put program_addr into ecx and jump to the context switch */
   asm volatile("       \n\
     movl %0, %%ecx     \n\
@@ -390,6 +730,87 @@ int32_t execute(const uint8_t* command){
   return 69;
 }
 
+/*
+ * execute
+ *    DESCRIPTION: Runs a command, or a pipeline of them split by '|', and
+ *                 waits for its last stage to halt
+ *    INPUTS: const uint8_t* command - command to execute
+ *    OUTPUTS: none
+ *    RETURN VALUE: -1 for failure, 0 to 255 for success, 256 for an exception
+ *    SIDE EFFECTS: end_process returns here through run_command's frame
+ */
+int32_t execute(const uint8_t* command){
+  return run_command(command, 0);
+}
+
+/*
+ * spawn
+ *    DESCRIPTION: Runs a command, or a pipeline of them, in the background
+ *                 and returns right away
+ *    INPUTS: const uint8_t* command - command to execute
+ *    OUTPUTS: none
+ *    RETURN VALUE: pid of the last stage, for wait, or -1 for failure
+ *    SIDE EFFECTS: The new processes run on later schedules
+ */
+int32_t spawn(const uint8_t* command){
+  return run_command(command, 1);
+}
+
+/*
+ * wait
+ *    DESCRIPTION: Collects the exit status of a process the current process
+ *                 spawned, waiting for it to halt
+ *    INPUTS: int32_t pid - the process, or -1 for any of them
+ *            int32_t* status - where to put its status, or NULL
+ *            int32_t flags - WAIT_NOHANG to return 0 if none has ended
+ *    OUTPUTS: the status, 0 to 255 or 256 for an exception
+ *    RETURN VALUE: pid of the process, 0 for WAIT_NOHANG, or -1 if there
+ *                  is no such process to wait for
+ *    SIDE EFFECTS: Blocks until the process halts
+ */
+int32_t wait(int32_t pid, int32_t* status, int32_t flags){
+  pcb_t* proc_pcb = get_proc_pcb();
+  unsigned long intr_flags; /* Saved interrupt flag */
+  uint32_t mask, bit;       /* Processes asked for, and one that ended */
+
+  /* Check for a valid user pointer */
+  if(status != NULL && ((uint8_t*)status < (uint8_t*)USER_PROG || (uint8_t*)status > (uint8_t*)(USER_PROG + FOUR_MB) - sizeof(int32_t))){
+    /* Return failure */
+    return -1;
+  }
+  if(pid == -1){
+    mask = 0xFFFFFFFF;
+  } else if(pid >= 1 && pid <= MAX_PROGS){
+    mask = 1 << (pid - 1);
+  } else{
+    /* Return failure */
+    return -1;
+  }
+
+  cli_and_save(intr_flags);
+  while(!(proc_pcb->zombies & mask)){
+    if(!(proc_pcb->children & mask) || (flags & WAIT_NOHANG)){
+      restore_flags(intr_flags);
+      return (proc_pcb->children & mask) ? 0 : -1;
+    }
+    if(sleep_on(&proc_pcb->child_wait) == -1){
+      restore_flags(intr_flags);
+      /* Return failure, a signal is waiting */
+      return -1;
+    }
+  }
+
+  asm volatile ("bsfl %1, %0" : "=r"(bit) : "r"(proc_pcb->zombies & mask));
+  proc_pcb->zombies &= ~(1 << bit);
+  proc_pcb->children &= ~(1 << bit);
+  if(status != NULL){
+    *status = proc_pcb->child_status[bit];
+  }
+  restore_flags(intr_flags);
+
+  return bit + 1;
+}
+
 /*
  * read
  *    DESCRIPTION: Reads at a given file descriptor
@@ -403,18 +824,11 @@ int32_t execute(const uint8_t* command){
 int32_t read(int32_t fd, void* buf, int32_t nbytes){
   cli(); /* Mask interrupts */
 
-  /* Check for a valid fd */
-	if(fd < 0 || fd > MAX_FD_NUM){
-		sti();
-    /* Return failure */
-		return -1;
-	}
-
-  /* Pointer to current pcb */
-	file_desc curr_file = get_pcb_add()->fdt[fd];
+  /* Get the descriptor, if it's open */
+	file_desc* curr_file = get_fd(fd);
 
   /* Check if file descriptor is in use */
-	if(curr_file.flags == -1){
+	if(curr_file == NULL){
 		sti();
     /* Return failure */
 		return -1;
@@ -423,7 +837,7 @@ int32_t read(int32_t fd, void* buf, int32_t nbytes){
   sti(); /* Restore interrupts */
 
   /* Jump to read */
-	return curr_file.jump_ptr->read(fd, buf, nbytes);
+	return curr_file->jump_ptr->read(fd, buf, nbytes);
 }
 
 /*
@@ -439,27 +853,145 @@ int32_t read(int32_t fd, void* buf, int32_t nbytes){
 int32_t write(int32_t fd, const void* buf, int32_t nbytes){
   cli(); /* Mask interrupts */
 
-  /* Check for a valid fd */
-	if(fd < 0 || fd > MAX_FD_NUM){
+  /* Get the descriptor, if it's open */
+	file_desc* curr_file = get_fd(fd);
+
+  /* Check if descriptor is in use */
+	if(curr_file == NULL){
 		sti();
     /* Return failure */
 		return -1;
 	}
 
-  /* Pointer to current pcb */
-	file_desc curr_file = get_pcb_add()->fdt[fd];
+  sti(); /* Restore interrupts */
 
-  /* Check if descriptor is in use */
-	if(curr_file.flags == -1){
-		sti();
+  /* Jump to write */
+	return curr_file->jump_ptr->write(fd, buf, nbytes);
+}
+
+/*
+ * lseek
+ *    DESCRIPTION: Moves the position of a file descriptor
+ *    INPUTS: int32_t fd - file descriptor to seek
+ *            int32_t offset - new position, relative to whence
+ *            int32_t whence - SEEK_SET, SEEK_CUR or SEEK_END
+ *    OUTPUTS: none
+ *    RETURN VALUE: the new position, or -1 for failure
+ *    SIDE EFFECTS: none
+ */
+int32_t lseek(int32_t fd, int32_t offset, int32_t whence){
+  /* Get the descriptor, if it's open */
+	file_desc* curr_file = get_fd(fd);
+
+  /* Check if descriptor is in use and can seek */
+	if(curr_file == NULL || curr_file->jump_ptr->lseek == NULL){
     /* Return failure */
 		return -1;
 	}
 
-  sti(); /* Restore interrupts */
+  /* Jump to lseek */
+	return curr_file->jump_ptr->lseek(fd, offset, whence);
+}
 
-  /* Jump to write */
-	return curr_file.jump_ptr->write(fd, buf, nbytes);
+/*
+ * pread
+ *    DESCRIPTION: Reads from a file descriptor at an offset, leaving its
+ *                 position alone
+ *    INPUTS: int32_t fd - file descriptor to read
+ *            void* buf - buffer to read to
+ *            int32_t nbytes - number of bytes to read
+ *            uint32_t offset - where in the file to start
+ *    OUTPUTS: none
+ *    RETURN VALUE: number of bytes read, or -1 for failure
+ *    SIDE EFFECTS: none
+ */
+int32_t pread(int32_t fd, void* buf, int32_t nbytes, uint32_t offset){
+  /* Get the descriptor, if it's open */
+	file_desc* curr_file = get_fd(fd);
+
+  /* Check if descriptor is in use and has positional reads */
+	if(curr_file == NULL || curr_file->jump_ptr->pread == NULL){
+    /* Return failure */
+		return -1;
+	}
+
+  /* Jump to pread */
+	return curr_file->jump_ptr->pread(fd, buf, nbytes, offset);
+}
+
+/*
+ * pwrite
+ *    DESCRIPTION: Writes to a file descriptor at an offset, leaving its
+ *                 position alone
+ *    INPUTS: int32_t fd - file descriptor to write to
+ *            const void* buf - buffer to write from
+ *            int32_t nbytes - number of bytes to write
+ *            uint32_t offset - where in the file to start
+ *    OUTPUTS: none
+ *    RETURN VALUE: number of bytes written, or -1 for failure
+ *    SIDE EFFECTS: none
+ */
+int32_t pwrite(int32_t fd, const void* buf, int32_t nbytes, uint32_t offset){
+  /* Get the descriptor, if it's open */
+	file_desc* curr_file = get_fd(fd);
+
+  /* Check if descriptor is in use and has positional writes */
+	if(curr_file == NULL || curr_file->jump_ptr->pwrite == NULL){
+    /* Return failure */
+		return -1;
+	}
+
+  /* Jump to pwrite */
+	return curr_file->jump_ptr->pwrite(fd, buf, nbytes, offset);
+}
+
+/*
+ * getdents
+ *    DESCRIPTION: Reads as many entries of a directory as fit in the buffer
+ *    INPUTS: int32_t fd - directory file descriptor
+ *            void* buf - buffer of dirent_t to read to
+ *            int32_t nbytes - size of the buffer
+ *    OUTPUTS: none
+ *    RETURN VALUE: number of bytes read, 0 at the end, or -1 for failure
+ *    SIDE EFFECTS: none
+ */
+int32_t getdents(int32_t fd, void* buf, int32_t nbytes){
+  /* Get the descriptor, if it's open */
+	file_desc* curr_file = get_fd(fd);
+
+  /* Check if descriptor is in use and is a directory */
+	if(curr_file == NULL || curr_file->jump_ptr->getdents == NULL){
+    /* Return failure */
+		return -1;
+	}
+
+  /* Jump to getdents */
+	return curr_file->jump_ptr->getdents(fd, buf, nbytes);
+}
+
+/*
+ * ioctl
+ *    DESCRIPTION: Gets or changes a setting of a device, such as a terminal's
+ *                 line discipline mode
+ *    INPUTS: int32_t fd - device file descriptor
+ *            int32_t request - what to do, defined by the device
+ *            int32_t arg - the request's argument
+ *    OUTPUTS: none
+ *    RETURN VALUE: depends on the request, -1 for failure
+ *    SIDE EFFECTS: none
+ */
+int32_t ioctl(int32_t fd, int32_t request, int32_t arg){
+  /* Get the descriptor, if it's open */
+	file_desc* curr_file = get_fd(fd);
+
+  /* Check if descriptor is in use and has settings */
+	if(curr_file == NULL || curr_file->jump_ptr->ioctl == NULL){
+    /* Return failure */
+		return -1;
+	}
+
+  /* Jump to ioctl */
+	return curr_file->jump_ptr->ioctl(fd, request, arg);
 }
 
 /*
@@ -491,6 +1023,24 @@ int32_t open(const uint8_t* filename){
 		return 1;
 	}
 
+  /* Open a device */
+  int32_t i;
+  for(i = 0; i < sizeof(devices) / sizeof(devices[0]); i++){
+    if(strlen((int8_t*)filename) == strlen(devices[i].name) &&
+       strncmp((int8_t*)filename, devices[i].name, strlen(devices[i].name)) == 0){
+      int32_t fd = alloc_fd();
+      if(fd == -1){
+        /* Return failure */
+        return -1;
+      }
+      get_fd(fd)->jump_ptr = devices[i].table;
+      get_fd(fd)->inode = 0;
+      devices[i].table->open(filename);
+      /* Return fd */
+      return fd;
+    }
+  }
+
 	dentry_t dentry;
 
   /* Get the dentry of the file */
@@ -499,45 +1049,37 @@ int32_t open(const uint8_t* filename){
 		return -1;
 	}
 
-  /* Pointer to the current pcb */
-  pcb_t* pcb_start = get_pcb_add();
-
-	int i; /* Loop variable */
-  /* Go through each file descriptor */
-	for(i = 2; i <= MAX_FD_NUM; i++){
-    /* Find file descriptor not in use */
-		if(pcb_start->fdt[i].flags == -1){
-      /* Load jump table and set inode number */
-			switch(dentry.file_type){
-        /* RTC */
-        case 0: pcb_start->fdt[i].jump_ptr = &rtc_table;
-                pcb_start->fdt[i].inode = 0;
-                rtc_open((uint8_t*)filename);
-                break;
-        /* Directory */
-        case 1: pcb_start->fdt[i].jump_ptr = &dir_table;
-                pcb_start->fdt[i].inode = 0;
-                dir_open((uint8_t*)filename);
-                break;
-        /* File */
-        case 2: pcb_start->fdt[i].jump_ptr = &file_table;
-                pcb_start->fdt[i].inode = dentry.inode_num;
-                file_open((uint8_t*)filename);
-                break;
-        /* Invalid file type */
-        default: return -1;
-      }
-      /* Mark file descriptor as in use and intialize file position */
-      pcb_start->fdt[i].flags = 1;
-      pcb_start->fdt[i].file_position = 0;
+  /* Jump table for the file type */
+  jump_table* table;
+	switch(dentry.file_type){
+    /* RTC */
+    case 0: table = &rtc_table;
+            break;
+    /* Directory */
+    case 1: table = &dir_table;
+            break;
+    /* File */
+    case 2: table = &file_table;
+            break;
+    /* Invalid file type */
+    default: return -1;
+  }
 
-      /* Return index */
-      return i;
-		}
-	}
+  /* Take the lowest free file descriptor */
+  int32_t fd = alloc_fd();
+  if(fd == -1){
+    /* Return failure */
+    return -1;
+  }
+  file_desc* new_file = get_fd(fd);
 
-  /* Return failure */
-	return -1;
+  /* Load jump table and set inode number, only files have one */
+  new_file->jump_ptr = table;
+  new_file->inode = dentry.file_type == FS_TYPE_FILE ? dentry.inode_num : 0;
+  table->open((uint8_t*)filename);
+
+  /* Return index */
+  return fd;
 }
 
 /*
@@ -549,26 +1091,26 @@ int32_t open(const uint8_t* filename){
  *    SIDE EFFECTS: none
  */
 int32_t close(int32_t fd){
-  /* Get a pointer to the pcb */
-  pcb_t* pcb_start = get_pcb_add();
+  /* Get a pointer to the pcb with the descriptors */
+  pcb_t* pcb_start = get_proc_pcb();
 
-  /* Check for an invalid fd */
-  if(fd < 2 || fd > MAX_FD_NUM){
+  /* Get the descriptor, if it's open */
+  file_desc* curr_file = get_fd(fd);
+
+  /* Check for an invalid fd, stdin and stdout can't be closed */
+  if(fd < 2 || curr_file == NULL){
     /* Return failure */
 		return -1;
 	}
 
-  /* Check if file desciptor is in use */
-	if(pcb_start->fdt[fd].flags == 1){
-    /* Jump to file's close and mark as not in use */
-    pcb_start->fdt[fd].jump_ptr->close(fd);
-    pcb_start->fdt[fd].flags = -1;
-    /* Return success */
-		return 0;
-	}
+  /* Stop watching it, then jump to file's close and mark as not in use */
+  epoll_forget(fd);
+  curr_file->jump_ptr->close(fd);
+  curr_file->flags = -1;
+  pcb_start->fds.in_use[fd / 32] &= ~(1 << (fd % 32));
 
-  /* Return failure */
-	return -1;
+  /* Return success */
+	return 0;
 }
 
 /*
@@ -581,8 +1123,8 @@ int32_t close(int32_t fd){
  *    SIDE EFFECTS: none
  */
 int32_t getargs(uint8_t* buf, int32_t nbytes){
-  /* Get pcb */
-  pcb_t* cur_pcb = get_pcb_add();
+  /* Get pcb, threads have their main thread's arguments */
+  pcb_t* cur_pcb = get_proc_pcb();
 
   /* Check for valid input, +1 is for null terminator */
   if(strlen((const int8_t*)cur_pcb->args)+1 > nbytes || buf == NULL || (cur_pcb->args)[0] == '\0' || buf < (uint8_t*)(USER_PROG) || buf >= (uint8_t*)(USER_PROG + FOUR_MB)){
@@ -606,18 +1148,20 @@ int32_t getargs(uint8_t* buf, int32_t nbytes){
  *    SIDE EFFECTS: Enables a new page
  */
 int32_t vidmap(uint8_t** screen_start){
+  pcb_t* pcb = get_proc_pcb();
+
   /* Check for a valid pointer */
   if(screen_start == NULL || screen_start < (uint8_t**)(USER_PROG) || screen_start >= (uint8_t**)(USER_PROG + FOUR_MB)){
     /* Return failure */
     return -1;
   }
 
-  /* Mark pcb as having video memory page */
-  get_pcb_add()->vidmem = 1;
-  sched_arr[cur_sched_term].vid_map = 1;
+  /* Mark pcb and terminal as having video memory page, the terminal stops moving its screen */
+  pcb->vidmem = 1;
+  screen_map(pcb->terminal, 1);
 
-  /* Add page to page table */
-  set_page_table2_entry(USER_VIDEO_MEM, VIDEO_MEM_ADDR);
+  /* Add page to page table, the top of the terminal's text region */
+  set_page_table2_entry(USER_VIDEO_MEM, sched_arr[pcb->terminal].video_buffer);
 
   /* Flush tlb */
   asm volatile ("      \n\
@@ -636,30 +1180,176 @@ int32_t vidmap(uint8_t** screen_start){
 }
 
 /*
- * set_handler
- *    DESCRIPTION: Does nothing for now
- *    INPUTS: int32_t signum -
- *            void* handler_address -
+ * pipe
+ *    DESCRIPTION: Makes a pipe and opens both of its ends
+ *    INPUTS: int32_t* fds - gets the read end in fds[0] and the write end in
+ *                           fds[1]
  *    OUTPUTS: none
- *    RETURN VALUE: -1 for failure
+ *    RETURN VALUE: 0 for success, -1 for failure
  *    SIDE EFFECTS: none
  */
-int32_t set_handler(int32_t signum, void* handler_address){
-  /* Return failure */
-  return -1;
+int32_t pipe(int32_t* fds){
+  pipe_t* new_pipe;          /* The pipe */
+  int32_t read_fd, write_fd; /* Its two ends */
+  file_desc* file;
+
+  if(fds == NULL || (new_pipe = pipe_create()) == NULL){
+    /* Return failure */
+    return -1;
+  }
+
+  /* Take the read end */
+  if((read_fd = alloc_fd()) == -1){
+    pipe_release(new_pipe, 0);
+    pipe_release(new_pipe, 1);
+    /* Return failure */
+    return -1;
+  }
+  file = get_fd(read_fd);
+  file->jump_ptr = &pipe_read_table;
+  file->inode = (int32_t)new_pipe;
+
+  /* Take the write end */
+  if((write_fd = alloc_fd()) == -1){
+    close(read_fd);
+    pipe_release(new_pipe, 1);
+    /* Return failure */
+    return -1;
+  }
+  file = get_fd(write_fd);
+  file->jump_ptr = &pipe_write_table;
+  file->inode = (int32_t)new_pipe;
+
+  fds[0] = read_fd;
+  fds[1] = write_fd;
+
+  /* Return success */
+  return 0;
 }
 
 /*
- * sigreturn
- *    DESCRIPTION: Does nothing for now
- *    INPUTS: none
+ * thread_create
+ *    DESCRIPTION: Starts another thread of the current process. It shares the
+ *                 program page, fds and shared memory, and gets its own kernel
+ *                 stack in a process slot and its own user stack below the
+ *                 main thread's
+ *    INPUTS: uint32_t start - user address the thread starts at
+ *            uint32_t func - pushed on the thread's stack for start
+ *            uint32_t arg - pushed under func
  *    OUTPUTS: none
- *    RETURN VALUE: 0 for success, -1 for failure
- *    SIDE EFFECTS: none
+ *    RETURN VALUE: the thread's id, a pid, or -1 for failure
+ *    SIDE EFFECTS: Takes a process slot, the thread runs on a later schedule
  */
-int32_t sigreturn(){
-  /* Return failure */
-  return -1;
+int32_t thread_create(uint32_t start, uint32_t func, uint32_t arg){
+  pcb_t* cur_pcb = get_pcb_add();
+  pcb_t* proc_pcb = get_proc_pcb();
+  pcb_t* pcb;
+  uint32_t* stack;    /* Top of the new user stack */
+  uint32_t slot;      /* Which user stack */
+  int32_t pid;
+  unsigned long flags; /* Saved interrupt flag */
+
+  /* Check for addresses in the program page */
+  if(start < USER_PROG || start >= USER_PROG + FOUR_MB || func < USER_PROG || func >= USER_PROG + FOUR_MB){
+    /* Return failure */
+    return -1;
+  }
+
+  cli_and_save(flags);
+
+  /* Threads count against the process limit */
+  if(process_num >= MAX_PROGS){
+    restore_flags(flags);
+    /* Return failure */
+    return -1;
+  }
+  for(pid = 1; process_array[pid - 1] != -1; pid++);
+  asm volatile ("bsfl %1, %0" : "=r"(slot) : "r"(~proc_pcb->thread_stacks));
+
+  process_array[pid - 1] = 1;
+  process_num++;
+  proc_pcb->thread_stacks |= 1 << slot;
+  proc_pcb->exited &= ~(1 << (pid - 1));
+
+  pcb = get_pcb(pid);
+  pcb->pid = pid;
+  pcb->tgid = proc_pcb->pid;
+  pcb->stack_slot = slot;
+  pcb->parent_pid = cur_pid;
+  pcb->terminal = cur_pcb->terminal;
+  pcb->freq = cur_pcb->freq;
+  pcb->background = 1;
+
+  /* start finds func, then arg as func's argument */
+  stack = (uint32_t*)(USER_PROG + FOUR_MB - slot*THREAD_STACK_SIZE);
+  *(--stack) = arg;
+  *(--stack) = func;
+  sched_new(pid, start, (uint32_t)stack);
+
+  restore_flags(flags);
+  return pid;
+}
+
+/*
+ * thread_exit
+ *    DESCRIPTION: Ends the calling thread, the rest of the process runs on
+ *    INPUTS: int32_t status - what thread_join returns
+ *    OUTPUTS: none
+ *    RETURN VALUE: -1 from a main thread, which ends the process with halt,
+ *                  otherwise never returns
+ *    SIDE EFFECTS: The thread's kernel stack is abandoned
+ */
+int32_t thread_exit(int32_t status){
+  pcb_t* cur_pcb = get_pcb_add();
+
+  if(cur_pcb->tgid == cur_pcb->pid){
+    /* Return failure */
+    return -1;
+  }
+
+  cli();
+  end_thread(cur_pcb, status);
+  sched_exit();
+  return 0;
+}
+
+/*
+ * thread_join
+ *    DESCRIPTION: Waits for another thread of the current process to end
+ *    INPUTS: int32_t tid - the thread
+ *    OUTPUTS: none
+ *    RETURN VALUE: the thread's status, or -1 if it isn't a thread of this
+ *                  process or was already joined
+ *    SIDE EFFECTS: Blocks until the thread ends
+ */
+int32_t thread_join(int32_t tid){
+  pcb_t* proc_pcb = get_proc_pcb();
+  unsigned long flags; /* Saved interrupt flag */
+  int32_t status;
+
+  if(tid < 1 || tid > MAX_PROGS || tid == cur_pid || tid == proc_pcb->pid){
+    /* Return failure */
+    return -1;
+  }
+
+  cli_and_save(flags);
+  while(!(proc_pcb->exited & (1 << (tid - 1)))){
+    if(process_array[tid - 1] == -1 || get_pcb(tid)->tgid != proc_pcb->pid){
+      restore_flags(flags);
+      /* Return failure */
+      return -1;
+    }
+    if(sleep_on(&proc_pcb->join_wait) == -1){
+      restore_flags(flags);
+      /* Return failure, a signal is waiting */
+      return -1;
+    }
+  }
+  proc_pcb->exited &= ~(1 << (tid - 1));
+  status = proc_pcb->exit_status[tid - 1];
+  restore_flags(flags);
+
+  return status;
 }
 
 /*
@@ -675,6 +1365,134 @@ int32_t invalid_read(int32_t fd, void* buf, int32_t nbytes){
   return -1;
 }
 
+/*
+ * init_fds
+ *    DESCRIPTION: Sets up a new descriptor table with stdin and stdout open
+ *    INPUTS: pcb_t* pcb - pcb to set up
+ *    OUTPUTS: none
+ *    RETURN VALUE: 0 for success, -1 if no page is free
+ *    SIDE EFFECTS: Takes a page for the first descriptors
+ */
+int32_t init_fds(pcb_t* pcb){
+  file_desc* page; /* First page of descriptors */
+
+  memset(&(pcb->fds), 0, sizeof(fd_table));
+  if((page = (file_desc*)alloc_page()) == NULL){
+    /* Return failure */
+    return -1;
+  }
+  pcb->fds.pages[0] = page;
+
+  /* Load stdin and stdout jump table and mark as in use */
+  page[0].jump_ptr = &stdin_table;
+  page[1].jump_ptr = &stdout_table;
+  page[0].flags = 1;
+  page[1].flags = 1;
+  /* stdin starts cooked */
+  page[0].tty_mode = LDISC_COOKED;
+  pcb->fds.in_use[0] = 0x3;
+
+  /* Return success */
+  return 0;
+}
+
+/*
+ * free_fds
+ *    DESCRIPTION: Closes every open descriptor of the current process and
+ *                 frees its table
+ *    INPUTS: none
+ *    OUTPUTS: none
+ *    RETURN VALUE: none
+ *    SIDE EFFECTS: Calls each open file's close
+ */
+void free_fds(void){
+  pcb_t* pcb = get_proc_pcb();
+  uint32_t i, bit; /* Word and bit of an open descriptor */
+  file_desc* file;
+
+  /* Only visit the words with open descriptors */
+  for(i = 0; i < FD_MAP_WORDS; i++){
+    while(pcb->fds.in_use[i] != 0){
+      asm volatile ("bsfl %1, %0" : "=r"(bit) : "r"(pcb->fds.in_use[i]));
+      file = get_fd(i * 32 + bit);
+      if(i * 32 + bit >= 2){
+        close(i * 32 + bit);
+      } else if(file->jump_ptr == &pipe_read_table || file->jump_ptr == &pipe_write_table){
+        /* Pipeline stages have pipes for stdin and stdout */
+        epoll_forget(i * 32 + bit);
+        file->jump_ptr->close(i * 32 + bit);
+      }
+      pcb->fds.in_use[i] &= ~(1 << bit);
+    }
+  }
+
+  for(i = 0; i < FD_PAGES; i++){
+    free_page(pcb->fds.pages[i]);
+    pcb->fds.pages[i] = NULL;
+  }
+}
+
+/*
+ * alloc_fd
+ *    DESCRIPTION: Takes the lowest free descriptor of the current process,
+ *                 adding a page to the table when needed
+ *    INPUTS: none
+ *    OUTPUTS: none
+ *    RETURN VALUE: the descriptor, or -1 if the table is full
+ *    SIDE EFFECTS: Marks the descriptor in use with its position at 0
+ */
+int32_t alloc_fd(void){
+  pcb_t* pcb = get_proc_pcb();
+  uint32_t i, bit; /* Word and bit of the free descriptor */
+  int32_t fd;
+  file_desc* page;
+
+  /* Find a word with a clear bit */
+  for(i = 0; i < FD_MAP_WORDS && pcb->fds.in_use[i] == 0xFFFFFFFF; i++);
+  if(i == FD_MAP_WORDS){
+    /* Return failure */
+    return -1;
+  }
+
+  /* Lowest clear bit */
+  asm volatile ("bsfl %1, %0" : "=r"(bit) : "r"(~pcb->fds.in_use[i]));
+  fd = i * 32 + bit;
+
+  /* Descriptors are added a page at a time */
+  if((page = pcb->fds.pages[fd / FDS_PER_PAGE]) == NULL){
+    if((page = (file_desc*)alloc_page()) == NULL){
+      /* Return failure */
+      return -1;
+    }
+    pcb->fds.pages[fd / FDS_PER_PAGE] = page;
+  }
+
+  /* Mark file descriptor as in use and intialize file position */
+  pcb->fds.in_use[i] |= 1 << bit;
+  page[fd % FDS_PER_PAGE].flags = 1;
+  page[fd % FDS_PER_PAGE].file_position = 0;
+  page[fd % FDS_PER_PAGE].tty_mode = LDISC_COOKED;
+  return fd;
+}
+
+/*
+ * get_fd
+ *    DESCRIPTION: Gets an open descriptor of the current process
+ *    INPUTS: int32_t fd - the descriptor
+ *    OUTPUTS: none
+ *    RETURN VALUE: pointer to the descriptor, or NULL if it isn't open
+ *    SIDE EFFECTS: none
+ */
+file_desc* get_fd(int32_t fd){
+  pcb_t* pcb = get_proc_pcb();
+
+  /* Check for a valid, open fd */
+  if(fd < 0 || fd > MAX_FD_NUM || !(pcb->fds.in_use[fd / 32] & (1 << (fd % 32)))){
+    return NULL;
+  }
+  return &(pcb->fds.pages[fd / FDS_PER_PAGE][fd % FDS_PER_PAGE]);
+}
+
 /*
  * get_pcb_add
  *    DESCRIPTION: Function for jump tables with no write
@@ -688,6 +1506,19 @@ int32_t invalid_write(int32_t fd, const void* buf, int32_t nbytes){
   return -1;
 }
 
+/*
+ * get_pcb
+ *    DESCRIPTION: Gets a pointer to a process' pcb, at the bottom of its
+ *                 kernel stack
+ *    INPUTS: int32_t pid - the process
+ *    OUTPUTS: none
+ *    RETURN VALUE: A pcb_t pointer
+ *    SIDE EFFECTS: none
+ */
+pcb_t* get_pcb(int32_t pid){
+  return (pcb_t*)(EIGHT_MB - pid*EIGHT_KB);
+}
+
 /*
  * get_pcb_add
  *    DESCRIPTION: Gets a pointer of the current process' pcb
@@ -708,3 +1539,16 @@ pcb_t* get_pcb_add(){
   /* 8kB = 2^13, so mask everything below 13th bit */
   return (pcb_t*)(esp & (EIGHT_MB - EIGHT_KB));
 }
+
+/*
+ * get_proc_pcb
+ *    DESCRIPTION: Gets the pcb of the current process' main thread, which has
+ *                 the fds, arguments, vidmap and shared memory of every thread
+ *    INPUTS: none
+ *    OUTPUTS: none
+ *    RETURN VALUE: A pcb_t pointer
+ *    SIDE EFFECTS: none
+ */
+pcb_t* get_proc_pcb(void){
+  return get_pcb(get_pcb_add()->tgid);
+}
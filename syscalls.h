@@ -8,14 +8,36 @@
 #include "linkage.h"
 #include "lib.h"
 #include "paging.h"
+#include "shm.h"
+#include "pit.h"
+#include "epoll.h"
+#include "signal.h"
 
 /* Maximum number of file descriptor indexes */
-#define MAX_FD_NUM      7
+#define MAX_FD_NUM      1023
+/* Descriptors held by one page of the table, file_desc is 16 bytes */
+#define FDS_PER_PAGE    256
+#define FD_PAGES        ((MAX_FD_NUM + 1) / FDS_PER_PAGE)
+#define FD_MAP_WORDS    ((MAX_FD_NUM + 1) / 32)
 #define EIGHT_KB        0x2000
 #define EIGHT_MB        0x800000
 #define FOUR_MB         0x400000
 #define USER_PROG       0x8000000
 #define MAX_PROGS       6
+/* System call numbers run from 1 to NUM_SYSCALLS */
+#define NUM_SYSCALLS    29
+/* Return value of execute when the program died from an exception */
+#define EXCEPTION_STATUS 256
+/* User stack of each thread, carved down from the top of the program page */
+#define THREAD_STACK_SIZE 0x10000
+/* wait returns 0 instead of blocking when no child has ended */
+#define WAIT_NOHANG     1
+
+/* Process states */
+#define PROC_NEW        0   /* Never run, starts at its entry point */
+#define PROC_RUNNABLE   1   /* Running or ready to run */
+#define PROC_WAITING    2   /* Parent blocked in execute until its child halts */
+#define PROC_BLOCKED    3   /* Asleep on a wait queue */
 
 #ifndef ASM
 
@@ -33,6 +55,13 @@ typedef struct jump_table {
 	int32_t(*read)(int32_t, void*, int32_t);
 	int32_t(*open)(const uint8_t*);
 	int32_t(*close)(int32_t);
+	int32_t(*lseek)(int32_t, int32_t, int32_t);              /* NULL if the file can't seek */
+	int32_t(*pread)(int32_t, void*, int32_t, uint32_t);
+	int32_t(*pwrite)(int32_t, const void*, int32_t, uint32_t);
+	int32_t(*getdents)(int32_t, void*, int32_t);             /* NULL if not a directory */
+	int32_t(*poll)(int32_t, int32_t);                        /* NULL if always ready */
+	epoll_item**(*watch)(int32_t);                           /* Watcher list the driver notifies, NULL if always ready */
+	int32_t(*ioctl)(int32_t, int32_t, int32_t);              /* NULL if the device has no settings */
 } jump_table;
 
 /* File descriptor struct */
@@ -40,20 +69,43 @@ typedef struct file_desc {
 	jump_table* jump_ptr;     /* Jump table to file's system calls */
 	int32_t inode;            /* File inode number */
 	int32_t file_position;    /* Current position of the file */
-	int32_t flags;            /* Flag to indicate is a descriptor is in use */
+	int16_t flags;            /* Flag to indicate is a descriptor is in use */
+	int16_t tty_mode;         /* Line discipline mode of a terminal descriptor */
 } file_desc;
 
+/* File descriptor table, kept in pool pages outside the pcb's kernel stack */
+typedef struct fd_table {
+	file_desc* pages[FD_PAGES];     /* Descriptors a page at a time, NULL until needed */
+	uint32_t in_use[FD_MAP_WORDS];  /* Bit per descriptor, set if open */
+} fd_table;
+
 /* PCB struct,  */
 typedef struct {
   int32_t pid; 									/* Process identification number */
   int32_t parent_pid; 					/* Parent process identification number */
-  int32_t current_esp; 					/* Current esp */
+  int32_t current_esp; 					/* Kernel esp while switched out */
   int32_t parent_esp; 					/* Parent's esp */
   int32_t parent_ebp; 					/* Parent's ebp */
-  file_desc fdt[MAX_FD_NUM+1]; 	/* File Descriptor Table */
+  fd_table fds;                 /* File Descriptor Table */
 	uint8_t args[BUF_LENGTH];     /* Commands passed in */
 	int32_t vidmem;
 	int32_t freq;
+	int32_t state;                /* PROC_NEW, PROC_RUNNABLE, PROC_WAITING or PROC_BLOCKED */
+	int32_t terminal;             /* Terminal the process runs on */
+	int32_t background;           /* 1 if no parent waits for it in execute */
+	shm_space shm;                /* Shared memory segments attached */
+	int32_t tgid;                 /* pid of the main thread, whose pcb has the fds, args, vidmem and memory */
+	int32_t stack_slot;           /* Which THREAD_STACK_SIZE user stack the thread runs on, 0 for the main thread */
+	/* Main thread only */
+	uint32_t thread_stacks;       /* Bit per user stack in use */
+	uint32_t exited;              /* Threads ended but not joined, bit pid - 1 */
+	int32_t exit_status[MAX_PROGS]; /* Their statuses, by pid - 1 */
+	wait_queue join_wait;         /* Threads in thread_join */
+	uint32_t children;            /* Processes spawned and not yet waited for, bit pid - 1 */
+	uint32_t zombies;             /* Those that have ended */
+	int32_t child_status[MAX_PROGS]; /* Their statuses, by pid - 1 */
+	wait_queue child_wait;        /* Threads in wait */
+	signal_state sig;             /* Handlers and pending signals */
 } pcb_t;
 
 /* Launch 3 shells for 3 terminals */
@@ -62,9 +114,18 @@ int32_t launch(void);
 /* Halt system call, stop a process */
 int32_t halt(uint8_t status);
 
+/* Stops the current process, returning status to the parent's execute */
+int32_t end_process(int32_t status);
+
 /* Execute system call, begins a process */
 int32_t execute(const uint8_t* command);
 
+/* Starts a process like execute without waiting for it, returning its pid */
+int32_t spawn(const uint8_t* command);
+
+/* Collects the exit status of a spawned process */
+int32_t wait(int32_t pid, int32_t* status, int32_t flags);
+
 /* Read system call, reads from a file */
 int32_t read(int32_t fd, void* buf, int32_t nbytes);
 
@@ -83,11 +144,32 @@ int32_t getargs(uint8_t* buf, int32_t nbytes);
 /* Map video memory to userspace */
 int32_t vidmap(uint8_t** screen_start);
 
-/* Does nothing */
-int32_t set_handler(int32_t signum, void* handler_address);
+/* Moves a file descriptor's position */
+int32_t lseek(int32_t fd, int32_t offset, int32_t whence);
+
+/* Reads at an offset without moving the position */
+int32_t pread(int32_t fd, void* buf, int32_t nbytes, uint32_t offset);
+
+/* Writes at an offset without moving the position */
+int32_t pwrite(int32_t fd, const void* buf, int32_t nbytes, uint32_t offset);
+
+/* Reads many directory entries at once */
+int32_t getdents(int32_t fd, void* buf, int32_t nbytes);
+
+/* Gets or changes a setting of a device */
+int32_t ioctl(int32_t fd, int32_t request, int32_t arg);
+
+/* Makes a pipe, with fds[0] the read end and fds[1] the write end */
+int32_t pipe(int32_t* fds);
 
-/* Does nothing */
-int32_t sigreturn(void);
+/* Starts a thread of the current process at start, with func and arg on its stack */
+int32_t thread_create(uint32_t start, uint32_t func, uint32_t arg);
+
+/* Ends the calling thread */
+int32_t thread_exit(int32_t status);
+
+/* Waits for a thread of the current process to end, returning its status */
+int32_t thread_join(int32_t tid);
 
 /* Function for bad read system calls */
 int32_t invalid_read(int32_t fd, void* buf, int32_t nbytes);
@@ -95,9 +177,30 @@ int32_t invalid_read(int32_t fd, void* buf, int32_t nbytes);
 /* Function for bad write system calls */
 int32_t invalid_write(int32_t fd, const void* buf, int32_t nbytes);
 
+/* Sets up a pcb's descriptor table with stdin and stdout */
+int32_t init_fds(pcb_t* pcb);
+
+/* Closes every descriptor of the current process and frees its table */
+void free_fds(void);
+
+/* Takes the lowest free descriptor of the current process */
+int32_t alloc_fd(void);
+
+/* Gets an open descriptor of the current process */
+file_desc* get_fd(int32_t fd);
+
+/* Function pointers for interest sets */
+extern jump_table epoll_table;
+
 /* Gets the address of the current pcb */
 pcb_t* get_pcb_add(void);
 
+/* Gets the pcb of the current process' main thread */
+pcb_t* get_proc_pcb(void);
+
+/* Gets the address of a process' pcb */
+pcb_t* get_pcb(int32_t pid);
+
 #endif /* ASM */
 
 #endif /* _SYSCALLS_H */
@@ -5,13 +5,67 @@
 
 #define BUFSIZE 1024
 
+/* 
+ * The kernel runs "a | b" itself; check that every stage of a pipeline
+ * names a command so a typo gets a better message than "no such command".
+ */
+static int32_t
+pipeline_ok (const uint8_t* buf)
+{
+    int32_t empty = 1;
+
+    for (; '\0' != *buf; buf++) {
+        if ('|' == *buf) {
+	    if (empty)
+	        return 0;
+	    empty = 1;
+	} else if (' ' != *buf)
+	    empty = 0;
+    }
+    return !empty;
+}
+
+/*
+ * Take a trailing '&' off the command; returns 1 if there was one.
+ */
+static int32_t
+background (uint8_t* buf, int32_t cnt)
+{
+    while (cnt > 0 && ' ' == buf[cnt - 1])
+        cnt--;
+    if (0 == cnt || '&' != buf[cnt - 1])
+        return 0;
+    buf[cnt - 1] = '\0';
+    return 1;
+}
+
+/*
+ * Report background jobs that have finished since the last prompt.
+ */
+static void
+reap_jobs (void)
+{
+    int32_t pid, status;
+    uint8_t num[12];
+
+    while (0 < (pid = ece391_wait (-1, &status, WAIT_NOHANG))) {
+        ece391_fdputs (1, (uint8_t*)"[");
+        ece391_fdputs (1, ece391_itoa (pid, num, 10));
+        ece391_fdputs (1, (uint8_t*)"] done, status ");
+        ece391_fdputs (1, ece391_itoa (status, num, 10));
+        ece391_fdputs (1, (uint8_t*)"\n");
+    }
+}
+
 int main ()
 {
     int32_t cnt, rval;
     uint8_t buf[BUFSIZE];
+    uint8_t num[12];
     ece391_fdputs (1, (uint8_t*)"Starting 391 Shell\n");
 
     while (1) {
+        reap_jobs ();
         ece391_fdputs (1, (uint8_t*)"391OS> ");
 	if (-1 == (cnt = ece391_read (0, buf, BUFSIZE-1))) {
 	    ece391_fdputs (1, (uint8_t*)"read from keyboard failed\n");
@@ -24,6 +78,24 @@ int main ()
 	    return 0;
 	if ('\0' == buf[0])
 	    continue;
+	if (background (buf, cnt)) {
+	    if (!pipeline_ok (buf)) {
+		ece391_fdputs (1, (uint8_t*)"bad pipeline\n");
+		continue;
+	    }
+	    if (-1 == (rval = ece391_spawn (buf))) {
+		ece391_fdputs (1, (uint8_t*)"no such command\n");
+		continue;
+	    }
+	    ece391_fdputs (1, (uint8_t*)"[");
+	    ece391_fdputs (1, ece391_itoa (rval, num, 10));
+	    ece391_fdputs (1, (uint8_t*)"]\n");
+	    continue;
+	}
+	if (!pipeline_ok (buf)) {
+	    ece391_fdputs (1, (uint8_t*)"bad pipeline\n");
+	    continue;
+	}
 	rval = ece391_execute (buf);
 	if (-1 == rval)
 	    ece391_fdputs (1, (uint8_t*)"no such command\n");
@@ -21,6 +21,83 @@ extern int32_t ece391_getargs (uint8_t* buf, int32_t nbytes);
 extern int32_t ece391_vidmap (uint8_t** screen_start);
 extern int32_t ece391_set_handler (int32_t signum, void* handler);
 extern int32_t ece391_sigreturn (void);
+extern int32_t ece391_lseek (int32_t fd, int32_t offset, int32_t whence);
+extern int32_t ece391_pread (int32_t fd, void* buf, int32_t nbytes, uint32_t offset);
+extern int32_t ece391_pwrite (int32_t fd, const void* buf, int32_t nbytes, uint32_t offset);
+extern int32_t ece391_getdents (int32_t fd, void* buf, int32_t nbytes);
+extern int32_t ece391_pipe (int32_t fds[2]);
+extern int32_t ece391_shm_create (uint32_t key, uint32_t size);
+/* returns the segment's address, or (void*)-1; addr 0 lets the kernel pick */
+extern void* ece391_shm_attach (uint32_t key, void* addr);
+extern int32_t ece391_shm_detach (void* addr);
+/* cmd is 0 to stop tracing, 1 to start it, 2 to copy the ring into buf */
+extern int32_t ece391_trace_ctl (int32_t cmd, void* buf, int32_t nbytes);
+/* threads share memory and fds; returning from func is thread_exit; halt in any thread ends them all */
+extern int32_t ece391_thread_create (int32_t (*func)(void* arg), void* arg);
+extern int32_t ece391_thread_exit (int32_t status);
+extern int32_t ece391_thread_join (int32_t tid);
+/* spawn runs a command like execute but returns its pid right away; wait
+ * collects its status, pid -1 means any child, and WAIT_NOHANG returns 0
+ * if none has ended */
+#define WAIT_NOHANG 1
+extern int32_t ece391_spawn (const uint8_t* command);
+extern int32_t ece391_wait (int32_t pid, int32_t* status, int32_t flags);
+
+/* Descriptor for poll, which waits until one can be read or written without
+ * waiting; timeout is in milliseconds, 0 only checks and -1 waits forever */
+typedef struct ece391_pollfd {
+	int32_t fd;
+	int16_t events;
+	int16_t revents;
+} ece391_pollfd_t;
+#define POLLIN   0x01
+#define POLLOUT  0x04
+#define POLLERR  0x08
+#define POLLHUP  0x10
+#define POLLNVAL 0x20
+extern int32_t ece391_poll (ece391_pollfd_t* fds, int32_t nfds, int32_t timeout);
+
+/* Interest set for many descriptors: epoll_ctl adds, changes or removes one,
+ * epoll_wait fills events with the ready ones and their data; events are
+ * poll's, and a descriptor stays ready until a read or write says otherwise */
+typedef struct ece391_epoll_event {
+	uint32_t events;
+	uint32_t data;
+} ece391_epoll_event_t;
+#define EPOLL_CTL_ADD 1
+#define EPOLL_CTL_DEL 2
+#define EPOLL_CTL_MOD 3
+extern int32_t ece391_epoll_create (void);
+extern int32_t ece391_epoll_ctl (int32_t epfd, int32_t op, int32_t fd, ece391_epoll_event_t* event);
+extern int32_t ece391_epoll_wait (int32_t epfd, ece391_epoll_event_t* events, int32_t maxevents, int32_t timeout);
+
+/* Terminal input modes for ioctl on stdin: cooked reads return edited
+ * lines, cbreak reads return each key as it is typed, and raw ones also
+ * stop the echo and give ctrl+letter as a control byte instead of a signal */
+#define TTY_GET_MODE 1
+#define TTY_SET_MODE 2
+#define TTY_COOKED   0
+#define TTY_CBREAK   1
+#define TTY_RAW      2
+extern int32_t ece391_ioctl (int32_t fd, int32_t request, int32_t arg);
+
+/* ioctl on the "dmesg" device, which reads the kernel log a line per record:
+ * arg 1 also prints new records on the viewing terminal, 0 stops it */
+#define DMESG_CONSOLE 1
+
+/* Directory entry filled in by getdents; names of 32 characters have no
+ * terminator */
+typedef struct ece391_dirent {
+	uint8_t name[32];
+	uint32_t type;
+	uint32_t inode;
+	uint32_t size;
+} ece391_dirent_t;
+
+/* lseek whence values */
+#define SEEK_SET 0
+#define SEEK_CUR 1
+#define SEEK_END 2
 
 enum signums {
 	DIV_ZERO = 0,
@@ -11,5 +11,24 @@
 #define SYS_VIDMAP  8
 #define SYS_SET_HANDLER  9
 #define SYS_SIGRETURN  10
+#define SYS_LSEEK   11
+#define SYS_PREAD   12
+#define SYS_PWRITE  13
+#define SYS_GETDENTS 14
+#define SYS_PIPE    15
+#define SYS_SHM_CREATE 16
+#define SYS_SHM_ATTACH 17
+#define SYS_SHM_DETACH 18
+#define SYS_TRACE_CTL 19
+#define SYS_THREAD_CREATE 20
+#define SYS_THREAD_EXIT 21
+#define SYS_THREAD_JOIN 22
+#define SYS_SPAWN   23
+#define SYS_WAIT    24
+#define SYS_POLL    25
+#define SYS_EPOLL_CREATE 26
+#define SYS_EPOLL_CTL 27
+#define SYS_EPOLL_WAIT 28
+#define SYS_IOCTL   29
 
 #endif /* ECE391SYSNUM_H */
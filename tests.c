@@ -6,6 +6,15 @@
 #include "file_system.h"
 #include "rtc.h"
 #include "syscalls.h"
+#include "pit.h"
+#include "pipe.h"
+#include "trace.h"
+#include "poll.h"
+#include "scrollback.h"
+#include "ldisc.h"
+#include "klog.h"
+#include "serial.h"
+#include "linkage.h"
 
 #define SYSCALL_NUM 0x80
 #define PASS 1
@@ -15,7 +24,64 @@
 #define TEST_HEADER 	\
 	printf("[TEST %s] Running %s at %s:%d\n", __FUNCTION__, __FUNCTION__, __FILE__, __LINE__)
 #define TEST_OUTPUT(name, result)	\
-	printf("[TEST %s] Result = %s\n", name, (result) ? "PASS" : "FAIL");
+	test_output(name, result);
+
+/* QEMU's isa-debug-exit device, QEMU exits with (value << 1) | 1 */
+#define DEBUG_EXIT_PORT 0xF4
+/* Longest line reported over serial */
+#define REPORT_LINE 80
+/* Each benchmark keeps its best of this many runs, so a tick landing in one doesn't count */
+#define BENCH_ROUNDS 5
+
+/* Results so far, for the headless exit status */
+static int32_t tests_passed = 0;
+static int32_t tests_failed = 0;
+
+static void place_test_pcb(jump_table* in, jump_table* out);
+
+/*
+ * report
+ *    DESCRIPTION: Sends one line of results over serial for a host to parse,
+ *                 waiting for room so no line is cut short
+ *    INPUTS: int8_t* format - format string, as for printf, then its arguments
+ *    OUTPUTS: none
+ *    RETURN VALUE: none
+ *    SIDE EFFECTS: Spins with interrupts on while the transmit ring is full.
+ *                  Does nothing without a UART
+ */
+static void report(int8_t* format, ...){
+	int8_t line[REPORT_LINE];
+	int32_t len;
+
+	if(!serial_present){
+		return;
+	}
+	len = vsnprintf(line, sizeof(line) - 2, format, (int32_t*)&format + 1);
+	line[len++] = '\r';
+	line[len++] = '\n';
+	while(serial_room() < len);
+	serial_send((uint8_t*)line, len);
+}
+
+/*
+ * test_output
+ *    DESCRIPTION: Prints a test's result, and reports it over serial as
+ *                 "TEST <name> PASS" or "TEST <name> FAIL"
+ *    INPUTS: int8_t* name - the test
+ *            int32_t result - PASS or FAIL
+ *    OUTPUTS: none
+ *    RETURN VALUE: none
+ *    SIDE EFFECTS: Counts the result
+ */
+static void test_output(int8_t* name, int32_t result){
+	printf("[TEST %s] Result = %s\n", name, result ? "PASS" : "FAIL");
+	report("TEST %s %s", name, result ? "PASS" : "FAIL");
+	if(result){
+		tests_passed++;
+	} else{
+		tests_failed++;
+	}
+}
 
 static inline void assertion_failure(){
 	/* Use exception #15 for assertions, otherwise
@@ -266,7 +332,8 @@ void divide_zero_test(){
 
 /*
  * page_directory_test
- *		ASSERTS: Page directory has tables marked not present
+ *		ASSERTS: Page directory has tables marked not present, other than the
+ *		         ones the kernel maps at boot
  *		INPUTS: None
  *    OUTPUTS: PASS or FAIL
  *		SIDE EFFECTS: None
@@ -278,6 +345,11 @@ int page_directory_test(){
 
   int result = PASS;
   int i;
+  int window_end = FS_IMAGE_ADDR >> 22; /* One past the file system window's last entry */
+
+  if(fs_image_start != 0 && fs_image_end > fs_image_start){
+    window_end += (((fs_image_end - 1) >> 22) - (fs_image_start >> 22)) + 1;
+  }
 
   if((get_dir(0) & 0x03) == 0x02){
     return FAIL;
@@ -287,7 +359,16 @@ int page_directory_test(){
     return FAIL;
   }
 
+  if((get_dir(USER_VIDEO_MEM >> 22) & 0x01) == 0 || (get_dir(PAGE_POOL_ADDR >> 22) & 0x03) != 0x03){
+    return FAIL;
+  }
+
   for(i=2; i<1024; i++){
+    /* The overlay and image window are only mapped when there is an image */
+    if(i == USER_VIDEO_MEM >> 22 || i == PAGE_POOL_ADDR >> 22 || i == FS_OVERLAY_ADDR >> 22 ||
+       (i >= FS_IMAGE_ADDR >> 22 && i < window_end)){
+      continue;
+    }
     if((get_dir(i) & 0x03) != 0x02){
       result = FAIL;
       break;
@@ -299,7 +380,8 @@ int page_directory_test(){
 
 /*
  * page_table_test
- *		ASSERTS: Page table has not present pages and correct addresses
+ *		ASSERTS: Page table has not present pages, other than each terminal's
+ *		         text region, and correct addresses
  *		INPUTS: None
  *    OUTPUTS: PASS or FAIL
  *		SIDE EFFECTS: None
@@ -316,7 +398,7 @@ int page_table_test(){
 		if(i!=((get_page(i))>>12)){
 			return FAIL;
 		}
-    if(i==0xB8){
+    if(i>=(VIDEO_MEM_ADDR>>12) && i<((THIRD_SHELL+TEXT_REGION_SIZE)>>12)){
       if((get_page(i)&0x03)!=0x03){
         return FAIL;
       }
@@ -707,6 +789,7 @@ void file_index_test(uint32_t index){
  */
 void fread_fail_test(void){
 	TEST_HEADER;
+	place_test_pcb(NULL, NULL);
 	int8_t buf[10000];
 	if(file_read(69,buf,100)==-1){
 		TEST_OUTPUT("fread_fail_test", PASS);
@@ -727,6 +810,7 @@ void fread_fail_test(void){
  */
 void dread_fail_test(void){
 	TEST_HEADER;
+	place_test_pcb(NULL, NULL);
 	uint8_t buf[33];
 	if(dir_read(69,buf,32)==-1){
 		TEST_OUTPUT("dread_fail_test", PASS);
@@ -756,13 +840,51 @@ void read_test(){
 /* Checkpoint 3 tests */
 
 /* Function pointers for stdin (only has terminal read) */
-jump_table stdin_table_1 = {NULL, terminal_read, terminal_open, terminal_close};
+jump_table stdin_table_1 = {invalid_write, terminal_read, terminal_open, terminal_close};
 
 /* function pointers for stdout(only has terminal write) */
-jump_table stdout_table_1 = {terminal_write, NULL, terminal_open, terminal_close};
+jump_table stdout_table_1 = {terminal_write, invalid_read, terminal_open, terminal_close};
 
 /* jump table for files*/
 jump_table file_table_1 = {file_write, file_read, file_open, file_close};
+
+/*
+ * place_test_pcb
+ * 		Sets up process 1's pcb, which get_pcb_add finds while the tests run,
+ * 		with a new descriptor table
+ * 		INPUTS: in, out - jump tables for stdin and stdout, NULL for the usual ones
+ * 		OUTPUTS: None
+ * 		SIDE EFFECTS: Closes the descriptors the last test left open
+ * */
+static void place_test_pcb(jump_table* in, jump_table* out){
+	static int placed = 0;
+	pcb_t* pcb = (pcb_t*)(EIGHT_MB - 1*0x2000);
+
+	/* The first time, the slot holds whatever was in memory */
+	if(placed){
+		free_fds();
+	}
+	placed = 1;
+
+	init_fds(pcb);
+	memset(&pcb->shm, 0, sizeof(shm_space));
+	pcb->pid = 1;
+	pcb->tgid = 1;
+	pcb->thread_stacks = 1;
+	pcb->exited = 0;
+	pcb->join_wait = 0;
+	pcb->children = 0;
+	pcb->zombies = 0;
+	pcb->child_wait = 0;
+	pcb->args[0] = '\0';
+	signal_init(&pcb->sig);
+	if(in != NULL){
+		pcb->fds.pages[0][0].jump_ptr = in;
+	}
+	if(out != NULL){
+		pcb->fds.pages[0][1].jump_ptr = out;
+	}
+}
 /*
  * execute_fail_test
  * 		ASSERTS: Running execute on invalid executable file should fail
@@ -802,10 +924,10 @@ void execute_fail_test_2(void){
   int8_t ret;
   ret = execute((uint8_t*)file);
   if(ret==-1){
-    TEST_OUTPUT("execute_fail_test", PASS);
+    TEST_OUTPUT("execute_fail_test_2", PASS);
   }
   else{
-    TEST_OUTPUT("execute_fail_test", FAIL);
+    TEST_OUTPUT("execute_fail_test_2", FAIL);
   }
 }
 
@@ -822,14 +944,7 @@ void execute_fail_test_2(void){
   * 		FILES: syscalls.c
   * */
 void open_null_test(void){
-  pcb_t pcb;
-  pcb.fdt[0].jump_ptr = &stdin_table_1;
-  pcb.fdt[1].jump_ptr = &stdout_table_1;
-  pcb.fdt[0].flags = 1;
-  pcb.fdt[1].flags = 1;
-
-  /* Place pcb in kernel memory */
-  memcpy((void *)(EIGHT_MB - 1*0x2000), &pcb, sizeof(pcb));
+  place_test_pcb(&stdin_table_1, &stdout_table_1);
 
   int ret=open(NULL);
 
@@ -852,14 +967,7 @@ void open_null_test(void){
  * 		FILES: syscalls.c
  * */
 void open_test_fail(void){
-  pcb_t pcb;
-  pcb.fdt[0].jump_ptr = &stdin_table_1;
-  pcb.fdt[1].jump_ptr = &stdout_table_1;
-  pcb.fdt[0].flags = 1;
-  pcb.fdt[1].flags = 1;
-
-  /* Place pcb in kernel memory */
-  memcpy((void *)(EIGHT_MB - 1*0x2000), &pcb, sizeof(pcb));
+  place_test_pcb(&stdin_table_1, &stdout_table_1);
 
   int ret=open((uint8_t*)"PiedPiper.exe");
 
@@ -881,14 +989,7 @@ void open_test_fail(void){
  * 		FILES: syscalls.c
  * */
 void close_test_fail_1(void){
-  pcb_t pcb;
-  pcb.fdt[0].jump_ptr = &stdin_table_1;
-  pcb.fdt[1].jump_ptr = &stdout_table_1;
-  pcb.fdt[0].flags = 1;
-  pcb.fdt[1].flags = 1;
-
-  /* Place pcb in kernel memory */
-  memcpy((void *)(EIGHT_MB - 1*0x2000), &pcb, sizeof(pcb));
+  place_test_pcb(&stdin_table_1, &stdout_table_1);
 
   int ret=close(-1);
 
@@ -900,7 +1001,7 @@ void close_test_fail_1(void){
 }
 /*
  * close_test_fail_2
- * 		ASSERTS: Cannot access fd > 7
+ * 		ASSERTS: Cannot access fd > MAX_FD_NUM
  * 		INPUTS: None
  * 		OUTPUTS: PASS - if ret = -1
 							 FAIL - if ret != -1
@@ -909,17 +1010,9 @@ void close_test_fail_1(void){
  * 		FILES: syscalls.c
  * */
 void close_test_fail_2(void){
-  pcb_t pcb;
-  pcb.fdt[0].jump_ptr = &stdin_table_1;
-  pcb.fdt[1].jump_ptr = &stdout_table_1;
-  pcb.fdt[0].flags = 1;
-  pcb.fdt[1].flags = 1;
-
-
-  /* Place pcb in kernel memory */
-  memcpy((void *)(EIGHT_MB - 1*0x2000), &pcb, sizeof(pcb));
+  place_test_pcb(&stdin_table_1, &stdout_table_1);
 
-  int ret=close(8);
+  int ret=close(MAX_FD_NUM + 1);
 
   if(ret==-1){
     TEST_OUTPUT("close_test_fail_2",PASS);
@@ -939,15 +1032,7 @@ void close_test_fail_2(void){
  * 		FILES: syscalls.c
  * */
 void read_test_fail_1(void){
-  pcb_t pcb;
-  pcb.fdt[0].jump_ptr = &stdin_table_1;
-  pcb.fdt[1].jump_ptr = &stdout_table_1;
-  pcb.fdt[0].flags = 1;
-  pcb.fdt[1].flags = 1;
-
-
-  /* Place pcb in kernel memory */
-  memcpy((void *)(EIGHT_MB - 1*0x2000), &pcb, sizeof(pcb));
+  place_test_pcb(&stdin_table_1, &stdout_table_1);
   unsigned char read_buf[128];
   int ret=read(-1,read_buf,128);
 
@@ -961,7 +1046,7 @@ void read_test_fail_1(void){
 
 /*
  * read_test_fail_2
- * 		ASSERTS: Cannot access fd > 7
+ * 		ASSERTS: Cannot access fd > MAX_FD_NUM
  * 		INPUTS: None
  * 		OUTPUTS: PASS - if ret = -1
 							 FAIL - if ret != -1
@@ -970,17 +1055,9 @@ void read_test_fail_1(void){
  * 		FILES: syscalls.c
  * */
 void read_test_fail_2(void){
-  pcb_t pcb;
-  pcb.fdt[0].jump_ptr = &stdin_table_1;
-  pcb.fdt[1].jump_ptr = &stdout_table_1;
-  pcb.fdt[0].flags = 1;
-  pcb.fdt[1].flags = 1;
-
-
-  /* Place pcb in kernel memory */
-  memcpy((void *)(EIGHT_MB - 1*0x2000), &pcb, sizeof(pcb));
+  place_test_pcb(&stdin_table_1, &stdout_table_1);
   unsigned char read_buf[128];
-  int ret=read(8,read_buf,128);
+  int ret=read(MAX_FD_NUM + 1,read_buf,128);
 
   if(ret==-1){
     TEST_OUTPUT("read_test_fail_2",PASS);
@@ -1001,15 +1078,7 @@ void read_test_fail_2(void){
  * 		FILES: syscalls.c
  * */
 void read_test_fail_3(void){
-  pcb_t pcb;
-  pcb.fdt[0].jump_ptr = &stdin_table_1;
-  pcb.fdt[1].jump_ptr = &stdout_table_1;
-  pcb.fdt[0].flags = 1;
-  pcb.fdt[1].flags = 1;
-
-
-  /* Place pcb in kernel memory */
-  memcpy((void *)(EIGHT_MB - 1*0x2000), &pcb, sizeof(pcb));
+  place_test_pcb(&stdin_table_1, &stdout_table_1);
   int ret=read(0,NULL,128);
 
   if(ret==-1){
@@ -1031,14 +1100,7 @@ void read_test_fail_3(void){
  * 		FILES: syscalls.c
  * */
 void read_test_fail_4(void){
-  pcb_t pcb;
-  pcb.fdt[0].jump_ptr = &stdin_table_1;
-  pcb.fdt[1].jump_ptr = &stdout_table_1;
-  pcb.fdt[0].flags = 1;
-  pcb.fdt[1].flags = 1;
-
-  /* Place pcb in kernel memory */
-  memcpy((void *)(EIGHT_MB - 1*0x2000), &pcb, sizeof(pcb));
+  place_test_pcb(&stdin_table_1, &stdout_table_1);
   unsigned char read_buf[128];
   int ret=read(0,read_buf,-1);
 
@@ -1061,14 +1123,7 @@ void read_test_fail_4(void){
  * 		FILES: syscalls.c
  * */
 void read_test_fail_5(void){
-  pcb_t pcb;
-  pcb.fdt[0].jump_ptr = &stdin_table_1;
-  pcb.fdt[1].jump_ptr = &stdout_table_1;
-  pcb.fdt[0].flags = 1;
-  pcb.fdt[1].flags = 1;
-
-  /* Place pcb in kernel memory */
-  memcpy((void *)(EIGHT_MB - 1*0x2000), &pcb, sizeof(pcb));
+  place_test_pcb(&stdin_table_1, &stdout_table_1);
   unsigned char read_buf[128];
   int ret=read(1,read_buf,128);
 
@@ -1091,15 +1146,7 @@ void read_test_fail_5(void){
  * 		FILES: syscalls.c
  * */
 void write_test_fail_1(void){
-  pcb_t pcb;
-  pcb.fdt[0].jump_ptr = &stdin_table_1;
-  pcb.fdt[1].jump_ptr = &stdout_table_1;
-  pcb.fdt[0].flags = 1;
-  pcb.fdt[1].flags = 1;
-
-
-  /* Place pcb in kernel memory */
-  memcpy((void *)(EIGHT_MB - 1*0x2000), &pcb, sizeof(pcb));
+  place_test_pcb(&stdin_table_1, &stdout_table_1);
   unsigned char read_buf[128];
   int ret = write(-1,read_buf,128);
 
@@ -1113,7 +1160,7 @@ void write_test_fail_1(void){
 
 /*
  * write_test_fail_2
- * 		ASSERTS: Cannot write when fd > 7
+ * 		ASSERTS: Cannot write when fd > MAX_FD_NUM
  * 		INPUTS: None
  * 		OUTPUTS: PASS - if ret = -1
 							 FAIL - if ret != -1
@@ -1122,17 +1169,9 @@ void write_test_fail_1(void){
  * 		FILES: syscalls.c
  * */
 void write_test_fail_2(void){
-  pcb_t pcb;
-  pcb.fdt[0].jump_ptr = &stdin_table_1;
-  pcb.fdt[1].jump_ptr = &stdout_table_1;
-  pcb.fdt[0].flags = 1;
-  pcb.fdt[1].flags = 1;
-
-
-  /* Place pcb in kernel memory */
-  memcpy((void *)(EIGHT_MB - 1*0x2000), &pcb, sizeof(pcb));
+  place_test_pcb(&stdin_table_1, &stdout_table_1);
   unsigned char read_buf[128];
-  int ret=write(8,read_buf,128);
+  int ret=write(MAX_FD_NUM + 1,read_buf,128);
 
   if(ret==-1){
     TEST_OUTPUT("write_test_fail_2",PASS);
@@ -1153,15 +1192,7 @@ void write_test_fail_2(void){
  * 		FILES: syscalls.c
  * */
 void write_test_fail_3(void){
-  pcb_t pcb;
-  pcb.fdt[0].jump_ptr = &stdin_table_1;
-  pcb.fdt[1].jump_ptr = &stdout_table_1;
-  pcb.fdt[0].flags = 1;
-  pcb.fdt[1].flags = 1;
-
-
-  /* Place pcb in kernel memory */
-  memcpy((void *)(EIGHT_MB - 1*0x2000), &pcb, sizeof(pcb));
+  place_test_pcb(&stdin_table_1, &stdout_table_1);
   //unsigned char read_buf[128];
   int ret=write(1,NULL,128);
 
@@ -1184,14 +1215,7 @@ void write_test_fail_3(void){
  * 		FILES: syscalls.c
  * */
 void write_test_fail_4(void){
-  pcb_t pcb;
-  pcb.fdt[0].jump_ptr = &stdin_table_1;
-  pcb.fdt[1].jump_ptr = &stdout_table_1;
-  pcb.fdt[0].flags = 1;
-  pcb.fdt[1].flags = 1;
-
-  /* Place pcb in kernel memory */
-  memcpy((void *)(EIGHT_MB - 1*0x2000), &pcb, sizeof(pcb));
+  place_test_pcb(&stdin_table_1, &stdout_table_1);
   unsigned char write_buf[128];
   int ret=write(1,write_buf,-1);
 
@@ -1214,14 +1238,7 @@ void write_test_fail_4(void){
  * 		FILES: syscalls.c
  * */
 void write_test_fail_5(void){
-  pcb_t pcb;
-  pcb.fdt[0].jump_ptr = &stdin_table_1;
-  pcb.fdt[1].jump_ptr = &stdout_table_1;
-  pcb.fdt[0].flags = 1;
-  pcb.fdt[1].flags = 1;
-
-  /* Place pcb in kernel memory */
-  memcpy((void *)(EIGHT_MB - 1*0x2000), &pcb, sizeof(pcb));
+  place_test_pcb(&stdin_table_1, &stdout_table_1);
   unsigned char write_buf[128];
   int ret=write(0,write_buf,128);
 
@@ -1235,7 +1252,7 @@ void write_test_fail_5(void){
 
 /*
  * write_test_fail_6
- * 		ASSERTS: Cannot write to files
+ * 		ASSERTS: Cannot write to a file after closing it
  * 		INPUTS: None
  * 		OUTPUTS: PASS - if ret = -1
 							 FAIL - if ret != -1
@@ -1244,17 +1261,8 @@ void write_test_fail_5(void){
  * 		FILES: syscalls.c
  * */
 void write_test_fail_6(void){
-	pcb_t pcb;
-	pcb.fdt[0].jump_ptr= &stdin_table_1;
-	pcb.fdt[1].jump_ptr= &stdout_table_1;
-	pcb.fdt[2].jump_ptr=  &file_table_1;
-	pcb.fdt[0].flags=1;
-	pcb.fdt[1].flags=1;
-	pcb.fdt[2].flags=1;
-	
-
-	memcpy((void *)(EIGHT_MB - 1*0x2000), &pcb, sizeof(pcb));
-	open((uint8_t*)"pingpong");
+	place_test_pcb(&stdin_table_1, &stdout_table_1);
+	close(open((uint8_t*)"pingpong"));
 	unsigned char write_buf[128];
         int ret=write(2,write_buf,128);
 
@@ -1276,14 +1284,7 @@ void write_test_fail_6(void){
  * 		FILES: syscalls.c
  * */
 void close_fail_1(){
-  pcb_t pcb;
-  pcb.fdt[0].jump_ptr = &stdin_table_1;
-  pcb.fdt[1].jump_ptr = &stdout_table_1;
-  pcb.fdt[0].flags = 1;
-  pcb.fdt[1].flags = 1;
-
-  /* Place pcb in kernel memory */
-  memcpy((void *)(EIGHT_MB - 1*0x2000), &pcb, sizeof(pcb));
+  place_test_pcb(&stdin_table_1, &stdout_table_1);
   int ret=close(-1);
 
   if(ret==-1){
@@ -1304,14 +1305,7 @@ void close_fail_1(){
  * 		FILES: syscalls.c
  * */
 void close_fail_2(){
-  pcb_t pcb;
-  pcb.fdt[0].jump_ptr = &stdin_table_1;
-  pcb.fdt[1].jump_ptr = &stdout_table_1;
-  pcb.fdt[0].flags = 1;
-  pcb.fdt[1].flags = 1;
-
-  /* Place pcb in kernel memory */
-  memcpy((void *)(EIGHT_MB - 1*0x2000), &pcb, sizeof(pcb));
+  place_test_pcb(&stdin_table_1, &stdout_table_1);
   int ret=close(3);
 
   if(ret==-1){
@@ -1323,7 +1317,7 @@ void close_fail_2(){
 
 /*
  * close_fail_3
- * 		ASSERTS: Cannot close when fd > 8
+ * 		ASSERTS: Cannot close when fd > MAX_FD_NUM
  * 		INPUTS: None
  * 		OUTPUTS: PASS - if ret = -1
 							 FAIL - if ret != -1
@@ -1332,15 +1326,8 @@ void close_fail_2(){
  * 		FILES: syscalls.c
  * */
 void close_fail_3(){
-  pcb_t pcb;
-  pcb.fdt[0].jump_ptr = &stdin_table_1;
-  pcb.fdt[1].jump_ptr = &stdout_table_1;
-  pcb.fdt[0].flags = 1;
-  pcb.fdt[1].flags = 1;
-
-  /* Place pcb in kernel memory */
-  memcpy((void *)(EIGHT_MB - 1*0x2000), &pcb, sizeof(pcb));
-  int ret=close(8);
+  place_test_pcb(&stdin_table_1, &stdout_table_1);
+  int ret=close(MAX_FD_NUM + 1);
 
   if(ret==-1){
     TEST_OUTPUT("close_fail_3",PASS);
@@ -1360,14 +1347,7 @@ void close_fail_3(){
  * 		FILES: syscalls.c
  * */
 void close_fail_4(){
-  pcb_t pcb;
-  pcb.fdt[0].jump_ptr = &stdin_table_1;
-  pcb.fdt[1].jump_ptr = &stdout_table_1;
-  pcb.fdt[0].flags = 1;
-  pcb.fdt[1].flags = 1;
-
-  /* Place pcb in kernel memory */
-  memcpy((void *)(EIGHT_MB - 1*0x2000), &pcb, sizeof(pcb));
+  place_test_pcb(&stdin_table_1, &stdout_table_1);
   int ret=close(0);
 
   if(ret==-1){
@@ -1388,14 +1368,7 @@ void close_fail_4(){
  * 		FILES: syscalls.c
  * */
 void close_fail_5(){
-  pcb_t pcb;
-  pcb.fdt[0].jump_ptr = &stdin_table_1;
-  pcb.fdt[1].jump_ptr = &stdout_table_1;
-  pcb.fdt[0].flags = 1;
-  pcb.fdt[1].flags = 1;
-
-  /* Place pcb in kernel memory */
-  memcpy((void *)(EIGHT_MB - 1*0x2000), &pcb, sizeof(pcb));
+  place_test_pcb(&stdin_table_1, &stdout_table_1);
   int ret=close(1);
 
   if(ret==-1){
@@ -1416,14 +1389,7 @@ void close_fail_5(){
  * 		FILES: syscalls.c
  * */
 void read_write(){
-  pcb_t pcb;
-  pcb.fdt[0].jump_ptr = &stdin_table_1;
-  pcb.fdt[1].jump_ptr = &stdout_table_1;
-  pcb.fdt[0].flags = 1;
-  pcb.fdt[1].flags = 1;
-
-  /* Place pcb in kernel memory */
-  memcpy((void *)(EIGHT_MB - 1*0x2000), &pcb, sizeof(pcb));
+  place_test_pcb(&stdin_table_1, &stdout_table_1);
   unsigned char read_buf[128];
 
  	read(0,read_buf,128);
@@ -1441,18 +1407,7 @@ void read_write(){
  * 		FILES: syscalls.c
  * */
 void fd_file_read_test(){
-  pcb_t pcb;
-  pcb.fdt[0].jump_ptr = &stdin_table_1;
-  pcb.fdt[1].jump_ptr = &stdout_table_1;
-  pcb.fdt[0].flags = 1;
-  pcb.fdt[1].flags = 1;
-
-	int i;
-	for(i = 2; i < 8; i++){
-    pcb.fdt[i].flags = -1;
-  }
-  /* Place pcb in kernel memory */
-  memcpy((void *)(EIGHT_MB - 1*0x2000), &pcb, sizeof(pcb));
+  place_test_pcb(&stdin_table_1, &stdout_table_1);
 	printf("Reading frame1.txt\n");
   unsigned char read_buf[1000];
 	int fd = open((uint8_t*)"frame1.txt");
@@ -1471,18 +1426,7 @@ void fd_file_read_test(){
  *		FILES: syscalls.c
  */
 void fd_dir_read_test(){
-	pcb_t pcb;
-  pcb.fdt[0].jump_ptr = &stdin_table_1;
-  pcb.fdt[1].jump_ptr = &stdout_table_1;
-  pcb.fdt[0].flags = 1;
-  pcb.fdt[1].flags = 1;
-
-	int i;
-	for(i = 2; i < 8; i++){
-    pcb.fdt[i].flags = -1;
-  }
-  /* Place pcb in kernel memory */
-  memcpy((void *)(EIGHT_MB - 1*0x2000), &pcb, sizeof(pcb));
+	place_test_pcb(&stdin_table_1, &stdout_table_1);
 	uint8_t buf[33];
   int32_t cnt;
   uint8_t dirName[]={'.'};
@@ -1497,68 +1441,50 @@ void fd_dir_read_test(){
 
 /*
  * rtc_system_call_test
- *		ASSERTS: RTC jump tables work
+ *		ASSERTS: RTC jump tables work, and write only takes the supported rates.
+ *		         Reading is left out, since it sleeps and there is no process to wake
  *		INPUTS: none
  *    OUTPUTS: PASS or FAIL
  *		SIDE EFFECTS: Sets the rtc rate
  *		COVERAGE: Opening an RTC file type
  *		FILES: syscalls.c
  */
-void rtc_system_call_test(){
+int rtc_system_call_test(){
 	TEST_HEADER;
 
-	pcb_t pcb;
-  pcb.fdt[0].jump_ptr = &stdin_table_1;
-  pcb.fdt[1].jump_ptr = &stdout_table_1;
-  pcb.fdt[0].flags = 1;
-  pcb.fdt[1].flags = 1;
-
-	int i;
-	for(i = 2; i < 8; i++){
-    pcb.fdt[i].flags = -1;
-  }
-	memcpy((void *)(EIGHT_MB - 1*0x2000), &pcb, sizeof(pcb));
+	place_test_pcb(&stdin_table_1, &stdout_table_1);
 
+	int result = PASS;
 	int fd;
 	int32_t buf[1] = {64};
-	int count;
 
-	printf("Opening RTC\n");
 	if(-1 == (fd = open((uint8_t*)"rtc"))){
-		TEST_OUTPUT("rtc open failure", FAIL);
-	}
-	rtc_test_flag = 1;
-	while(count < 1000000000){
-		count++;
+		return FAIL;
 	}
-	printf("\nWrite called: 64hz\n");
 	if(-1 == write(fd, buf, 4)){
-		TEST_OUTPUT("rtc write failure", FAIL);
+		result = FAIL;
 	}
-	count = 0;
-	while(count < 1000000000){
-		count++;
+	buf[0] = 3;
+	if(-1 != write(fd, buf, 4)){
+		result = FAIL;
 	}
-	printf("\n");
-	buf[0] = 1;
-	if(-1 == write(fd, buf, 4)){
-		TEST_OUTPUT("rtc write failure", FAIL);
+	buf[0] = 1024;
+	if(-1 != write(fd, buf, 2)){
+		result = FAIL;
 	}
-	rtc_test_flag = 0;
-	rtc_read_test_flag = 1;
-	if(-1 == read(fd, buf, 4)){
-		TEST_OUTPUT("rtc read failure", FAIL);
+	buf[0] = 2;
+	if(-1 == write(fd, buf, 4)){
+		result = FAIL;
 	}
-	rtc_read_test_flag = 0;
 	if(-1 == close(fd)){
-		TEST_OUTPUT("rtc close failure", FAIL);
+		result = FAIL;
 	}
-	TEST_OUTPUT("rtc_system_call_test", PASS);
+	return result;
 }
 
 /*
  * pcb_overflow
- *		ASSERTS: Can't add more than 6 file descriptors
+ *		ASSERTS: Can open more than the old limit of 6 file descriptors
  *		INPUTS: none
  *    OUTPUTS: PASS or FAIL
  *		SIDE EFFECTS: Sets file descriptors to in use
@@ -1568,17 +1494,7 @@ void rtc_system_call_test(){
 void pcb_overflow(){
 	TEST_HEADER;
 
-	pcb_t pcb;
-  pcb.fdt[0].jump_ptr = &stdin_table_1;
-  pcb.fdt[1].jump_ptr = &stdout_table_1;
-  pcb.fdt[0].flags = 1;
-  pcb.fdt[1].flags = 1;
-
-	int i;
-	for(i = 2; i < 8; i++){
-    pcb.fdt[i].flags = -1;
-  }
-	memcpy((void *)(EIGHT_MB - 1*0x2000), &pcb, sizeof(pcb));
+	place_test_pcb(&stdin_table_1, &stdout_table_1);
 
 	if(-1 == open((uint8_t*)"rtc")){
 		TEST_OUTPUT("Opening file 1", FAIL);
@@ -1638,11 +1554,12 @@ void pcb_overflow(){
 * Side Effects- None
 */
 void vidmap_test_1(void){
+	place_test_pcb(NULL, NULL);
 	int ret_val=vidmap((uint8_t**)USER_PROG-0x1000);
 	if(ret_val==-1){
-		TEST_OUTPUT("vidmap test 1",PASS);
+		TEST_OUTPUT("vidmap_test_1",PASS);
 	} else{
-		TEST_OUTPUT("vidmap test 1",FAIL);
+		TEST_OUTPUT("vidmap_test_1",FAIL);
 	}
 }
 
@@ -1654,11 +1571,12 @@ void vidmap_test_1(void){
 * Side Effects- None
 */
 void vidmap_test_2(void){
+	place_test_pcb(NULL, NULL);
 	int ret_val= vidmap((uint8_t**)USER_PROG+FOUR_MB+1);
 	if(ret_val==-1){
-		TEST_OUTPUT("vidmap test 2",PASS);
+		TEST_OUTPUT("vidmap_test_2",PASS);
 	} else{
-		TEST_OUTPUT("vidmap test 2",FAIL);
+		TEST_OUTPUT("vidmap_test_2",FAIL);
 	}
 }
 /*
@@ -1670,104 +1588,2248 @@ void vidmap_test_2(void){
 */
 
 void getargs_test_1(void){
+	place_test_pcb(NULL, NULL);
 	int ret_val=getargs(NULL,69);
 	if(ret_val==-1){
-		TEST_OUTPUT("getargs test 1",PASS);
+		TEST_OUTPUT("getargs_test_1",PASS);
 	} else{
-		TEST_OUTPUT("getargs test 1",FAIL);
+		TEST_OUTPUT("getargs_test_1",FAIL);
 	}
 }
 
 
 /* Checkpoint 5 tests */
 
+/* Buffers for file comparison tests, too large for the kernel stack */
+static uint8_t whole_buf[40000];
+static uint8_t chunk_buf[40000];
 
-/* Test suite entry point */
-void launch_tests(){
-	// TEST_OUTPUT("idt_test", idt_test());
-	// launch your tests here
-  // TEST_OUTPUT("idt_test2", idt_test_2());
-  // TEST_OUTPUT("idt_test3", idt_test_3());
-	// page_fault_test0();
-	// page_fault_test1();
-	// page_fault_test2();
-	// page_fault_test3();
-	// page_fault_test4();
-	// page_fault_test5();
-	// page_fault_test6();
-  // divide_zero_test();
-  // TEST_OUTPUT("page_directory_test", page_directory_test());
-  // TEST_OUTPUT("page_table_test", page_table_test());
+/* Images built by tests and loaded in place of the real one */
+#define TEST_IMG_BLOCKS 13
+static uint8_t test_img[TEST_IMG_BLOCKS * FS_BLOCK_SIZE] __attribute__((aligned(FS_BLOCK_SIZE)));
 
-	/* Checkpoint 2 tests */
-	//buffer_write();
-	// file_index_test(0);
-	// file_index_test(1);
-	// dir_read_test();
-  //uint8_t name[] = "frame0.txt";
-	//read_file_test(name);
-	//uint8_t name[] = "frame1.txt";
-	//read_file_test(name);
-	//uint8_t name[] = "verylargetextwithverylongname.tx";
-	//read_file_test(name);
-	//uint8_t name[] = "cat";
-	//read_file_test(name);
-	//uint8_t name[] = "fish";
-	//read_file_test(name);
-	//uint8_t name[] = "counter";
-	//read_file_test(name);
-	//uint8_t name[] = "grep";
-	//read_file_test(name);
-	//uint8_t name[] = "hello";
-	//read_file_test(name);
-	//uint8_t name[] = "ls";
-	//read_file_test(name);
-	//uint8_t name[] = "pingpong";
-	//read_file_test(name);
-	//uint8_t name[] = "shell";
-	//read_file_test(name);
-	//uint8_t name[] = "sigtest";
-	//read_file_test(name);
-	//uint8_t name[] = "syserr";
-	//read_file_test(name);
-	//uint8_t name[] = "testprint";
-	//read_file_test(name);
-	//rtc_write_test();
-	// rtc_read_test();
-	//rtc_open_test();
-	//fread_fail_test();
-	//dread_fail_test();
-	//read_test();
+/* The indirect image has one file, whose block i is data block i % PATTERN_BLOCKS.
+ * It ends two blocks into the second table under the double indirect block */
+#define PATTERN_BLOCKS 7
+#define INDIRECT_FILE_BLOCKS (DIRECT_BLOCK_NUM + 2 * PTRS_PER_BLOCK + 2)
+#define INDIRECT_FILE_SIZE (INDIRECT_FILE_BLOCKS * FS_BLOCK_SIZE - 100)
 
-	/* checkpoint 3 tests */
-	/*
-	open_null_test();
-	open_test_fail();
-	execute_fail_test();
-	execute_fail_test_2();
-	read_test_fail_1();
-	read_test_fail_2();
-	read_test_fail_3();
-	read_test_fail_4();
-	read_test_fail_5();
-	write_test_fail_1();
-	write_test_fail_2();
-	write_test_fail_2();
-	write_test_fail_3();
-	write_test_fail_4();
-	write_test_fail_5();
-	write_test_fail_6();
-	close_fail_1();
-	close_fail_2();
-	close_fail_3();
-	close_fail_4();
-	close_fail_5(); */
-	// fd_file_read_test();
-	// fd_dir_read_test();
-	// rtc_system_call_test();
-	// pcb_overflow();
+/*
+ * flush_tlb
+ *    DESCRIPTION: Reloads cr3, as switch_process does
+ *    INPUTS: none
+ *    OUTPUTS: none
+ *    RETURN VALUE: none
+ *    SIDE EFFECTS: Flushes the TLB
+ */
+static void flush_tlb(void){
+	asm volatile ("      \n\
+     movl %%cr3, %%eax \n\
+     movl %%eax, %%cr3"
+     :
+     :
+     : "eax", "memory"
+	);
+}
 
-	vidmap_test_1();
-	vidmap_test_2();
-	getargs_test_1();
+/*
+ * load_image
+ *    DESCRIPTION: Loads a file system image in place of the current one
+ *    INPUTS: uint32_t start - physical address of the image
+ *            uint32_t end - physical address of its end
+ *    OUTPUTS: none
+ *    RETURN VALUE: none
+ *    SIDE EFFECTS: Empties the overlay, so tests that load an image run
+ *                  before the ones that write
+ */
+static void load_image(uint32_t start, uint32_t end){
+	file_system_init((uint32_t*)start, end);
+	flush_tlb();
+}
+
+/*
+ * indirect_byte
+ *    DESCRIPTION: Gives what the indirect image's file holds at an offset
+ *    INPUTS: uint32_t offset - offset in the file
+ *    OUTPUTS: none
+ *    RETURN VALUE: the byte there
+ *    SIDE EFFECTS: none
+ */
+static uint8_t indirect_byte(uint32_t offset){
+	return (uint8_t)((offset / FS_BLOCK_SIZE) % PATTERN_BLOCKS * 41 + offset % FS_BLOCK_SIZE);
+}
+
+/*
+ * build_indirect_image
+ *    DESCRIPTION: Builds an image with FS_FEATURE_INDIRECT set and one file,
+ *                 "big", that runs through the direct blocks, the single
+ *                 indirect block and two tables under the double indirect
+ *                 block. The data blocks are shared, so the image is small
+ *    INPUTS: none
+ *    OUTPUTS: none
+ *    RETURN VALUE: none
+ *    SIDE EFFECTS: Overwrites test_img
+ */
+static void build_indirect_image(void){
+	boot_block_t* boot = (boot_block_t*)test_img;
+	inode_t* inode = (inode_t*)(test_img + FS_BLOCK_SIZE);
+	uint8_t* data = test_img + 2 * FS_BLOCK_SIZE;
+	/* Data blocks 7 to 10 are the single indirect block, the double indirect
+	 * block, then the two second level tables. A lookup that runs past the
+	 * end of a table lands on the wrong kind of block */
+	uint32_t* single = (uint32_t*)(data + PATTERN_BLOCKS * FS_BLOCK_SIZE);
+	uint32_t* dbl = single + PTRS_PER_BLOCK;
+	uint32_t* second = dbl + PTRS_PER_BLOCK;
+	uint32_t i;
+
+	memset(test_img, 0, sizeof(test_img));
+	boot->num_dentries = 1;
+	boot->num_inodes = 1;
+	boot->num_dblocks = TEST_IMG_BLOCKS - 2;
+	boot->feature_flags = FS_FEATURE_INDIRECT;
+	memcpy(boot->dentries[0].file_name, "big", 3);
+	boot->dentries[0].file_type = FS_TYPE_FILE;
+	boot->dentries[0].inode_num = 0;
+
+	inode->length = INDIRECT_FILE_SIZE;
+	for(i = 0; i < DIRECT_BLOCK_NUM; i++){
+		inode->dblocks[i] = i % PATTERN_BLOCKS;
+	}
+	for(; i < DIRECT_BLOCK_NUM + PTRS_PER_BLOCK; i++){
+		single[i - DIRECT_BLOCK_NUM] = i % PATTERN_BLOCKS;
+	}
+	for(; i < INDIRECT_FILE_BLOCKS; i++){
+		second[i - DIRECT_BLOCK_NUM - PTRS_PER_BLOCK] = i % PATTERN_BLOCKS;
+	}
+	inode->dblocks[SINGLE_INDIRECT] = PATTERN_BLOCKS;
+	inode->dblocks[DOUBLE_INDIRECT] = PATTERN_BLOCKS + 1;
+	dbl[0] = PATTERN_BLOCKS + 2;
+	dbl[1] = PATTERN_BLOCKS + 3;
+
+	for(i = 0; i < PATTERN_BLOCKS * FS_BLOCK_SIZE; i++){
+		data[i] = indirect_byte(i);
+	}
+}
+
+/*
+ * read_data_chunk_test
+ *		ASSERTS: reading a file in odd sized pieces matches reading it all at once
+ *		INPUTS: None
+ *    OUTPUTS: PASS/FAIL
+ *		SIDE EFFECTS: None
+ *		COVERAGE: read_data block lookups across block boundaries
+ *		FILES: file_system.c
+ */
+int read_data_chunk_test(){
+	TEST_HEADER;
+
+	dentry_t dentry;
+	int32_t size, cnt;
+	uint32_t offset = 0;
+	int i;
+
+	if(read_dentry_by_name((uint8_t*)"fish", &dentry) == -1){
+		return FAIL;
+	}
+	size = read_data(dentry.inode_num, 0, whole_buf, sizeof(whole_buf));
+
+	/* 1000 bytes at a time lands mid-block on most reads */
+	while((cnt = read_data(dentry.inode_num, offset, chunk_buf + offset, 1000)) > 0){
+		offset += cnt;
+	}
+	if(cnt == -1 || offset != size){
+		return FAIL;
+	}
+	for(i = 0; i < size; i++){
+		if(whole_buf[i] != chunk_buf[i]){
+			return FAIL;
+		}
+	}
+
+	/* Reading past the end of the file gives nothing */
+	if(read_data(dentry.inode_num, size, chunk_buf, 1) != 0){
+		return FAIL;
+	}
+	return PASS;
+}
+
+/*
+ * read_data_aligned_test
+ *		ASSERTS: whole-block reads match reading the file all at once
+ *		INPUTS: None
+ *    OUTPUTS: PASS/FAIL
+ *		SIDE EFFECTS: None
+ *		COVERAGE: read_data block coalescing and the aligned copy path
+ *		FILES: file_system.c
+ */
+int read_data_aligned_test(){
+	TEST_HEADER;
+
+	dentry_t dentry;
+	int32_t size, cnt;
+	uint32_t offset = 0;
+	int i;
+
+	if(read_dentry_by_name((uint8_t*)"fish", &dentry) == -1){
+		return FAIL;
+	}
+	size = read_data(dentry.inode_num, 0, whole_buf, sizeof(whole_buf));
+
+	/* Two blocks per read, starting on block boundaries */
+	while((cnt = read_data(dentry.inode_num, offset, chunk_buf + offset, 2 * FS_BLOCK_SIZE)) > 0){
+		offset += cnt;
+	}
+	if(cnt == -1 || offset != size){
+		return FAIL;
+	}
+	for(i = 0; i < size; i++){
+		if(whole_buf[i] != chunk_buf[i]){
+			return FAIL;
+		}
+	}
+	return PASS;
+}
+
+/*
+ * read_data_indirect_test
+ *		ASSERTS: reads across the direct, single indirect and double indirect
+ *		         blocks of an image with FS_FEATURE_INDIRECT match the data,
+ *		         read whole or in odd sized pieces
+ *		INPUTS: None
+ *    OUTPUTS: PASS/FAIL
+ *		SIDE EFFECTS: Loads a built image, then the real one again with an empty overlay
+ *		COVERAGE: get_block_run indirect lookups, read_data runs ending at a table
+ *		FILES: file_system.c
+ */
+int read_data_indirect_test(){
+	TEST_HEADER;
+
+	/* Windows around where each table starts, and the end of the file */
+	uint32_t edges[] = {DIRECT_BLOCK_NUM, DIRECT_BLOCK_NUM + PTRS_PER_BLOCK,
+	                    DIRECT_BLOCK_NUM + 2 * PTRS_PER_BLOCK, INDIRECT_FILE_BLOCKS};
+	uint32_t start = fs_image_start, end = fs_image_end;
+	uint32_t base, offset, expected, e, i;
+	dentry_t dentry;
+	int32_t size, cnt = 0;
+	int result = PASS;
+
+	build_indirect_image();
+	load_image((uint32_t)test_img, (uint32_t)test_img + sizeof(test_img));
+
+	if(read_dentry_by_name((uint8_t*)"big", &dentry) == -1){
+		result = FAIL;
+	}
+	for(e = 0; result == PASS && e < sizeof(edges) / sizeof(edges[0]); e++){
+		base = edges[e] * FS_BLOCK_SIZE - sizeof(whole_buf) / 2;
+		expected = INDIRECT_FILE_SIZE - base < sizeof(whole_buf) ? INDIRECT_FILE_SIZE - base : sizeof(whole_buf);
+		size = read_data(dentry.inode_num, base, whole_buf, sizeof(whole_buf));
+
+		/* 1000 bytes at a time lands mid-block on most reads */
+		for(offset = 0; offset < expected; offset += cnt){
+			if((cnt = read_data(dentry.inode_num, base + offset, chunk_buf + offset, 1000)) <= 0){
+				break;
+			}
+		}
+		if(size != expected || offset != expected){
+			result = FAIL;
+		}
+		for(i = 0; result == PASS && i < expected; i++){
+			if(whole_buf[i] != indirect_byte(base + i) || chunk_buf[i] != whole_buf[i]){
+				result = FAIL;
+			}
+		}
+	}
+
+	/* Reading past the end of the file gives nothing */
+	if(result == PASS && read_data(dentry.inode_num, INDIRECT_FILE_SIZE, chunk_buf, 1) != 0){
+		result = FAIL;
+	}
+
+	load_image(start, end);
+	return result;
+}
+
+/* Names for the sorted image, "." first then the rest in strncmp order */
+static int8_t* sorted_names[] = {".", "cat", "counter", "fish", "frame0.txt", "frame1.txt", "grep", "hello",
+                                 "ls", "pingpong", "rtc", "shell", "sigtest", "syserr", "testprint",
+                                 "verylargetextwithverylongname.tx"};
+
+/*
+ * build_sorted_image
+ *    DESCRIPTION: Builds an image with FS_FEATURE_SORTED set and a dentry for
+ *                 each of sorted_names, as mkfs391 lays them out
+ *    INPUTS: none
+ *    OUTPUTS: none
+ *    RETURN VALUE: none
+ *    SIDE EFFECTS: Overwrites test_img
+ */
+static void build_sorted_image(void){
+	boot_block_t* boot = (boot_block_t*)test_img;
+	uint32_t i;
+
+	memset(test_img, 0, sizeof(test_img));
+	boot->num_dentries = sizeof(sorted_names) / sizeof(sorted_names[0]);
+	boot->feature_flags = FS_FEATURE_SORTED;
+	for(i = 0; i < boot->num_dentries; i++){
+		strncpy((int8_t*)boot->dentries[i].file_name, sorted_names[i], NAME_LENGTH);
+		boot->dentries[i].file_type = i == 0 ? FS_TYPE_DIR : FS_TYPE_FILE;
+	}
+}
+
+/*
+ * find_every_dentry
+ *    DESCRIPTION: Looks up every dentry of the loaded image by name, and a
+ *                 few names that aren't there
+ *    INPUTS: none
+ *    OUTPUTS: none
+ *    RETURN VALUE: PASS/FAIL
+ *    SIDE EFFECTS: none
+ */
+static int find_every_dentry(void){
+	dentry_t dentry;
+	dentry_t* found;
+	uint8_t name[NAME_LENGTH + 1];
+	int i;
+
+	for(i = 0; read_dentry_by_index(i, &dentry) == 0; i++){
+		memcpy(name, dentry.file_name, NAME_LENGTH);
+		name[NAME_LENGTH] = '\0';
+		found = find_dentry(name);
+		if(found == NULL || strncmp((int8_t*)found->file_name, (int8_t*)dentry.file_name, NAME_LENGTH) != 0){
+			return FAIL;
+		}
+	}
+
+	/* Prefixes, extensions and overlong names must miss */
+	if(find_dentry((uint8_t*)"") != NULL || find_dentry((uint8_t*)"fis") != NULL ||
+	   find_dentry((uint8_t*)"fishh") != NULL || find_dentry((uint8_t*)"verylargetextwithverylongname.txt") != NULL){
+		return FAIL;
+	}
+	return PASS;
+}
+
+/* find_dentry_test
+ *
+ * Looks up every dentry by name and a few names that aren't there, in the
+ * real image and in a built image with FS_FEATURE_SORTED set
+ * Inputs: None
+ * Outputs: PASS/FAIL
+ * Side Effects: Loads a built image, then the real one again with an empty overlay
+ * Coverage: find_dentry, linear and sorted
+ * Files: file_system.c/h
+ */
+int find_dentry_test(){
+	TEST_HEADER;
+
+	uint32_t start = fs_image_start, end = fs_image_end;
+	int result;
+
+	if(find_every_dentry() == FAIL){
+		return FAIL;
+	}
+
+	/* The binary search also has to miss names before the first and after the last */
+	build_sorted_image();
+	load_image((uint32_t)test_img, (uint32_t)test_img + sizeof(test_img));
+	result = find_every_dentry();
+	if(find_dentry((uint8_t*)"a") != NULL || find_dentry((uint8_t*)"zz") != NULL || find_dentry((uint8_t*)"rt") != NULL){
+		result = FAIL;
+	}
+	load_image(start, end);
+	return result;
+}
+
+/* "big" in the image tools/Makefile's bigimage target builds holds the
+ * numbers below BIG_LINES, one per BIG_LINE byte line with six digits */
+#define BIG_LINES 1000000
+#define BIG_LINE  7
+
+/*
+ * big_byte
+ *    DESCRIPTION: Gives what "big" holds at an offset
+ *    INPUTS: uint32_t offset - offset in the file
+ *    OUTPUTS: none
+ *    RETURN VALUE: the byte there
+ *    SIDE EFFECTS: none
+ */
+static uint8_t big_byte(uint32_t offset){
+	static const uint32_t place[BIG_LINE - 1] = {100000, 10000, 1000, 100, 10, 1};
+	uint32_t line = offset / BIG_LINE, col = offset % BIG_LINE;
+
+	return col == BIG_LINE - 1 ? '\n' : '0' + line / place[col] % 10;
+}
+
+/* large_image_test
+ *
+ * Checks that the image was copied past the process, overlay and pool
+ * memory, and when booted with the bigimage image, reads all of "big" back
+ * Inputs: None
+ * Outputs: PASS/FAIL
+ * Side Effects: None
+ * Coverage: move_fs_image, file_system_init, read_data past 4MB of image
+ * Files: kernel.c, boot.S, file_system.c/h
+ */
+int large_image_test(){
+	TEST_HEADER;
+
+	dentry_t dentry;
+	uint32_t offset, i;
+	int32_t got;
+
+	if(fs_image_start < FS_IMAGE_PHYS){
+		return FAIL;
+	}
+
+	/* Only the large image has the file */
+	if(read_dentry_by_name((uint8_t*)"big", &dentry) == -1){
+		return PASS;
+	}
+	if(fs_image_end - fs_image_start <= FOUR_MB){
+		return FAIL;
+	}
+
+	for(offset = 0; (got = read_data(dentry.inode_num, offset, whole_buf, sizeof(whole_buf))) > 0; offset += got){
+		for(i = 0; i < got; i++){
+			if(whole_buf[i] != big_byte(offset + i)){
+				return FAIL;
+			}
+		}
+	}
+	return (got == 0 && offset == BIG_LINES * BIG_LINE) ? PASS : FAIL;
+}
+
+/* fs_overlay_write_test
+ *
+ * Creates a file, writes it through the syscalls, and overwrites part of a
+ * file from the image
+ * Inputs: None
+ * Outputs: PASS/FAIL
+ * Side Effects: Adds "wtest" to the file system
+ * Coverage: dir_write, file_write, copy on write of image blocks
+ * Files: file_system.c/h, syscalls.c
+ */
+int fs_overlay_write_test(){
+	TEST_HEADER;
+
+	dentry_t dentry;
+	int32_t fd, size, i;
+	int result = PASS;
+
+	place_test_pcb(NULL, NULL);
+
+	/* Create the file by writing its name to the directory */
+	if((fd = open((uint8_t*)".")) == -1 || write(fd, "wtest", 5) != 0 || write(fd, "wtest", 5) != -1){
+		return FAIL;
+	}
+	close(fd);
+
+	for(i = 0; i < 10000; i++){
+		whole_buf[i] = (uint8_t)(i * 7);
+	}
+	if((fd = open((uint8_t*)"wtest")) == -1 || write(fd, whole_buf, 10000) != 10000){
+		return FAIL;
+	}
+	close(fd);
+	if((fd = open((uint8_t*)"wtest")) == -1 || read(fd, chunk_buf, 20000) != 10000){
+		return FAIL;
+	}
+	close(fd);
+	for(i = 0; i < 10000; i++){
+		if(whole_buf[i] != chunk_buf[i]){
+			return FAIL;
+		}
+	}
+
+	/* Overwrite the start of an image file, then put the original bytes back */
+	if(read_dentry_by_name((uint8_t*)"frame0.txt", &dentry) == -1){
+		return FAIL;
+	}
+	size = read_data(dentry.inode_num, 0, whole_buf, sizeof(whole_buf));
+	if((fd = open((uint8_t*)"frame0.txt")) == -1 || write(fd, "XXXXX", 5) != 5){
+		return FAIL;
+	}
+	if(read_data(dentry.inode_num, 0, chunk_buf, sizeof(chunk_buf)) != size || strncmp((int8_t*)chunk_buf, "XXXXX", 5) != 0 ||
+	   strncmp((int8_t*)chunk_buf + 5, (int8_t*)whole_buf + 5, size - 5) != 0){
+		result = FAIL;
+	}
+	close(fd);
+	if((fd = open((uint8_t*)"frame0.txt")) == -1 || write(fd, whole_buf, 5) != 5){
+		return FAIL;
+	}
+	close(fd);
+	return result;
+}
+
+/* fs_append_throughput_test
+ *
+ * Times small and block sized appends against memcpy of the same data,
+ * failing if appending is more than APPEND_SLOWDOWN or BULK_SLOWDOWN times
+ * slower
+ * Inputs: None
+ * Outputs: PASS/FAIL, prints cycles per KB for both
+ * Side Effects: Adds "wbench" and "wbulk" to the file system
+ * Coverage: file_write append path
+ * Files: file_system.c/h, syscalls.c
+ */
+/* A 16 byte append pays for the fd lookup, the block lookup and two masked
+ * sections, a few times a 16 byte memcpy. Copying the block on each append
+ * would be hundreds of times slower */
+#define APPEND_SLOWDOWN 8
+/* Whole blocks are zeroed when they're allocated and then copied in */
+#define BULK_SLOWDOWN 3
+
+int fs_append_throughput_test(){
+	TEST_HEADER;
+
+	int32_t fd, i;
+	uint32_t start, append_cycles, memcpy_cycles;
+
+	place_test_pcb(NULL, NULL);
+
+	if((fd = open((uint8_t*)".")) == -1 || write(fd, "wbench", 6) != 0){
+		return FAIL;
+	}
+	close(fd);
+	if((fd = open((uint8_t*)"wbench")) == -1){
+		return FAIL;
+	}
+	for(i = 0; i < 32768; i++){
+		whole_buf[i] = (uint8_t)i;
+	}
+
+	/* 16 byte records, like a log */
+	start = rdtsc();
+	for(i = 0; i < 32768; i += 16){
+		if(write(fd, whole_buf + i, 16) != 16){
+			return FAIL;
+		}
+	}
+	append_cycles = rdtsc() - start;
+
+	start = rdtsc();
+	for(i = 0; i < 32768; i += 16){
+		memcpy(chunk_buf + i, whole_buf + i, 16);
+	}
+	memcpy_cycles = rdtsc() - start;
+	close(fd);
+
+	printf("append: %u cycles/KB, memcpy: %u cycles/KB\n", append_cycles / 32, memcpy_cycles / 32);
+	if(append_cycles / APPEND_SLOWDOWN > memcpy_cycles){
+		return FAIL;
+	}
+
+	if((fd = open((uint8_t*)"wbench")) == -1 || read(fd, chunk_buf, sizeof(chunk_buf)) != 32768){
+		return FAIL;
+	}
+	close(fd);
+	for(i = 0; i < 32768; i++){
+		if(whole_buf[i] != chunk_buf[i]){
+			return FAIL;
+		}
+	}
+
+	if((fd = open((uint8_t*)".")) == -1 || write(fd, "wbulk", 5) != 0){
+		return FAIL;
+	}
+	close(fd);
+	if((fd = open((uint8_t*)"wbulk")) == -1){
+		return FAIL;
+	}
+
+	/* A block at a time, the copy should be most of the cost */
+	start = rdtsc();
+	for(i = 0; i < 32768; i += FS_BLOCK_SIZE){
+		if(write(fd, whole_buf + i, FS_BLOCK_SIZE) != FS_BLOCK_SIZE){
+			return FAIL;
+		}
+	}
+	append_cycles = rdtsc() - start;
+
+	start = rdtsc();
+	for(i = 0; i < 32768; i += FS_BLOCK_SIZE){
+		memcpy(chunk_buf + i, whole_buf + i, FS_BLOCK_SIZE);
+	}
+	memcpy_cycles = rdtsc() - start;
+	close(fd);
+
+	printf("bulk append: %u cycles/KB, memcpy: %u cycles/KB\n", append_cycles / 32, memcpy_cycles / 32);
+	if(append_cycles / BULK_SLOWDOWN > memcpy_cycles){
+		return FAIL;
+	}
+	return PASS;
+}
+
+/* lseek_pread_pwrite_test
+ *
+ * Seeks around a file and uses positional reads and writes
+ * Inputs: None
+ * Outputs: PASS/FAIL
+ * Side Effects: Changes "wtest"
+ * Coverage: lseek, pread, pwrite
+ * Files: file_system.c/h, syscalls.c
+ */
+int lseek_pread_pwrite_test(){
+	TEST_HEADER;
+
+	dentry_t dentry;
+	int32_t fd, size;
+	uint8_t byte;
+
+	place_test_pcb(NULL, NULL);
+
+	if(read_dentry_by_name((uint8_t*)"fish", &dentry) == -1 || (fd = open((uint8_t*)"fish")) == -1){
+		return FAIL;
+	}
+	size = read_data(dentry.inode_num, 0, whole_buf, sizeof(whole_buf));
+
+	/* Positional reads leave the position alone */
+	if(pread(fd, chunk_buf, 100, 20000) != 100 || lseek(fd, 0, SEEK_CUR) != 0 ||
+	   strncmp((int8_t*)chunk_buf, (int8_t*)whole_buf + 20000, 100) != 0){
+		return FAIL;
+	}
+
+	/* Seek from each end and read one byte */
+	if(lseek(fd, -1, SEEK_END) != size - 1 || read(fd, &byte, 1) != 1 || byte != whole_buf[size - 1] ||
+	   lseek(fd, 5000, SEEK_SET) != 5000 || lseek(fd, 10, SEEK_CUR) != 5010 || read(fd, &byte, 1) != 1 || byte != whole_buf[5010] ||
+	   lseek(fd, -1, SEEK_SET) != -1 || lseek(fd, 0, 3) != -1){
+		return FAIL;
+	}
+	close(fd);
+
+	/* Positional writes, including one past the end */
+	if((fd = open((uint8_t*)"wtest")) == -1 || pwrite(fd, "abc", 3, 100) != 3 || pwrite(fd, "end", 3, 12000) != 3 ||
+	   lseek(fd, 0, SEEK_CUR) != 0 || lseek(fd, 0, SEEK_END) != 12003 || pread(fd, chunk_buf, 3, 100) != 3 ||
+	   strncmp((int8_t*)chunk_buf, "abc", 3) != 0 || pread(fd, chunk_buf, 10, 11995) != 8 || chunk_buf[0] != 0 ||
+	   strncmp((int8_t*)chunk_buf + 5, "end", 3) != 0){
+		return FAIL;
+	}
+	close(fd);
+
+	/* Only files can seek */
+	if((fd = open((uint8_t*)".")) == -1 || lseek(fd, 0, SEEK_SET) != -1 || pread(fd, chunk_buf, 1, 0) != -1){
+		return FAIL;
+	}
+	close(fd);
+	return PASS;
+}
+
+/* getdents_test
+ *
+ * Reads the directory a few entries at a time and checks them against the
+ * dentries
+ * Inputs: None
+ * Outputs: PASS/FAIL
+ * Side Effects: None
+ * Coverage: getdents
+ * Files: file_system.c/h, syscalls.c
+ */
+int getdents_test(){
+	TEST_HEADER;
+
+	dentry_t dentry;
+	dirent_t* dirents = (dirent_t*)chunk_buf;
+	int32_t fd, cnt, i, total = 0;
+
+	place_test_pcb(NULL, NULL);
+
+	if((fd = open((uint8_t*)".")) == -1 || getdents(fd, dirents, sizeof(dirent_t) - 1) != -1){
+		return FAIL;
+	}
+
+	/* Ten entries per call, the last call gets the rest */
+	while((cnt = getdents(fd, dirents, 10 * sizeof(dirent_t))) > 0){
+		if(cnt % sizeof(dirent_t) != 0){
+			return FAIL;
+		}
+		for(i = 0; i < cnt / (int32_t)sizeof(dirent_t); i++, total++){
+			if(read_dentry_by_index(total, &dentry) == -1 || strncmp((int8_t*)dirents[i].name, (int8_t*)dentry.file_name, NAME_LENGTH) != 0 ||
+			   dirents[i].type != dentry.file_type ||
+			   (dentry.file_type == FS_TYPE_FILE && dirents[i].size <= sizeof(whole_buf) && read_data(dentry.inode_num, 0, whole_buf, sizeof(whole_buf)) != (int32_t)dirents[i].size)){
+				return FAIL;
+			}
+		}
+	}
+	close(fd);
+	if(cnt != 0 || read_dentry_by_index(total, &dentry) != -1){
+		return FAIL;
+	}
+
+	/* Files don't have entries */
+	if((fd = open((uint8_t*)"fish")) == -1 || getdents(fd, dirents, sizeof(chunk_buf)) != -1){
+		return FAIL;
+	}
+	close(fd);
+	return PASS;
+}
+
+/* fd_table_grow_test
+ *
+ * Fills the descriptor table, then checks that freed descriptors are reused
+ * lowest first and that the table's pages go back to the pool
+ * Inputs: None
+ * Outputs: PASS/FAIL
+ * Side Effects: None
+ * Coverage: alloc_fd, get_fd, free_fds
+ * Files: syscalls.c/h, paging.c/h
+ */
+int fd_table_grow_test(){
+	TEST_HEADER;
+
+	int32_t fd, expect;
+	uint32_t free_pages;
+
+	place_test_pcb(NULL, NULL);
+	free_pages = free_page_count();
+
+	/* Every descriptor past stdin and stdout, in order */
+	for(expect = 2; (fd = open((uint8_t*)"frame0.txt")) != -1; expect++){
+		if(fd != expect){
+			return FAIL;
+		}
+	}
+	if(expect != MAX_FD_NUM + 1 || free_page_count() != free_pages - (FD_PAGES - 1)){
+		return FAIL;
+	}
+
+	/* Lowest free descriptor comes back first */
+	if(close(700) != 0 || close(300) != 0 || close(300) != -1 || read(300, &fd, 1) != -1 ||
+	   open((uint8_t*)"frame0.txt") != 300 || open((uint8_t*)"frame0.txt") != 700){
+		return FAIL;
+	}
+
+	/* A new table is back to one page */
+	place_test_pcb(NULL, NULL);
+	if(free_page_count() != free_pages){
+		return FAIL;
+	}
+	return PASS;
+}
+
+/* pipe_test
+ *
+ * Sends data through a pipe in one process, checks the end of data and
+ * writes with no reader and that each end's turn is handed back, then
+ * times the ring in MB/s
+ * Inputs: None
+ * Outputs: PASS/FAIL, prints the pipe's throughput
+ * Side Effects: None
+ * Coverage: pipe, pipe_read, pipe_write, pipe_read_close, pipe_write_close
+ * Files: pipe.c/h, syscalls.c/h
+ */
+int pipe_test(){
+	TEST_HEADER;
+
+	int32_t fds[2], i, j;
+	uint32_t free_pages, start, ticks, bytes = 0;
+
+	place_test_pcb(NULL, NULL);
+	free_pages = free_page_count();
+	for(i = 0; i < PIPE_SIZE; i++){
+		whole_buf[i] = (uint8_t)(i * 7);
+	}
+
+	/* Odd sizes so the ring wraps in the middle of a copy */
+	if(pipe(fds) != 0 || write(fds[0], whole_buf, 1) != -1 || read(fds[1], chunk_buf, 1) != -1){
+		return FAIL;
+	}
+	for(i = 0; i < 8; i++){
+		if(write(fds[1], whole_buf, 3000) != 3000 || read(fds[0], chunk_buf, PIPE_SIZE) != 3000){
+			return FAIL;
+		}
+		for(j = 0; j < 3000; j++){
+			if(whole_buf[j] != chunk_buf[j]){
+				return FAIL;
+			}
+		}
+	}
+
+	/* Each end is free for the next reader or writer */
+	if(((pipe_t*)get_fd(fds[0])->inode)->reading || ((pipe_t*)get_fd(fds[1])->inode)->writing){
+		return FAIL;
+	}
+
+	/* What's left is read after the writer closes, then the end of data */
+	if(write(fds[1], whole_buf, 100) != 100 || close(fds[1]) != 0 ||
+	   read(fds[0], chunk_buf, PIPE_SIZE) != 100 || read(fds[0], chunk_buf, PIPE_SIZE) != 0){
+		return FAIL;
+	}
+	close(fds[0]);
+
+	/* Nobody to read it, and the failed write hands its turn back */
+	if(pipe(fds) != 0 || close(fds[0]) != 0 || write(fds[1], whole_buf, 1) != -1 ||
+	   ((pipe_t*)get_fd(fds[1])->inode)->writing){
+		return FAIL;
+	}
+	close(fds[1]);
+
+	/* Full ring each way, for half a second of PIT ticks */
+	if(pipe(fds) != 0){
+		return FAIL;
+	}
+	start = pit_ticks;
+	while((ticks = pit_ticks - start) < PIT_HZ / 2 && bytes < 0x40000000){
+		if(write(fds[1], whole_buf, PIPE_SIZE) != PIPE_SIZE || read(fds[0], chunk_buf, PIPE_SIZE) != PIPE_SIZE){
+			return FAIL;
+		}
+		bytes += PIPE_SIZE;
+	}
+	close(fds[0]);
+	close(fds[1]);
+	if(ticks != 0){
+		printf("pipe: %u MB/s\n", bytes / ticks * PIT_HZ / (1024 * 1024));
+	}
+
+	/* Both pipes' rings are back in the pool */
+	if(free_page_count() != free_pages){
+		return FAIL;
+	}
+	return PASS;
+}
+
+/* shm_test
+ *
+ * Attaches one segment at two addresses and checks that both see the same
+ * frames, then that halting's cleanup gives every page back
+ * Inputs: None
+ * Outputs: PASS/FAIL
+ * Side Effects: None
+ * Coverage: shm_create, shm_attach, shm_detach, shm_exit
+ * Files: shm.c/h, paging.c/h
+ */
+int shm_test(){
+	TEST_HEADER;
+
+	uint32_t free_pages, i;
+	uint32_t *a, *b;
+	uint32_t chosen = SHM_BASE + 0x100000;
+
+	place_test_pcb(NULL, NULL);
+	free_pages = free_page_count();
+
+	/* 4 pages, a key can only be used once */
+	if(shm_create(0x391, 3 * PAGE_SIZE + 1) != 0 || shm_create(0x391, PAGE_SIZE) != -1 ||
+	   shm_create(0x392, 0) != -1 || shm_attach(0x393, NULL) != -1){
+		return FAIL;
+	}
+
+	/* Lowest free range, then a chosen one; bad or taken places fail */
+	if((a = (uint32_t*)shm_attach(0x391, NULL)) != (uint32_t*)SHM_BASE ||
+	   (b = (uint32_t*)shm_attach(0x391, (void*)chosen)) != (uint32_t*)chosen ||
+	   shm_attach(0x391, (void*)(chosen + 1)) != -1 || shm_attach(0x391, (void*)(SHM_BASE + PAGE_SIZE)) != -1 ||
+	   shm_attach(0x391, (void*)(SHM_BASE + SHM_WINDOW - PAGE_SIZE)) != -1){
+		return FAIL;
+	}
+
+	/* Same frames behind both */
+	for(i = 0; i < PAGE_SIZE; i++){
+		a[i] = i * 3;
+	}
+	for(i = 0; i < PAGE_SIZE; i++){
+		if(b[i] != i * 3){
+			return FAIL;
+		}
+	}
+
+	/* Still there after one detach */
+	if(shm_detach(a) != 0 || shm_detach(a) != -1 || b[PAGE_SIZE - 1] != (PAGE_SIZE - 1) * 3){
+		return FAIL;
+	}
+
+	/* Halt drops the rest, and a segment nothing attached */
+	if(shm_create(0x394, PAGE_SIZE) != 0){
+		return FAIL;
+	}
+	shm_exit();
+	if(free_page_count() != free_pages || shm_create(0x391, PAGE_SIZE) != 0){
+		return FAIL;
+	}
+	shm_exit();
+	return PASS;
+}
+
+/* Tracepoints record read_data calls only while on, and cost a few cycles while off
+ * Inputs: None
+ * Outputs: PASS/FAIL
+ * Side Effects: Prints the cycles per tracepoint on and off
+ * Coverage: trace_ctl, TRACE, read_data's tracepoints
+ * Files: trace.c/h, file_system.c
+ */
+int trace_test(){
+	TEST_HEADER;
+
+	dentry_t dentry;
+	trace_rec* rec;
+	uint32_t i, start, off_cycles, on_cycles;
+
+	if(read_dentry_by_name((uint8_t*)"frame0.txt", &dentry) == -1){
+		return FAIL;
+	}
+
+	/* On empties the ring, then a read is an enter and an exit */
+	if(trace_ctl(TRACE_CTL_ON, NULL, 0) != 0 || trace_log.head != 0 ||
+	   read_data(dentry.inode_num, 0, whole_buf, 10) != 10 || trace_log.head != 2){
+		trace_ctl(TRACE_CTL_OFF, NULL, 0);
+		return FAIL;
+	}
+	rec = trace_log.recs;
+	if(rec[0].event != TRACE_READ_DATA_ENTER || rec[0].arg != dentry.inode_num ||
+	   rec[1].event != TRACE_READ_DATA_EXIT || rec[1].arg != 10 || rec[1].pid != cur_pid ||
+	   (rec[1].tsc_hi == rec[0].tsc_hi && rec[1].tsc_lo < rec[0].tsc_lo)){
+		trace_ctl(TRACE_CTL_OFF, NULL, 0);
+		return FAIL;
+	}
+
+	/* The ring wraps onto the oldest slot */
+	for(i = 0; i < TRACE_RECORDS; i++){
+		TRACE(TRACE_HALT, i);
+	}
+	if(trace_log.head != TRACE_RECORDS + 2 || trace_log.recs[1].arg != TRACE_RECORDS - 1){
+		trace_ctl(TRACE_CTL_OFF, NULL, 0);
+		return FAIL;
+	}
+
+	start = rdtsc();
+	for(i = 0; i < TRACE_RECORDS; i++){
+		TRACE(TRACE_HALT, i);
+	}
+	on_cycles = (rdtsc() - start) / TRACE_RECORDS;
+
+	/* Nothing more once off, and kernel buffers can't be read into */
+	if(trace_ctl(TRACE_CTL_OFF, NULL, 0) != 0 || trace_ctl(TRACE_CTL_READ, whole_buf, sizeof(whole_buf)) != -1 ||
+	   trace_ctl(3, NULL, 0) != -1){
+		return FAIL;
+	}
+	i = trace_log.head;
+	read_data(dentry.inode_num, 0, whole_buf, 10);
+	if(trace_log.head != i){
+		return FAIL;
+	}
+
+	start = rdtsc();
+	for(i = 0; i < TRACE_RECORDS; i++){
+		TRACE(TRACE_HALT, i);
+	}
+	off_cycles = (rdtsc() - start) / TRACE_RECORDS;
+
+	printf("tracepoint: %d cycles on, %d off\n", on_cycles, off_cycles);
+	return PASS;
+}
+
+/* Threads take process slots and user stacks, and join returns their status
+ * Inputs: None
+ * Outputs: PASS/FAIL
+ * Side Effects: Maps the test process' program page, puts the process slots back
+ * Coverage: thread_create, thread_join, sched_new
+ * Files: syscalls.c/h, pit.c
+ */
+int thread_test(){
+	TEST_HEADER;
+
+	int32_t saved_slots[MAX_PROGS], saved_num = process_num;
+	int32_t i, tid, result = PASS;
+	pcb_t* pcb = get_pcb(1);
+	uint32_t *stack, *kstack;
+
+	place_test_pcb(NULL, NULL);
+	for(i = 0; i < MAX_PROGS; i++){
+		saved_slots[i] = process_array[i];
+		process_array[i] = -1;
+	}
+	process_array[0] = 1;
+	process_num = 1;
+	set_page_dir_entry(USER_PROG, EIGHT_MB);
+	asm volatile ("movl %%cr3, %%eax; movl %%eax, %%cr3" : : : "eax");
+
+	/* Only addresses in the program page */
+	if(thread_create(0, USER_PROG, 0) != -1 || thread_create(USER_PROG, USER_PROG + FOUR_MB, 0) != -1){
+		result = FAIL;
+	}
+
+	/* Every free slot, each thread on a stack further down with func and arg on it */
+	for(i = 1; result == PASS && i < MAX_PROGS; i++){
+		tid = thread_create(USER_PROG, USER_PROG + i, 0x391 + i);
+		stack = (uint32_t*)(USER_PROG + FOUR_MB - i * THREAD_STACK_SIZE) - 2;
+		kstack = (uint32_t*)get_pcb(tid)->current_esp;
+		if(tid != i + 1 || get_pcb(tid)->tgid != 1 || get_pcb(tid)->state != PROC_NEW || get_pcb(tid)->stack_slot != i ||
+		   stack[0] != USER_PROG + i || stack[1] != 0x391 + i || kstack[5] != USER_PROG || kstack[6] != (uint32_t)stack){
+			result = FAIL;
+		}
+	}
+	if(result == PASS && (thread_create(USER_PROG, USER_PROG, 0) != -1 || pcb->thread_stacks != (1 << MAX_PROGS) - 1)){
+		result = FAIL;
+	}
+
+	/* Not threads of this process */
+	if(result == PASS && (thread_join(1) != -1 || thread_join(0) != -1 || thread_join(MAX_PROGS + 1) != -1)){
+		result = FAIL;
+	}
+
+	/* Thread 3 ended with status 7, the way end_thread leaves it */
+	process_array[2] = -1;
+	process_num--;
+	pcb->thread_stacks &= ~(1 << 2);
+	pcb->exit_status[2] = 7;
+	pcb->exited |= 1 << 2;
+	if(result == PASS && (thread_join(3) != 7 || thread_join(3) != -1)){
+		result = FAIL;
+	}
+
+	/* Its slot and stack are used again */
+	if(result == PASS && (thread_create(USER_PROG, USER_PROG, 0) != 3 || get_pcb(3)->stack_slot != 2)){
+		result = FAIL;
+	}
+
+	for(i = 0; i < MAX_PROGS; i++){
+		process_array[i] = saved_slots[i];
+	}
+	process_num = saved_num;
+	pcb->thread_stacks = 1;
+	pcb->exited = 0;
+	return result;
+}
+
+/* spawn returns the new pid without running it, and wait collects its status
+ * Inputs: None
+ * Outputs: PASS/FAIL
+ * Side Effects: Maps the test process' program page, puts the process slots back
+ * Coverage: spawn, wait
+ * Files: syscalls.c/h
+ */
+int spawn_wait_test(){
+	TEST_HEADER;
+
+	int32_t saved_slots[MAX_PROGS], saved_num = process_num;
+	int32_t i, pid, result = PASS;
+	pcb_t* pcb = get_pcb(1);
+	int32_t* status = (int32_t*)(USER_PROG + FOUR_MB - THREAD_STACK_SIZE);
+
+	place_test_pcb(NULL, NULL);
+	for(i = 0; i < MAX_PROGS; i++){
+		saved_slots[i] = process_array[i];
+		process_array[i] = -1;
+	}
+	process_array[0] = 1;
+	process_num = 1;
+
+	/* Placed to run in the background, reporting to this process */
+	pid = spawn((uint8_t*)"ls");
+	if(pid != 2 || get_pcb(pid)->state != PROC_NEW || !get_pcb(pid)->background ||
+	   get_pcb(pid)->parent_pid != 1 || pcb->children != 1 << (pid - 1) || spawn((uint8_t*)"nosuchprogram") != -1){
+		result = FAIL;
+	}
+
+	set_page_dir_entry(USER_PROG, EIGHT_MB);
+	asm volatile ("movl %%cr3, %%eax; movl %%eax, %%cr3" : : : "eax");
+
+	/* Not a child, a kernel pointer, and still running */
+	if(result == PASS && (wait(3, NULL, 0) != -1 || wait(MAX_PROGS + 1, NULL, 0) != -1 ||
+	   wait(pid, (int32_t*)whole_buf, 0) != -1 || wait(-1, status, WAIT_NOHANG) != 0)){
+		result = FAIL;
+	}
+
+	/* It halted with 42, the way end_process leaves it */
+	pcb->child_status[pid - 1] = 42;
+	pcb->zombies |= 1 << (pid - 1);
+	*status = 0;
+	if(result == PASS && (wait(-1, status, 0) != pid || *status != 42 || wait(-1, NULL, WAIT_NOHANG) != -1)){
+		result = FAIL;
+	}
+
+	free_page(get_pcb(2)->fds.pages[0]);
+	for(i = 0; i < MAX_PROGS; i++){
+		process_array[i] = saved_slots[i];
+	}
+	process_num = saved_num;
+	pcb->children = 0;
+	pcb->zombies = 0;
+	return result;
+}
+
+/* poll_test
+ *
+ * Checks what poll reports for both ends of a pipe as it fills and its
+ * writer closes, for the screen and for descriptors that aren't open
+ * Inputs: None
+ * Outputs: PASS/FAIL
+ * Side Effects: None
+ * Coverage: poll, pipe_read_poll, pipe_write_poll
+ * Files: poll.c/h, pipe.c/h
+ */
+int poll_test(){
+	TEST_HEADER;
+
+	pollfd* pfds = (pollfd*)(USER_PROG + FOUR_MB - THREAD_STACK_SIZE);
+	int32_t fds[2];
+	pipe_t* pipe_ptr;
+
+	place_test_pcb(NULL, NULL);
+	set_page_dir_entry(USER_PROG, EIGHT_MB);
+	asm volatile ("movl %%cr3, %%eax; movl %%eax, %%cr3" : : : "eax");
+
+	if(pipe(fds) != 0){
+		return FAIL;
+	}
+	pipe_ptr = (pipe_t*)get_fd(fds[0])->inode;
+	pfds[0].fd = fds[0];
+	pfds[0].events = POLLIN;
+	pfds[1].fd = fds[1];
+	pfds[1].events = POLLIN | POLLOUT;
+	pfds[2].fd = 1;
+	pfds[2].events = POLLIN | POLLOUT;
+	pfds[3].fd = 100;
+	pfds[3].events = POLLIN;
+	pfds[4].fd = -1;
+	pfds[4].events = POLLIN;
+
+	/* Empty, only checking, so nothing joins the read queue */
+	if(poll(pfds, 5, 0) != 3 || pfds[0].revents != 0 || pfds[1].revents != POLLOUT ||
+	   pfds[2].revents != (POLLIN | POLLOUT) || pfds[3].revents != POLLNVAL || pfds[4].revents != 0 ||
+	   pipe_ptr->read_wait != 0){
+		return FAIL;
+	}
+
+	/* Data, then the end of it */
+	if(write(fds[1], whole_buf, 1) != 1 || poll(pfds, 1, 0) != 1 || pfds[0].revents != POLLIN ||
+	   close(fds[1]) != 0 || poll(pfds, 2, 0) != 2 || pfds[0].revents != (POLLIN | POLLHUP) ||
+	   pfds[1].revents != POLLNVAL){
+		return FAIL;
+	}
+	close(fds[0]);
+
+	/* Nobody to read what's written */
+	if(pipe(fds) != 0 || close(fds[0]) != 0){
+		return FAIL;
+	}
+	pfds[0].fd = fds[1];
+	pfds[0].events = POLLOUT;
+	if(poll(pfds, 1, 0) != 1 || pfds[0].revents != POLLERR){
+		return FAIL;
+	}
+	close(fds[1]);
+
+	/* Kernel memory, past the end of the program page, and too many descriptors */
+	if(poll((pollfd*)whole_buf, 1, 0) != -1 || poll((pollfd*)(USER_PROG + FOUR_MB), 1, 0) != -1 ||
+	   poll((pollfd*)(USER_PROG + FOUR_MB - sizeof(pollfd) + 1), 1, 0) != -1 ||
+	   poll((pollfd*)FS_IMAGE_ADDR, 1, 0) != -1 || poll(pfds, POLL_MAX + 1, 0) != -1){
+		return FAIL;
+	}
+	return PASS;
+}
+
+/* epoll_test
+ *
+ * Watches both ends of a pipe in an interest set, checking that only ready
+ * descriptors come back, that one stays ready until it's read, and that
+ * closing either side takes the items off the pipe's watcher lists
+ * Inputs: None
+ * Outputs: PASS/FAIL
+ * Side Effects: None
+ * Coverage: epoll_create, epoll_ctl, epoll_wait, epoll_notify, epoll_forget
+ * Files: epoll.c/h, pipe.c/h, syscalls.c/h
+ */
+int epoll_test(){
+	TEST_HEADER;
+
+	epoll_event* ev = (epoll_event*)(USER_PROG + FOUR_MB - THREAD_STACK_SIZE);
+	epoll_event* out = ev + 1;
+	int32_t fds[2], epfd;
+	pipe_t* pipe_ptr;
+
+	place_test_pcb(NULL, NULL);
+	set_page_dir_entry(USER_PROG, EIGHT_MB);
+	asm volatile ("movl %%cr3, %%eax; movl %%eax, %%cr3" : : : "eax");
+
+	if((epfd = epoll_create()) == -1 || pipe(fds) != 0){
+		return FAIL;
+	}
+	pipe_ptr = (pipe_t*)get_fd(fds[0])->inode;
+
+	/* Empty, so nothing is ready, and sets can't watch sets */
+	ev->events = POLLIN;
+	ev->data = 7;
+	if(epoll_ctl(epfd, EPOLL_CTL_ADD, fds[0], ev) != 0 || epoll_ctl(epfd, EPOLL_CTL_ADD, fds[0], ev) != -1 ||
+	   epoll_ctl(epfd, EPOLL_CTL_ADD, epfd, ev) != -1 || epoll_ctl(fds[0], EPOLL_CTL_ADD, fds[1], ev) != -1 ||
+	   epoll_wait(epfd, out, 4, 0) != 0 || pipe_ptr->read_watch == NULL){
+		return FAIL;
+	}
+
+	/* The write notifies the set, and it stays ready until it's read */
+	if(write(fds[1], whole_buf, 1) != 1 || epoll_wait(epfd, out, 4, 0) != 1 ||
+	   out[0].events != POLLIN || out[0].data != 7 || epoll_wait(epfd, out, 4, 0) != 1 ||
+	   read(fds[0], chunk_buf, 1) != 1 || epoll_wait(epfd, out, 4, 0) != 0){
+		return FAIL;
+	}
+
+	/* Room to write, until it's taken out */
+	ev->events = POLLOUT;
+	ev->data = 9;
+	if(epoll_ctl(epfd, EPOLL_CTL_ADD, fds[1], ev) != 0 || epoll_wait(epfd, out, 4, 0) != 1 ||
+	   out[0].data != 9 || epoll_ctl(epfd, EPOLL_CTL_DEL, fds[1], NULL) != 0 ||
+	   epoll_wait(epfd, out, 4, 0) != 0 || pipe_ptr->write_watch != NULL){
+		return FAIL;
+	}
+
+	/* The writer closing shows up on the read end */
+	if(close(fds[1]) != 0 || epoll_wait(epfd, out, 4, 0) != 1 || out[0].events != (POLLIN | POLLHUP)){
+		return FAIL;
+	}
+
+	/* Events past the end of the program page, while one is ready to be written there */
+	if(epoll_ctl(epfd, EPOLL_CTL_MOD, fds[0], (epoll_event*)(USER_PROG + FOUR_MB)) != -1 ||
+	   epoll_ctl(epfd, EPOLL_CTL_MOD, fds[0], (epoll_event*)FS_IMAGE_ADDR) != -1 ||
+	   epoll_wait(epfd, (epoll_event*)(USER_PROG + FOUR_MB - sizeof(epoll_event) + 1), 1, 0) != -1 ||
+	   epoll_wait(epfd, (epoll_event*)FS_IMAGE_ADDR, 4, 0) != -1){
+		return FAIL;
+	}
+
+	/* Closing the set frees its items */
+	if(close(epfd) != 0 || pipe_ptr->read_watch != NULL || epoll_wait(epfd, out, 4, 0) != -1){
+		return FAIL;
+	}
+	close(fds[0]);
+	return PASS;
+}
+
+/* signal_test
+ *
+ * Delivers ALARM to a handler the way the linkage would on the way back to
+ * user space, checks the frame sigtest relies on, changes the saved eax
+ * like sigtest's handler, then returns through sigreturn
+ * Inputs: None
+ * Outputs: PASS/FAIL
+ * Side Effects: None
+ * Coverage: set_handler, send_signal, deliver_signals, sigreturn
+ * Files: signal.c/h
+ */
+int signal_test(){
+	TEST_HEADER;
+
+	static hw_context regs, frame[1];
+	uint32_t handler = USER_PROG + 0x48000;
+	uint32_t user_esp = USER_PROG + FOUR_MB - THREAD_STACK_SIZE;
+	uint32_t* stack;
+	uint8_t* tramp;
+	uint32_t saved_esp0;
+	int32_t ret, result = PASS;
+	pcb_t* pcb = get_pcb(1);
+
+	place_test_pcb(NULL, NULL);
+	set_page_dir_entry(USER_PROG, EIGHT_MB);
+	asm volatile ("movl %%cr3, %%eax; movl %%eax, %%cr3" : : : "eax");
+
+	if(set_handler(NUM_SIGNALS, (void*)handler) != -1 || set_handler(ALARM, whole_buf) != -1 ||
+	   set_handler(ALARM, (void*)handler) != 0){
+		return FAIL;
+	}
+
+	memset(&regs, 0, sizeof(hw_context));
+	regs.cs = USER_CS;
+	regs.ss = USER_DS;
+	regs.eflags = 0x202;
+	regs.esp = user_esp;
+	regs.eip = USER_PROG + 0x48100;
+	regs.eax = 0x1234;
+
+	/* Ignored by default, and nothing happens on the way back to the kernel */
+	send_signal(1, USER1);
+	send_signal(1, ALARM);
+	regs.cs = KERNEL_CS;
+	deliver_signals(&regs);
+	regs.cs = USER_CS;
+	if(regs.eip != USER_PROG + 0x48100 || pcb->sig.pending != ((1 << USER1) | (1 << ALARM))){
+		return FAIL;
+	}
+
+	/* Return address to the trampoline, the signal, then the context */
+	deliver_signals(&regs);
+	stack = (uint32_t*)regs.esp;
+	tramp = (uint8_t*)stack[0];
+	if(regs.eip != handler || pcb->sig.pending != 0 || stack[1] != ALARM || stack[1 + 7] != 0x1234 ||
+	   stack[1 + 13] != USER_PROG + 0x48100 || stack[1 + 16] != user_esp ||
+	   tramp[0] != 0xB8 || tramp[1] != 10 || tramp[5] != 0xCD || tramp[6] != 0x80){
+		result = FAIL;
+	}
+
+	/* Held back while the handler runs */
+	send_signal(1, ALARM);
+	if(result == PASS){
+		deliver_signals(&regs);
+		if(regs.esp != (uint32_t)stack){
+			result = FAIL;
+		}
+	}
+
+	/* The handler changes eax and returns, the trampoline calls sigreturn */
+	stack[1 + 7] = 0x5678;
+	memcpy(frame, &regs, sizeof(hw_context));
+	frame[0].esp = (uint32_t)stack + 4;
+	saved_esp0 = tss.esp0;
+	tss.esp0 = (uint32_t)(frame + 1);
+	ret = sigreturn();
+	tss.esp0 = saved_esp0;
+	if(result == PASS && (ret != 0x5678 || frame[0].eip != USER_PROG + 0x48100 || frame[0].esp != user_esp ||
+	   frame[0].cs != USER_CS || pcb->sig.masked != 0 || pcb->sig.pending != 1 << ALARM)){
+		result = FAIL;
+	}
+
+	signal_init(&pcb->sig);
+	return result;
+}
+
+/* terminal_batch_test
+ *
+ * Checks that a batched terminal_write renders, wraps and scrolls like putc
+ * and programs the cursor where the text ends
+ * Inputs: None
+ * Outputs: PASS/FAIL
+ * Side Effects: Clears the screen
+ * Coverage: terminal_write, putbuf
+ * Files: lib.c, kb.c
+ */
+int terminal_batch_test(){
+	TEST_HEADER;
+
+	uint8_t* vid = (uint8_t*)terminals[cur_terminal].vid_mem;
+	int32_t i, pos, result = PASS;
+
+	print_terminal = cur_terminal;
+	clear();
+	reset_screen();
+
+	/* A newline, then a row that wraps onto the next */
+	memset(whole_buf, 'w', NUM_COLS + 3);
+	whole_buf[0] = 'a';
+	whole_buf[1] = '\n';
+	if(terminal_write(1, whole_buf, NUM_COLS + 3) != NUM_COLS + 3){
+		result = FAIL;
+	}
+	screen_flush();
+	if(vid[0] != 'a' || vid[NUM_COLS << 1] != 'w' ||
+	   vid[(2 * NUM_COLS) << 1] != 'w' || terminals[cur_terminal].x != 1 || terminals[cur_terminal].y != 2){
+		result = FAIL;
+	}
+
+	/* Enough newlines to scroll everything off, then the last row */
+	memset(whole_buf, '\n', 2 * NUM_ROWS);
+	whole_buf[2 * NUM_ROWS] = 'z';
+	terminal_write(1, whole_buf, 2 * NUM_ROWS + 1);
+	screen_flush();
+	vid = (uint8_t*)terminals[cur_terminal].vid_mem + ((terminals[cur_terminal].origin * NUM_COLS) << 1);
+	if(terminals[cur_terminal].y != NUM_ROWS - 1 || vid[((NUM_ROWS - 1) * NUM_COLS) << 1] != 'z'){
+		result = FAIL;
+	}
+	for(i = 0; i < (NUM_ROWS - 1) * NUM_COLS; i++){
+		if(vid[i << 1] != ' '){
+			result = FAIL;
+		}
+	}
+
+	/* The flush programmed the cursor where the text ends */
+	outb(0x0F, 0x3D4);
+	pos = inb(0x3D5);
+	outb(0x0E, 0x3D4);
+	pos |= inb(0x3D5) << 8;
+	if(pos != (((uint32_t)terminals[cur_terminal].vid_mem - VIDEO_MEM_ADDR) >> 1) + (terminals[cur_terminal].origin + NUM_ROWS - 1) * NUM_COLS + 1){
+		result = FAIL;
+	}
+
+	clear();
+	reset_screen();
+	return result;
+}
+
+/* hw_scroll_test
+ *
+ * Checks that the viewing terminal scrolls by moving the VGA start address,
+ * and keeps its text when the screen moves back to the top of the region
+ * Inputs: None
+ * Outputs: PASS/FAIL
+ * Side Effects: Clears the screen
+ * Coverage: scroll_up, screen_map
+ * Files: lib.c/h
+ */
+int hw_scroll_test(){
+	TEST_HEADER;
+
+	uint8_t* vid;
+	uint8_t* region = (uint8_t*)terminals[cur_terminal].vid_mem;
+	int32_t i, start, result = PASS;
+	int32_t rows = TEXT_REGION_SIZE / (NUM_COLS << 1);
+
+	print_terminal = cur_terminal;
+	clear();
+	reset_screen();
+
+	/* Row 1 has a mark, scroll it to the top of the screen */
+	memset(whole_buf, '\n', NUM_ROWS + 1);
+	whole_buf[1] = 'm';
+	terminal_write(1, whole_buf, NUM_ROWS + 1);
+	screen_flush();
+	outb(0x0C, 0x3D4);
+	start = inb(0x3D5) << 8;
+	outb(0x0D, 0x3D4);
+	start |= inb(0x3D5);
+	vid = region + ((terminals[cur_terminal].origin * NUM_COLS) << 1);
+	if(terminals[cur_terminal].origin != 1 || start != (((uint32_t)region - VIDEO_MEM_ADDR) >> 1) + NUM_COLS || vid[0] != 'm'){
+		result = FAIL;
+	}
+
+	/* Scroll to the end of the region, then once more to move back to the top */
+	for(i = 0; i < rows - NUM_ROWS - 1; i++){
+		putc('\n');
+	}
+	putc('k');
+	putc('\n');
+	screen_flush();
+	if(terminals[cur_terminal].origin != 0 || region[((NUM_ROWS - 2) * NUM_COLS) << 1] != 'k'){
+		result = FAIL;
+	}
+
+	/* vidmap's page shows the screen once it is back at the top */
+	putc('\n');
+	screen_map(cur_terminal, 1);
+	if(terminals[cur_terminal].origin != 0 || region[((NUM_ROWS - 3) * NUM_COLS) << 1] != 'k'){
+		result = FAIL;
+	}
+	screen_map(cur_terminal, 0);
+
+	clear();
+	reset_screen();
+	return result;
+}
+
+/* page_flip_test
+ *
+ * Checks that switching terminals only moves the VGA display, and that a
+ * background terminal's output reaches its own text region once it is shown
+ * Inputs: None
+ * Outputs: PASS/FAIL
+ * Side Effects: Clears the first and third terminals
+ * Coverage: change_shell, putc
+ * Files: lib.c/h, paging.h
+ */
+int page_flip_test(){
+	TEST_HEADER;
+
+	int32_t start, result = PASS;
+
+	print_terminal = 0;
+	change_shell(0);
+	clear();
+	reset_screen();
+	putc('a');
+	screen_flush();
+
+	/* The second terminal's region is shown, the first one's is left alone */
+	change_shell(1);
+	outb(0x0C, 0x3D4);
+	start = inb(0x3D5) << 8;
+	outb(0x0D, 0x3D4);
+	start |= inb(0x3D5);
+	if(start != ((SECOND_SHELL - VIDEO_MEM_ADDR) >> 1) + terminals[1].origin * NUM_COLS || *(uint8_t*)FIRST_SHELL != 'a'){
+		result = FAIL;
+	}
+
+	/* The third terminal prints in the background without moving the display */
+	*(uint8_t*)THIRD_SHELL = ' ';
+	print_terminal = 2;
+	clear();
+	terminals[2].x = 0;
+	terminals[2].y = 0;
+	putc('b');
+	outb(0x0C, 0x3D4);
+	start = inb(0x3D5) << 8;
+	outb(0x0D, 0x3D4);
+	start |= inb(0x3D5);
+	if(start != ((SECOND_SHELL - VIDEO_MEM_ADDR) >> 1) + terminals[1].origin * NUM_COLS || *(uint8_t*)THIRD_SHELL == 'b'){
+		result = FAIL;
+	}
+
+	/* Its rows go out when it is shown */
+	change_shell(2);
+	if(*(uint8_t*)THIRD_SHELL != 'b'){
+		result = FAIL;
+	}
+
+	/* Back to the first terminal, with nothing copied */
+	print_terminal = 0;
+	change_shell(0);
+	outb(0x0C, 0x3D4);
+	start = inb(0x3D5) << 8;
+	outb(0x0D, 0x3D4);
+	start |= inb(0x3D5);
+	if(start != 0 || *(uint8_t*)FIRST_SHELL != 'a'){
+		result = FAIL;
+	}
+
+	clear();
+	reset_screen();
+	return result;
+}
+
+/* shadow_flush_test
+ *
+ * Checks that terminal output collects in RAM until a flush, and that a
+ * flush only copies the rows that changed
+ * Inputs: None
+ * Outputs: PASS/FAIL
+ * Side Effects: Clears the screen
+ * Coverage: putbuf, screen_flush
+ * Files: lib.c/h
+ */
+int shadow_flush_test(){
+	TEST_HEADER;
+
+	uint8_t* vid = (uint8_t*)terminals[cur_terminal].vid_mem;
+	uint32_t ticks = pit_ticks;
+	unsigned long flags;
+	int32_t pos, result = PASS;
+
+	/* No PIT flush in the middle, and output doesn't go straight out as it does at boot */
+	cli_and_save(flags);
+	if(ticks == 0){
+		pit_ticks = 1;
+	}
+
+	print_terminal = cur_terminal;
+	clear();
+	reset_screen();
+	screen_flush();
+
+	/* A burst of output stays in RAM */
+	putc('x');
+	terminal_write(1, "yz", 2);
+	if(vid[0] == 'x'){
+		result = FAIL;
+	}
+
+	/* One flush copies the row and moves the cursor */
+	screen_flush();
+	outb(0x0F, 0x3D4);
+	pos = inb(0x3D5);
+	outb(0x0E, 0x3D4);
+	pos |= inb(0x3D5) << 8;
+	if(vid[0] != 'x' || vid[2] != 'y' || vid[4] != 'z' || pos != (((uint32_t)vid - VIDEO_MEM_ADDR) >> 1) + 3){
+		result = FAIL;
+	}
+
+	/* A row nothing printed to isn't copied again */
+	vid[NUM_COLS << 1] = 'q';
+	putc('w');
+	screen_flush();
+	if(vid[NUM_COLS << 1] != 'q' || vid[6] != 'w'){
+		result = FAIL;
+	}
+
+	pit_ticks = ticks;
+	clear();
+	reset_screen();
+	screen_flush();
+	restore_flags(flags);
+	return result;
+}
+
+/* row_holds
+ *
+ * Checks that a screen row holds a string followed by blanks
+ * Inputs: row - the row's characters and attributes, str - what it should say
+ * Outputs: 1 if it does, 0 if not
+ */
+static int row_holds(const uint16_t* row, const char* str){
+	int32_t i;
+	for(i = 0; i < NUM_COLS; i++){
+		if((row[i] & 0xFF) != (*str ? (uint8_t)*str++ : ' ')){
+			return 0;
+		}
+	}
+	return 1;
+}
+
+/* scrollback_test
+ *
+ * Checks that rows scrolling off the screen are kept, that they come back
+ * unchanged, and that Shift+PgUp's view holds still while output continues
+ * Inputs: None
+ * Outputs: PASS/FAIL
+ * Side Effects: Clears the screen and the terminal's history
+ * Coverage: scrollback_push, scrollback_read, scrollback_report, screen_view
+ * Files: scrollback.c/h, lib.c/h
+ */
+int scrollback_test(){
+	TEST_HEADER;
+
+	scrollback_t* sb = &scrollbacks[cur_terminal];
+	uint16_t rows[2][NUM_COLS];
+	uint16_t* vga;
+	uint32_t ticks = pit_ticks;
+	unsigned long flags;
+	int8_t line[16];
+	int32_t i, result = PASS;
+
+	cli_and_save(flags);
+	if(ticks == 0){
+		pit_ticks = 1;
+	}
+
+	print_terminal = cur_terminal;
+	sb->head = sb->tail = 0;
+	sb->lines = sb->view = 0;
+	clear();
+	reset_screen();
+	screen_flush();
+
+	/* 60 lines leave the last 24 and a blank row on screen */
+	for(i = 0; i < 60; i++){
+		strcpy(line, (int8_t*)"row ");
+		itoa(i, line + 4, 10);
+		puts(line);
+		putc('\n');
+	}
+	if(sb->lines != 36 || scrollback_read(cur_terminal, 36, rows[0], 2) != 2 ||
+	   !row_holds(rows[0], "row 0") || !row_holds(rows[1], "row 1") || rows[0][NUM_COLS - 1] != ((rows[0][0] & 0xFF00) | ' ')){
+		result = FAIL;
+	}
+	printf("scrollback: %u bytes per %d lines\n", scrollback_report(cur_terminal), SCROLLBACK_REPORT);
+	screen_flush();
+
+	/* The view shows history where the display starts, and output underneath doesn't disturb it */
+	outb(0x0C, 0x3D4);
+	i = inb(0x3D5) << 8;
+	outb(0x0D, 0x3D4);
+	i |= inb(0x3D5);
+	vga = (uint16_t*)VIDEO_MEM_ADDR + i;
+	screen_view(SCROLLBACK_PAGE);
+	if(sb->view != SCROLLBACK_PAGE || !row_holds(vga, "row 12") || !row_holds(vga + (NUM_ROWS - 1) * NUM_COLS, "row 36")){
+		result = FAIL;
+	}
+	puts((int8_t*)"live");
+	screen_flush();
+	if(!row_holds(vga + (NUM_ROWS - 1) * NUM_COLS, "row 36")){
+		result = FAIL;
+	}
+
+	/* Going back shows what was printed meanwhile */
+	screen_view(0);
+	outb(0x0C, 0x3D4);
+	i = inb(0x3D5) << 8;
+	outb(0x0D, 0x3D4);
+	i |= inb(0x3D5);
+	vga = (uint16_t*)VIDEO_MEM_ADDR + i;
+	if(sb->view != 0 || !row_holds(vga, "row 36") || !row_holds(vga + (NUM_ROWS - 1) * NUM_COLS, "live")){
+		result = FAIL;
+	}
+
+	/* A row with its own colors comes back with them */
+	for(i = 0; i < NUM_COLS; i++){
+		rows[0][i] = ((i & 0xF) << 8) | ('a' + (i % 26));
+	}
+	scrollback_push(cur_terminal, rows[0]);
+	scrollback_read(cur_terminal, 1, rows[1], 1);
+	for(i = 0; i < NUM_COLS; i++){
+		if(rows[1][i] != rows[0][i]){
+			result = FAIL;
+		}
+	}
+
+	pit_ticks = ticks;
+	clear();
+	reset_screen();
+	screen_flush();
+	restore_flags(flags);
+	return result;
+}
+
+/* kb_ring_test
+ *
+ * Checks that queued scan codes are all decoded by the bottom half, that a
+ * full ring drops rather than overwrites, and times the interrupt's share
+ * Inputs: None
+ * Outputs: PASS/FAIL
+ * Side Effects: Clears the screen and the viewing terminal's line
+ * Coverage: keyboard_push, keyboard_process
+ * Files: kb.c/h
+ */
+int kb_ring_test(){
+	TEST_HEADER;
+
+	shell_t* term = &terminals[cur_terminal];
+	uint32_t overruns = kb_overruns;
+	uint32_t start, push_cycles;
+	unsigned long flags;
+	int32_t i, result = PASS;
+
+	/* No tick in the middle */
+	cli_and_save(flags);
+	term->buf_index = 0;
+	ldisc_mode(cur_terminal, LDISC_COOKED);
+
+	/* A burst of 'a' presses and releases, all kept */
+	start = rdtsc();
+	for(i = 0; i < KB_RING_SIZE; i += 2){
+		keyboard_push(30);
+		keyboard_push(30 + 0x80);
+	}
+	push_cycles = (rdtsc() - start) / KB_RING_SIZE;
+	if(kb_overruns != overruns || keyboard_push(30) != -1 || kb_overruns != overruns + 1){
+		result = FAIL;
+	}
+
+	/* 128 presses fill the line, which keeps its last slot for enter */
+	keyboard_process();
+	if(term->buf_index != BUF_LENGTH - 1){
+		result = FAIL;
+	}
+	for(i = 0; i < term->buf_index; i++){
+		if(term->kb_buf[i] != 'a'){
+			result = FAIL;
+		}
+	}
+
+	/* The ring is empty again and takes more */
+	if(keyboard_push(30 + 0x80) != 0){
+		result = FAIL;
+	}
+	keyboard_process();
+	printf("keyboard: %u cycles per queued scan code\n", push_cycles);
+
+	term->buf_index = 0;
+	clear();
+	reset_screen();
+	restore_flags(flags);
+	return result;
+}
+
+/* ldisc_test
+ *
+ * Checks that typing ahead of a reader keeps every line, that a short read
+ * leaves the rest of its line, and that cbreak and raw hand over keys at once
+ * Inputs: None
+ * Outputs: PASS/FAIL
+ * Side Effects: Clears the screen and the viewing terminal's typeahead
+ * Coverage: ldisc_receive, ldisc_mode, ldisc_ready, ldisc_read
+ * Files: ldisc.c/h
+ */
+int ldisc_test(){
+	TEST_HEADER;
+
+	ldisc_t* ld = &ldiscs[cur_terminal];
+	uint8_t buf[16];
+	unsigned long flags;
+	int32_t i, result = PASS;
+
+	cli_and_save(flags);
+	print_terminal = cur_terminal;
+	ldisc_mode(cur_terminal, LDISC_COOKED);
+	terminals[cur_terminal].buf_index = 0;
+	ld->head = ld->tail = 0;
+	ld->lines = 0;
+
+	/* Editing happens before the line is queued, and a line isn't readable until enter */
+	ldisc_receive(cur_terminal, 'a');
+	ldisc_receive(cur_terminal, 'b');
+	ldisc_receive(cur_terminal, '\b');
+	ldisc_receive(cur_terminal, 'c');
+	if(ldisc_ready(cur_terminal)){
+		result = FAIL;
+	}
+	ldisc_receive(cur_terminal, '\n');
+
+	/* Lines typed ahead of the reader all wait their turn */
+	for(i = 0; i < 50; i++){
+		ldisc_receive(cur_terminal, 'x');
+		ldisc_receive(cur_terminal, '\n');
+	}
+	if(!ldisc_ready(cur_terminal) || ld->lines != 51){
+		result = FAIL;
+	}
+
+	/* A short read leaves the rest of its line for the next */
+	if(ldisc_read(cur_terminal, buf, 1) != 1 || buf[0] != 'a' ||
+	   ldisc_read(cur_terminal, buf, sizeof(buf)) != 2 || strncmp((int8_t*)buf, "c\n", 2) != 0){
+		result = FAIL;
+	}
+	for(i = 0; i < 50; i++){
+		if(ldisc_read(cur_terminal, buf, sizeof(buf)) != 2 || strncmp((int8_t*)buf, "x\n", 2) != 0){
+			result = FAIL;
+		}
+	}
+	if(ldisc_ready(cur_terminal)){
+		result = FAIL;
+	}
+
+	/* cbreak keys are readable as soon as they're typed */
+	ldisc_mode(cur_terminal, LDISC_CBREAK);
+	ldisc_receive(cur_terminal, 'q');
+	if(!ldisc_ready(cur_terminal) || ldisc_read(cur_terminal, buf, sizeof(buf)) != 1 || buf[0] != 'q'){
+		result = FAIL;
+	}
+
+	/* Going raw hands over the half typed line, then control bytes as they come */
+	ldisc_mode(cur_terminal, LDISC_COOKED);
+	ldisc_receive(cur_terminal, 'p');
+	ldisc_mode(cur_terminal, LDISC_RAW);
+	ldisc_receive(cur_terminal, 0x03);
+	if(ldisc_read(cur_terminal, buf, sizeof(buf)) != 2 || buf[0] != 'p' || buf[1] != 0x03){
+		result = FAIL;
+	}
+
+	/* A full queue keeps what it has */
+	for(i = 0; i < LDISC_SIZE + 8; i++){
+		ldisc_receive(cur_terminal, 'r');
+	}
+	if(ld->head - ld->tail != LDISC_SIZE){
+		result = FAIL;
+	}
+
+	/* A mode set through ioctl belongs to the descriptor, apart from its inode */
+	place_test_pcb(NULL, NULL);
+	if(ioctl(0, TTY_SET_MODE, LDISC_CBREAK) != 0 || ioctl(0, TTY_GET_MODE, 0) != LDISC_CBREAK ||
+	   get_fd(0)->inode != 0 || ioctl(0, TTY_SET_MODE, LDISC_RAW + 1) != -1 ||
+	   ioctl(0, TTY_SET_MODE, LDISC_COOKED) != 0){
+		result = FAIL;
+	}
+
+	ld->tail = ld->head;
+	ld->lines = 0;
+	ldisc_mode(cur_terminal, LDISC_COOKED);
+	print_terminal = cur_sched_term;
+	clear();
+	reset_screen();
+	restore_flags(flags);
+	return result;
+}
+
+/* klog_test
+ *
+ * Checks that log records come back as they were formatted, that readers
+ * lapped by the writers pick up at the oldest record, and times a record
+ * Inputs: None
+ * Outputs: PASS/FAIL
+ * Side Effects: Fills the kernel log
+ * Coverage: klog, klog_write, klog_get, vsnprintf
+ * Files: klog.c/h, lib.c/h
+ */
+int klog_test(){
+	TEST_HEADER;
+
+	int32_t console = klog_to_console;
+	klog_record rec;
+	uint32_t pos = 0, start, write_cycles;
+	int8_t* args[1] = {"longer than eight"};
+	int8_t buf[8];
+	unsigned long flags;
+	int32_t i, result = PASS;
+
+	/* Keep the records off the screen, and the tick still */
+	cli_and_save(flags);
+	klog_to_console = 0;
+	klog_drain();
+
+	/* Catch up */
+	while(klog_get(&pos, &rec));
+
+	klog("value %d and %s\n", -5, "str");
+	if(!klog_get(&pos, &rec) || rec.len != 16 || strncmp(rec.text, "value -5 and str", 16) != 0 ||
+	   rec.tick != pit_ticks || klog_get(&pos, &rec)){
+		result = FAIL;
+	}
+
+	/* A reader that falls behind loses the oldest records, not its place */
+	start = rdtsc();
+	for(i = 0; i < KLOG_RECORDS + 10; i++){
+		klog_write("a record of about forty bytes of text...", 40);
+	}
+	write_cycles = (rdtsc() - start) / (KLOG_RECORDS + 10);
+	klog("last");
+	for(i = 0; klog_get(&pos, &rec); i++);
+	if(i != KLOG_RECORDS || rec.len != 4 || strncmp(rec.text, "last", 4) != 0){
+		result = FAIL;
+	}
+
+	/* Formatting into a buffer stops at its end */
+	if(vsnprintf(buf, sizeof(buf), "%s", (int32_t*)args) != 7 || buf[7] != '\0'){
+		result = FAIL;
+	}
+
+	klog_drain();
+	klog_to_console = console;
+	restore_flags(flags);
+	printf("klog: %u cycles per 40 byte record\n", write_cycles);
+	return result;
+}
+
+/* serial_test
+ *
+ * Checks that a burst queued for COM1 drains through the transmit interrupt,
+ * and that bytes looped back in the UART come out of a read
+ * Inputs: None
+ * Outputs: PASS/FAIL
+ * Side Effects: Sends test bytes out of COM1
+ * Coverage: serial_send, serial_interrupt_handler, serial_read, serial_poll
+ * Files: serial.c/h
+ */
+int serial_test(){
+	TEST_HEADER;
+
+	uint8_t burst[1000];
+	uint8_t buf[8];
+	uint32_t start, send_cycles, ticks;
+	unsigned long flags;
+	int32_t result = PASS;
+
+	if(!serial_present){
+		printf("serial: no UART at COM1\n");
+		return result;
+	}
+
+	/* The burst is queued in one go, then drained a FIFO at a time by the interrupt */
+	memset(burst, '.', sizeof(burst));
+	burst[sizeof(burst) - 1] = '\n';
+	cli_and_save(flags);
+	start = rdtsc();
+	if(serial_send(burst, sizeof(burst)) != sizeof(burst)){
+		result = FAIL;
+	}
+	send_cycles = (rdtsc() - start) / sizeof(burst);
+	restore_flags(flags);
+
+	sti();
+	ticks = pit_ticks;
+	while(serial_room() != SERIAL_TX_SIZE && pit_ticks - ticks < PIT_HZ);
+	ticks = pit_ticks - ticks;
+	if(serial_room() != SERIAL_TX_SIZE){
+		result = FAIL;
+	}
+
+	/* In loopback mode what is sent is received */
+	outb(0x1B, COM1_PORT + 4);
+	serial_send((uint8_t*)"ping", 4);
+	start = pit_ticks;
+	while(!(serial_poll(0, 0) & POLLIN) && pit_ticks - start < PIT_HZ);
+	if(!(serial_poll(0, 0) & POLLIN) || serial_read(0, buf, sizeof(buf)) != 4 || strncmp((int8_t*)buf, "ping", 4) != 0){
+		result = FAIL;
+	}
+	outb(0x0B, COM1_PORT + 4);
+	restore_flags(flags);
+
+	printf("serial: %u cycles per queued byte, %u ticks to send 1000 bytes\n", send_cycles, ticks);
+	return result;
+}
+
+/* Benchmarks, run headless after the tests. Each is timed in TSC cycles and
+ * keeps its best round, the tsc line lets a host convert to time */
+
+/* Iterations of each benchmark per round */
+#define BENCH_CALLS     1000
+#define BENCH_SWITCHES  1000
+#define BENCH_READS     4
+#define BENCH_LINES     64
+/* Second kernel stack for the switch benchmark, as big as a process' */
+#define BENCH_STACK_WORDS (EIGHT_KB / 4)
+
+static uint32_t bench_stack[BENCH_STACK_WORDS];
+static int32_t bench_esp;   /* The benchmark's stack while the partner runs */
+static int32_t partner_esp; /* The partner's stack while the benchmark runs */
+
+/*
+ * switch_partner
+ *    DESCRIPTION: Runs on the second stack and switches straight back each
+ *                 time the benchmark switches to it
+ *    INPUTS: none
+ *    OUTPUTS: none
+ *    RETURN VALUE: none, never returns
+ *    SIDE EFFECTS: none
+ */
+static void switch_partner(void){
+	for(;;){
+		flush_tlb();
+		switch_stack(&partner_esp, bench_esp);
+	}
+}
+
+/*
+ * bench_tsc_khz
+ *    DESCRIPTION: Counts TSC cycles over a tenth of a second of PIT ticks
+ *    INPUTS: none
+ *    OUTPUTS: none
+ *    RETURN VALUE: TSC rate in kHz
+ *    SIDE EFFECTS: Needs interrupts on
+ */
+static uint32_t bench_tsc_khz(void){
+	uint32_t tick, start;
+
+	/* Start on a tick edge */
+	tick = pit_ticks;
+	while(pit_ticks == tick);
+	start = rdtsc();
+	tick = pit_ticks;
+	while(pit_ticks - tick < PIT_HZ / 10);
+	/* Cycles in 100 ms, to cycles per ms */
+	return (rdtsc() - start) / 100;
+}
+
+/*
+ * bench_syscall
+ *    DESCRIPTION: Makes system calls with an invalid number, which go through
+ *                 the whole linkage but no handler
+ *    INPUTS: none
+ *    OUTPUTS: none
+ *    RETURN VALUE: cycles for BENCH_CALLS calls
+ *    SIDE EFFECTS: none
+ */
+static uint32_t bench_syscall(void){
+	uint32_t i, start;
+	int32_t ret;
+
+	start = rdtsc();
+	for(i = 0; i < BENCH_CALLS; i++){
+		asm volatile ("int $0x80" : "=a"(ret) : "a"(0) : "memory", "cc");
+	}
+	return rdtsc() - start;
+}
+
+/*
+ * bench_switch
+ *    DESCRIPTION: Switches kernel stacks back and forth with a partner, each
+ *                 switch reloading cr3 as switch_process does
+ *    INPUTS: none
+ *    OUTPUTS: none
+ *    RETURN VALUE: cycles for 2 * BENCH_SWITCHES switches
+ *    SIDE EFFECTS: none
+ */
+static uint32_t bench_switch(void){
+	uint32_t* stack = bench_stack + BENCH_STACK_WORDS;
+	uint32_t i, start;
+
+	/* Lay out the partner's stack the way switch_stack leaves it, with a
+	 * return address and argument slot below switch_partner that are never used */
+	*(--stack) = 0;
+	*(--stack) = 0;
+	*(--stack) = (uint32_t)switch_partner;
+	for(i = 0; i < 4; i++){
+		*(--stack) = 0;
+	}
+	partner_esp = (int32_t)stack;
+
+	start = rdtsc();
+	for(i = 0; i < BENCH_SWITCHES; i++){
+		flush_tlb();
+		switch_stack(&bench_esp, partner_esp);
+	}
+	return rdtsc() - start;
+}
+
+/*
+ * bench_read_data
+ *    DESCRIPTION: Reads the largest file in the image whole, a few times over
+ *    INPUTS: none
+ *    OUTPUTS: none
+ *    RETURN VALUE: cycles per KB read, 0 if the file is missing
+ *    SIDE EFFECTS: none
+ */
+static uint32_t bench_read_data(void){
+	dentry_t dentry;
+	uint32_t i, start, bytes = 0;
+
+	if(read_dentry_by_name((uint8_t*)"fish", &dentry) == -1){
+		return 0;
+	}
+	start = rdtsc();
+	for(i = 0; i < BENCH_READS; i++){
+		bytes += read_data(dentry.inode_num, 0, whole_buf, sizeof(whole_buf));
+	}
+	return (rdtsc() - start) / (bytes / 1024);
+}
+
+/*
+ * bench_terminal_write
+ *    DESCRIPTION: Writes screen lines to the terminal, 64 bytes each so the
+ *                 total is a whole number of KB
+ *    INPUTS: none
+ *    OUTPUTS: none
+ *    RETURN VALUE: cycles per KB written
+ *    SIDE EFFECTS: Scrolls the screen
+ */
+static uint32_t bench_terminal_write(void){
+	uint8_t line[64];
+	uint32_t i, start;
+
+	memset(line, '#', sizeof(line));
+	line[sizeof(line) - 1] = '\n';
+	start = rdtsc();
+	for(i = 0; i < BENCH_LINES; i++){
+		terminal_write(1, line, sizeof(line));
+	}
+	return (rdtsc() - start) / (BENCH_LINES * sizeof(line) / 1024);
+}
+
+/*
+ * bench_best
+ *    DESCRIPTION: Runs a benchmark BENCH_ROUNDS times
+ *    INPUTS: uint32_t (*bench)(void) - the benchmark
+ *    OUTPUTS: none
+ *    RETURN VALUE: its lowest result
+ *    SIDE EFFECTS: none
+ */
+static uint32_t bench_best(uint32_t (*bench)(void)){
+	uint32_t i, cycles, best = 0xFFFFFFFF;
+
+	for(i = 0; i < BENCH_ROUNDS; i++){
+		cycles = bench();
+		if(cycles < best){
+			best = cycles;
+		}
+	}
+	return best;
+}
+
+
+/* Test suite entry point */
+void launch_tests(){
+	TEST_OUTPUT("idt_test", idt_test());
+	// launch your tests here
+  TEST_OUTPUT("idt_test2", idt_test_2());
+  TEST_OUTPUT("idt_test3", idt_test_3());
+	// page_fault_test0();
+	// page_fault_test1();
+	// page_fault_test2();
+	// page_fault_test3();
+	// page_fault_test4();
+	// page_fault_test5();
+	// page_fault_test6();
+  // divide_zero_test();
+  TEST_OUTPUT("page_directory_test", page_directory_test());
+  TEST_OUTPUT("page_table_test", page_table_test());
+
+	/* Checkpoint 2 tests */
+	//buffer_write();
+	// file_index_test(0);
+	// file_index_test(1);
+	// dir_read_test();
+  //uint8_t name[] = "frame0.txt";
+	//read_file_test(name);
+	//uint8_t name[] = "frame1.txt";
+	//read_file_test(name);
+	//uint8_t name[] = "verylargetextwithverylongname.tx";
+	//read_file_test(name);
+	//uint8_t name[] = "cat";
+	//read_file_test(name);
+	//uint8_t name[] = "fish";
+	//read_file_test(name);
+	//uint8_t name[] = "counter";
+	//read_file_test(name);
+	//uint8_t name[] = "grep";
+	//read_file_test(name);
+	//uint8_t name[] = "hello";
+	//read_file_test(name);
+	//uint8_t name[] = "ls";
+	//read_file_test(name);
+	//uint8_t name[] = "pingpong";
+	//read_file_test(name);
+	//uint8_t name[] = "shell";
+	//read_file_test(name);
+	//uint8_t name[] = "sigtest";
+	//read_file_test(name);
+	//uint8_t name[] = "syserr";
+	//read_file_test(name);
+	//uint8_t name[] = "testprint";
+	//read_file_test(name);
+	//rtc_write_test();
+	// rtc_read_test();
+	//rtc_open_test();
+	fread_fail_test();
+	dread_fail_test();
+	//read_test();
+
+	/* checkpoint 3 tests */
+	open_null_test();
+	open_test_fail();
+	execute_fail_test();
+	execute_fail_test_2();
+	read_test_fail_1();
+	read_test_fail_2();
+	read_test_fail_3();
+	read_test_fail_4();
+	read_test_fail_5();
+	write_test_fail_1();
+	write_test_fail_2();
+	write_test_fail_3();
+	write_test_fail_4();
+	write_test_fail_5();
+	write_test_fail_6();
+	close_test_fail_1();
+	close_test_fail_2();
+	close_fail_1();
+	close_fail_2();
+	close_fail_3();
+	close_fail_4();
+	close_fail_5();
+	// fd_file_read_test();
+	// fd_dir_read_test();
+	TEST_OUTPUT("rtc_system_call_test", rtc_system_call_test());
+	// pcb_overflow();
+
+	/* Checkpoint 4 tests */
+	vidmap_test_1();
+	vidmap_test_2();
+	getargs_test_1();
+
+	/* Checkpoint 5 tests */
+	TEST_OUTPUT("read_data_chunk_test", read_data_chunk_test());
+	TEST_OUTPUT("read_data_aligned_test", read_data_aligned_test());
+	TEST_OUTPUT("read_data_indirect_test", read_data_indirect_test());
+	TEST_OUTPUT("find_dentry_test", find_dentry_test());
+	TEST_OUTPUT("large_image_test", large_image_test());
+	TEST_OUTPUT("fs_overlay_write_test", fs_overlay_write_test());
+	TEST_OUTPUT("fs_append_throughput_test", fs_append_throughput_test());
+	TEST_OUTPUT("lseek_pread_pwrite_test", lseek_pread_pwrite_test());
+	TEST_OUTPUT("getdents_test", getdents_test());
+	TEST_OUTPUT("fd_table_grow_test", fd_table_grow_test());
+	TEST_OUTPUT("pipe_test", pipe_test());
+	TEST_OUTPUT("shm_test", shm_test());
+	TEST_OUTPUT("trace_test", trace_test());
+	TEST_OUTPUT("thread_test", thread_test());
+	TEST_OUTPUT("spawn_wait_test", spawn_wait_test());
+	TEST_OUTPUT("poll_test", poll_test());
+	TEST_OUTPUT("epoll_test", epoll_test());
+	TEST_OUTPUT("signal_test", signal_test());
+	TEST_OUTPUT("terminal_batch_test", terminal_batch_test());
+	TEST_OUTPUT("hw_scroll_test", hw_scroll_test());
+	TEST_OUTPUT("page_flip_test", page_flip_test());
+	TEST_OUTPUT("shadow_flush_test", shadow_flush_test());
+	TEST_OUTPUT("scrollback_test", scrollback_test());
+	TEST_OUTPUT("kb_ring_test", kb_ring_test());
+	TEST_OUTPUT("ldisc_test", ldisc_test());
+	TEST_OUTPUT("klog_test", klog_test());
+	TEST_OUTPUT("serial_test", serial_test());
+}
+
+/*
+ * launch_headless
+ *    DESCRIPTION: Runs the tests and benchmarks for a host watching the serial
+ *                 port, then exits QEMU. Each result is a line: "TEST <name>
+ *                 PASS|FAIL", "BENCH <name> <value> <unit>", and last
+ *                 "DONE <passed> <failed>"
+ *    INPUTS: none
+ *    OUTPUTS: none
+ *    RETURN VALUE: none, never returns
+ *    SIDE EFFECTS: Writes 0 to the exit device if every test passed, 1 if not,
+ *                  so QEMU's exit status is 1 or 3. Halts if there is no device
+ */
+void launch_headless(){
+	report("BEGIN");
+	launch_tests();
+
+	report("BENCH tsc %u kHz", bench_tsc_khz());
+	report("BENCH syscall %u cycles/call", bench_best(bench_syscall) / BENCH_CALLS);
+	report("BENCH switch %u cycles/switch", bench_best(bench_switch) / (2 * BENCH_SWITCHES));
+	report("BENCH read_data %u cycles/KB", bench_best(bench_read_data));
+	report("BENCH terminal_write %u cycles/KB", bench_best(bench_terminal_write));
+
+	report("DONE %d %d", tests_passed, tests_failed);
+	serial_flush();
+	outb(tests_failed ? 1 : 0, DEBUG_EXIT_PORT);
+
+	cli();
+	asm volatile ("1: hlt; jmp 1b;");
 }
@@ -4,4 +4,7 @@
 // test launcher
 void launch_tests();
 
+// run the tests and benchmarks, reporting over serial, then exit QEMU
+void launch_headless();
+
 #endif /* TESTS_H */
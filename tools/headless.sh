@@ -0,0 +1,66 @@
+#!/bin/bash
+# headless.sh - Host script that boots the kernel in QEMU with "headless" on
+# its command line, so it runs the tests and benchmarks, reports them over
+# serial, and exits QEMU through the isa-debug-exit device
+#
+# Usage: tools/headless.sh [baseline]
+#   Run from the directory with bootimg and filesys_img. Prints the TEST,
+#   BENCH and DONE lines, so the output of one run can be saved as the
+#   baseline for the next. Given a baseline, also compares each benchmark
+#   to it on stderr.
+#
+# Exits 0 if every test passed and no benchmark got more than SLACK percent
+# slower than the baseline, 1 if not, 2 if the run never finished.
+#
+# FS=filesys_big_img, from make -C tools bigimage, also runs large_image_test
+# over an image larger than 4 MB.
+#
+# Environment: KERNEL (bootimg), FS (filesys_img), QEMU (qemu-system-i386),
+#              TIMEOUT in seconds (120), SLACK in percent (10)
+
+KERNEL=${KERNEL:-bootimg}
+FS=${FS:-filesys_img}
+QEMU=${QEMU:-qemu-system-i386}
+TIMEOUT=${TIMEOUT:-120}
+SLACK=${SLACK:-10}
+
+LOG=$(mktemp)
+trap 'rm -f "$LOG"' EXIT
+
+# The kernel writes 0 to the exit device when every test passed and 1 if not,
+# and QEMU exits with (value << 1) | 1
+timeout "$TIMEOUT" "$QEMU" -m 256 -display none -no-reboot \
+    -device isa-debug-exit,iobase=0xf4,iosize=0x04 \
+    -serial file:"$LOG" \
+    -kernel "$KERNEL" -initrd "$FS" -append headless
+status=$?
+
+# The log ring also drains to serial, keep only the results
+tr -d '\r' < "$LOG" | grep -E '^(BEGIN|TEST|BENCH|DONE)( |$)'
+
+if ! grep -q '^DONE ' "$LOG"; then
+    echo "headless: the run did not finish (QEMU status $status)" >&2
+    exit 2
+fi
+
+result=0
+if [ "$status" -ne 1 ]; then
+    result=1
+fi
+
+# Cycle counts only, the tsc line is a rate
+if [ $# -ge 1 ]; then
+    tr -d '\r' < "$LOG" | awk -v slack="$SLACK" '
+        NR == FNR {
+            if ($1 == "BENCH" && $4 ~ /^cycles/) base[$2] = $3
+            next
+        }
+        $1 == "BENCH" && ($2 in base) && base[$2] > 0 {
+            pct = ($3 - base[$2]) * 100 / base[$2]
+            printf "%-16s %10d %10d %+7.1f%%\n", $2, base[$2], $3, pct > "/dev/stderr"
+            if (pct > slack) slower = 1
+        }
+        END { exit slower }' "$1" - || result=1
+fi
+
+exit $result
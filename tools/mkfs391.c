@@ -0,0 +1,595 @@
+/* mkfs391.c - Host tool that builds and checks file system images
+ *
+ * Builds filesys_img from a directory in the format file_system.c reads:
+ * a boot block of dentries, one 4 kB block per inode, then data blocks.
+ * Each file's data blocks are laid out back to back so the kernel's
+ * read_data can copy whole extents at once, and dentries are sorted so
+ * find_dentry can binary search them.
+ *
+ * Usage: mkfs391 -i <dir> -o <image>   build an image from the files in dir
+ *        mkfs391 -c <image>            check an image and report fragmentation
+ *        -v                            also list every file's extents
+ */
+
+#include <dirent.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+/* Image format, must match file_system.h */
+#define BLOCK_SIZE          4096
+#define NAME_LENGTH         32
+#define MAX_DENTRIES        63
+#define INODE_BLOCK_NUM     1023
+#define PTRS_PER_BLOCK      1024
+#define DIRECT_BLOCK_NUM    1021
+#define SINGLE_INDIRECT     1021
+#define DOUBLE_INDIRECT     1022
+#define FS_FEATURE_INDIRECT 0x1
+#define FS_FEATURE_SORTED   0x2
+
+/* File types */
+#define TYPE_RTC            0
+#define TYPE_DIR            1
+#define TYPE_FILE           2
+
+typedef struct dentry {
+  char file_name[NAME_LENGTH];
+  uint32_t file_type;
+  uint32_t inode_num;
+  uint32_t reserved24[6];
+} dentry_t;
+
+typedef struct boot_block {
+  uint32_t num_dentries;
+  uint32_t num_inodes;
+  uint32_t num_dblocks;
+  uint32_t feature_flags;
+  uint32_t reserved48[12];
+  dentry_t dentries[MAX_DENTRIES];
+} boot_block_t;
+
+typedef struct inode {
+  uint32_t length;
+  uint32_t dblocks[INODE_BLOCK_NUM];
+} inode_t;
+
+/* File picked up from the input directory */
+typedef struct input_file {
+  char name[NAME_LENGTH + 1];
+  char path[4096];
+  uint32_t length;
+} input_file_t;
+
+static int verbose = 0;
+
+/*
+ * blocks_for
+ *    DESCRIPTION: Counts the data blocks a file needs
+ *    INPUTS: uint32_t length - file length in bytes
+ *    OUTPUTS: none
+ *    RETURN VALUE: number of 4 kB data blocks
+ *    SIDE EFFECTS: none
+ */
+static uint32_t blocks_for(uint32_t length){
+  return (length + BLOCK_SIZE - 1) / BLOCK_SIZE;
+}
+
+/*
+ * pointer_blocks_for
+ *    DESCRIPTION: Counts the indirect blocks a file needs
+ *    INPUTS: uint32_t nblocks - number of data blocks in the file
+ *    OUTPUTS: none
+ *    RETURN VALUE: number of single and double indirect blocks
+ *    SIDE EFFECTS: none
+ */
+static uint32_t pointer_blocks_for(uint32_t nblocks){
+  if(nblocks <= DIRECT_BLOCK_NUM){
+    return 0;
+  }
+  nblocks -= DIRECT_BLOCK_NUM;
+  if(nblocks <= PTRS_PER_BLOCK){
+    return 1;
+  }
+  nblocks -= PTRS_PER_BLOCK;
+
+  /* Single indirect, double indirect, and its second level tables */
+  return 2 + (nblocks + PTRS_PER_BLOCK - 1) / PTRS_PER_BLOCK;
+}
+
+/*
+ * compare_names
+ *    DESCRIPTION: qsort comparison of input files by name
+ *    INPUTS: const void* a, const void* b - input_file_t pointers
+ *    OUTPUTS: none
+ *    RETURN VALUE: <0, 0 or >0 like strncmp
+ *    SIDE EFFECTS: none
+ */
+static int compare_names(const void* a, const void* b){
+  return strncmp(((const input_file_t*)a)->name, ((const input_file_t*)b)->name, NAME_LENGTH);
+}
+
+/*
+ * block_entry
+ *    DESCRIPTION: Finds the block number entry for a block of a file, the
+ *                 same way file_system.c's get_block_run does
+ *    INPUTS: uint8_t* image - the image
+ *            inode_t* inode - the file's inode
+ *            uint32_t index - which block of the file to find
+ *    OUTPUTS: none
+ *    RETURN VALUE: pointer to the entry, or NULL if a table is out of range
+ *    SIDE EFFECTS: none
+ */
+static uint32_t* block_entry(uint8_t* image, inode_t* inode, uint32_t index){
+  boot_block_t* boot = (boot_block_t*)image;
+  uint8_t* dblocks = image + (boot->num_inodes + 1) * BLOCK_SIZE;
+  uint32_t* table;
+
+  if(!(boot->feature_flags & FS_FEATURE_INDIRECT)){
+    return index < INODE_BLOCK_NUM ? &inode->dblocks[index] : NULL;
+  }
+  if(index < DIRECT_BLOCK_NUM){
+    return &inode->dblocks[index];
+  }
+  index -= DIRECT_BLOCK_NUM;
+  if(index < PTRS_PER_BLOCK){
+    if(inode->dblocks[SINGLE_INDIRECT] >= boot->num_dblocks){
+      return NULL;
+    }
+    table = (uint32_t*)(dblocks + inode->dblocks[SINGLE_INDIRECT] * BLOCK_SIZE);
+    return &table[index];
+  }
+  index -= PTRS_PER_BLOCK;
+  if(inode->dblocks[DOUBLE_INDIRECT] >= boot->num_dblocks){
+    return NULL;
+  }
+  table = (uint32_t*)(dblocks + inode->dblocks[DOUBLE_INDIRECT] * BLOCK_SIZE);
+  if(table[index / PTRS_PER_BLOCK] >= boot->num_dblocks){
+    return NULL;
+  }
+  table = (uint32_t*)(dblocks + table[index / PTRS_PER_BLOCK] * BLOCK_SIZE);
+  return &table[index % PTRS_PER_BLOCK];
+}
+
+/*
+ * mark_block
+ *    DESCRIPTION: Records that a data block is in use, catching blocks
+ *                 shared between files
+ *    INPUTS: uint8_t* used - one byte per data block
+ *            uint32_t num_dblocks - number of data blocks in the image
+ *            uint32_t block - block to mark
+ *            const char* name - file that owns the block, for errors
+ *    OUTPUTS: error message on failure
+ *    RETURN VALUE: 0 for success, -1 for failure
+ *    SIDE EFFECTS: Sets used[block]
+ */
+static int mark_block(uint8_t* used, uint32_t num_dblocks, uint32_t block, const char* name){
+  if(block >= num_dblocks){
+    fprintf(stderr, "%.32s: block %u is past the end of the image\n", name, block);
+    return -1;
+  }
+  if(used[block]){
+    fprintf(stderr, "%.32s: block %u is used twice\n", name, block);
+    return -1;
+  }
+  used[block] = 1;
+  return 0;
+}
+
+/*
+ * check_image
+ *    DESCRIPTION: Verifies the dentry, inode and block tables of an image and
+ *                 prints fragmentation statistics
+ *    INPUTS: uint8_t* image - the image
+ *            size_t size - number of bytes in the image
+ *    OUTPUTS: statistics on stdout, errors on stderr
+ *    RETURN VALUE: 0 for a good image, -1 for a bad one
+ *    SIDE EFFECTS: none
+ */
+static int check_image(uint8_t* image, size_t size){
+  boot_block_t* boot = (boot_block_t*)image;
+  uint8_t* used;
+  uint32_t i, j;
+  uint32_t files = 0, blocks = 0, extents = 0, fragmented = 0, max_extents = 0;
+  int ret = 0;
+
+  if(size < BLOCK_SIZE || boot->num_dentries > MAX_DENTRIES ||
+     (uint64_t)(boot->num_inodes + 1 + boot->num_dblocks) * BLOCK_SIZE > size){
+    fprintf(stderr, "boot block counts don't fit the image\n");
+    return -1;
+  }
+  if((used = calloc(boot->num_dblocks + 1, 1)) == NULL){
+    perror("calloc");
+    return -1;
+  }
+
+  for(i = 0; i < boot->num_dentries; i++){
+    dentry_t* dentry = &boot->dentries[i];
+    inode_t* inode;
+    uint32_t nblocks, file_extents = 1;
+    uint32_t* entry;
+    uint32_t prev = 0;
+
+    /* Names must be unique, and in order when the image says they're sorted */
+    for(j = 0; j < i; j++){
+      if(strncmp(boot->dentries[j].file_name, dentry->file_name, NAME_LENGTH) == 0){
+        fprintf(stderr, "%.32s: duplicate name\n", dentry->file_name);
+        ret = -1;
+      }
+    }
+    if((boot->feature_flags & FS_FEATURE_SORTED) && i > 1 &&
+       strncmp(boot->dentries[i - 1].file_name, dentry->file_name, NAME_LENGTH) > 0){
+      fprintf(stderr, "%.32s: dentries are flagged sorted but out of order\n", dentry->file_name);
+      ret = -1;
+    }
+    if(dentry->file_type > TYPE_FILE){
+      fprintf(stderr, "%.32s: bad file type %u\n", dentry->file_name, dentry->file_type);
+      ret = -1;
+      continue;
+    }
+    if(dentry->file_type != TYPE_FILE){
+      continue;
+    }
+    if(dentry->inode_num >= boot->num_inodes){
+      fprintf(stderr, "%.32s: inode %u out of range\n", dentry->file_name, dentry->inode_num);
+      ret = -1;
+      continue;
+    }
+
+    inode = (inode_t*)(image + (dentry->inode_num + 1) * BLOCK_SIZE);
+    nblocks = blocks_for(inode->length);
+    if(!(boot->feature_flags & FS_FEATURE_INDIRECT) && nblocks > INODE_BLOCK_NUM){
+      fprintf(stderr, "%.32s: %u blocks need indirect blocks\n", dentry->file_name, nblocks);
+      ret = -1;
+      continue;
+    }
+
+    /* Indirect tables count as used blocks too */
+    if((boot->feature_flags & FS_FEATURE_INDIRECT) && nblocks > DIRECT_BLOCK_NUM){
+      if(mark_block(used, boot->num_dblocks, inode->dblocks[SINGLE_INDIRECT], dentry->file_name)){
+        ret = -1;
+        continue;
+      }
+      if(nblocks > DIRECT_BLOCK_NUM + PTRS_PER_BLOCK){
+        uint32_t* table;
+        if(mark_block(used, boot->num_dblocks, inode->dblocks[DOUBLE_INDIRECT], dentry->file_name)){
+          ret = -1;
+          continue;
+        }
+        table = (uint32_t*)(image + (boot->num_inodes + 1 + inode->dblocks[DOUBLE_INDIRECT]) * BLOCK_SIZE);
+        for(j = 0; j * PTRS_PER_BLOCK < nblocks - DIRECT_BLOCK_NUM - PTRS_PER_BLOCK; j++){
+          if(mark_block(used, boot->num_dblocks, table[j], dentry->file_name)){
+            ret = -1;
+            break;
+          }
+        }
+      }
+    }
+
+    /* Walk the data blocks, counting runs of consecutive block numbers */
+    for(j = 0; j < nblocks; j++){
+      if((entry = block_entry(image, inode, j)) == NULL || mark_block(used, boot->num_dblocks, *entry, dentry->file_name)){
+        ret = -1;
+        break;
+      }
+      if(j > 0 && *entry != prev + 1){
+        file_extents++;
+      }
+      prev = *entry;
+    }
+
+    if(nblocks == 0){
+      file_extents = 0;
+    }
+    if(verbose){
+      printf("%-32.32s inode %3u  %9u bytes  %6u blocks  %4u extents\n",
+             dentry->file_name, dentry->inode_num, inode->length, nblocks, file_extents);
+    }
+    files++;
+    blocks += nblocks;
+    extents += file_extents;
+    if(file_extents > 1){
+      fragmented++;
+    }
+    if(file_extents > max_extents){
+      max_extents = file_extents;
+    }
+  }
+
+  printf("%u dentries, %u inodes, %u data blocks%s%s\n", boot->num_dentries, boot->num_inodes, boot->num_dblocks,
+         (boot->feature_flags & FS_FEATURE_INDIRECT) ? ", indirect blocks" : "",
+         (boot->feature_flags & FS_FEATURE_SORTED) ? ", sorted dentries" : "");
+  printf("%u files in %u blocks: %u extents, %u fragmented files, at most %u extents per file",
+         files, blocks, extents, fragmented, max_extents);
+  if(blocks > files){
+    /* Block to block steps that aren't contiguous */
+    printf(", %.1f%% of block steps discontiguous", 100.0 * (extents - files) / (blocks - files));
+  }
+  printf("\n");
+
+  free(used);
+  return ret;
+}
+
+/*
+ * read_dir
+ *    DESCRIPTION: Collects the regular files of a directory, sorted by name
+ *    INPUTS: const char* dir_name - directory to read
+ *            input_file_t* files - array to fill
+ *            int max - size of files
+ *    OUTPUTS: error messages on stderr
+ *    RETURN VALUE: number of files, or -1 for failure
+ *    SIDE EFFECTS: none
+ */
+static int read_dir(const char* dir_name, input_file_t* files, int max){
+  DIR* dir;
+  struct dirent* ent;
+  struct stat st;
+  int count = 0;
+
+  if((dir = opendir(dir_name)) == NULL){
+    perror(dir_name);
+    return -1;
+  }
+  while((ent = readdir(dir)) != NULL){
+    if(ent->d_name[0] == '.'){
+      continue;
+    }
+    if(count == max){
+      fprintf(stderr, "too many files, the boot block holds %d dentries\n", MAX_DENTRIES);
+      closedir(dir);
+      return -1;
+    }
+    snprintf(files[count].path, sizeof(files[count].path), "%s/%s", dir_name, ent->d_name);
+    if(stat(files[count].path, &st) != 0 || !S_ISREG(st.st_mode)){
+      continue;
+    }
+    if((uint64_t)st.st_size > 0xFFFFFFFFu){
+      fprintf(stderr, "%s: larger than 4 GB\n", ent->d_name);
+      closedir(dir);
+      return -1;
+    }
+    /* Like createfs, long names keep their first NAME_LENGTH characters */
+    if(strlen(ent->d_name) > NAME_LENGTH){
+      fprintf(stderr, "%s: name truncated to %d characters\n", ent->d_name, NAME_LENGTH);
+    }
+    strncpy(files[count].name, ent->d_name, NAME_LENGTH);
+    files[count].name[NAME_LENGTH] = '\0';
+    files[count].length = (uint32_t)st.st_size;
+    count++;
+  }
+  closedir(dir);
+
+  qsort(files, count, sizeof(input_file_t), compare_names);
+  return count;
+}
+
+/*
+ * build_image
+ *    DESCRIPTION: Lays out the files of a directory into an image. Each
+ *                 file's data blocks are contiguous and its indirect
+ *                 tables follow its data.
+ *    INPUTS: const char* dir_name - directory to read
+ *            size_t* size - set to the image size
+ *    OUTPUTS: error messages on stderr
+ *    RETURN VALUE: the image, or NULL for failure
+ *    SIDE EFFECTS: Allocates the image
+ */
+static uint8_t* build_image(const char* dir_name, size_t* size){
+  static input_file_t files[MAX_DENTRIES];
+  boot_block_t* boot;
+  uint8_t* image;
+  uint8_t* dblocks;
+  uint32_t num_dblocks = 0, next = 0;
+  int count, i, d = 0;
+  int rtc_added = 0;
+
+  /* Leave room for "." and "rtc" */
+  if((count = read_dir(dir_name, files, MAX_DENTRIES - 2)) < 0){
+    return NULL;
+  }
+  for(i = 0; i < count; i++){
+    uint64_t total = (uint64_t)num_dblocks + blocks_for(files[i].length) + pointer_blocks_for(blocks_for(files[i].length));
+    if(total > 0xFFFFFFFFu / BLOCK_SIZE){
+      fprintf(stderr, "image would be larger than 4 GB\n");
+      return NULL;
+    }
+    num_dblocks = (uint32_t)total;
+  }
+
+  *size = (size_t)(1 + count + num_dblocks) * BLOCK_SIZE;
+  if((image = calloc(*size, 1)) == NULL){
+    perror("calloc");
+    return NULL;
+  }
+  boot = (boot_block_t*)image;
+  dblocks = image + (1 + count) * BLOCK_SIZE;
+  boot->num_inodes = count;
+  boot->num_dblocks = num_dblocks;
+  boot->feature_flags = FS_FEATURE_SORTED;
+
+  /* "." always comes first, the rest are in name order with "rtc" merged in */
+  strncpy(boot->dentries[d].file_name, ".", NAME_LENGTH);
+  boot->dentries[d++].file_type = TYPE_DIR;
+
+  for(i = 0; i <= count; i++){
+    inode_t* inode;
+    uint32_t nblocks, b, first;
+    FILE* fp;
+
+    if(!rtc_added && (i == count || strncmp("rtc", files[i].name, NAME_LENGTH) < 0)){
+      strncpy(boot->dentries[d].file_name, "rtc", NAME_LENGTH);
+      boot->dentries[d++].file_type = TYPE_RTC;
+      rtc_added = 1;
+    }
+    if(i == count){
+      break;
+    }
+    if(strncmp("rtc", files[i].name, NAME_LENGTH) == 0){
+      fprintf(stderr, "rtc: name is reserved for the RTC device\n");
+      free(image);
+      return NULL;
+    }
+
+    memcpy(boot->dentries[d].file_name, files[i].name, strlen(files[i].name));
+    boot->dentries[d].file_type = TYPE_FILE;
+    boot->dentries[d++].inode_num = i;
+
+    inode = (inode_t*)(image + (i + 1) * BLOCK_SIZE);
+    inode->length = files[i].length;
+    nblocks = blocks_for(files[i].length);
+
+    /* Data goes in one run starting at the next free block */
+    if((fp = fopen(files[i].path, "rb")) == NULL || fread(dblocks + (size_t)next * BLOCK_SIZE, 1, files[i].length, fp) != files[i].length){
+      perror(files[i].path);
+      if(fp != NULL){
+        fclose(fp);
+      }
+      free(image);
+      return NULL;
+    }
+    fclose(fp);
+    first = next;
+    next += nblocks;
+
+    if(nblocks > INODE_BLOCK_NUM){
+      boot->feature_flags |= FS_FEATURE_INDIRECT;
+    }
+    for(b = 0; b < nblocks && b < DIRECT_BLOCK_NUM; b++){
+      inode->dblocks[b] = first + b;
+    }
+    /* Small files in old-layout images can use the last two entries directly */
+    for(; b < nblocks && b < INODE_BLOCK_NUM && !(boot->feature_flags & FS_FEATURE_INDIRECT); b++){
+      inode->dblocks[b] = first + b;
+    }
+  }
+
+  /* With indirect blocks on, every file past DIRECT_BLOCK_NUM gets its tables */
+  for(i = 0; i < count; i++){
+    inode_t* inode = (inode_t*)(image + (i + 1) * BLOCK_SIZE);
+    uint32_t nblocks = blocks_for(inode->length);
+    uint32_t first = inode->dblocks[0];
+    uint32_t b, t;
+    uint32_t* table;
+
+    if(!(boot->feature_flags & FS_FEATURE_INDIRECT) || nblocks <= DIRECT_BLOCK_NUM){
+      continue;
+    }
+    inode->dblocks[SINGLE_INDIRECT] = next;
+    table = (uint32_t*)(dblocks + (size_t)next++ * BLOCK_SIZE);
+    for(b = DIRECT_BLOCK_NUM; b < nblocks && b < DIRECT_BLOCK_NUM + PTRS_PER_BLOCK; b++){
+      table[b - DIRECT_BLOCK_NUM] = first + b;
+    }
+    if(b == nblocks){
+      continue;
+    }
+    inode->dblocks[DOUBLE_INDIRECT] = next;
+    table = (uint32_t*)(dblocks + (size_t)next++ * BLOCK_SIZE);
+    for(t = 0; b < nblocks; t++){
+      uint32_t* second = (uint32_t*)(dblocks + (size_t)next * BLOCK_SIZE);
+      uint32_t k;
+      table[t] = next++;
+      for(k = 0; k < PTRS_PER_BLOCK && b < nblocks; k++, b++){
+        second[k] = first + b;
+      }
+    }
+  }
+
+  boot->num_dentries = d;
+  return image;
+}
+
+/*
+ * load_image
+ *    DESCRIPTION: Reads an image file into memory
+ *    INPUTS: const char* name - image file
+ *            size_t* size - set to the image size
+ *    OUTPUTS: error messages on stderr
+ *    RETURN VALUE: the image, or NULL for failure
+ *    SIDE EFFECTS: Allocates the image
+ */
+static uint8_t* load_image(const char* name, size_t* size){
+  FILE* fp;
+  uint8_t* image;
+  long len;
+
+  if((fp = fopen(name, "rb")) == NULL || fseek(fp, 0, SEEK_END) != 0 || (len = ftell(fp)) < 0){
+    perror(name);
+    if(fp != NULL){
+      fclose(fp);
+    }
+    return NULL;
+  }
+  rewind(fp);
+  if((image = malloc(len > 0 ? len : 1)) == NULL || fread(image, 1, len, fp) != (size_t)len){
+    perror(name);
+    free(image);
+    fclose(fp);
+    return NULL;
+  }
+  fclose(fp);
+  *size = len;
+  return image;
+}
+
+int main(int argc, char** argv){
+  const char* in_dir = NULL;
+  const char* out_name = NULL;
+  const char* check_name = NULL;
+  uint8_t* image;
+  size_t size;
+  FILE* fp;
+  int i;
+
+  for(i = 1; i < argc; i++){
+    if(strcmp(argv[i], "-v") == 0){
+      verbose = 1;
+    } else if(strcmp(argv[i], "-i") == 0 && i + 1 < argc){
+      in_dir = argv[++i];
+    } else if(strcmp(argv[i], "-o") == 0 && i + 1 < argc){
+      out_name = argv[++i];
+    } else if(strcmp(argv[i], "-c") == 0 && i + 1 < argc){
+      check_name = argv[++i];
+    } else{
+      break;
+    }
+  }
+  if(i != argc || (check_name == NULL) == (in_dir == NULL || out_name == NULL)){
+    fprintf(stderr, "usage: %s [-v] -i <dir> -o <image>\n       %s [-v] -c <image>\n", argv[0], argv[0]);
+    return 1;
+  }
+
+  /* Check an existing image, e.g. one made by createfs */
+  if(check_name != NULL){
+    if((image = load_image(check_name, &size)) == NULL){
+      return 1;
+    }
+    i = check_image(image, size);
+    free(image);
+    return i ? 1 : 0;
+  }
+
+  if((image = build_image(in_dir, &size)) == NULL){
+    return 1;
+  }
+
+  /* Never write out an image the kernel would trip over */
+  if(check_image(image, size) != 0){
+    fprintf(stderr, "internal error: built image failed verification\n");
+    free(image);
+    return 1;
+  }
+  if((fp = fopen(out_name, "wb")) == NULL || fwrite(image, 1, size, fp) != size){
+    perror(out_name);
+    free(image);
+    if(fp != NULL){
+      fclose(fp);
+    }
+    return 1;
+  }
+  fclose(fp);
+  free(image);
+  return 0;
+}
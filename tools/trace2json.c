@@ -0,0 +1,354 @@
+/* trace2json.c - Host tool that turns a kernel trace dump into Chrome trace-event JSON
+ *
+ * The dump is the kernel's trace_log ring byte for byte, either from gdb:
+ *     (gdb) dump binary value trace.bin trace_log
+ * or copied out by a program with the trace_ctl system call. The output
+ * loads in chrome://tracing or ui.perfetto.dev. The "cpu0" track shows
+ * which process ran when and the keyboard interrupts, the "processes"
+ * track has one row per pid with its system calls, read_data calls,
+ * executes and halts.
+ *
+ * Usage: trace2json [-m <MHz>] <dump> [<out.json>]
+ *        -m   time stamp counter rate, when the dump has no PIT ticks to
+ *             work it out from
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Ring format, must match trace.h */
+#define TRACE_MAGIC            0x45435254
+#define TRACE_SYSCALL_ENTER    1
+#define TRACE_SYSCALL_EXIT     2
+#define TRACE_SWITCH           3
+#define TRACE_EXECUTE          4
+#define TRACE_HALT             5
+#define TRACE_READ_DATA_ENTER  6
+#define TRACE_READ_DATA_EXIT   7
+#define TRACE_KEYBOARD_ENTER   8
+#define TRACE_KEYBOARD_EXIT    9
+
+/* PIT interrupts per second, must match pit.h */
+#define PIT_HZ                 100
+
+/* Process slots, must match syscalls.h */
+#define MAX_PROGS              6
+
+/* Slices open at once on one row */
+#define MAX_DEPTH              16
+
+typedef struct trace_rec {
+  uint32_t tsc_lo;
+  uint32_t tsc_hi;
+  uint16_t event;
+  uint16_t pid;
+  uint32_t arg;
+} trace_rec;
+
+typedef struct trace_header {
+  uint32_t magic;
+  uint32_t head;
+  uint32_t num_records;
+  uint32_t ticks;
+  uint32_t tsc_start_lo;
+  uint32_t tsc_start_hi;
+  uint32_t tsc_tick_lo;
+  uint32_t tsc_tick_hi;
+} trace_header;
+
+/* Chrome pids of the two tracks */
+#define TRACK_CPU              0
+#define TRACK_PROCS            1
+
+/* A slice that has started but not ended */
+typedef struct open_slice {
+  uint16_t event;                  /* The *_ENTER event */
+  uint32_t arg;
+  uint64_t tsc;
+} open_slice;
+
+/* Open slices of one row */
+typedef struct slice_stack {
+  open_slice slices[MAX_DEPTH];
+  int depth;
+} slice_stack;
+
+/* System call names, by number */
+static const char* syscall_names[] = {
+  "?", "halt", "execute", "read", "write", "open", "close", "getargs",
+  "vidmap", "set_handler", "sigreturn", "lseek", "pread", "pwrite",
+  "getdents", "pipe", "shm_create", "shm_attach", "shm_detach", "trace_ctl",
+  "thread_create", "thread_exit", "thread_join", "spawn", "wait", "poll",
+  "epoll_create", "epoll_ctl", "epoll_wait", "ioctl"
+};
+#define NUM_SYSCALL_NAMES (sizeof(syscall_names) / sizeof(syscall_names[0]))
+
+static FILE* out;
+static uint64_t tsc_zero;          /* Time stamp counter of the first record */
+static double tsc_per_us;          /* Counter ticks per microsecond */
+
+/* One row per pid, and row 0 is the CPU's interrupts */
+static slice_stack rows[MAX_PROGS + 1];
+
+/*
+ * to_us
+ *    DESCRIPTION: Converts a time stamp counter value to the trace's clock
+ *    INPUTS: uint64_t tsc - counter value
+ *    OUTPUTS: none
+ *    RETURN VALUE: microseconds since the first record
+ *    SIDE EFFECTS: none
+ */
+static double to_us(uint64_t tsc){
+  return (double)(tsc - tsc_zero) / tsc_per_us;
+}
+
+/*
+ * slice_name
+ *    DESCRIPTION: Names a slice for the timeline
+ *    INPUTS: uint16_t event - the *_ENTER event that started it
+ *            uint32_t arg - what that event carried
+ *    OUTPUTS: none
+ *    RETURN VALUE: the name
+ *    SIDE EFFECTS: none
+ */
+static const char* slice_name(uint16_t event, uint32_t arg){
+  switch(event){
+    case TRACE_SYSCALL_ENTER:
+      return arg < NUM_SYSCALL_NAMES ? syscall_names[arg] : "syscall?";
+    case TRACE_READ_DATA_ENTER:
+      return "read_data";
+    case TRACE_KEYBOARD_ENTER:
+      return "keyboard";
+    default:
+      return "?";
+  }
+}
+
+/*
+ * emit
+ *    DESCRIPTION: Writes one trace event
+ *    INPUTS: const char* name - what shows on the timeline
+ *            char ph - Chrome phase, 'X' for a slice or 'i' for an instant
+ *            int track, tid - where it shows
+ *            uint64_t start, end - counter values, end is ignored for 'i'
+ *            const char* key - name of the argument, or NULL for none
+ *            int32_t value - the argument
+ *    OUTPUTS: JSON to out
+ *    RETURN VALUE: none
+ *    SIDE EFFECTS: none
+ */
+static void emit(const char* name, char ph, int track, int tid, uint64_t start, uint64_t end,
+                 const char* key, int32_t value){
+  fprintf(out, ",\n{\"name\":\"%s\",\"ph\":\"%c\",\"pid\":%d,\"tid\":%d,\"ts\":%.3f",
+          name, ph, track, tid, to_us(start));
+  if(ph == 'X'){
+    fprintf(out, ",\"dur\":%.3f", to_us(end) - to_us(start));
+  } else{
+    fprintf(out, ",\"s\":\"t\"");
+  }
+  if(key != NULL){
+    fprintf(out, ",\"args\":{\"%s\":%d}", key, value);
+  }
+  fprintf(out, "}");
+}
+
+/*
+ * row_for
+ *    DESCRIPTION: Finds the row an event's slice goes on
+ *    INPUTS: const trace_rec* rec - the event
+ *    OUTPUTS: none
+ *    RETURN VALUE: the row, 0 for interrupts
+ *    SIDE EFFECTS: none
+ */
+static int row_for(const trace_rec* rec){
+  if(rec->event == TRACE_KEYBOARD_ENTER || rec->event == TRACE_KEYBOARD_EXIT || rec->pid > MAX_PROGS){
+    return 0;
+  }
+  return rec->pid;
+}
+
+/*
+ * close_slice
+ *    DESCRIPTION: Ends the top open slice of a row
+ *    INPUTS: int row - the row
+ *            uint64_t tsc - when it ended
+ *            int has_ret - whether ret is the slice's result
+ *            int32_t ret - the result
+ *    OUTPUTS: the slice to out
+ *    RETURN VALUE: none
+ *    SIDE EFFECTS: Pops the row's stack
+ */
+static void close_slice(int row, uint64_t tsc, int has_ret, int32_t ret){
+  slice_stack* stack = &rows[row];
+  open_slice* slice = &stack->slices[--stack->depth];
+
+  emit(slice_name(slice->event, slice->arg), 'X', row == 0 ? TRACK_CPU : TRACK_PROCS, row,
+       slice->tsc, tsc, has_ret ? "ret" : NULL, ret);
+}
+
+/*
+ * convert
+ *    DESCRIPTION: Writes every record of the ring as trace events, oldest first
+ *    INPUTS: const trace_header* header - the dump's header
+ *            const trace_rec* recs - its records
+ *    OUTPUTS: JSON to out
+ *    RETURN VALUE: none
+ *    SIDE EFFECTS: none
+ */
+static void convert(const trace_header* header, const trace_rec* recs){
+  uint32_t count = header->head < header->num_records ? header->head : header->num_records;
+  uint32_t first = header->head - count;
+  uint64_t tsc = 0, run_start = 0;
+  int running = -1;               /* pid on the CPU, -1 until the first record */
+  uint32_t i;
+  int row;
+  char name[16];
+
+  fprintf(out, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[");
+  fprintf(out, "\n{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%d,\"args\":{\"name\":\"cpu0\"}}", TRACK_CPU);
+  fprintf(out, ",\n{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%d,\"args\":{\"name\":\"processes\"}}", TRACK_PROCS);
+
+  for(i = 0; i < count; i++){
+    const trace_rec* rec = &recs[(first + i) % header->num_records];
+    tsc = ((uint64_t)rec->tsc_hi << 32) | rec->tsc_lo;
+    if(i == 0){
+      tsc_zero = tsc;
+      run_start = tsc;
+      running = rec->pid;
+    }
+    row = row_for(rec);
+
+    switch(rec->event){
+      case TRACE_SYSCALL_ENTER:
+      case TRACE_READ_DATA_ENTER:
+      case TRACE_KEYBOARD_ENTER:
+        if(rows[row].depth == MAX_DEPTH){
+          break;
+        }
+        rows[row].slices[rows[row].depth].event = rec->event;
+        rows[row].slices[rows[row].depth].arg = rec->arg;
+        rows[row].slices[rows[row].depth].tsc = tsc;
+        rows[row].depth++;
+        break;
+
+      case TRACE_SYSCALL_EXIT:
+      case TRACE_READ_DATA_EXIT:
+      case TRACE_KEYBOARD_EXIT:
+        /* Drop an end whose start is older than the ring */
+        if(rows[row].depth > 0 && rows[row].slices[rows[row].depth - 1].event == rec->event - 1){
+          close_slice(row, tsc, rec->event != TRACE_KEYBOARD_EXIT, (int32_t)rec->arg);
+        }
+        break;
+
+      case TRACE_SWITCH:
+        sprintf(name, "pid %d", running);
+        emit(name, 'X', TRACK_CPU, 0, run_start, tsc, NULL, 0);
+        running = rec->arg;
+        run_start = tsc;
+        break;
+
+      case TRACE_EXECUTE:
+        emit("execute", 'i', TRACK_PROCS, row, tsc, tsc, "pid", (int32_t)rec->arg);
+        break;
+
+      case TRACE_HALT:
+        /* halt never returns, end everything the process had open */
+        emit("halt", 'i', TRACK_PROCS, row, tsc, tsc, "status", (int32_t)rec->arg);
+        while(row != 0 && rows[row].depth > 0){
+          close_slice(row, tsc, 0, 0);
+        }
+        break;
+
+      default:
+        fprintf(stderr, "record %u: unknown event %u\n", first + i, rec->event);
+        break;
+    }
+  }
+
+  /* End whatever is still going at the last record */
+  if(count > 0){
+    sprintf(name, "pid %d", running);
+    emit(name, 'X', TRACK_CPU, 0, run_start, tsc, NULL, 0);
+  }
+  for(row = 0; row <= MAX_PROGS; row++){
+    while(rows[row].depth > 0){
+      close_slice(row, tsc, 0, 0);
+    }
+  }
+
+  fprintf(out, "\n]}\n");
+}
+
+int main(int argc, char* argv[]){
+  const char* in_name = NULL;
+  const char* out_name = NULL;
+  double mhz = 0;
+  trace_header header;
+  trace_rec* recs;
+  uint64_t tsc_start, tsc_tick;
+  FILE* fp;
+  int i;
+
+  for(i = 1; i < argc; i++){
+    if(strcmp(argv[i], "-m") == 0 && i + 1 < argc){
+      mhz = atof(argv[++i]);
+    } else if(in_name == NULL){
+      in_name = argv[i];
+    } else if(out_name == NULL){
+      out_name = argv[i];
+    } else{
+      break;
+    }
+  }
+  if(i != argc || in_name == NULL){
+    fprintf(stderr, "usage: %s [-m <MHz>] <dump> [<out.json>]\n", argv[0]);
+    return 1;
+  }
+
+  if((fp = fopen(in_name, "rb")) == NULL){
+    perror(in_name);
+    return 1;
+  }
+  if(fread(&header, sizeof(header), 1, fp) != 1 || header.magic != TRACE_MAGIC || header.num_records == 0){
+    fprintf(stderr, "%s: not a trace dump\n", in_name);
+    fclose(fp);
+    return 1;
+  }
+  if((recs = malloc(header.num_records * sizeof(trace_rec))) == NULL ||
+     fread(recs, sizeof(trace_rec), header.num_records, fp) != header.num_records){
+    fprintf(stderr, "%s: dump is cut short\n", in_name);
+    free(recs);
+    fclose(fp);
+    return 1;
+  }
+  fclose(fp);
+
+  /* Counter rate from the PIT ticks stamped while tracing was on */
+  tsc_start = ((uint64_t)header.tsc_start_hi << 32) | header.tsc_start_lo;
+  tsc_tick = ((uint64_t)header.tsc_tick_hi << 32) | header.tsc_tick_lo;
+  if(mhz > 0){
+    tsc_per_us = mhz;
+  } else if(header.ticks > 0 && tsc_tick > tsc_start){
+    tsc_per_us = (double)(tsc_tick - tsc_start) / (header.ticks * (1000000.0 / PIT_HZ));
+  } else{
+    fprintf(stderr, "%s: no PIT ticks in the dump, give the rate with -m\n", in_name);
+    free(recs);
+    return 1;
+  }
+
+  if(out_name == NULL){
+    out = stdout;
+  } else if((out = fopen(out_name, "w")) == NULL){
+    perror(out_name);
+    free(recs);
+    return 1;
+  }
+  convert(&header, recs);
+  free(recs);
+  if(out != stdout){
+    fclose(out);
+  }
+  return 0;
+}
@@ -0,0 +1,132 @@
+/* trace.c - Static tracepoints recorded into a binary ring */
+
+#include "trace.h"
+#include "syscalls.h"
+#include "pit.h"
+#include "lib.h"
+
+/* Nonzero while tracepoints record */
+int32_t trace_on = 0;
+
+/* The ring, dump it from gdb with "dump binary value trace.bin trace_log" */
+trace_ring trace_log = {TRACE_MAGIC, 0, TRACE_RECORDS};
+
+/* Read the whole time stamp counter */
+#define read_tsc(lo, hi) asm volatile ("rdtsc" : "=a"(lo), "=d"(hi))
+
+/*
+ * trace_record
+ *    DESCRIPTION: Adds an event to the ring, overwriting the oldest once it
+ *                 is full
+ *    INPUTS: uint32_t event - TRACE_* event
+ *            uint32_t arg - what the event carries
+ *    OUTPUTS: none
+ *    RETURN VALUE: none
+ *    SIDE EFFECTS: Briefly masks interrupts so a handler can't take the same slot
+ */
+void trace_record(uint32_t event, uint32_t arg){
+  unsigned long flags; /* Saved interrupt flag */
+  trace_rec* rec;
+
+  cli_and_save(flags);
+
+  rec = &trace_log.recs[trace_log.head & (TRACE_RECORDS - 1)];
+  trace_log.head++;
+
+  read_tsc(rec->tsc_lo, rec->tsc_hi);
+  rec->event = event;
+  rec->pid = cur_pid;
+  rec->arg = arg;
+
+  restore_flags(flags);
+}
+
+/*
+ * trace_tick
+ *    DESCRIPTION: Stamps the time stamp counter at a PIT tick, the host tool
+ *                 divides by the ticks to get the counter's rate
+ *    INPUTS: none
+ *    OUTPUTS: none
+ *    RETURN VALUE: none
+ *    SIDE EFFECTS: Called from the PIT handler with interrupts masked
+ */
+void trace_tick(void){
+  read_tsc(trace_log.tsc_tick_lo, trace_log.tsc_tick_hi);
+  trace_log.ticks++;
+}
+
+/*
+ * trace_syscall_enter
+ *    DESCRIPTION: Tracepoint as the linkage calls a system call
+ *    INPUTS: int32_t num - index into the system call table
+ *    OUTPUTS: none
+ *    RETURN VALUE: none
+ *    SIDE EFFECTS: none
+ */
+void trace_syscall_enter(int32_t num){
+  /* The table starts at system call 1 */
+  TRACE(TRACE_SYSCALL_ENTER, num + 1);
+}
+
+/*
+ * trace_syscall_exit
+ *    DESCRIPTION: Tracepoint as a system call returns to the linkage
+ *    INPUTS: int32_t ret - what the system call returned
+ *    OUTPUTS: none
+ *    RETURN VALUE: none
+ *    SIDE EFFECTS: none
+ */
+void trace_syscall_exit(int32_t ret){
+  TRACE(TRACE_SYSCALL_EXIT, ret);
+}
+
+/*
+ * trace_ctl
+ *    DESCRIPTION: System call to turn tracing on or off, or to copy the ring
+ *                 out to a user buffer
+ *    INPUTS: int32_t cmd - TRACE_CTL_OFF, TRACE_CTL_ON or TRACE_CTL_READ
+ *            void* buf - where TRACE_CTL_READ copies to
+ *            int32_t nbytes - size of buf
+ *    OUTPUTS: the start of the ring in buf for TRACE_CTL_READ
+ *    RETURN VALUE: bytes copied for TRACE_CTL_READ, 0 for the others, or -1
+ *                  for failure
+ *    SIDE EFFECTS: TRACE_CTL_ON empties the ring and restarts its clock
+ */
+int32_t trace_ctl(int32_t cmd, void* buf, int32_t nbytes){
+  unsigned long flags; /* Saved interrupt flag */
+
+  switch(cmd){
+    case TRACE_CTL_OFF:
+      trace_on = 0;
+      return 0;
+
+    case TRACE_CTL_ON:
+      cli_and_save(flags);
+      trace_log.head = 0;
+      trace_log.ticks = 0;
+      read_tsc(trace_log.tsc_start_lo, trace_log.tsc_start_hi);
+      trace_log.tsc_tick_lo = trace_log.tsc_start_lo;
+      trace_log.tsc_tick_hi = trace_log.tsc_start_hi;
+      trace_on = 1;
+      restore_flags(flags);
+      return 0;
+
+    case TRACE_CTL_READ:
+      /* Check for a valid user buffer */
+      if(buf == NULL || nbytes < 0 || (uint8_t*)buf < (uint8_t*)USER_PROG || nbytes > (uint8_t*)(USER_PROG + FOUR_MB) - (uint8_t*)buf){
+        /* Return failure */
+        return -1;
+      }
+      if(nbytes > sizeof(trace_ring)){
+        nbytes = sizeof(trace_ring);
+      }
+      cli_and_save(flags);
+      memcpy(buf, &trace_log, nbytes);
+      restore_flags(flags);
+      return nbytes;
+
+    default:
+      /* Return failure */
+      return -1;
+  }
+}
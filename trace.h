@@ -0,0 +1,81 @@
+/* trace.h - Static tracepoints recorded into a binary ring */
+
+#ifndef _TRACE_H
+#define _TRACE_H
+
+#include "types.h"
+
+/* Records the ring holds, a power of two so the slot is a mask */
+#define TRACE_RECORDS   4096
+/* First word of the ring, "TRCE" when dumped */
+#define TRACE_MAGIC     0x45435254
+
+/* trace_ctl commands */
+#define TRACE_CTL_OFF   0
+#define TRACE_CTL_ON    1
+#define TRACE_CTL_READ  2
+
+/* Events, tools/trace2json.c has the same list */
+#define TRACE_SYSCALL_ENTER    1   /* arg is the system call number */
+#define TRACE_SYSCALL_EXIT     2   /* arg is the return value */
+#define TRACE_SWITCH           3   /* arg is the pid switched to */
+#define TRACE_EXECUTE          4   /* arg is the pid of the new program */
+#define TRACE_HALT             5   /* arg is the exit status */
+#define TRACE_READ_DATA_ENTER  6   /* arg is the inode */
+#define TRACE_READ_DATA_EXIT   7   /* arg is the bytes read */
+#define TRACE_KEYBOARD_ENTER   8   /* arg is the scan code */
+#define TRACE_KEYBOARD_EXIT    9   /* arg is 0 */
+
+#ifndef ASM
+
+/* One event */
+typedef struct trace_rec {
+  uint32_t tsc_lo;                 /* Time stamp counter when it happened */
+  uint32_t tsc_hi;
+  uint16_t event;                  /* TRACE_* */
+  uint16_t pid;                    /* Process running, 0 before launch */
+  uint32_t arg;
+} trace_rec;
+
+/* The ring, laid out the same in memory, from trace_ctl and in a dump */
+typedef struct trace_ring {
+  uint32_t magic;                  /* TRACE_MAGIC */
+  uint32_t head;                   /* Records ever written, the slot is head % TRACE_RECORDS */
+  uint32_t num_records;            /* TRACE_RECORDS */
+  uint32_t ticks;                  /* PIT ticks since tracing was turned on */
+  uint32_t tsc_start_lo;           /* Time stamp counter when tracing was turned on */
+  uint32_t tsc_start_hi;
+  uint32_t tsc_tick_lo;            /* Time stamp counter at the last PIT tick */
+  uint32_t tsc_tick_hi;
+  trace_rec recs[TRACE_RECORDS];
+} trace_ring;
+
+/* Nonzero while tracepoints record */
+extern int32_t trace_on;
+
+/* The ring, there is one CPU so there is one ring */
+extern trace_ring trace_log;
+
+/* Tracepoint, a single branch the compiler lays out as not taken while tracing is off */
+#define TRACE(event, arg)                              \
+do {                                                   \
+    if(__builtin_expect(trace_on, 0))                  \
+        trace_record((event), (uint32_t)(arg));        \
+} while(0)
+
+/* Add an event to the ring */
+void trace_record(uint32_t event, uint32_t arg);
+
+/* Stamp the PIT tick for the host tool's clock */
+void trace_tick(void);
+
+/* Tracepoints for the system call linkage */
+void trace_syscall_enter(int32_t num);
+void trace_syscall_exit(int32_t ret);
+
+/* Turn tracing on or off, or copy the ring out */
+int32_t trace_ctl(int32_t cmd, void* buf, int32_t nbytes);
+
+#endif /* ASM */
+
+#endif /* _TRACE_H */